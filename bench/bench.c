@@ -0,0 +1,201 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+#include <assert.h>
+
+#include "bench.h"
+
+/*minimum run time of each case (ns)*/
+static uint64_t min_time_ns = BENCH_MIN_TIME_MS * 1000000ULL;
+
+/*json report entries printed so far*/
+static int json_entries = 0;
+
+/*
+ * get the monotonic time
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: time in ns
+ */
+uint64_t bench_time_ns()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((uint64_t) now.tv_sec * 1000000000ULL) + now.tv_nsec;
+}
+
+/*
+ * set the minimum run time of each benchmark case
+ * args:
+ *    ms - time in ms (values < 1 are set to 1)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void bench_set_min_time(int ms)
+{
+	if(ms < 1)
+		ms = 1;
+
+	min_time_ns = (uint64_t) ms * 1000000ULL;
+}
+
+/*
+ * get the minimum run time of each benchmark case
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: time in ns
+ */
+uint64_t bench_get_min_time_ns()
+{
+	return min_time_ns;
+}
+
+/*
+ * run a benchmark case: one untimed warm up call, then timed calls
+ *   until the minimum run time and number of iterations are reached
+ * args:
+ *    func - case function
+ *    data - case data
+ *    result - pointer to result struct to fill
+ *
+ * asserts:
+ *    func is not null
+ *    result is not null
+ *
+ * returns: none
+ */
+void bench_run(bench_func_t func, void *data, bench_result_t *result)
+{
+	/*assertions*/
+	assert(func != NULL);
+	assert(result != NULL);
+
+	result->iterations = 0;
+	result->total_ns = 0;
+	result->min_ns = UINT64_MAX;
+	result->max_ns = 0;
+
+	/*warm up: caches, lazy allocations and cpu clock*/
+	func(data);
+
+	while(result->total_ns < min_time_ns ||
+		result->iterations < BENCH_MIN_ITERATIONS)
+	{
+		uint64_t start = bench_time_ns();
+		func(data);
+		uint64_t elapsed = bench_time_ns() - start;
+
+		result->iterations++;
+		result->total_ns += elapsed;
+		if(elapsed < result->min_ns)
+			result->min_ns = elapsed;
+		if(elapsed > result->max_ns)
+			result->max_ns = elapsed;
+	}
+}
+
+/*
+ * print the start of the json report (to stdout)
+ * args:
+ *    name - benchmark program name
+ *
+ * asserts:
+ *    name is not null
+ *
+ * returns: none
+ */
+void bench_json_begin(const char *name)
+{
+	/*assertions*/
+	assert(name != NULL);
+
+	json_entries = 0;
+	printf("{\n  \"bench\": \"%s\",\n  \"min_time_ms\": %" PRIu64 ",\n  \"results\": [",
+		name, min_time_ns / 1000000);
+}
+
+/*
+ * print a json report entry: fmt holds the entry members
+ *   (without the enclosing braces), the timing members of
+ *   result are appended if it's not null
+ * args:
+ *    result - pointer to timing result (can be null)
+ *    fmt - printf format of the entry members
+ *
+ * asserts:
+ *    fmt is not null
+ *
+ * returns: none
+ */
+void bench_json_entry(const bench_result_t *result, const char *fmt, ...)
+{
+	/*assertions*/
+	assert(fmt != NULL);
+
+	printf("%s\n    {", json_entries ? "," : "");
+
+	va_list ap;
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+
+	if(result != NULL && result->iterations > 0)
+		printf(", \"iterations\": %" PRIu64 ", \"mean_ns\": %" PRIu64
+			", \"min_ns\": %" PRIu64 ", \"max_ns\": %" PRIu64,
+			result->iterations, result->total_ns / result->iterations,
+			result->min_ns, result->max_ns);
+
+	printf("}");
+	fflush(stdout);
+
+	json_entries++;
+}
+
+/*
+ * print the end of the json report
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void bench_json_end()
+{
+	printf("\n  ]\n}\n");
+}
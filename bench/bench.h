@@ -0,0 +1,145 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+/*
+ * default minimum run time of each benchmark case (ms)
+ */
+#define BENCH_MIN_TIME_MS (200)
+
+/*
+ * minimum number of timed calls of each benchmark case
+ */
+#define BENCH_MIN_ITERATIONS (5)
+
+typedef struct _bench_result_t
+{
+	uint64_t iterations; //timed calls
+	uint64_t total_ns; //total time of the timed calls (ns)
+	uint64_t min_ns; //fastest call (ns)
+	uint64_t max_ns; //slowest call (ns)
+} bench_result_t;
+
+/*
+ * benchmark case: one call is one timed operation
+ * args:
+ *    data - case data
+ */
+typedef void (*bench_func_t)(void *data);
+
+/*
+ * get the monotonic time
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: time in ns
+ */
+uint64_t bench_time_ns();
+
+/*
+ * set the minimum run time of each benchmark case
+ * args:
+ *    ms - time in ms (values < 1 are set to 1)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void bench_set_min_time(int ms);
+
+/*
+ * get the minimum run time of each benchmark case
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: time in ns
+ */
+uint64_t bench_get_min_time_ns();
+
+/*
+ * run a benchmark case: one untimed warm up call, then timed calls
+ *   until the minimum run time and number of iterations are reached
+ * args:
+ *    func - case function
+ *    data - case data
+ *    result - pointer to result struct to fill
+ *
+ * asserts:
+ *    func is not null
+ *    result is not null
+ *
+ * returns: none
+ */
+void bench_run(bench_func_t func, void *data, bench_result_t *result);
+
+/*
+ * print the start of the json report (to stdout)
+ * args:
+ *    name - benchmark program name
+ *
+ * asserts:
+ *    name is not null
+ *
+ * returns: none
+ */
+void bench_json_begin(const char *name);
+
+/*
+ * print a json report entry: fmt holds the entry members
+ *   (without the enclosing braces), the timing members of
+ *   result are appended if it's not null
+ * args:
+ *    result - pointer to timing result (can be null)
+ *    fmt - printf format of the entry members
+ *
+ * asserts:
+ *    fmt is not null
+ *
+ * returns: none
+ */
+void bench_json_entry(const bench_result_t *result, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+/*
+ * print the end of the json report
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void bench_json_end();
+
+#endif
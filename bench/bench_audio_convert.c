@@ -0,0 +1,231 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*******************************************************************************#
+#                                                                               #
+#  Audio conversion benchmark: times the audio_convert sample conversions       #
+#  (float to int16, float to int16/float planes and back) against the scalar   #
+#  lroundf float to int16 loop, for common buffer sizes and channel counts     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "gview.h"
+#include "audio_convert.h"
+#include "bench.h"
+
+#if defined(__SSE2__)
+#define CONVERT_PATH "sse2"
+#elif defined(__aarch64__)
+#define CONVERT_PATH "neon"
+#else
+#define CONVERT_PATH "scalar"
+#endif
+
+/*frames per buffer (capture buffer sizes)*/
+static const int convert_frames[] = {1024, 4096};
+
+#define CONVERT_N_FRAMES (int)(sizeof(convert_frames)/sizeof(int))
+
+static const int convert_channels[] = {1, 2, 4, 6};
+
+#define CONVERT_N_CHANNELS (int)(sizeof(convert_channels)/sizeof(int))
+
+typedef struct _convert_case_t
+{
+	sample_t *in;
+	void *out;
+	int frames;
+	int channels;
+} convert_case_t;
+
+/*
+ * scalar reference: float to int16 with lroundf
+ * args:
+ *    data - pointer to convert_case_t
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void run_scalar_s16(void *data)
+{
+	convert_case_t *c = (convert_case_t *) data;
+	int16_t *out = (int16_t *) c->out;
+	int samples = c->frames * c->channels;
+
+	int i = 0;
+	for(i = 0; i < samples; i++)
+	{
+		float x = c->in[i] * INT16_MAX;
+		out[i] = (x >= INT16_MAX) ? INT16_MAX :
+			(x <= INT16_MIN) ? INT16_MIN : (int16_t) lroundf(x);
+	}
+}
+
+static void run_float_to_s16(void *data)
+{
+	convert_case_t *c = (convert_case_t *) data;
+	audio_convert_float_to_s16((int16_t *) c->out, c->in, c->frames * c->channels);
+}
+
+static void run_float_to_s16p(void *data)
+{
+	convert_case_t *c = (convert_case_t *) data;
+	audio_convert_float_to_s16p((int16_t *) c->out, c->in, c->frames, c->channels);
+}
+
+static void run_float_to_fltp(void *data)
+{
+	convert_case_t *c = (convert_case_t *) data;
+	audio_convert_float_to_fltp((float *) c->out, c->in, c->frames, c->channels);
+}
+
+static void run_fltp_to_float(void *data)
+{
+	convert_case_t *c = (convert_case_t *) data;
+	audio_convert_fltp_to_float((sample_t *) c->out, c->in, c->frames, c->channels);
+}
+
+typedef struct _convert_func_t
+{
+	const char *name;
+	bench_func_t func;
+} convert_func_t;
+
+static const convert_func_t convert_funcs[] =
+{
+	{"scalar_lroundf_s16",          run_scalar_s16},
+	{"audio_convert_float_to_s16",  run_float_to_s16},
+	{"audio_convert_float_to_s16p", run_float_to_s16p},
+	{"audio_convert_float_to_fltp", run_float_to_fltp},
+	{"audio_convert_fltp_to_float", run_fltp_to_float}
+};
+
+#define CONVERT_N_FUNCS (int)(sizeof(convert_funcs)/sizeof(convert_func_t))
+
+/*
+ * time every conversion for a buffer size and channel count
+ * args:
+ *    frames - frames per buffer
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void bench_convert(int frames, int channels)
+{
+	int samples = frames * channels;
+
+	convert_case_t c;
+	c.frames = frames;
+	c.channels = channels;
+	c.in = malloc(samples * sizeof(sample_t));
+	c.out = malloc(samples * sizeof(float)); //large enough for any output
+	if(c.in == NULL || c.out == NULL)
+	{
+		fprintf(stderr, "BENCH: FATAL memory allocation failure (bench_convert): %s\n",
+			strerror(errno));
+		exit(-1);
+	}
+
+	/*pseudo random samples in [-1.0, 1.0]*/
+	uint32_t seed = 0x12345678;
+	int i = 0;
+	for(i = 0; i < samples; i++)
+	{
+		seed = seed * 1664525 + 1013904223;
+		c.in[i] = ((float) (seed >> 8) / (float) (1 << 23)) - 1.0f;
+	}
+
+	for(i = 0; i < CONVERT_N_FUNCS; i++)
+	{
+		bench_result_t result;
+		bench_run(convert_funcs[i].func, &c, &result);
+
+		double mean_ns = result.iterations ?
+			(double) result.total_ns / result.iterations : 0;
+
+		bench_json_entry(&result,
+			"\"function\": \"%s\", \"frames\": %i, \"channels\": %i, "
+			"\"ns_per_sample\": %.3f, \"msamples_per_s\": %.1f",
+			convert_funcs[i].name, frames, channels,
+			mean_ns / samples, mean_ns > 0 ? (samples * 1000.0) / mean_ns : 0);
+	}
+
+	free(c.in);
+	free(c.out);
+}
+
+/*
+ * print the command line usage
+ * args:
+ *    prog - program name
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-t min_time_ms]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt = 0;
+
+	while((opt = getopt(argc, argv, "t:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 't':
+				bench_set_min_time(atoi(optarg));
+				break;
+			default:
+				usage(argv[0]);
+				return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	bench_json_begin("audio_convert");
+
+	bench_json_entry(NULL, "\"simd\": \"%s\"", CONVERT_PATH);
+
+	int i = 0, j = 0;
+	for(i = 0; i < CONVERT_N_FRAMES; i++)
+		for(j = 0; j < CONVERT_N_CHANNELS; j++)
+			bench_convert(convert_frames[i], convert_channels[j]);
+
+	bench_json_end();
+
+	return 0;
+}
@@ -0,0 +1,207 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*******************************************************************************#
+#                                                                               #
+#  Audio fx benchmark: times audio_fx_apply for each audio effect (and all of  #
+#  them chained) in ns per sample, with the capture buffer size guvcview uses  #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "gview.h"
+#include "audio.h"
+#include "bench.h"
+
+/*frames per capture buffer (AUDBUFF_FRAMES) and sample rate*/
+#define FX_FRAMES   (1152)
+#define FX_SAMPRATE (48000)
+
+typedef struct _fx_effect_t
+{
+	const char *name;
+	uint32_t mask;
+} fx_effect_t;
+
+static const fx_effect_t fx_effects[] =
+{
+	{"none",   AUDIO_FX_NONE}, //buffer copy only (baseline)
+	{"echo",   AUDIO_FX_ECHO},
+	{"fuzz",   AUDIO_FX_FUZZ},
+	{"reverb", AUDIO_FX_REVERB},
+	{"wahwah", AUDIO_FX_WAHWAH},
+	{"ducky",  AUDIO_FX_DUCKY},
+	{"all",    AUDIO_FX_ECHO | AUDIO_FX_FUZZ | AUDIO_FX_REVERB |
+		AUDIO_FX_WAHWAH | AUDIO_FX_DUCKY}
+};
+
+#define FX_N_EFFECTS (int)(sizeof(fx_effects)/sizeof(fx_effect_t))
+
+static const int fx_channels[] = {1, 2};
+
+#define FX_N_CHANNELS (int)(sizeof(fx_channels)/sizeof(int))
+
+typedef struct _fx_case_t
+{
+	audio_context_t *audio_ctx;
+	sample_t *in;   //captured samples
+	sample_t *data; //buffer processed in place
+	int samples;
+	uint32_t mask;
+} fx_case_t;
+
+/*
+ * apply the fx to a fresh copy of the captured samples
+ * args:
+ *    data - pointer to fx_case_t
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void run_fx_apply(void *data)
+{
+	fx_case_t *c = (fx_case_t *) data;
+
+	memcpy(c->data, c->in, c->samples * sizeof(sample_t));
+	audio_fx_apply(c->audio_ctx, c->data, c->mask);
+}
+
+/*
+ * time every audio fx for a channel count
+ * args:
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void bench_fx(int channels)
+{
+	fx_case_t c;
+	memset(&c, 0, sizeof(fx_case_t));
+
+	c.audio_ctx = audio_init(AUDIO_NONE, -1);
+	if(c.audio_ctx == NULL)
+	{
+		fprintf(stderr, "BENCH: couldn't create the audio context\n");
+		exit(-1);
+	}
+
+	c.samples = FX_FRAMES * channels;
+	audio_set_channels(c.audio_ctx, channels);
+	audio_set_samprate(c.audio_ctx, FX_SAMPRATE);
+	audio_set_cap_buffer_size(c.audio_ctx, c.samples);
+	/*audio_start only allocates the fx state for a real api*/
+	audio_fx_init(c.audio_ctx);
+
+	c.in = malloc(c.samples * sizeof(sample_t));
+	c.data = malloc(c.samples * sizeof(sample_t));
+	if(c.in == NULL || c.data == NULL)
+	{
+		fprintf(stderr, "BENCH: FATAL memory allocation failure (bench_fx): %s\n",
+			strerror(errno));
+		exit(-1);
+	}
+
+	/*a 440 Hz tone with some pseudo random noise*/
+	uint32_t seed = 0x12345678;
+	int i = 0;
+	for(i = 0; i < c.samples; i++)
+	{
+		seed = seed * 1664525 + 1013904223;
+		float noise = ((float) (seed >> 8) / (float) (1 << 23)) - 1.0f;
+		c.in[i] = 0.5f * sinf(2 * M_PI * 440 * (i / channels) / FX_SAMPRATE) +
+			0.05f * noise;
+	}
+
+	for(i = 0; i < FX_N_EFFECTS; i++)
+	{
+		c.mask = fx_effects[i].mask;
+
+		bench_result_t result;
+		bench_run(run_fx_apply, &c, &result);
+
+		double mean_ns = result.iterations ?
+			(double) result.total_ns / result.iterations : 0;
+
+		bench_json_entry(&result,
+			"\"fx\": \"%s\", \"frames\": %i, \"channels\": %i, \"samprate\": %i, "
+			"\"ns_per_sample\": %.3f",
+			fx_effects[i].name, FX_FRAMES, channels, FX_SAMPRATE,
+			mean_ns / c.samples);
+	}
+
+	audio_close(c.audio_ctx);
+	free(c.in);
+	free(c.data);
+}
+
+/*
+ * print the command line usage
+ * args:
+ *    prog - program name
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-t min_time_ms]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt = 0;
+
+	while((opt = getopt(argc, argv, "t:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 't':
+				bench_set_min_time(atoi(optarg));
+				break;
+			default:
+				usage(argv[0]);
+				return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	bench_json_begin("audio_fx");
+
+	int i = 0;
+	for(i = 0; i < FX_N_CHANNELS; i++)
+		bench_fx(fx_channels[i]);
+
+	bench_json_end();
+
+	return 0;
+}
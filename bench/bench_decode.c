@@ -0,0 +1,841 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*******************************************************************************#
+#                                                                               #
+#  Frame decoding benchmark (no capture device needed): times every raw         #
+#  format converter used by decode_v4l2_frame, bayer_to_rgb24, the builtin     #
+#  and libavcodec jpeg decoders and the h264 decoder at 480p, 720p, 1080p      #
+#  and 4K and prints the results in json                                       #
+#                                                                               #
+#  raw formats use synthetic frames; compressed formats use the recorded       #
+#  samples in the samples dir (mjpeg_<width>x<height>.jpg - one mjpeg frame,   #
+#  h264_<width>x<height>.h264 - one annex b access unit with sps/pps/idr)     #
+#  or, if missing, frames encoded here (save_image_jpeg and the libavcodec     #
+#  h264 encoder, if available)                                                  #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include "gviewv4l2core.h"
+#include "colorspaces.h"
+#include "frame_decoder.h"
+#include "jpeg_decoder.h"
+#include "uvc_h264.h"
+#include "save_image.h"
+#include "decoder_pool.h"
+#include "gview.h"
+#include "../config.h"
+#include "bench.h"
+#include "bench_jpeg.h"
+
+#ifndef BENCH_SAMPLES_DIR
+#define BENCH_SAMPLES_DIR "samples"
+#endif
+
+typedef struct _bench_size_t
+{
+	const char *name;
+	int width;
+	int height;
+} bench_size_t;
+
+static const bench_size_t bench_sizes[] =
+{
+	{"480p",   640,  480},
+	{"720p",  1280,  720},
+	{"1080p", 1920, 1080},
+	{"4k",    3840, 2160}
+};
+
+#define BENCH_N_SIZES (int)(sizeof(bench_sizes)/sizeof(bench_size_t))
+
+typedef void (*yu12_conv_t)(uint8_t *out, uint8_t *in, int width, int height);
+
+/*
+ * yu12 is copied as is by decode_v4l2_frame
+ * args:
+ *    out - pointer to output yu12 buffer
+ *    in - pointer to input yu12 buffer
+ *    width - frame width
+ *    height - frame height
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void yu12_copy(uint8_t *out, uint8_t *in, int width, int height)
+{
+	memcpy(out, in, (width * height * 3) / 2);
+}
+
+typedef struct _bench_conv_t
+{
+	const char *format; //v4l2 fourcc
+	const char *function; //converter name
+	yu12_conv_t convert;
+	int pix_order; //bayer pixel order (-1 - not bayer)
+} bench_conv_t;
+
+#define CONV(fmt, func) {fmt, #func, func, -1}
+#define BAYER(fmt, order) {fmt, "bayer_to_rgb24+rgb24_to_yu12", rgb24_to_yu12, order}
+
+/*same converters as decode_v4l2_frame_ctx*/
+static const bench_conv_t bench_convs[] =
+{
+	CONV("YUYV", yuyv_to_yu12),
+	CONV("UYVY", uyvy_to_yu12),
+	CONV("VYUY", vyuy_to_yu12),
+	CONV("YVYU", yvyu_to_yu12),
+	CONV("YYUV", yyuv_to_yu12),
+	CONV("Y444", y444_to_yu12),
+	CONV("YUVO", yuvo_to_yu12),
+	CONV("YUVP", yuvp_to_yu12),
+	CONV("YUV4", yuv4_to_yu12),
+	CONV("YU12", yu12_copy),
+	CONV("422P", yuv422p_to_yu12),
+	CONV("YV12", yv12_to_yu12),
+	CONV("NV12", nv12_to_yu12),
+	CONV("NV21", nv21_to_yu12),
+	CONV("NV16", nv16_to_yu12),
+	CONV("NV61", nv61_to_yu12),
+	CONV("NV24", nv24_to_yu12),
+	CONV("NV42", nv42_to_yu12),
+	CONV("Y41P", y41p_to_yu12),
+	CONV("GREY", grey_to_yu12),
+	CONV("Y10B", y10b_to_yu12),
+	CONV("Y16 ", y16_to_yu12),
+	CONV("Y16X", y16x_to_yu12),
+	CONV("S501", s501_to_yu12),
+	CONV("S505", s505_to_yu12),
+	CONV("S508", s508_to_yu12),
+	BAYER("GBRG", 0),
+	BAYER("GRBG", 1),
+	BAYER("BA81", 2),
+	BAYER("RGGB", 3),
+	CONV("RGB3", rgb24_to_yu12),
+	CONV("BGR3", bgr24_to_yu12),
+	CONV("RGB1", rgb1_to_yu12),
+	CONV("RGBP", rgbp_to_yu12),
+	CONV("RGBR", rgbr_to_yu12),
+	CONV("AR12", ar12_to_yu12),
+	CONV("AR15", ar15_to_yu12),
+	CONV("AR15X", ar15x_to_yu12),
+	CONV("BGRH", bgrh_to_yu12),
+	CONV("AR24", ar24_to_yu12),
+	CONV("BA24", ba24_to_yu12)
+};
+
+#define BENCH_N_CONVS (int)(sizeof(bench_convs)/sizeof(bench_conv_t))
+
+typedef struct _conv_case_t
+{
+	const bench_conv_t *conv;
+	uint8_t *in; //raw frame
+	uint8_t *out; //yu12 frame
+	uint8_t *tmp; //rgb24 frame (bayer)
+	int width;
+	int height;
+	int pix_order; //bayer_to_rgb24 only
+} conv_case_t;
+
+typedef struct _jpeg_case_t
+{
+	int (*decode)(jpeg_decoder_context_t *ctx, uint8_t *out_buf, uint8_t *in_buf, int size);
+	jpeg_decoder_context_t *ctx;
+	uint8_t *in;
+	int size;
+	uint8_t *out;
+} jpeg_case_t;
+
+typedef struct _h264_case_t
+{
+	uint8_t *in;
+	int size;
+	uint8_t *out;
+} h264_case_t;
+
+/*
+ * allocate a buffer or exit
+ * args:
+ *    size - buffer size
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to zeroed buffer
+ */
+static uint8_t *bench_alloc(size_t size)
+{
+	uint8_t *buf = calloc(size, 1);
+	if(buf == NULL)
+	{
+		fprintf(stderr, "BENCH: FATAL memory allocation failure (bench_alloc): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	return buf;
+}
+
+/*
+ * fill a buffer with pseudo random data (same data on every run)
+ * args:
+ *    buf - pointer to buffer
+ *    size - buffer size
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void fill_random(uint8_t *buf, size_t size)
+{
+	uint32_t seed = 0x12345678;
+	size_t i = 0;
+
+	for(i = 0; i < size; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		buf[i] = (uint8_t) (seed >> 16);
+	}
+}
+
+/*
+ * fill a yu12 frame with a smooth test pattern (compresses like a
+ *   camera frame, unlike random data)
+ * args:
+ *    buf - pointer to yu12 buffer
+ *    width - frame width
+ *    height - frame height
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void fill_pattern(uint8_t *buf, int width, int height)
+{
+	int i = 0;
+	int j = 0;
+
+	for(j = 0; j < height; j++)
+		for(i = 0; i < width; i++)
+			buf[j * width + i] = (uint8_t) (((i * 255) / width + (j * 255) / height) / 2 +
+				(((i / 32) + (j / 32)) % 2) * 32);
+
+	uint8_t *u = buf + width * height;
+	uint8_t *v = u + (width * height) / 4;
+	for(j = 0; j < height / 2; j++)
+		for(i = 0; i < width / 2; i++)
+		{
+			u[j * (width / 2) + i] = (uint8_t) (64 + (i * 128) / (width / 2));
+			v[j * (width / 2) + i] = (uint8_t) (192 - (j * 128) / (height / 2));
+		}
+}
+
+/*
+ * read a whole file
+ * args:
+ *    filename - file to read
+ *    size - pointer to returned data size
+ *
+ * asserts:
+ *    size is not null
+ *
+ * returns: pointer to file data (must be freed) or NULL on error
+ */
+static uint8_t *load_file(const char *filename, int *size)
+{
+	/*assertions*/
+	assert(size != NULL);
+
+	FILE *fp = fopen(filename, "rb");
+	if(fp == NULL)
+		return NULL;
+
+	uint8_t *data = NULL;
+	long len = -1;
+
+	if(fseek(fp, 0, SEEK_END) == 0)
+		len = ftell(fp);
+
+	if(len > 0 && fseek(fp, 0, SEEK_SET) == 0)
+	{
+		/*the builtin jpeg decoder may read a few bytes past the end*/
+		data = bench_alloc(len + 64);
+		if(fread(data, len, 1, fp) < 1)
+		{
+			free(data);
+			data = NULL;
+		}
+	}
+
+	fclose(fp);
+
+	*size = (int) len;
+	return data;
+}
+
+/*
+ * load a recorded sample
+ * args:
+ *    dir - samples dir
+ *    prefix - sample type (mjpeg, h264)
+ *    ext - file extension
+ *    width - frame width
+ *    height - frame height
+ *    size - pointer to returned data size
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to sample data (must be freed) or NULL if not found
+ */
+static uint8_t *load_sample(const char *dir, const char *prefix, const char *ext,
+	int width, int height, int *size)
+{
+	char filename[1024];
+	snprintf(filename, sizeof(filename), "%s/%s_%ix%i.%s", dir, prefix, width, height, ext);
+
+	return load_file(filename, size);
+}
+
+/*
+ * encode a test pattern frame to jpeg (save_image_jpeg)
+ * args:
+ *    width - frame width
+ *    height - frame height
+ *    size - pointer to returned data size
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to jpeg data (must be freed) or NULL on error
+ */
+static uint8_t *synth_jpeg(int width, int height, int *size)
+{
+	char filename[] = "/tmp/guvcview_bench_XXXXXX";
+	int fd = mkstemp(filename);
+	if(fd < 0)
+	{
+		fprintf(stderr, "BENCH: couldn't create a temporary file: %s\n", strerror(errno));
+		return NULL;
+	}
+	close(fd);
+
+	v4l2_frame_buff_t frame;
+	memset(&frame, 0, sizeof(v4l2_frame_buff_t));
+	frame.width = width;
+	frame.height = height;
+	frame.yuv_frame = bench_alloc((width * height * 3) / 2);
+	fill_pattern(frame.yuv_frame, width, height);
+
+	uint8_t *data = NULL;
+	if(save_image_jpeg(&frame, filename) == E_OK)
+		data = load_file(filename, size);
+
+	save_image_jpeg_clean_cache();
+	unlink(filename);
+	free(frame.yuv_frame);
+
+	return data;
+}
+
+/*
+ * encode a test pattern frame to h264 (libavcodec h264 encoder)
+ * args:
+ *    width - frame width
+ *    height - frame height
+ *    size - pointer to returned data size
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to h264 access unit with sps/pps/idr (must be freed)
+ *   or NULL if no h264 encoder is available
+ */
+static uint8_t *synth_h264(int width, int height, int *size)
+{
+	uint8_t *data = NULL;
+#if LIBAVCODEC_VER_AT_LEAST(57,37)
+	const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+	if(codec == NULL)
+		return NULL;
+
+	AVCodecContext *codec_ctx = avcodec_alloc_context3(codec);
+	if(codec_ctx == NULL)
+		return NULL;
+
+	codec_ctx->width = width;
+	codec_ctx->height = height;
+	codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+	codec_ctx->time_base.num = 1;
+	codec_ctx->time_base.den = 30;
+	codec_ctx->gop_size = 1;
+	codec_ctx->max_b_frames = 0;
+
+	if(avcodec_open2(codec_ctx, codec, NULL) < 0)
+	{
+		avcodec_free_context(&codec_ctx);
+		return NULL;
+	}
+
+	AVFrame *picture = av_frame_alloc();
+	AVPacket *packet = av_packet_alloc();
+	uint8_t *yu12 = bench_alloc((width * height * 3) / 2);
+	fill_pattern(yu12, width, height);
+
+	picture->format = AV_PIX_FMT_YUV420P;
+	picture->width = width;
+	picture->height = height;
+	picture->pts = 0;
+
+	if(av_frame_get_buffer(picture, 0) == 0)
+	{
+		int plane = 0;
+		uint8_t *src = yu12;
+		for(plane = 0; plane < 3; plane++)
+		{
+			int w = plane ? width / 2 : width;
+			int h = plane ? height / 2 : height;
+			int line = 0;
+			for(line = 0; line < h; line++)
+				memcpy(picture->data[plane] + line * picture->linesize[plane], src + line * w, w);
+			src += w * h;
+		}
+
+		/*send the frame and flush: the idr comes out with sps/pps*/
+		if(avcodec_send_frame(codec_ctx, picture) == 0 &&
+			avcodec_send_frame(codec_ctx, NULL) == 0 &&
+			avcodec_receive_packet(codec_ctx, packet) == 0)
+		{
+			data = bench_alloc(packet->size + AV_INPUT_BUFFER_PADDING_SIZE);
+			memcpy(data, packet->data, packet->size);
+			*size = packet->size;
+		}
+	}
+
+	free(yu12);
+	av_packet_free(&packet);
+	av_frame_free(&picture);
+	avcodec_free_context(&codec_ctx);
+#else
+	(void) width;
+	(void) height;
+	(void) size;
+#endif
+	return data;
+}
+
+/*
+ * get the restart interval (DRI) of a jpeg frame
+ *   (the builtin decoder only uses threads for frames with restart markers)
+ * args:
+ *    data - pointer to jpeg data
+ *    size - data size
+ *
+ * asserts:
+ *    data is not null
+ *
+ * returns: restart interval in mcus (0 - none)
+ */
+static int jpeg_restart_interval(uint8_t *data, int size)
+{
+	/*assertions*/
+	assert(data != NULL);
+
+	int i = 0;
+	for(i = 0; i + 5 < size; i++)
+	{
+		if(data[i] != 0xFF)
+			continue;
+		if(data[i + 1] == 0xDA) /*start of scan: no DRI*/
+			break;
+		if(data[i + 1] == 0xDD)
+			return (data[i + 4] << 8) | data[i + 5];
+	}
+
+	return 0;
+}
+
+/*
+ * bench case: convert a raw frame to yu12
+ * args:
+ *    data - pointer to case data
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void run_conv(void *data)
+{
+	conv_case_t *c = (conv_case_t *) data;
+
+	if(c->conv->pix_order >= 0)
+	{
+		bayer_to_rgb24(c->in, c->tmp, c->width, c->height, c->conv->pix_order);
+		c->conv->convert(c->out, c->tmp, c->width, c->height);
+	}
+	else
+		c->conv->convert(c->out, c->in, c->width, c->height);
+}
+
+/*
+ * bench case: bayer_to_rgb24
+ * args:
+ *    data - pointer to case data
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void run_bayer(void *data)
+{
+	conv_case_t *c = (conv_case_t *) data;
+
+	bayer_to_rgb24(c->in, c->tmp, c->width, c->height, c->pix_order);
+}
+
+/*
+ * bench case: decode a jpeg frame
+ * args:
+ *    data - pointer to case data
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void run_jpeg(void *data)
+{
+	jpeg_case_t *c = (jpeg_case_t *) data;
+
+	c->decode(c->ctx, c->out, c->in, c->size);
+}
+
+/*
+ * bench case: decode a h264 access unit
+ * args:
+ *    data - pointer to case data
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void run_h264(void *data)
+{
+	h264_case_t *c = (h264_case_t *) data;
+
+	h264_decode(c->out, c->in, c->size);
+}
+
+/*
+ * add a json result with the frame rate of a case
+ * args:
+ *    result - pointer to timing result
+ *    function - function name
+ *    format - v4l2 fourcc (or NULL)
+ *    size - pointer to frame size
+ *    extra - extra json members (or NULL)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void add_result(bench_result_t *result, const char *function,
+	const char *format, const bench_size_t *size, const char *extra)
+{
+	uint64_t mean_ns = result->total_ns / result->iterations;
+	double mpixels = mean_ns ?
+		((double) size->width * size->height * 1000.0) / mean_ns : 0;
+
+	bench_json_entry(result,
+		"\"function\": \"%s\"%s%s%s, \"size\": \"%s\", \"width\": %i, \"height\": %i%s%s"
+		", \"mpixels_per_s\": %.1f",
+		function,
+		format ? ", \"format\": \"" : "", format ? format : "", format ? "\"" : "",
+		size->name, size->width, size->height,
+		extra ? ", " : "", extra ? extra : "",
+		mpixels);
+}
+
+/*
+ * time the raw format converters and bayer_to_rgb24
+ * args:
+ *    size - pointer to frame size
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void bench_converters(const bench_size_t *size)
+{
+	conv_case_t c;
+	memset(&c, 0, sizeof(conv_case_t));
+
+	c.width = size->width;
+	c.height = size->height;
+
+	/*large enough for every raw format (max 4 bytes per pixel)*/
+	c.in = bench_alloc(size->width * size->height * 4);
+	c.out = bench_alloc(size->width * size->height * 3 / 2);
+	c.tmp = bench_alloc(size->width * size->height * 3);
+	fill_random(c.in, size->width * size->height * 4);
+
+	bench_result_t result;
+	int i = 0;
+
+	for(i = 0; i < BENCH_N_CONVS; i++)
+	{
+		c.conv = &bench_convs[i];
+		bench_run(run_conv, &c, &result);
+		add_result(&result, c.conv->function, c.conv->format, size, NULL);
+	}
+
+	for(i = 0; i < 4; i++)
+	{
+		char extra[32];
+		snprintf(extra, sizeof(extra), "\"pix_order\": %i", i);
+
+		c.pix_order = i;
+		bench_run(run_bayer, &c, &result);
+		add_result(&result, "bayer_to_rgb24", NULL, size, extra);
+	}
+
+	free(c.in);
+	free(c.out);
+	free(c.tmp);
+}
+
+/*
+ * time the builtin (single and multi thread) and libavcodec jpeg decoders
+ * args:
+ *    size - pointer to frame size
+ *    samples_dir - recorded samples dir
+ *    threads - decoder threads for the builtin decoder
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void bench_jpeg(const bench_size_t *size, const char *samples_dir, int threads)
+{
+	const char *source = "sample";
+	int jpeg_size = 0;
+	uint8_t *jpeg = load_sample(samples_dir, "mjpeg", "jpg", size->width, size->height, &jpeg_size);
+	if(jpeg == NULL)
+	{
+		source = "synthetic";
+		jpeg = synth_jpeg(size->width, size->height, &jpeg_size);
+	}
+	if(jpeg == NULL)
+	{
+		bench_json_entry(NULL, "\"function\": \"jpeg_decode\", \"size\": \"%s\", "
+			"\"skipped\": \"no jpeg frame\"", size->name);
+		return;
+	}
+
+	jpeg_case_t c;
+	c.in = jpeg;
+	c.size = jpeg_size;
+	c.out = bench_alloc(size->width * size->height * 2);
+
+	int dri = jpeg_restart_interval(jpeg, jpeg_size);
+	decoder_pool_t *pool = decoder_pool_create(threads);
+
+	char extra[160];
+	bench_result_t result;
+
+	/*builtin decoder: single thread, then with the decoder pool*/
+	c.decode = bench_builtin_jpeg_decode_ctx;
+	c.ctx = bench_builtin_jpeg_init_decoder_ctx(size->width, size->height);
+	if(c.ctx != NULL && c.decode(c.ctx, c.out, c.in, c.size) == 0)
+	{
+		int pass = 0;
+		for(pass = 0; pass < 2; pass++)
+		{
+			if(pass == 1)
+			{
+				if(pool == NULL)
+					break;
+				bench_builtin_jpeg_set_decoder_pool(c.ctx, pool);
+			}
+
+			snprintf(extra, sizeof(extra),
+				"\"decoder\": \"builtin\", \"threads\": %i, \"source\": \"%s\", "
+				"\"bytes\": %i, \"restart_interval\": %i",
+				pass ? decoder_pool_get_threads(pool) : 1, source, jpeg_size, dri);
+			bench_run(run_jpeg, &c, &result);
+			add_result(&result, "jpeg_decode", "MJPG", size, extra);
+		}
+	}
+	else
+		bench_json_entry(NULL, "\"function\": \"jpeg_decode\", \"decoder\": \"builtin\", "
+			"\"size\": \"%s\", \"skipped\": \"decoding failed\"", size->name);
+
+	if(c.ctx != NULL)
+		bench_builtin_jpeg_close_decoder_ctx(c.ctx);
+
+	/*libavcodec decoder*/
+	c.decode = bench_libav_jpeg_decode_ctx;
+	c.ctx = bench_libav_jpeg_init_decoder_ctx(size->width, size->height);
+	if(c.ctx != NULL && c.decode(c.ctx, c.out, c.in, c.size) > 0)
+	{
+		snprintf(extra, sizeof(extra),
+			"\"decoder\": \"libav\", \"source\": \"%s\", \"bytes\": %i",
+			source, jpeg_size);
+		bench_run(run_jpeg, &c, &result);
+		add_result(&result, "jpeg_decode", "MJPG", size, extra);
+	}
+	else
+		bench_json_entry(NULL, "\"function\": \"jpeg_decode\", \"decoder\": \"libav\", "
+			"\"size\": \"%s\", \"skipped\": \"no libavcodec mjpeg decoder\"", size->name);
+
+	if(c.ctx != NULL)
+		bench_libav_jpeg_close_decoder_ctx(c.ctx);
+
+	if(pool != NULL)
+		decoder_pool_destroy(pool);
+
+	free(c.out);
+	free(jpeg);
+}
+
+/*
+ * time the h264 decoder
+ * args:
+ *    size - pointer to frame size
+ *    samples_dir - recorded samples dir
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void bench_h264(const bench_size_t *size, const char *samples_dir)
+{
+	const char *source = "sample";
+	h264_case_t c;
+	c.size = 0;
+	c.in = load_sample(samples_dir, "h264", "h264", size->width, size->height, &c.size);
+	if(c.in == NULL)
+	{
+		source = "synthetic";
+		c.in = synth_h264(size->width, size->height, &c.size);
+	}
+	if(c.in == NULL)
+	{
+		bench_json_entry(NULL, "\"function\": \"h264_decode\", \"size\": \"%s\", "
+			"\"skipped\": \"no h264 sample or encoder\"", size->name);
+		return;
+	}
+
+	if(h264_init_decoder(size->width, size->height) != E_OK)
+	{
+		bench_json_entry(NULL, "\"function\": \"h264_decode\", \"size\": \"%s\", "
+			"\"skipped\": \"no h264 decoder\"", size->name);
+		free(c.in);
+		return;
+	}
+
+	c.out = bench_alloc(size->width * size->height * 3 / 2);
+
+	char extra[96];
+	snprintf(extra, sizeof(extra), "\"source\": \"%s\", \"bytes\": %i", source, c.size);
+
+	/*every call decodes the same idr access unit*/
+	bench_result_t result;
+	bench_run(run_h264, &c, &result);
+	add_result(&result, "h264_decode", "H264", size, extra);
+
+	h264_close_decoder();
+	free(c.out);
+	free(c.in);
+}
+
+/*
+ * print the command line usage
+ * args:
+ *    prog - program name
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-t min_time_ms] [-s samples_dir] [-j jpeg_threads]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *samples_dir = BENCH_SAMPLES_DIR;
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	int threads = ncpu > DECODER_MAX_THREADS ? DECODER_MAX_THREADS : (int) ncpu;
+	int opt = 0;
+
+	while((opt = getopt(argc, argv, "t:s:j:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 't':
+				bench_set_min_time(atoi(optarg));
+				break;
+			case 's':
+				samples_dir = optarg;
+				break;
+			case 'j':
+				threads = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	bench_json_begin("decode");
+
+	int i = 0;
+	for(i = 0; i < BENCH_N_SIZES; i++)
+	{
+		bench_converters(&bench_sizes[i]);
+		bench_jpeg(&bench_sizes[i], samples_dir, threads);
+		bench_h264(&bench_sizes[i], samples_dir);
+	}
+
+	bench_json_end();
+
+	return 0;
+}
@@ -0,0 +1,415 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*******************************************************************************#
+#                                                                               #
+#  Encoder video ring benchmark: times the enqueue (encoder_add_video_frame,   #
+#  encoder_add_video_frame_ref) and dequeue (encoder_wait_video_buffer,        #
+#  encoder_process_next_video_buffer) of the lock free video ring with raw     #
+#  (direct input) video and no muxer, so only the ring itself is measured      #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <linux/videodev2.h>
+
+#include "gviewencoder.h"
+#include "gview.h"
+#include "bench.h"
+
+/*encoder frame size: raw input allows frames up to width*height*3 bytes*/
+#define RING_WIDTH  (1920)
+#define RING_HEIGHT (1080)
+/*15 fps: the ring holds 1.5 sec (22 frames)*/
+#define RING_FPS_NUM (1)
+#define RING_FPS_DEN (15)
+/*frames the producer keeps in the ring (below the ring size: no drops)*/
+#define RING_MAX_IN_FLIGHT (20)
+/*paced producer period (ns) and consumer wait timeout (ms)*/
+#define RING_PACE_NS (1000000)
+#define RING_WAIT_TIMEOUT (10)
+
+typedef struct _ring_frame_t
+{
+	const char *name;
+	int size; //bytes
+} ring_frame_t;
+
+static const ring_frame_t ring_frames[] =
+{
+	{"4k_bytes",          4096},
+	{"1080p_mjpeg",  (RING_WIDTH * RING_HEIGHT) / 4},
+	{"1080p_yuyv",    RING_WIDTH * RING_HEIGHT * 2}
+};
+
+#define RING_N_FRAMES (int)(sizeof(ring_frames)/sizeof(ring_frame_t))
+
+typedef struct _ring_case_t
+{
+	encoder_context_t *encoder_ctx;
+	uint8_t *frame;
+	int size;
+	int by_ref; //use encoder_add_video_frame_ref
+
+	uint64_t pace_ns; //producer period (0 - as fast as possible)
+	uint64_t first_ts; //timestamp of the first frame (reference pts)
+
+	_Atomic int producer_done;
+	_Atomic uint64_t produced;
+	_Atomic uint64_t consumed;
+
+	bench_result_t latency; //enqueue to dequeue time
+} ring_case_t;
+
+static _Atomic int frame_refs_released = 0;
+
+/*
+ * frame reference release callback
+ * args:
+ *    data - unused
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void release_frame(void *data)
+{
+	(void) data;
+	atomic_fetch_add(&frame_refs_released, 1);
+}
+
+/*
+ * create a raw video encoder context (no audio, no muxer)
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to encoder context
+ */
+static encoder_context_t *ring_encoder_init()
+{
+	encoder_context_t *encoder_ctx = encoder_init(V4L2_PIX_FMT_YUYV, 0, -1,
+		ENCODER_MUX_MKV, RING_WIDTH, RING_HEIGHT, RING_FPS_NUM, RING_FPS_DEN, 0, 0);
+
+	if(encoder_ctx == NULL)
+	{
+		fprintf(stderr, "BENCH: couldn't create the encoder context\n");
+		exit(-1);
+	}
+
+	return encoder_ctx;
+}
+
+/*
+ * enqueue a frame
+ * args:
+ *    c - pointer to case data
+ *    timestamp - frame timestamp
+ *
+ * asserts:
+ *    none
+ *
+ * returns: error code
+ */
+static int ring_add(ring_case_t *c, int64_t timestamp)
+{
+	if(c->by_ref)
+		return encoder_add_video_frame_ref(c->frame, c->size, timestamp, 1,
+			release_frame, NULL);
+
+	return encoder_add_video_frame(c->frame, c->size, timestamp, 1);
+}
+
+/*
+ * bench case: enqueue and dequeue one frame in the same thread
+ * args:
+ *    data - pointer to case data
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void run_add_process(void *data)
+{
+	ring_case_t *c = (ring_case_t *) data;
+
+	ring_add(c, (int64_t) bench_time_ns());
+	encoder_process_next_video_buffer(c->encoder_ctx);
+}
+
+/*
+ * producer thread: enqueue frames for the minimum run time
+ * args:
+ *    data - pointer to case data
+ *
+ * asserts:
+ *    none
+ *
+ * returns: NULL
+ */
+static void *producer_thread(void *data)
+{
+	ring_case_t *c = (ring_case_t *) data;
+
+	uint64_t start = bench_time_ns();
+	uint64_t next = start;
+	uint64_t n = 0;
+
+	while(bench_time_ns() - start < bench_get_min_time_ns() || n < 100)
+	{
+		/*keep the ring from filling up*/
+		while(n - atomic_load(&c->consumed) >= RING_MAX_IN_FLIGHT)
+			sched_yield();
+
+		if(c->pace_ns)
+		{
+			next += c->pace_ns;
+			uint64_t now = bench_time_ns();
+			if(next > now)
+			{
+				struct timespec req = {
+					.tv_sec = (next - now) / 1000000000ULL,
+					.tv_nsec = (next - now) % 1000000000ULL};
+				nanosleep(&req, NULL);
+			}
+		}
+
+		uint64_t ts = bench_time_ns();
+		if(n == 0)
+			c->first_ts = ts;
+
+		if(ring_add(c, (int64_t) ts) == 0)
+		{
+			n++;
+			atomic_store(&c->produced, n);
+		}
+	}
+
+	atomic_store(&c->producer_done, 1);
+
+	return NULL;
+}
+
+/*
+ * consumer thread: wait for and dequeue all the frames
+ *   (the encoder thread loop)
+ * args:
+ *    data - pointer to case data
+ *
+ * asserts:
+ *    none
+ *
+ * returns: NULL
+ */
+static void *consumer_thread(void *data)
+{
+	ring_case_t *c = (ring_case_t *) data;
+
+	uint64_t n = 0;
+
+	while(!atomic_load(&c->producer_done) || n < atomic_load(&c->produced))
+	{
+		if(!encoder_wait_video_buffer(RING_WAIT_TIMEOUT))
+			continue;
+
+		while(encoder_process_next_video_buffer(c->encoder_ctx) == 0)
+		{
+			/*pts is relative to the first frame timestamp*/
+			uint64_t latency = bench_time_ns() -
+				(c->first_ts + (uint64_t) c->encoder_ctx->enc_video_ctx->pts);
+
+			c->latency.iterations++;
+			c->latency.total_ns += latency;
+			if(latency < c->latency.min_ns)
+				c->latency.min_ns = latency;
+			if(latency > c->latency.max_ns)
+				c->latency.max_ns = latency;
+
+			n++;
+			atomic_store(&c->consumed, n);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * time enqueue + dequeue in a single thread (ring and copy cost)
+ * args:
+ *    frame - pointer to frame size
+ *    by_ref - use encoder_add_video_frame_ref
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void bench_single_thread(const ring_frame_t *frame, int by_ref)
+{
+	ring_case_t c;
+	memset(&c, 0, sizeof(ring_case_t));
+
+	c.encoder_ctx = ring_encoder_init();
+	c.size = frame->size;
+	c.by_ref = by_ref;
+	c.frame = calloc(frame->size, 1);
+	if(c.frame == NULL)
+	{
+		fprintf(stderr, "BENCH: FATAL memory allocation failure (bench_single_thread): %s\n",
+			strerror(errno));
+		exit(-1);
+	}
+
+	bench_result_t result;
+	bench_run(run_add_process, &c, &result);
+
+	bench_json_entry(&result,
+		"\"mode\": \"single_thread\", \"enqueue\": \"%s\", \"frame\": \"%s\", \"bytes\": %i",
+		by_ref ? "encoder_add_video_frame_ref" : "encoder_add_video_frame",
+		frame->name, frame->size);
+
+	encoder_close(c.encoder_ctx);
+	free(c.frame);
+}
+
+/*
+ * time a producer and a consumer thread (the capture and encoder threads)
+ * args:
+ *    frame - pointer to frame size
+ *    pace_ns - producer period (0 - as fast as possible)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void bench_threads(const ring_frame_t *frame, uint64_t pace_ns)
+{
+	ring_case_t c;
+	memset(&c, 0, sizeof(ring_case_t));
+
+	c.encoder_ctx = ring_encoder_init();
+	c.size = frame->size;
+	c.pace_ns = pace_ns;
+	c.latency.min_ns = UINT64_MAX;
+	c.frame = calloc(frame->size, 1);
+	if(c.frame == NULL)
+	{
+		fprintf(stderr, "BENCH: FATAL memory allocation failure (bench_threads): %s\n",
+			strerror(errno));
+		exit(-1);
+	}
+
+	__THREAD_TYPE producer;
+	__THREAD_TYPE consumer;
+
+	uint64_t start = bench_time_ns();
+
+	if(__THREAD_CREATE(&consumer, consumer_thread, &c) ||
+		__THREAD_CREATE(&producer, producer_thread, &c))
+	{
+		fprintf(stderr, "BENCH: couldn't start the ring threads\n");
+		exit(-1);
+	}
+
+	__THREAD_JOIN(producer);
+	__THREAD_JOIN(consumer);
+
+	uint64_t elapsed = bench_time_ns() - start;
+	uint64_t frames = atomic_load(&c.consumed);
+
+	bench_json_entry(NULL,
+		"\"mode\": \"%s\", \"enqueue\": \"encoder_add_video_frame\", \"frame\": \"%s\", "
+		"\"bytes\": %i, \"frames\": %" PRIu64 ", \"ns_per_frame\": %" PRIu64 ", "
+		"\"latency_mean_ns\": %" PRIu64 ", \"latency_min_ns\": %" PRIu64
+		", \"latency_max_ns\": %" PRIu64,
+		pace_ns ? "threads_paced" : "threads_burst",
+		frame->name, frame->size, frames, frames ? elapsed / frames : 0,
+		frames ? c.latency.total_ns / frames : 0,
+		frames ? c.latency.min_ns : 0, c.latency.max_ns);
+
+	encoder_close(c.encoder_ctx);
+	free(c.frame);
+}
+
+/*
+ * print the command line usage
+ * args:
+ *    prog - program name
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-t min_time_ms]\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt = 0;
+
+	while((opt = getopt(argc, argv, "t:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 't':
+				bench_set_min_time(atoi(optarg));
+				break;
+			default:
+				usage(argv[0]);
+				return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	bench_json_begin("encoder_ring");
+
+	int i = 0;
+	for(i = 0; i < RING_N_FRAMES; i++)
+	{
+		bench_single_thread(&ring_frames[i], 0);
+		bench_single_thread(&ring_frames[i], 1);
+		bench_threads(&ring_frames[i], 0);
+	}
+
+	/*wake up latency of a consumer blocked in encoder_wait_video_buffer*/
+	bench_threads(&ring_frames[0], RING_PACE_NS);
+
+	bench_json_end();
+
+	if(atomic_load(&frame_refs_released) == 0)
+		fprintf(stderr, "BENCH: no frame reference was released\n");
+
+	return 0;
+}
@@ -0,0 +1,48 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*******************************************************************************#
+#                                                                               #
+#  M/Jpeg decoder backends built side by side for the decode benchmark          #
+#  (the library only builds the one selected by configure)                      #
+#                                                                               #
+********************************************************************************/
+
+#ifndef BENCH_JPEG_H
+#define BENCH_JPEG_H
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+#include "jpeg_decoder.h"
+
+/*builtin decoder - bench_jpeg_builtin.c (see jpeg_decoder.h for the api docs)*/
+jpeg_decoder_context_t *bench_builtin_jpeg_init_decoder_ctx(int width, int height);
+int bench_builtin_jpeg_decode_ctx(jpeg_decoder_context_t *ctx, uint8_t *out_buf, uint8_t *in_buf, int size);
+void bench_builtin_jpeg_close_decoder_ctx(jpeg_decoder_context_t *ctx);
+void bench_builtin_jpeg_set_decoder_pool(jpeg_decoder_context_t *ctx, decoder_pool_t *pool);
+
+/*libavcodec decoder - bench_jpeg_libav.c (see jpeg_decoder.h for the api docs)*/
+jpeg_decoder_context_t *bench_libav_jpeg_init_decoder_ctx(int width, int height);
+int bench_libav_jpeg_decode_ctx(jpeg_decoder_context_t *ctx, uint8_t *out_buf, uint8_t *in_buf, int size);
+void bench_libav_jpeg_close_decoder_ctx(jpeg_decoder_context_t *ctx);
+
+#endif
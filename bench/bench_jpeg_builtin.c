@@ -0,0 +1,40 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*******************************************************************************#
+#                                                                               #
+#  M/Jpeg builtin decoder for the decode benchmark:                             #
+#  jpeg_decoder.c with the backend forced and the symbols renamed               #
+#                                                                               #
+********************************************************************************/
+
+#define JPEG_DECODER_BUILTIN 1
+
+#define jpeg_init_decoder_ctx  bench_builtin_jpeg_init_decoder_ctx
+#define jpeg_decode_ctx        bench_builtin_jpeg_decode_ctx
+#define jpeg_close_decoder_ctx bench_builtin_jpeg_close_decoder_ctx
+#define jpeg_set_decoder_pool  bench_builtin_jpeg_set_decoder_pool
+#define jpeg_init_decoder      bench_builtin_jpeg_init_decoder
+#define jpeg_decode            bench_builtin_jpeg_decode
+#define jpeg_close_decoder     bench_builtin_jpeg_close_decoder
+#define jpeg_huffman_table     bench_builtin_jpeg_huffman_table
+
+#include "../gview_v4l2core/jpeg_decoder.c"
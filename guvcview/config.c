@@ -52,8 +52,21 @@ static config_t my_config =
 #endif
 	.audio = "port",
 	.capture = "mmap",
+	.yuv_matrix = "bt601",
+	.yuv_range = "full",
+	.decoder_threads = 1,
+	.frame_queue = 1,
+	.buffers = 4,
+	.frame_hold = 4,
 	.video_codec = "dx50",
 	.audio_codec = "mp2",
+	.io_mode = "sync",
+	.preallocate = 0,
+	.segment_time = 0,
+	.segment_size = 0,
+	.segment_keep = 0,
+	.preroll = 0,
+	.preroll_size = 64,
 	.profile_name = NULL,
 	.profile_path = NULL,
 	.video_name = NULL,
@@ -62,6 +75,9 @@ static config_t my_config =
 	.photo_path = NULL,
 	.video_sufix = 1,
 	.photo_sufix = 1,
+	.png_level = -1,
+	.png_filter = "adaptive",
+	.png_threads = 0,
 	.fps_num = 1,
 	.fps_denom = 25,
 	.audio_device = -1,/*guvcview will use API default in this case*/
@@ -121,8 +137,20 @@ int config_save(const char *filename)
 	fprintf(fp, "height=%i\n", my_config.height);
 	fprintf(fp, "#video input format\n");
 	fprintf(fp, "v4l2_format=%u\n", my_config.format);
-	fprintf(fp, "#video input capture method\n");
+	fprintf(fp, "#video input capture method [read mmap userptr dmabuf]\n");
 	fprintf(fp, "capture=%s\n", my_config.capture);
+	fprintf(fp, "#yuv to rgb color matrix [bt601 bt709]\n");
+	fprintf(fp, "yuv_matrix=%s\n", my_config.yuv_matrix);
+	fprintf(fp, "#yuv quantization range [full limited]\n");
+	fprintf(fp, "yuv_range=%s\n", my_config.yuv_range);
+	fprintf(fp, "#raw frame decoder threads [0 (auto) 1 N]\n");
+	fprintf(fp, "decoder_threads=%i\n", my_config.decoder_threads);
+	fprintf(fp, "#frame queue size [1 N (pipelined decoding with N-1 threads)]\n");
+	fprintf(fp, "frame_queue=%i\n", my_config.frame_queue);
+	fprintf(fp, "#number of v4l2 driver buffers [2 - 32]\n");
+	fprintf(fp, "buffers=%i\n", my_config.buffers);
+	fprintf(fp, "#extra frames held by the video encoder [0 (copy frames) N]\n");
+	fprintf(fp, "frame_hold=%i\n", my_config.frame_hold);
 	fprintf(fp, "#audio api\n");
 	fprintf(fp, "audio=%s\n", my_config.audio);
 	fprintf(fp, "#gui api\n");
@@ -133,6 +161,20 @@ int config_save(const char *filename)
 	fprintf(fp, "video_codec=%s\n", my_config.video_codec);
 	fprintf(fp, "#audio codec [pcm mp2 mp3 aac ac3 vorb]\n");
 	fprintf(fp, "audio_codec=%s\n", my_config.audio_codec);
+	fprintf(fp, "#video file writer [sync thread direct uring]\n");
+	fprintf(fp, "io_mode=%s\n", my_config.io_mode);
+	fprintf(fp, "#preallocate video files in large extents [0 1]\n");
+	fprintf(fp, "preallocate=%i\n", my_config.preallocate);
+	fprintf(fp, "#video segment duration in sec [0 (single file) N]\n");
+	fprintf(fp, "segment_time=%i\n", my_config.segment_time);
+	fprintf(fp, "#video segment size in Mbytes [0 (single file) N]\n");
+	fprintf(fp, "segment_size=%i\n", my_config.segment_size);
+	fprintf(fp, "#video segments kept, the oldest are deleted [0 (keep all) N]\n");
+	fprintf(fp, "segment_keep=%i\n", my_config.segment_keep);
+	fprintf(fp, "#video pre-roll (sec before the capture) [0 (disabled) N]\n");
+	fprintf(fp, "preroll=%i\n", my_config.preroll);
+	fprintf(fp, "#video pre-roll memory budget in Mbytes\n");
+	fprintf(fp, "preroll_size=%i\n", my_config.preroll_size);
 	fprintf(fp, "#profile name\n");
 	fprintf(fp, "profile_name=%s\n", my_config.profile_name);
 	fprintf(fp, "#profile path\n");
@@ -149,6 +191,12 @@ int config_save(const char *filename)
 	fprintf(fp, "photo_path=%s\n", my_config.photo_path);
 	fprintf(fp, "#photo sufix flag\n");
 	fprintf(fp, "photo_sufix=%i\n", my_config.photo_sufix);
+	fprintf(fp, "#png compression level [-1 (default) 0 - 9]\n");
+	fprintf(fp, "png_level=%i\n", my_config.png_level);
+	fprintf(fp, "#png row filter [none sub up avg paeth adaptive]\n");
+	fprintf(fp, "png_filter=%s\n", my_config.png_filter);
+	fprintf(fp, "#png compression threads [0 (auto) 1 (single stream) N]\n");
+	fprintf(fp, "png_threads=%i\n", my_config.png_threads);
 	fprintf(fp, "#fps numerator (def. 1)\n");
 	fprintf(fp, "fps_num=%i\n", my_config.fps_num);
 	fprintf(fp, "#fps denominator (def. 25)\n");
@@ -263,7 +311,19 @@ int config_load(const char *filename)
 		else if(strcmp(token, "v4l2_format") == 0)
 			my_config.format = (uint32_t) strtoul(value, NULL, 10);
 		else if(strcmp(token, "capture") == 0)
-			strncpy(my_config.capture, value, 4);
+			strncpy(my_config.capture, value, 7);
+		else if(strcmp(token, "yuv_matrix") == 0)
+			strncpy(my_config.yuv_matrix, value, 5);
+		else if(strcmp(token, "yuv_range") == 0)
+			strncpy(my_config.yuv_range, value, 7);
+		else if(strcmp(token, "decoder_threads") == 0)
+			my_config.decoder_threads = (int) strtoul(value, NULL, 10);
+		else if(strcmp(token, "frame_queue") == 0)
+			my_config.frame_queue = (int) strtoul(value, NULL, 10);
+		else if(strcmp(token, "buffers") == 0)
+			my_config.buffers = (int) strtoul(value, NULL, 10);
+		else if(strcmp(token, "frame_hold") == 0)
+			my_config.frame_hold = (int) strtoul(value, NULL, 10);
 		else if(strcmp(token, "audio") == 0)
 			strncpy(my_config.audio, value, 5);
 		else if(strcmp(token, "gui") == 0)
@@ -274,6 +334,20 @@ int config_load(const char *filename)
 			strncpy(my_config.video_codec, value, 4);
 		else if(strcmp(token, "audio_codec") == 0)
 			strncpy(my_config.audio_codec, value, 4);
+		else if(strcmp(token, "io_mode") == 0)
+			strncpy(my_config.io_mode, value, 6);
+		else if(strcmp(token, "preallocate") == 0)
+			my_config.preallocate = (int) strtoul(value, NULL, 10);
+		else if(strcmp(token, "segment_time") == 0)
+			my_config.segment_time = (int) strtoul(value, NULL, 10);
+		else if(strcmp(token, "segment_size") == 0)
+			my_config.segment_size = (int) strtoul(value, NULL, 10);
+		else if(strcmp(token, "segment_keep") == 0)
+			my_config.segment_keep = (int) strtoul(value, NULL, 10);
+		else if(strcmp(token, "preroll") == 0)
+			my_config.preroll = (int) strtoul(value, NULL, 10);
+		else if(strcmp(token, "preroll_size") == 0)
+			my_config.preroll_size = (int) strtoul(value, NULL, 10);
 		else if(strcmp(token, "profile_name") == 0 && strlen(value) > 2)
 		{
 			if(my_config.profile_name)
@@ -322,6 +396,12 @@ int config_load(const char *filename)
 			my_config.photo_sufix = (int) strtoul(value, NULL, 10);
 			set_photo_sufix_flag(my_config.photo_sufix);
 		}
+		else if(strcmp(token, "png_level") == 0)
+			my_config.png_level = (int) strtol(value, NULL, 10);
+		else if(strcmp(token, "png_filter") == 0)
+			strncpy(my_config.png_filter, value, 8);
+		else if(strcmp(token, "png_threads") == 0)
+			my_config.png_threads = (int) strtoul(value, NULL, 10);
 		else if(strcmp(token, "fps_num") == 0)
 			my_config.fps_num = (int) strtoul(value, NULL, 10);
 		else if(strcmp(token, "fps_denom") == 0)
@@ -386,7 +466,26 @@ void config_update(options_t *my_options)
 
 	/*capture method*/
 	if(strlen(my_options->capture) > 3)
-		strncpy(my_config.capture, my_options->capture, 4);
+		strncpy(my_config.capture, my_options->capture, 7);
+
+	/*yuv color encoding*/
+	if(strlen(my_options->yuv_matrix) > 4)
+		strncpy(my_config.yuv_matrix, my_options->yuv_matrix, 5);
+	if(strlen(my_options->yuv_range) > 3)
+		strncpy(my_config.yuv_range, my_options->yuv_range, 7);
+
+	/*raw frame decoder threads*/
+	if(my_options->decoder_threads >= 0)
+		my_config.decoder_threads = my_options->decoder_threads;
+
+	if(my_options->frame_queue > 0)
+		my_config.frame_queue = my_options->frame_queue;
+
+	if(my_options->buffers > 0)
+		my_config.buffers = my_options->buffers;
+
+	if(my_options->frame_hold >= 0)
+		my_config.frame_hold = my_options->frame_hold;
 
 	/*render API*/
 	if(strlen(my_options->render) > 2)
@@ -419,6 +518,28 @@ void config_update(options_t *my_options)
 	if(strlen(my_options->audio_codec) > 2)
 		strncpy(my_config.audio_codec, my_options->audio_codec, 4);
 
+	/*video file writer*/
+	if(strlen(my_options->io_mode) > 3)
+		strncpy(my_config.io_mode, my_options->io_mode, 6);
+
+	if(my_options->preallocate >= 0)
+		my_config.preallocate = my_options->preallocate;
+
+	if(my_options->segment_time >= 0)
+		my_config.segment_time = my_options->segment_time;
+
+	if(my_options->segment_size >= 0)
+		my_config.segment_size = my_options->segment_size;
+
+	if(my_options->segment_keep >= 0)
+		my_config.segment_keep = my_options->segment_keep;
+
+	if(my_options->preroll >= 0)
+		my_config.preroll = my_options->preroll;
+
+	if(my_options->preroll_size > 0)
+		my_config.preroll_size = my_options->preroll_size;
+
 	/*profile*/
 	if(my_options->profile_name)
 	{
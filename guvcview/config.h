@@ -32,9 +32,22 @@ typedef struct _config_t
 	char render[5];  /*render api*/
 	char gui[5];     /*gui api*/
 	char audio[6];   /*audio api - none; port; pulse*/
-	char capture[5]; /*capture method: read or mmap*/
+	char capture[8]; /*capture method: read, mmap, userptr or dmabuf*/
+	char yuv_matrix[6]; /*yuv to rgb color matrix: bt601 or bt709*/
+	char yuv_range[8]; /*yuv quantization range: full or limited*/
+	int decoder_threads; /*raw frame decoder threads (0 = auto)*/
+	int frame_queue; /*frame queue size (pipelined decoding if > 1)*/
+	int buffers; /*number of v4l2 driver buffers*/
+	int frame_hold; /*extra frames held by the video encoder (0 = copy frames)*/
 	char video_codec[5]; /*video codec*/
 	char audio_codec[5]; /*video codec*/
+	char io_mode[7]; /*video file writer: sync, thread, direct or uring*/
+	int preallocate; /*preallocate video files in large extents*/
+	int segment_time; /*video segment duration in sec (0 = single file)*/
+	int segment_size; /*video segment size in Mbytes (0 = single file)*/
+	int segment_keep; /*video segments kept, oldest are deleted (0 = keep all)*/
+	int preroll; /*video pre-roll in sec (0 = disabled)*/
+	int preroll_size; /*video pre-roll memory budget in Mbytes*/
 	char *profile_path;
 	char *profile_name;
 	char *video_path;
@@ -43,6 +56,9 @@ typedef struct _config_t
 	char *photo_name;
 	int video_sufix; /*flag if video file has auto suffix enable*/
 	int photo_sufix; /*flag if photo file has auto suffix enable*/
+	int png_level; /*png compression level (-1 = zlib default)*/
+	char png_filter[9]; /*png row filter: none, sub, up, avg, paeth or adaptive*/
+	int png_threads; /*png compression threads (0 = auto; 1 = single stream)*/
 	int fps_num;
 	int fps_denom;
 	int audio_device;/*audio device index*/
@@ -458,10 +458,8 @@ unsigned long long get_file_suffix(const char *path, const char* filename)
 }
 
 /*
- * add a number suffix to filename (e.g. name.ext => name-suffix.ext)
- *   the suffix depends on the existing values in the path dir
+ * set a number suffix in filename (e.g. name.ext => name-suffix.ext)
  * args:
- * 	  path - string with file path (to dir)
  *    filename - string with file basename (name.ext)
  *    suffix - suffix number
  *
@@ -470,11 +468,8 @@ unsigned long long get_file_suffix(const char *path, const char* filename)
  *
  * returns: newly allocated string with suffixed file name (must free)
  */
-char *add_file_suffix(const char *path, const char *filename)
+char *set_file_suffix(const char *filename, unsigned long long suffix)
 {
-	unsigned long long suffix = get_file_suffix(path, filename);
-	/*increment existing suffix*/
-	suffix++;
 	int size_suffix = get_uint64_num_chars(suffix);
 	int size_name = strlen(filename);
 
@@ -494,7 +489,7 @@ char *add_file_suffix(const char *path, const char *filename)
 	char *new_name = calloc(size_name + size_suffix + 3, sizeof(char));
 	if(new_name == NULL)
 	{
-		fprintf(stderr,"GUVCVIEW: FATAL memory allocation failure (add_file_suffix): %s\n", strerror(errno));
+		fprintf(stderr,"GUVCVIEW: FATAL memory allocation failure (set_file_suffix): %s\n", strerror(errno));
 		exit(-1);
 	}
 	if(noextname && extension)
@@ -504,7 +499,31 @@ char *add_file_suffix(const char *path, const char *filename)
 		free(extension);
 	}
 	else
+	{
 		sprintf(new_name, "%s-%llu", filename, suffix);
+		free(noextname);
+	}
 
 	return new_name;
 }
+
+/*
+ * add a number suffix to filename (e.g. name.ext => name-suffix.ext)
+ *   the suffix depends on the existing values in the path dir
+ * args:
+ * 	  path - string with file path (to dir)
+ *    filename - string with file basename (name.ext)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: newly allocated string with suffixed file name (must free)
+ */
+char *add_file_suffix(const char *path, const char *filename)
+{
+	unsigned long long suffix = get_file_suffix(path, filename);
+	/*increment existing suffix*/
+	suffix++;
+
+	return set_file_suffix(filename, suffix);
+}
@@ -149,13 +149,25 @@ char *set_file_extension(const char *filename, const char *ext);
  */
 unsigned long long get_file_suffix(const char *path, const char* filename);
 
+/*
+ * set a number suffix in filename (e.g. name.ext => name-suffix.ext)
+ * args:
+ *    filename - string with file basename (name.ext)
+ *    suffix - suffix number
+ *
+ * asserts:
+ *    none
+ *
+ * returns: newly allocated string with suffixed file name (must free)
+ */
+char *set_file_suffix(const char *filename, unsigned long long suffix);
+
 /*
  * add a number suffix to filename (e.g. name.ext => name-suffix.ext)
  *   the suffix depends on the existing values in the path dir
  * args:
  * 	  path - string with file path (to dir)
  *    filename - string with file basename (name.ext)
- *    suffix - suffix number
  *
  * asserts:
  *    none
@@ -475,7 +475,7 @@ void gui_error(
 /*
  * adds a message to the status bar
  * args:
- *    message - message string
+ *    message - message string (copied: may be reused after the call)
  *
  * asserts:
  *    none
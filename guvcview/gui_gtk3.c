@@ -92,7 +92,7 @@ static gboolean set_status_message(const char *message)
 /*
  * adds a message to the status bar
  * args:
- *    message - message string
+ *    message - message string (copied: may be reused after the call)
  *
  * asserts:
  *    none
@@ -101,8 +101,12 @@ static gboolean set_status_message(const char *message)
  */
 void gui_status_message_gtk3(const char *message)
 {
-	/*this maybe called from a different thread, so protect it*/
-	gdk_threads_add_idle ((GSourceFunc)set_status_message, (gpointer) message);
+	/*
+	 * this maybe called from a different thread, so protect it:
+	 * the idle handler gets its own copy of the message (freed after it runs)
+	 */
+	gdk_threads_add_idle_full (G_PRIORITY_DEFAULT_IDLE,
+		(GSourceFunc)set_status_message, (gpointer) g_strdup(message), g_free);
 }
 
 /*
@@ -928,12 +932,18 @@ int gui_attach_gtk3(int width, int height)
 	gtk_widget_add_events (GTK_WIDGET (main_window), GDK_KEY_PRESS_MASK | GDK_KEY_RELEASE_MASK);
 	g_signal_connect (GTK_WINDOW(main_window), "key_press_event", G_CALLBACK(window_key_pressed), NULL);
 
-	/* add update timers:
-	 *  devices
-	 */
-	gtk_devices_timer_id = g_timeout_add( 1000, check_device_events, NULL);
-	/*controls*/
-	gtk_control_events_timer_id = g_timeout_add(1000, check_control_events, NULL);
+	if(is_control_panel)
+	{
+		/* add update timers (no capture loop to wait on events):
+		 *  devices
+		 */
+		gtk_devices_timer_id = g_timeout_add( 1000, check_device_events, NULL);
+		/*controls*/
+		gtk_control_events_timer_id = g_timeout_add(1000, check_control_events, NULL);
+	}
+	else
+		/*the capture loop reports device and control events as they happen*/
+		v4l2core_set_event_callback(get_v4l2_device_handler(), core_events, NULL);
 
 	return 0;
 }
@@ -267,7 +267,7 @@ void gui_clean_gtk3_control_widgets_list();
 /*
  * adds a message to the status bar
  * args:
- *    message - message string
+ *    message - message string (copied: may be reused after the call)
  *
  * asserts:
  *    none
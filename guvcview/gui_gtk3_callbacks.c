@@ -2525,3 +2525,41 @@ gboolean check_control_events(gpointer data)
 
 	return (TRUE);
 }
+
+/*
+ * core events idle callback (gui thread)
+ * args:
+ *   data - core event (EV_CONTROLS or EV_DEVICES)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: false (remove the idle source)
+ */
+static gboolean core_events_idle(gpointer data)
+{
+	if(GPOINTER_TO_INT(data) == EV_DEVICES)
+		check_device_events(NULL);
+	else
+		check_control_events(NULL);
+
+	return (FALSE);
+}
+
+/*
+ * core events callback (called from the capture thread)
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   event - core event (EV_CONTROLS or EV_DEVICES)
+ *   data - pointer to user data
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void core_events(v4l2_dev_t *vd, int event, void *data)
+{
+	/*handle the events in the gui thread*/
+	g_idle_add(core_events_idle, GINT_TO_POINTER(event));
+}
@@ -622,4 +622,18 @@ gboolean check_device_events(gpointer data);
  */
 gboolean check_control_events(gpointer data);
 
+/*
+ * core events callback (called from the capture thread)
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   event - core event (EV_CONTROLS or EV_DEVICES)
+ *   data - pointer to user data
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void core_events(v4l2_dev_t *vd, int event, void *data);
+
 #endif
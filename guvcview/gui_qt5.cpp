@@ -218,15 +218,47 @@ MainWindow::MainWindow()
 	statusbar = statusBar();
 	statusbar->show();
 
-	timer_check_device = new QTimer(this);
-    connect(timer_check_device, SIGNAL(timeout()), 
-		this, SLOT(check_device_events()));
-    timer_check_device->start(1000);
+	timer_check_device = NULL;
+	timer_check_control_events = NULL;
+
+	if(is_control_panel)
+	{
+		/*no capture loop to wait on events: poll them*/
+		timer_check_device = new QTimer(this);
+		connect(timer_check_device, SIGNAL(timeout()), 
+			this, SLOT(check_device_events()));
+		timer_check_device->start(1000);
 	
-	timer_check_control_events = new QTimer(this);
-	connect(timer_check_control_events, SIGNAL(timeout()), 
-		this, SLOT(check_control_events()));
-	timer_check_control_events->start(1000);
+		timer_check_control_events = new QTimer(this);
+		connect(timer_check_control_events, SIGNAL(timeout()), 
+			this, SLOT(check_control_events()));
+		timer_check_control_events->start(1000);
+	}
+	else
+		/*the capture loop reports device and control events as they happen*/
+		v4l2core_set_event_callback(get_v4l2_device_handler(), core_events, this);
+}
+
+/*
+ * core events callback (called from the capture thread)
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   event - core event (EV_CONTROLS or EV_DEVICES)
+ *   data - pointer to main window
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void MainWindow::core_events(v4l2_dev_t *vd, int event, void *data)
+{
+	MainWindow *win = (MainWindow *) data;
+
+	/*handle the events in the gui thread*/
+	QMetaObject::invokeMethod(win,
+		(event == EV_DEVICES) ? "check_device_events" : "check_control_events",
+		Qt::QueuedConnection);
 }
 
 MainWindow::~MainWindow()
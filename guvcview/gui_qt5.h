@@ -83,7 +83,7 @@ void gui_error_qt5(
 /*
  * adds a message to the status bar
  * args:
- *    message - message string
+ *    message - message string (copied: may be reused after the call)
  *
  * asserts:
  *    none
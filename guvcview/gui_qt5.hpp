@@ -118,6 +118,7 @@ private slots:
 
 
 private:
+   static void core_events(v4l2_dev_t *vd, int event, void *data);
    ControlWidgets *gui_qt5_get_widgets_by_id(int id);
    void gui_qt5_update_controls_state();
    int gui_attach_qt5_v4l2ctrls(QWidget *parent);
@@ -242,6 +242,11 @@ int main(int argc, char *argv[])
 	/*set the v4l2 core verbosity*/
 	v4l2core_set_verbosity(debug_level);
 
+	/*set the frame queue size (must be set before creating the device)*/
+	v4l2core_set_frame_queue_size(my_config->frame_queue);
+	/*extra frames for zero-copy video recording*/
+	v4l2core_set_frame_hold_count(my_config->frame_hold);
+
 	/*set the v4l2core device (redefines language catalog)*/
 	v4l2_dev_t *vd = create_v4l2_device_handler(my_options->device);
 	if(!vd)
@@ -261,9 +266,42 @@ int main(int argc, char *argv[])
 	/*select capture method*/
 	if(strcasecmp(my_config->capture, "read") == 0)
 		v4l2core_set_capture_method(vd, IO_READ);
+	else if(strcasecmp(my_config->capture, "userptr") == 0)
+		v4l2core_set_capture_method(vd, IO_USERPTR);
+	else if(strcasecmp(my_config->capture, "dmabuf") == 0)
+		v4l2core_set_capture_method(vd, IO_DMABUF);
 	else
 		v4l2core_set_capture_method(vd, IO_MMAP);
 
+	/*number of driver buffers*/
+	v4l2core_set_buffer_count(vd, my_config->buffers);
+
+	/*set the yuv color encoding for rgb conversions (snapshots and render)*/
+	int yuv_matrix = (strcasecmp(my_config->yuv_matrix, "bt709") == 0) ?
+		YUV_MATRIX_BT709 : YUV_MATRIX_BT601;
+	int yuv_range = (strcasecmp(my_config->yuv_range, "limited") == 0) ?
+		YUV_RANGE_LIMITED : YUV_RANGE_FULL;
+	v4l2core_set_yuv_color_encoding(vd, yuv_matrix, yuv_range);
+	render_set_yuv_color_encoding(yuv_matrix, yuv_range);
+
+	/*set the number of threads for decoding raw frames*/
+	v4l2core_set_decoder_threads(vd, my_config->decoder_threads);
+
+	/*set the png snapshot compression*/
+	int png_filter = IMG_PNG_FILTER_ADAPTIVE;
+	if(strcasecmp(my_config->png_filter, "none") == 0)
+		png_filter = IMG_PNG_FILTER_NONE;
+	else if(strcasecmp(my_config->png_filter, "sub") == 0)
+		png_filter = IMG_PNG_FILTER_SUB;
+	else if(strcasecmp(my_config->png_filter, "up") == 0)
+		png_filter = IMG_PNG_FILTER_UP;
+	else if(strcasecmp(my_config->png_filter, "avg") == 0)
+		png_filter = IMG_PNG_FILTER_AVG;
+	else if(strcasecmp(my_config->png_filter, "paeth") == 0)
+		png_filter = IMG_PNG_FILTER_PAETH;
+	v4l2core_set_png_options(my_config->png_level, png_filter,
+		my_config->png_threads);
+
 	/*set software autofocus sort method*/
 	v4l2core_soft_autofocus_set_sort(AUTOF_SORT_INSERT);
 
@@ -354,6 +392,20 @@ int main(int argc, char *argv[])
 	
 	encoder_set_verbosity(debug_level);
 
+	/*video file writer (applies to files opened after this)*/
+	if(strcasecmp(my_config->io_mode, "thread") == 0)
+		encoder_set_io_mode(ENCODER_IO_THREAD);
+	else if(strcasecmp(my_config->io_mode, "direct") == 0)
+		encoder_set_io_mode(ENCODER_IO_DIRECT);
+	else if(strcasecmp(my_config->io_mode, "uring") == 0)
+		encoder_set_io_mode(ENCODER_IO_URING);
+	else
+		encoder_set_io_mode(ENCODER_IO_SYNC);
+
+	encoder_set_file_preallocation(my_config->preallocate);
+	encoder_set_segment_limits(my_config->segment_time, my_config->segment_size);
+	encoder_set_preroll(my_config->preroll, my_config->preroll_size);
+
 	/*start capture thread if not in control_panel mode*/
 	if(!my_options->control_panel)
 	{
@@ -82,7 +82,7 @@ static opt_values_t opt_values[] =
 		.opt_long = "capture",
 		.req_arg = 1,
 		.opt_help_arg = N_("METHOD"),
-		.opt_help = N_("Set capture method [read | mmap (def)]"),
+		.opt_help = N_("Set capture method [read | mmap (def) | userptr | dmabuf]"),
 	},
 	{
 		.opt_short = 'b',
@@ -91,6 +91,48 @@ static opt_values_t opt_values[] =
 		.opt_help_arg = "",
 		.opt_help = N_("disable calls to libv4l2"),
 	},
+	{
+		.opt_short = 'M',
+		.opt_long = "yuv_matrix",
+		.req_arg = 1,
+		.opt_help_arg = N_("MATRIX"),
+		.opt_help = N_("Set yuv to rgb color matrix [bt601 (def) | bt709]"),
+	},
+	{
+		.opt_short = 'R',
+		.opt_long = "yuv_range",
+		.req_arg = 1,
+		.opt_help_arg = N_("RANGE"),
+		.opt_help = N_("Set yuv quantization range [full (def) | limited]"),
+	},
+	{
+		.opt_short = 'T',
+		.opt_long = "decoder_threads",
+		.req_arg = 1,
+		.opt_help_arg = N_("NTHREADS"),
+		.opt_help = N_("Set raw frame decoder threads [0 (auto) | 1 (def) | N]"),
+	},
+	{
+		.opt_short = 'Q',
+		.opt_long = "frame_queue",
+		.req_arg = 1,
+		.opt_help_arg = N_("NFRAMES"),
+		.opt_help = N_("Set frame queue size [1 (def) | N: pipelined decoding with N-1 threads]"),
+	},
+	{
+		.opt_short = 'B',
+		.opt_long = "buffers",
+		.req_arg = 1,
+		.opt_help_arg = N_("NBUFFERS"),
+		.opt_help = N_("Set number of driver buffers [2 - 32] (def: 4)"),
+	},
+	{
+		.opt_short = 'H',
+		.opt_long = "frame_hold",
+		.req_arg = 1,
+		.opt_help_arg = N_("NFRAMES"),
+		.opt_help = N_("Set extra frames for zero-copy video recording [0 (copy) | N] (def: 4)"),
+	},
 	{
 		.opt_short = 'x',
 		.opt_long = "resolution",
@@ -170,6 +212,55 @@ static opt_values_t opt_values[] =
 		.opt_help_arg = N_("CODEC"),
 		.opt_help = N_("Video codec [raw mjpg mpeg flv1 wmv1 mpg2 mp43 dx50 h264 vp80 theo]")
 	},
+	{
+		.opt_short = 'O',
+		.opt_long = "io_mode",
+		.req_arg = 1,
+		.opt_help_arg = N_("MODE"),
+		.opt_help = N_("Video file writer [sync (def) | thread | direct | uring]")
+	},
+	{
+		.opt_short = 'L',
+		.opt_long = "preallocate",
+		.req_arg = 1,
+		.opt_help_arg = N_("FLAG"),
+		.opt_help = N_("Preallocate video files in large extents [0 (def) | 1]")
+	},
+	{
+		.opt_short = 'S',
+		.opt_long = "segment_time",
+		.req_arg = 1,
+		.opt_help_arg = N_("TIME_IN_SEC"),
+		.opt_help = N_("start a new video file every TIME_IN_SEC [0 (def) - disabled]")
+	},
+	{
+		.opt_short = 's',
+		.opt_long = "segment_size",
+		.req_arg = 1,
+		.opt_help_arg = N_("MBYTES"),
+		.opt_help = N_("start a new video file every MBYTES [0 (def) - disabled]")
+	},
+	{
+		.opt_short = 'K',
+		.opt_long = "segment_keep",
+		.req_arg = 1,
+		.opt_help_arg = N_("NFILES"),
+		.opt_help = N_("keep only the last NFILES video segments [0 (def) - keep all]")
+	},
+	{
+		.opt_short = 'P',
+		.opt_long = "preroll",
+		.req_arg = 1,
+		.opt_help_arg = N_("TIME_IN_SEC"),
+		.opt_help = N_("start video files with the TIME_IN_SEC before the capture [0 (def) - disabled]")
+	},
+	{
+		.opt_short = 'W',
+		.opt_long = "preroll_size",
+		.req_arg = 1,
+		.opt_help_arg = N_("MBYTES"),
+		.opt_help = N_("memory for the video pre-roll (encoded) [64 (def)]")
+	},
 	{
 		.opt_short = 'p',
 		.opt_long = "profile",
@@ -249,8 +340,21 @@ static options_t my_options =
 	.audio = "",
 	.audio_device = -1, /*use default*/
 	.capture = "",
+	.yuv_matrix = "",
+	.yuv_range = "",
+	.decoder_threads = -1, /*use config*/
+	.frame_queue = -1, /*use config*/
+	.buffers = -1, /*use config*/
+	.frame_hold = -1, /*use config*/
 	.video_codec = "",
 	.audio_codec = "",
+	.io_mode = "",
+	.preallocate = -1, /*use config*/
+	.segment_time = -1, /*use config*/
+	.segment_size = -1, /*use config*/
+	.segment_keep = -1, /*use config*/
+	.preroll = -1, /*use config*/
+	.preroll_size = -1, /*use config*/
 	.prof_filename = NULL,
 	.profile_name = NULL,
 	.profile_path = NULL,
@@ -486,9 +590,13 @@ int options_parse(int argc, char *argv[])
 			}
 			case 'c':
 			{
-				int str_size = strlen(optarg);
-				if(str_size == 4) /*capture method*/
-					strncpy(my_options.capture, optarg, 4);
+				if(strcasecmp(optarg, "read") == 0 ||
+					strcasecmp(optarg, "mmap") == 0 ||
+					strcasecmp(optarg, "userptr") == 0 ||
+					strcasecmp(optarg, "dmabuf") == 0)
+					strncpy(my_options.capture, optarg, 7);
+				else
+					fprintf(stderr, "V4L2_CORE: (options) Error in capture usage: -c[--capture] read|mmap|userptr|dmabuf \n");
 				break;
 			}
 			case 'b':
@@ -496,6 +604,62 @@ int options_parse(int argc, char *argv[])
 				my_options.disable_libv4l2 = 1;
 				break;
 			}
+			case 'M':
+			{
+				if(strcasecmp(optarg, "bt601") == 0 || strcasecmp(optarg, "bt709") == 0)
+					strncpy(my_options.yuv_matrix, optarg, 5);
+				else
+					fprintf(stderr, "V4L2_CORE: (options) Error in yuv_matrix usage: -M[--yuv_matrix] bt601|bt709 \n");
+				break;
+			}
+			case 'R':
+			{
+				if(strcasecmp(optarg, "full") == 0 || strcasecmp(optarg, "limited") == 0)
+					strncpy(my_options.yuv_range, optarg, 7);
+				else
+					fprintf(stderr, "V4L2_CORE: (options) Error in yuv_range usage: -R[--yuv_range] full|limited \n");
+				break;
+			}
+			case 'T':
+			{
+				my_options.decoder_threads = (int) strtoul(optarg, &stopstring, 10);
+				if(*stopstring != '\0')
+				{
+					fprintf(stderr, "V4L2_CORE: (options) Error in decoder_threads usage: -T[--decoder_threads] NTHREADS \n");
+					my_options.decoder_threads = -1;
+				}
+				break;
+			}
+			case 'Q':
+			{
+				my_options.frame_queue = (int) strtoul(optarg, &stopstring, 10);
+				if(*stopstring != '\0' || my_options.frame_queue < 1)
+				{
+					fprintf(stderr, "V4L2_CORE: (options) Error in frame_queue usage: -Q[--frame_queue] NFRAMES \n");
+					my_options.frame_queue = -1;
+				}
+				break;
+			}
+			case 'B':
+			{
+				my_options.buffers = (int) strtoul(optarg, &stopstring, 10);
+				if(*stopstring != '\0' || my_options.buffers < 2)
+				{
+					fprintf(stderr, "V4L2_CORE: (options) Error in buffers usage: -B[--buffers] NBUFFERS \n");
+					my_options.buffers = -1;
+				}
+				break;
+			}
+			case 'H':
+			{
+				my_options.frame_hold = (int) strtoul(optarg, &stopstring, 10);
+				if(*stopstring != '\0' || my_options.frame_hold < 0)
+				{
+					fprintf(stderr, "V4L2_CORE: (options) Error in frame_hold usage: -H[--frame_hold] NFRAMES \n");
+					my_options.frame_hold = -1;
+				}
+				break;
+			}
 			case 'x':
 				my_options.width = (int) strtoul(optarg, &stopstring, 10);
 				if( *stopstring != 'x')
@@ -599,6 +763,77 @@ int options_parse(int argc, char *argv[])
 					strncpy(my_options.video_codec, optarg, 4);
 				break;
 			}
+			case 'O':
+			{
+				if(strcasecmp(optarg, "sync") == 0 ||
+					strcasecmp(optarg, "thread") == 0 ||
+					strcasecmp(optarg, "direct") == 0 ||
+					strcasecmp(optarg, "uring") == 0)
+					strncpy(my_options.io_mode, optarg, 6);
+				else
+					fprintf(stderr, "V4L2_CORE: (options) Error in io_mode usage: -O[--io_mode] sync|thread|direct|uring \n");
+				break;
+			}
+			case 'L':
+			{
+				my_options.preallocate = (int) strtoul(optarg, &stopstring, 10);
+				if(*stopstring != '\0' || my_options.preallocate > 1)
+				{
+					fprintf(stderr, "V4L2_CORE: (options) Error in preallocate usage: -L[--preallocate] 0|1 \n");
+					my_options.preallocate = -1;
+				}
+				break;
+			}
+			case 'S':
+			{
+				my_options.segment_time = (int) strtoul(optarg, &stopstring, 10);
+				if(*stopstring != '\0' || my_options.segment_time < 0)
+				{
+					fprintf(stderr, "V4L2_CORE: (options) Error in segment_time usage: -S[--segment_time] TIME_IN_SEC \n");
+					my_options.segment_time = -1;
+				}
+				break;
+			}
+			case 's':
+			{
+				my_options.segment_size = (int) strtoul(optarg, &stopstring, 10);
+				if(*stopstring != '\0' || my_options.segment_size < 0)
+				{
+					fprintf(stderr, "V4L2_CORE: (options) Error in segment_size usage: -s[--segment_size] MBYTES \n");
+					my_options.segment_size = -1;
+				}
+				break;
+			}
+			case 'K':
+			{
+				my_options.segment_keep = (int) strtoul(optarg, &stopstring, 10);
+				if(*stopstring != '\0' || my_options.segment_keep < 0)
+				{
+					fprintf(stderr, "V4L2_CORE: (options) Error in segment_keep usage: -K[--segment_keep] NFILES \n");
+					my_options.segment_keep = -1;
+				}
+				break;
+			}
+			case 'P':
+			{
+				my_options.preroll = (int) strtoul(optarg, &stopstring, 10);
+				if(*stopstring != '\0' || my_options.preroll < 0)
+				{
+					fprintf(stderr, "V4L2_CORE: (options) Error in preroll usage: -P[--preroll] TIME_IN_SEC \n");
+					my_options.preroll = -1;
+				}
+				break;
+			}
+			case 'W':
+			{
+				my_options.preroll_size = (int) strtoul(optarg, &stopstring, 10);
+				if(*stopstring != '\0' || my_options.preroll_size <= 0)
+				{
+					fprintf(stderr, "V4L2_CORE: (options) Error in preroll_size usage: -W[--preroll_size] MBYTES \n");
+					my_options.preroll_size = -1;
+				}
+				break;
+			}
 			case 'p':
 			{
 				if(my_options.prof_filename != NULL)
@@ -37,9 +37,22 @@ typedef struct _options_t
 	char gui[5];     /*gui api*/
 	char audio[6];   /*audio api - none; port; pulse*/
 	int audio_device; /*audio device index 0..N (-1 = default)*/
-	char capture[5]; /*capture method: read or mmap*/
+	char capture[8]; /*capture method: read, mmap, userptr or dmabuf*/
+	char yuv_matrix[6]; /*yuv to rgb color matrix: bt601 or bt709*/
+	char yuv_range[8]; /*yuv quantization range: full or limited*/
+	int decoder_threads; /*raw frame decoder threads (0 = auto; -1 = not set)*/
+	int frame_queue; /*frame queue size (pipelined decoding if > 1; -1 = not set)*/
+	int buffers; /*number of v4l2 driver buffers (-1 = not set)*/
+	int frame_hold; /*extra frames held by the video encoder (-1 = not set)*/
 	char audio_codec[5]; /*audio codec*/
 	char video_codec[5]; /*video codec*/
+	char io_mode[7]; /*video file writer: sync, thread, direct or uring*/
+	int preallocate; /*preallocate video files (-1 = not set)*/
+	int segment_time; /*video segment duration in sec (-1 = not set)*/
+	int segment_size; /*video segment size in Mbytes (-1 = not set)*/
+	int segment_keep; /*video segments kept (-1 = not set)*/
+	int preroll; /*video pre-roll in sec (-1 = not set)*/
+	int preroll_size; /*video pre-roll memory in Mbytes (-1 = not set)*/
 	char *prof_filename; /*profile_filename (if set load it on start)*/
 	char *profile_name;
 	char *profile_path;
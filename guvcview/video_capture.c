@@ -31,6 +31,7 @@
 #include <errno.h>
 #include <assert.h>
 #include <math.h>
+#include <stdatomic.h>
 /* support for internationalization - i18n */
 #include <locale.h>
 #include <libintl.h>
@@ -85,8 +86,18 @@ static __THREAD_TYPE encoder_thread;
 
 static int my_encoder_status = 0;
 
+static _Atomic int preroll_enabled = 0; /*keep a video pre-roll while not recording*/
+static _Atomic int preroll_armed = 0; /*encoder thread is filling the pre-roll ring*/
+/*serializes the encoder thread start/stop (gui and capture threads)*/
+static __MUTEX_TYPE encoder_thread_mutex = __STATIC_MUTEX_INIT;
+static __thread int in_encoder_thread = 0; /*set in the encoder thread*/
+
 static char status_message[80];
 
+/*photo suffix (images may be queued but not written yet)*/
+static char *photo_suffix_base = NULL; /*path and name of the last suffixed photo*/
+static unsigned long long photo_suffix = 0;
+
 /*
  * set render flag
  * args:
@@ -726,7 +737,7 @@ static void *audio_processing_loop(void *data)
 
 	render_set_osd_mask(osd_mask);
 
-	while(video_capture_get_save_video())
+	while(video_capture_get_save_video() || atomic_load(&preroll_armed))
 	{
 		int ret = audio_get_next_buffer(audio_ctx, audio_buff,
 				sample_type, my_audio_mask);
@@ -734,13 +745,10 @@ static void *audio_processing_loop(void *data)
 		if(ret > 0)
 		{
 			/*
-			 * no buffers to process
-			 * sleep a couple of milisec
+			 * no buffers to process: wait for the next one
+			 * (timeout so that a capture stop is seen)
 			 */
-			 struct timespec req = {
-				.tv_sec = 0,
-				.tv_nsec = 1000000};/*nanosec*/
-			 nanosleep(&req, NULL);
+			audio_wait_buffer(audio_ctx, 100);
 		}
 		else if(ret == 0)
 		{
@@ -768,12 +776,112 @@ static void *audio_processing_loop(void *data)
 
 	render_set_osd_mask(osd_mask);
 
+	audio_stats_t audio_stats;
+	audio_get_stats(audio_ctx, &audio_stats);
+	if(debug_level > 0 || audio_stats.dropped > 0 || audio_stats.overruns > 0)
+		printf("GUVCVIEW: audio buffers: %" PRIu64 " dropped: %" PRIu64
+			" overruns: %" PRIu64 " (ring max fill %i of %i)\n",
+			audio_stats.buffers, audio_stats.dropped, audio_stats.overruns,
+			audio_stats.ring_max_fill, audio_stats.ring_size);
+
 	audio_stop(audio_ctx);
 	audio_delete_buffer(audio_buff);
 
 	return ((void *) 0);
 }
 
+/*
+ * start the encoder audio thread
+ * args:
+ *    encoder_ctx - pointer to encoder context
+ *    audio_ctx - pointer to audio context
+ *    thread - pointer to audio thread
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 1 if the thread was started; 0 otherwise
+ */
+static int start_encoder_audio_thread(encoder_context_t *encoder_ctx,
+	audio_context_t *audio_ctx,
+	__THREAD_TYPE *thread)
+{
+	if(encoder_ctx->enc_audio_ctx == NULL || audio_ctx == NULL ||
+		audio_get_channels(audio_ctx) <= 0)
+		return 0;
+
+	if(debug_level > 1)
+		printf("GUVCVIEW: starting encoder audio thread\n");
+
+	int ret = __THREAD_CREATE(thread, audio_processing_loop, (void *) encoder_ctx);
+
+	if(ret)
+	{
+		fprintf(stderr, "GUVCVIEW: encoder audio thread creation failed (%i)\n", ret);
+		return 0;
+	}
+	else if(debug_level > 2)
+		printf("GUVCVIEW: created audio encoder thread with tid: %u\n",
+			(unsigned int) *thread);
+
+	return 1;
+}
+
+/*
+ * get a new (suffixed) video segment filename
+ * args:
+ *    path - video path
+ *    name - video base name
+ *
+ * asserts:
+ *   none
+ *
+ * returns: newly allocated string with the segment full path (must free)
+ */
+static char *get_segment_filename(const char *path, const char *name)
+{
+	char *segment_name = add_file_suffix(path, name);
+	char *segment_filename = NULL;
+
+	int pathsize = strlen(path);
+	if(path[pathsize - 1] != '/')
+		segment_filename = smart_cat(path, '/', segment_name);
+	else
+		segment_filename = smart_cat(path, 0, segment_name);
+
+	free(segment_name);
+
+	return segment_filename;
+}
+
+/*
+ * delete the oldest finished video segment (ring retention)
+ * args:
+ *    segment_list - list of finished segment files (oldest first)
+ *    n_segments - pointer to number of entries in the list
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void delete_oldest_segment(char **segment_list, int *n_segments)
+{
+	if(*n_segments <= 0)
+		return;
+
+	if(debug_level > 0)
+		printf("GUVCVIEW: deleting video segment %s\n", segment_list[0]);
+
+	if(unlink(segment_list[0]) < 0)
+		fprintf(stderr, "GUVCVIEW: couldn't delete video segment %s: %s\n",
+			segment_list[0], strerror(errno));
+
+	free(segment_list[0]);
+	(*n_segments)--;
+	memmove(segment_list, segment_list + 1, *n_segments * sizeof(char *));
+}
+
 /*
  * encoder loop (should run in a separate thread)
  * args:
@@ -786,7 +894,12 @@ static void *audio_processing_loop(void *data)
  */
 static void *encoder_loop(void *data)
 {
-	my_encoder_status = 1;
+	in_encoder_thread = 1;
+
+	/*in pre-roll the encoder only counts as started when recording*/
+	int preroll = atomic_load(&preroll_armed);
+	if(!preroll)
+		my_encoder_status = 1;
 
 	if(debug_level > 1)
 		printf("GUVCVIEW: encoder thread (tid: %u)\n",
@@ -864,11 +977,38 @@ static void *encoder_loop(void *data)
 		current_framerate = v4l2core_get_h264_frame_rate_config(my_vd);
 	}
 
+	/*pre-roll: encode into the memory ring until the recording is triggered*/
+	int audio_started = 0;
+	if(preroll)
+	{
+		if(encoder_muxer_preroll_init(encoder_ctx) < 0)
+			fprintf(stderr, "GUVCVIEW: couldn't start the video pre-roll buffer\n");
+
+		audio_started = start_encoder_audio_thread(encoder_ctx, audio_ctx, &encoder_audio_thread);
+
+		while(atomic_load(&preroll_armed) && !video_capture_get_save_video())
+		{
+			if(encoder_process_next_video_buffer(encoder_ctx) > 0)
+				encoder_wait_video_buffer(100);
+		}
+	}
+
+	/*pre-roll stopped without a recording*/
+	int record = !preroll || video_capture_get_save_video();
+
 	char *video_filename = NULL;
 	/*get_video_[name|path] always return a non NULL value*/
 	char *name = strdup(get_video_name());
 	char *path = strdup(get_video_path());
 
+	/*segmented recording*/
+	char *base_name = strdup(name); /*segments are suffixed from the base name*/
+	char *next_filename = NULL; /*next segment (already opened by the muxer)*/
+	char **segment_list = NULL; /*finished segments (oldest first)*/
+	int n_segments = 0;
+	int segment_count = 0;
+	int segment_keep = config_get()->segment_keep;
+
 	if(get_video_sufix_flag())
 	{
 		char *new_name = add_file_suffix(path, name);
@@ -881,48 +1021,36 @@ static void *encoder_loop(void *data)
 	else
 		video_filename = smart_cat(path, 0, name);
 
-	snprintf(status_message, 79, _("saving video to %s"), video_filename);
-	gui_status_message(status_message);
+	if(record)
+	{
+		my_encoder_status = 1;
+
+		snprintf(status_message, 79, _("saving video to %s"), video_filename);
+		gui_status_message(status_message);
 
-	/*muxer initialization*/
-	encoder_muxer_init(encoder_ctx, video_filename);
+		/*muxer initialization (writes the pre-roll packets)*/
+		encoder_muxer_init(encoder_ctx, video_filename);
 
-	/*start video capture*/
-	video_capture_save_video(1);
+		/*start video capture*/
+		video_capture_save_video(1);
+	}
 
 	int treshold = 102400; /*100 Mbytes*/
 	int64_t last_check_pts = 0; /*last pts when disk supervisor called*/
 
-	/*start audio processing thread*/
-	if(encoder_ctx->enc_audio_ctx != NULL && audio_get_channels(audio_ctx) > 0)
-	{
-		if(debug_level > 1)
-			printf("GUVCVIEW: starting encoder audio thread\n");
-
-		int ret = __THREAD_CREATE(&encoder_audio_thread, audio_processing_loop, (void *) encoder_ctx);
-
-		if(ret)
-			fprintf(stderr, "GUVCVIEW: encoder audio thread creation failed (%i)\n", ret);
-		else if(debug_level > 2)
-			printf("GUVCVIEW: created audio encoder thread with tid: %u\n",
-				(unsigned int) encoder_audio_thread);
-	}
+	/*start audio processing thread (already running in pre-roll)*/
+	if(record && !audio_started)
+		audio_started = start_encoder_audio_thread(encoder_ctx, audio_ctx, &encoder_audio_thread);
 
 	while(video_capture_get_save_video())
 	{
-		/*process the video buffer*/
+		/*
+		 * process the video buffer
+		 * if empty, sleep until the capture thread adds a frame
+		 * (the timeout lets us check the stop flag)
+		 */
 		if(encoder_process_next_video_buffer(encoder_ctx) > 0)
-		{
-			/*
-			 * no buffers to process
-			 * sleep a couple of milisec
-			 */
-			 struct timespec req = {
-				.tv_sec = 0,
-				.tv_nsec = 1000000};/*nanosec*/
-			 nanosleep(&req, NULL);
-
-		}
+			encoder_wait_video_buffer(100);
 
 		/*disk supervisor*/
 		if(encoder_ctx->enc_video_ctx->pts - last_check_pts > 2 * NSEC_PER_SEC)
@@ -931,10 +1059,55 @@ static void *encoder_loop(void *data)
 
 			if(!encoder_disk_supervisor(treshold, path))
 			{
-				/*stop capture*/
-				gui_set_video_capture_button_status(0);
+				/*ring retention: make room by deleting the oldest segment*/
+				if(segment_keep > 0 && n_segments > 0)
+					delete_oldest_segment(segment_list, &n_segments);
+				else /*stop capture*/
+					gui_set_video_capture_button_status(0);
 			}
 		}
+
+		/*open the next segment ahead of the cut*/
+		if(encoder_muxer_need_segment(encoder_ctx))
+		{
+			free(next_filename);
+			next_filename = get_segment_filename(path, base_name);
+
+			if(encoder_muxer_prepare_segment(encoder_ctx, next_filename) < 0)
+			{
+				free(next_filename);
+				next_filename = NULL;
+			}
+		}
+
+		/*h264 direct input: the cut needs an IDR frame from the camera*/
+		if(encoder_ctx->video_codec_ind == 0 &&
+			v4l2core_get_requested_frame_format(my_vd) == V4L2_PIX_FMT_H264 &&
+			encoder_muxer_segment_key_request(encoder_ctx))
+			v4l2core_h264_request_idr(my_vd);
+
+		/*the muxer switched to the next segment*/
+		if(encoder_muxer_get_segment_count() > segment_count)
+		{
+			segment_count++;
+
+			segment_list = realloc(segment_list, (n_segments + 1) * sizeof(char *));
+			if(segment_list == NULL)
+			{
+				fprintf(stderr,"GUVCVIEW: FATAL memory allocation failure (encoder_loop): %s\n", strerror(errno));
+				exit(-1);
+			}
+			segment_list[n_segments++] = video_filename;
+			video_filename = next_filename;
+			next_filename = NULL;
+
+			/*keep the current and the last (segment_keep - 1) segments*/
+			while(segment_keep > 0 && n_segments >= segment_keep)
+				delete_oldest_segment(segment_list, &n_segments);
+
+			snprintf(status_message, 79, _("saving video to %s"), video_filename);
+			gui_status_message(status_message);
+		}
 	}
 
 	if(debug_level > 1)
@@ -945,7 +1118,7 @@ static void *encoder_loop(void *data)
 		printf("GUVCVIEW: flushing video buffers - done\n");
 
 	/*make sure the audio processing thread has stopped*/
-	if(encoder_ctx->enc_audio_ctx != NULL && audio_get_channels(audio_ctx) > 0)
+	if(audio_started)
 	{
 		if(debug_level > 1)
 			printf("GUVCVIEW: join encoder audio thread\n");
@@ -968,12 +1141,132 @@ static void *encoder_loop(void *data)
 	free(video_filename);
 	free(path);
 	free(name);
+	free(base_name);
+	free(next_filename);
+	int i = 0;
+	for(i = 0; i < n_segments; i++)
+		free(segment_list[i]);
+	free(segment_list);
 
 	my_encoder_status = 0;
 
 	return ((void *) 0);
 }
 
+/*
+ * release a video frame reference held by the encoder
+ *   (called from the encoder thread)
+ * args:
+ *   data - pointer to frame buffer
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void release_encoder_frame(void *data)
+{
+	v4l2core_release_frame(my_vd, (v4l2_frame_buff_t *) data);
+}
+
+/*
+ * add a video frame to the encoder ring buffer
+ *   the frame is referenced instead of copied when it is safe:
+ *   there is a free frame left for capture, the data doesn't live in a
+ *   driver buffer (requeued when referenced) and it won't change before
+ *   encoding (osd is rendered in place)
+ * args:
+ *   frame - pointer to frame buffer
+ *   input_frame - pointer to frame data to encode (yuv, raw or h264)
+ *   size - frame data size (in bytes)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+static int add_encoder_frame(v4l2_frame_buff_t *frame, uint8_t *input_frame, int size)
+{
+	int zero_copy = (v4l2core_get_free_frames(my_vd) > 0);
+
+	if(input_frame == frame->yuv_frame)
+		zero_copy = zero_copy && (render_get_osd_mask() == REND_OSD_NONE);
+	else if(input_frame == frame->raw_frame)
+		zero_copy = zero_copy && (frame->index < 0);
+
+	if(!zero_copy)
+		return encoder_add_video_frame(input_frame, size, frame->timestamp, frame->isKeyframe);
+
+	v4l2core_frame_ref(my_vd, frame);
+
+	int ret = encoder_add_video_frame_ref(input_frame, size, frame->timestamp,
+		frame->isKeyframe, release_encoder_frame, frame);
+
+	if(ret != 0)
+		v4l2core_release_frame(my_vd, frame); /*dropped: not referenced*/
+
+	return ret;
+}
+
+/*
+ * add a number suffix to the photo name
+ *   the photo dir is only checked for the suffix when the path or name
+ *   changes, after that the suffix is incremented (queued photos may
+ *   not be in the dir yet)
+ * args:
+ *   path - string with photo path (to dir)
+ *   name - string with photo basename (name.ext)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: newly allocated string with suffixed photo name (must free)
+ */
+static char *add_photo_suffix(const char *path, const char *name)
+{
+	char *base = smart_cat(path, '/', name);
+
+	if(photo_suffix_base == NULL || strcmp(base, photo_suffix_base) != 0)
+	{
+		if(photo_suffix_base)
+			free(photo_suffix_base);
+		photo_suffix_base = base;
+		photo_suffix = get_file_suffix(path, name);
+	}
+	else
+		free(base);
+
+	photo_suffix++;
+
+	return set_file_suffix(name, photo_suffix);
+}
+
+/*
+ * save image callback (called from a save queue worker thread)
+ * args:
+ *   filename - saved image file name
+ *   ret - save error code
+ *   data - callback user data (not used)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void save_image_done(const char *filename, int ret, void *data)
+{
+	/*called concurrently by the save queue workers: use a local message*/
+	char message[80];
+
+	if(ret == E_OK)
+		snprintf(message, 79, _("saved image to %s"), filename);
+	else
+		snprintf(message, 79, _("couldn't save image to %s"), filename);
+
+	/*the gui keeps its own copy*/
+	gui_status_message(message);
+}
+
 /*
  * capture loop (should run in a separate thread)
  * args:
@@ -1039,6 +1332,10 @@ void *capture_loop(void *data)
 		render_set_event_callback(EV_KEY_RIGHT, &key_RIGHT_callback, NULL);
 	}
 
+	/*keep encoding the last seconds of video until a recording starts*/
+	preroll_enabled = (my_config->preroll > 0);
+	start_encoder_preroll();
+
 	/*add a video capture timer*/
 	if(my_options->video_timer > 0)
 	{
@@ -1074,6 +1371,30 @@ void *capture_loop(void *data)
 			int current_height = v4l2core_get_frame_height(my_vd);
 
 			restart = 0; /*reset*/
+
+			/*the pre-roll encoder uses the current format*/
+			stop_encoder_preroll();
+
+			/*
+			 * frames referenced by the encoder must be released before
+			 * cleaning the buffers: no new references are added here and
+			 * the encoder thread releases them, either when encoding or
+			 * when closing the ring, so wait for all of them (no timeout)
+			 */
+			int wait_ms = 0;
+			while(encoder_get_video_frame_refs() > 0)
+			{
+				struct timespec req = {
+					.tv_sec = 0,
+					.tv_nsec = 10000000};/*nanosec*/
+				nanosleep(&req, NULL);
+				wait_ms += 10;
+
+				if(wait_ms % 2000 == 0)
+					fprintf(stderr, "GUVCVIEW: still waiting for the encoder to release %i frames\n",
+						encoder_get_video_frame_refs());
+			}
+
 			v4l2core_stop_stream(my_vd);
 
 			v4l2core_clean_buffers(my_vd);
@@ -1138,6 +1459,7 @@ void *capture_loop(void *data)
 
 			v4l2core_start_stream(my_vd);
 
+			start_encoder_preroll();
 		}
 
 		/*get the frame from v4l2 core*/
@@ -1198,7 +1520,7 @@ void *capture_loop(void *data)
 
 				if(get_photo_sufix_flag())
 				{
-					char *new_name = add_file_suffix(path, name);
+					char *new_name = add_photo_suffix(path, name);
 					free(name); /*free old name*/
 					name = new_name; /*replace with suffixed name*/
 				}
@@ -1211,10 +1533,26 @@ void *capture_loop(void *data)
 				//if(debug_level > 1)
 				//	printf("GUVCVIEW: saving image to %s\n", img_filename);
 
-				snprintf(status_message, 79, _("saving image to %s"), img_filename);
-				gui_status_message(status_message);
+				/*
+				 * without render fx the camera jpeg bitstream (mjpeg)
+				 * is the same image, so save it instead of re-encoding
+				 */
+				int photo_format = get_photo_format();
+				if(photo_format == IMG_FMT_JPG && my_render_mask == REND_FX_YUV_NOFILT)
+					photo_format |= IMG_FLAG_PASSTHROUGH;
 
-				v4l2core_save_image(frame, img_filename, get_photo_format());
+				/*
+				 * encoded and written by the save queue workers
+				 * (the osd is rendered in place, so copy the frame)
+				 */
+				if(v4l2core_save_image_async(my_vd, frame, img_filename,
+					photo_format, (render_get_osd_mask() != REND_OSD_NONE),
+					save_image_done, NULL) != E_OK)
+				{
+					fprintf(stderr, "GUVCVIEW: too many pending images - dropped %s\n", img_filename);
+					snprintf(status_message, 79, _("couldn't save image to %s"), img_filename);
+					gui_status_message(status_message);
+				}
 
 				free(path);
 				free(name);
@@ -1223,8 +1561,8 @@ void *capture_loop(void *data)
 				save_image = 0; /*reset*/
 			}
 
-			/*save the frame (video)*/
-			if(video_capture_get_save_video())
+			/*save the frame (video or pre-roll)*/
+			if(video_capture_get_save_video() || atomic_load(&preroll_armed))
 			{
 				int size = (frame->width * frame->height * 3) / 2;
 
@@ -1249,7 +1587,7 @@ void *capture_loop(void *data)
 
 				}
 				/*add the frame to the encoder buffer*/
-				encoder_add_video_frame(input_frame, size, frame->timestamp, frame->isKeyframe);
+				add_encoder_frame(frame, input_frame, size);
 
 				/*
 				 * exponencial scheduler
@@ -1296,17 +1634,56 @@ void *capture_loop(void *data)
 		}
 	}
 
-	v4l2core_stop_stream(my_vd);
-
-	/*if we are still saving video then stop it*/
+	/*
+	 * if we are still saving video (or in pre-roll) then stop it
+	 * (releases the frames referenced by the encoder)
+	 */
+	preroll_enabled = 0;
+	stop_encoder_preroll();
 	if(video_capture_get_save_video())
 		stop_encoder_thread();
 
+	/*write the queued images*/
+	v4l2core_flush_save_image(my_vd);
+
+	v4l2core_stop_stream(my_vd);
+
 	render_close();
 
 	return ((void *) 0);
 }
 
+/*
+ * start the encoder thread in pre-roll mode (if enabled)
+ *   encoder_thread_mutex must be held
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+static int preroll_start()
+{
+	if(!preroll_enabled || atomic_load(&preroll_armed) || get_encoder_status())
+		return 0;
+
+	atomic_store(&preroll_armed, 1);
+
+	int ret = __THREAD_CREATE(&encoder_thread, encoder_loop, NULL);
+
+	if(ret)
+	{
+		fprintf(stderr, "GUVCVIEW: encoder pre-roll thread creation failed (%i)\n", ret);
+		atomic_store(&preroll_armed, 0);
+	}
+	else if(debug_level > 1)
+		printf("GUVCVIEW: video pre-roll started\n");
+
+	return ret;
+}
+
 /*
  * start the encoder thread
  * args:
@@ -1319,6 +1696,18 @@ void *capture_loop(void *data)
  */
 int start_encoder_thread()
 {
+	__LOCK_MUTEX(&encoder_thread_mutex);
+
+	/*the pre-roll encoder is running: start recording from it*/
+	if(atomic_load(&preroll_armed))
+	{
+		/*set the flag first: the pre-roll thread must not see both cleared*/
+		video_capture_save_video(1);
+		atomic_store(&preroll_armed, 0);
+		__UNLOCK_MUTEX(&encoder_thread_mutex);
+		return 0;
+	}
+
 	int ret = __THREAD_CREATE(&encoder_thread, encoder_loop, NULL);
 
 	if(ret)
@@ -1327,6 +1716,8 @@ int start_encoder_thread()
 		printf("GUVCVIEW: created encoder thread with tid: %u\n",
 			(unsigned int) encoder_thread);
 
+	__UNLOCK_MUTEX(&encoder_thread_mutex);
+
 	return ret;
 }
 
@@ -1342,12 +1733,91 @@ int start_encoder_thread()
  */
 int stop_encoder_thread()
 {
+	/*
+	 * called from the encoder thread (disk supervisor stop):
+	 * it can't join itself, flag it to finish and detach it
+	 * (unless another thread is already stopping and joining it)
+	 */
+	if(in_encoder_thread)
+	{
+		video_capture_save_video(0);
+		atomic_store(&preroll_armed, 0);
+
+		if(__TRYLOCK_MUTEX(&encoder_thread_mutex) == 0)
+		{
+			__THREAD_DETACH(__THREAD_SELF());
+			__UNLOCK_MUTEX(&encoder_thread_mutex);
+		}
+		return 0;
+	}
+
+	__LOCK_MUTEX(&encoder_thread_mutex);
+
 	video_capture_save_video(0);
+	atomic_store(&preroll_armed, 0);
 
 	__THREAD_JOIN(encoder_thread);
 
 	if(debug_level > 1)
 		printf("GUVCVIEW: encoder thread terminated and joined\n");
 
+	/*fill the pre-roll for the next recording*/
+	preroll_start();
+
+	__UNLOCK_MUTEX(&encoder_thread_mutex);
+
+	return 0;
+}
+
+/*
+ * start the encoder thread in pre-roll mode (if enabled):
+ *   video is encoded into a memory ring and only written
+ *   to file when the recording starts (start_encoder_thread)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int start_encoder_preroll()
+{
+	__LOCK_MUTEX(&encoder_thread_mutex);
+	int ret = preroll_start();
+	__UNLOCK_MUTEX(&encoder_thread_mutex);
+
+	return ret;
+}
+
+/*
+ * stop the encoder thread in pre-roll mode (no recording)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int stop_encoder_preroll()
+{
+	__LOCK_MUTEX(&encoder_thread_mutex);
+
+	if(!atomic_load(&preroll_armed))
+	{
+		__UNLOCK_MUTEX(&encoder_thread_mutex);
+		return 0;
+	}
+
+	atomic_store(&preroll_armed, 0);
+
+	__THREAD_JOIN(encoder_thread);
+
+	__UNLOCK_MUTEX(&encoder_thread_mutex);
+
+	if(debug_level > 1)
+		printf("GUVCVIEW: video pre-roll stopped\n");
+
 	return 0;
 }
@@ -311,6 +311,32 @@ int start_encoder_thread();
  */
 int stop_encoder_thread();
 
+/*
+ * start the encoder thread in pre-roll mode (if enabled):
+ *   video is encoded into a memory ring and only written
+ *   to file when the recording starts (start_encoder_thread)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int start_encoder_preroll();
+
+/*
+ * stop the encoder thread in pre-roll mode (no recording)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+int stop_encoder_preroll();
+
 /*
  * capture loop (should run in a separate thread)
  * args:
@@ -38,6 +38,9 @@
 #include <math.h>
 #include <errno.h>
 #include <assert.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/eventfd.h>
 /* support for internationalization - i18n */
 #include <locale.h>
 #include <libintl.h>
@@ -45,17 +48,30 @@
 #include "../config.h"
 #include "gviewaudio.h"
 #include "audio.h"
+#include "audio_convert.h"
 #include "gview.h"
 #include "audio_portaudio.h"
 #if HAS_PULSEAUDIO
   #include "audio_pulseaudio.h"
 #endif
 
-#define AUDBUFF_NUM     80    /*number of audio buffers*/
+#define AUDBUFF_TIME    2.0   /*audio time (sec) the ring holds on top of latency*/
+#define AUDBUFF_MIN     8     /*min number of audio buffers*/
+#define AUDBUFF_MAX     1024  /*max number of audio buffers*/
 #define AUDBUFF_FRAMES  1152  /*number of audio frames per buffer*/
+
+/*
+ * audio ring buffer: lock free single producer (audio api callback)
+ * single consumer (audio processing thread); the buffer counters only
+ * grow, the slot is counter % audio_buffers_num
+ */
 static audio_buff_t *audio_buffers = NULL; /*pointer to buffers list*/
-static int buffer_read_index = 0; /*current read index of buffer list*/
-static int buffer_write_index = 0;/*current write index of buffer list*/
+static sample_t *audio_buffers_data = NULL; /*sample storage for all buffers*/
+static int audio_buffers_num = 0; /*number of buffers in the ring*/
+static _Atomic uint64_t buffer_read_count = 0;  /*buffers consumed*/
+static _Atomic uint64_t buffer_write_count = 0; /*buffers produced*/
+static _Atomic int buffer_consumer_waiting = 0; /*consumer blocked on event_fd*/
+static int buffer_event_fd = -1; /*eventfd: wakes up the consumer*/
 
 int audio_verbosity = 0;
 
@@ -116,8 +132,13 @@ void audio_unlock_mutex(audio_context_t *audio_ctx)
  */
 static void audio_free_buffers()
 {
-	buffer_read_index = 0;
-	buffer_write_index = 0;
+	atomic_store(&buffer_read_count, 0);
+	atomic_store(&buffer_write_count, 0);
+	atomic_store(&buffer_consumer_waiting, 0);
+
+	if(buffer_event_fd >= 0)
+		close(buffer_event_fd);
+	buffer_event_fd = -1;
 
 	/*return if no buffers set*/
 	if(!audio_buffers)
@@ -127,15 +148,12 @@ static void audio_free_buffers()
 		return;
 	}
 
-	int i = 0;
-
-	for(i = 0; i < AUDBUFF_NUM; ++i)
-	{
-		free(audio_buffers[i].data);
-	}
+	free(audio_buffers_data);
+	audio_buffers_data = NULL;
 
 	free(audio_buffers);
 	audio_buffers = NULL;
+	audio_buffers_num = 0;
 }
 
 /*
@@ -197,6 +215,38 @@ void audio_delete_buffer(audio_buff_t *audio_buff)
 	free(audio_buff);
 }
 
+/*
+ * get the number of buffers for the ring
+ * args:
+ *    audio_ctx - pointer to audio context data
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of buffers needed to hold AUDBUFF_TIME sec
+ *   plus a couple of api latency periods (bursts)
+ */
+static int audio_get_ring_size(audio_context_t *audio_ctx)
+{
+	int frames = audio_ctx->capture_buff_size / audio_ctx->channels;
+	int samprate = audio_ctx->samprate;
+
+	if(frames <= 0 || samprate <= 0)
+		return AUDBUFF_MIN;
+
+	double latency = audio_ctx->latency > 0 ? audio_ctx->latency : 0;
+	double ring_time = AUDBUFF_TIME + 2 * latency;
+
+	int num = (int) ceil((ring_time * samprate) / frames);
+
+	if(num < AUDBUFF_MIN)
+		num = AUDBUFF_MIN;
+	if(num > AUDBUFF_MAX)
+		num = AUDBUFF_MAX;
+
+	return num;
+}
+
 /*
  * alloc audio buffers
  * args:
@@ -239,24 +289,36 @@ static int audio_init_buffers(audio_context_t *audio_ctx)
 	/*free audio_buffers (if any)*/
 	audio_free_buffers();
 
-	audio_buffers = calloc(AUDBUFF_NUM, sizeof(audio_buff_t));
-	if(audio_buffers == NULL)
+	audio_buffers_num = audio_get_ring_size(audio_ctx);
+
+	audio_buffers = calloc(audio_buffers_num, sizeof(audio_buff_t));
+	audio_buffers_data = calloc(
+		(size_t) audio_buffers_num * audio_ctx->capture_buff_size,
+		sizeof(sample_t));
+	if(audio_buffers == NULL || audio_buffers_data == NULL)
 	{
 		fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_init_buffers): %s\n", strerror(errno));
 		exit(-1);
 	}
 
-	for(i = 0; i < AUDBUFF_NUM; ++i)
-	{
-		audio_buffers[i].data = calloc(
-			audio_ctx->capture_buff_size, sizeof(sample_t));
-		if(audio_buffers[i].data == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_init_buffers): %s\n", strerror(errno));
-			exit(-1);
-		}
-		audio_buffers[i].flag = AUDIO_BUFF_FREE;
-	}
+	for(i = 0; i < audio_buffers_num; ++i)
+		audio_buffers[i].data = audio_buffers_data +
+			((size_t) i * audio_ctx->capture_buff_size);
+
+	buffer_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if(buffer_event_fd < 0)
+		fprintf(stderr, "AUDIO: couldn't create audio ring event (%s): polling\n",
+			strerror(errno));
+
+	/*reset the ring stats*/
+	atomic_store(&audio_ctx->stats_buffers, 0);
+	atomic_store(&audio_ctx->stats_dropped, 0);
+	atomic_store(&audio_ctx->stats_overruns, 0);
+	atomic_store(&audio_ctx->stats_max_fill, 0);
+
+	if(audio_verbosity > 1)
+		printf("AUDIO: ring buffer with %i buffers of %i frames\n",
+			audio_buffers_num, audio_ctx->capture_buff_size / audio_ctx->channels);
 
 	return 0;
 }
@@ -287,45 +349,161 @@ void audio_fill_buffer(audio_context_t *audio_ctx, int64_t ts)
 
 	audio_ctx->ts_drift = audio_ctx->current_ts - ts;
 
-	/*get the current write indexed buffer flag*/
-	audio_lock_mutex(audio_ctx);
-	int flag = audio_buffers[buffer_write_index].flag;
-	audio_unlock_mutex(audio_ctx);
+	if(!audio_buffers)
+		return;
 
-	if(flag == AUDIO_BUFF_USED)
+	/*we are the only producer: relaxed load of our own counter*/
+	uint64_t write_count =
+		atomic_load_explicit(&buffer_write_count, memory_order_relaxed);
+	/*acquire: the consumer is done with the slot*/
+	uint64_t fill = write_count -
+		atomic_load_explicit(&buffer_read_count, memory_order_acquire);
+
+	if(fill >= (uint64_t) audio_buffers_num)
 	{
-		fprintf(stderr, "AUDIO: write buffer(%i) is still in use - dropping data\n", buffer_write_index);
+		/*don't print from the api callback for every buffer*/
+		if(atomic_fetch_add_explicit(&audio_ctx->stats_dropped, 1, memory_order_relaxed) == 0 ||
+			audio_verbosity > 1)
+			fprintf(stderr, "AUDIO: audio ring buffer full - dropping data\n");
 		return;
 	}
 
+	int ind = (int) (write_count % audio_buffers_num);
+
 	/*write max_frames and fill a buffer*/
-	memcpy(audio_buffers[buffer_write_index].data,
+	memcpy(audio_buffers[ind].data,
 		audio_ctx->capture_buff,
 		audio_ctx->capture_buff_size * sizeof(sample_t));
 	/*buffer begin time*/
-	audio_buffers[buffer_write_index].timestamp = audio_ctx->current_ts - buffer_length;
-	if(audio_buffers[buffer_write_index].timestamp < 0)
+	audio_buffers[ind].timestamp = audio_ctx->current_ts - buffer_length;
+	if(audio_buffers[ind].timestamp < 0)
 		fprintf(stderr, "AUDIO: write buffer(%i) - invalid timestamp (< 0): cur_ts:%" PRId64 " buf_length:%" PRId64 "\n", 
-			buffer_write_index, audio_ctx->current_ts, buffer_length);
+			ind, audio_ctx->current_ts, buffer_length);
 
-	audio_buffers[buffer_write_index].level_meter[0] = audio_ctx->capture_buff_level[0];
-	audio_buffers[buffer_write_index].level_meter[1] = audio_ctx->capture_buff_level[1];
+	audio_buffers[ind].level_meter[0] = audio_ctx->capture_buff_level[0];
+	audio_buffers[ind].level_meter[1] = audio_ctx->capture_buff_level[1];
 
-	audio_lock_mutex(audio_ctx);
-	audio_buffers[buffer_write_index].flag = AUDIO_BUFF_USED;
-	NEXT_IND(buffer_write_index, AUDBUFF_NUM);
-	audio_unlock_mutex(audio_ctx);
+	/*
+	 * publish the buffer (seq_cst: must be ordered before the
+	 * waiting flag check, see audio_wait_buffer)
+	 */
+	atomic_store(&buffer_write_count, write_count + 1);
 
+	atomic_fetch_add_explicit(&audio_ctx->stats_buffers, 1, memory_order_relaxed);
+	if(fill + 1 > atomic_load_explicit(&audio_ctx->stats_max_fill, memory_order_relaxed))
+		atomic_store_explicit(&audio_ctx->stats_max_fill, fill + 1, memory_order_relaxed);
+
+	if(atomic_load(&buffer_consumer_waiting) && buffer_event_fd >= 0)
+	{
+		uint64_t one = 1;
+		if(write(buffer_event_fd, &one, sizeof(uint64_t)) < 0 && errno != EAGAIN)
+			fprintf(stderr, "AUDIO: couldn't signal audio ring event: %s\n",
+				strerror(errno));
+	}
 }
 
-/* saturate float samples to int16 limits*/
-static int16_t clip_int16 (float in)
+/*
+ * count an api (device/server) overrun
+ * args:
+ *   audio_ctx - pointer to audio context data
+ *
+ * asserts:
+ *   audio_ctx is not null
+ *
+ * returns: none
+ */
+void audio_add_overrun(audio_context_t *audio_ctx)
+{
+	/*assertions*/
+	assert(audio_ctx != NULL);
+
+	atomic_fetch_add_explicit(&audio_ctx->stats_overruns, 1, memory_order_relaxed);
+}
+
+/*
+ * wait for a buffer in the ring (consumer side)
+ * args:
+ *   audio_ctx - pointer to audio context
+ *   timeout - maximum wait time (in ms)
+ *
+ * asserts:
+ *   audio_ctx is not null
+ *
+ * returns: 1 if a buffer is available, 0 on timeout
+ */
+int audio_wait_buffer(audio_context_t *audio_ctx, int timeout)
 {
-	//int16_t out = (int16_t) (in < -32768) ? -32768 : (in > 32767) ? 32767 : in;
+	/*assertions*/
+	assert(audio_ctx != NULL);
 
-	long lout =  lroundf(in);
-	int16_t out = (lout < INT16_MIN) ? INT16_MIN : (lout > INT16_MAX) ? INT16_MAX: (int16_t) lout;
-	return (out);
+	if(!audio_buffers)
+		return 0;
+
+	if(atomic_load_explicit(&buffer_write_count, memory_order_acquire) !=
+		atomic_load_explicit(&buffer_read_count, memory_order_relaxed))
+		return 1;
+
+	if(buffer_event_fd < 0)
+	{
+		/*no event: fall back to a short sleep*/
+		struct timespec req = {
+			.tv_sec = 0,
+			.tv_nsec = 1000000};/*nanosec*/
+		nanosleep(&req, NULL);
+	}
+	else
+	{
+		/*
+		 * announce the wait and check again: the producer either sees
+		 * the flag and signals or published the buffer before the check
+		 */
+		atomic_store(&buffer_consumer_waiting, 1);
+
+		if(atomic_load(&buffer_write_count) ==
+			atomic_load_explicit(&buffer_read_count, memory_order_relaxed))
+		{
+			struct pollfd pfd = {.fd = buffer_event_fd, .events = POLLIN};
+			if(poll(&pfd, 1, timeout) > 0)
+			{
+				uint64_t count = 0;
+				if(read(buffer_event_fd, &count, sizeof(uint64_t)) < 0 && errno != EAGAIN)
+					fprintf(stderr, "AUDIO: couldn't read audio ring event: %s\n",
+						strerror(errno));
+			}
+		}
+
+		atomic_store(&buffer_consumer_waiting, 0);
+	}
+
+	return (atomic_load_explicit(&buffer_write_count, memory_order_acquire) !=
+		atomic_load_explicit(&buffer_read_count, memory_order_relaxed));
+}
+
+/*
+ * get the audio capture stats
+ * args:
+ *   audio_ctx - pointer to audio context
+ *   stats - pointer to stats structure to fill
+ *
+ * asserts:
+ *   audio_ctx is not null
+ *   stats is not null
+ *
+ * returns: none
+ */
+void audio_get_stats(audio_context_t *audio_ctx, audio_stats_t *stats)
+{
+	/*assertions*/
+	assert(audio_ctx != NULL);
+	assert(stats != NULL);
+
+	stats->buffers = atomic_load_explicit(&audio_ctx->stats_buffers, memory_order_relaxed);
+	stats->dropped = atomic_load_explicit(&audio_ctx->stats_dropped, memory_order_relaxed);
+	stats->overruns = atomic_load_explicit(&audio_ctx->stats_overruns, memory_order_relaxed);
+	stats->ring_size = audio_buffers_num;
+	stats->ring_fill = audio_buffers ?
+		(int) (atomic_load(&buffer_write_count) - atomic_load(&buffer_read_count)) : 0;
+	stats->ring_max_fill = (int) atomic_load_explicit(&audio_ctx->stats_max_fill, memory_order_relaxed);
 }
 
 /*
@@ -343,73 +521,43 @@ static int16_t clip_int16 (float in)
  */
 int audio_get_next_buffer(audio_context_t *audio_ctx, audio_buff_t *buff, int type, uint32_t mask)
 {
-	audio_lock_mutex(audio_ctx);
-	int flag = audio_buffers[buffer_read_index].flag;
-	audio_unlock_mutex(audio_ctx);
-
-	if(flag == AUDIO_BUFF_FREE)
+	if(!audio_buffers)
+		return 1;
+
+	/*we are the only consumer: relaxed load of our own counter*/
+	uint64_t read_count =
+		atomic_load_explicit(&buffer_read_count, memory_order_relaxed);
+	/*acquire: the buffer data was written before the count*/
+	if(read_count ==
+		atomic_load_explicit(&buffer_write_count, memory_order_acquire))
 		return 1; /*all done*/
 
+	int buffer_read_index = (int) (read_count % audio_buffers_num);
+
 	/*aplly fx*/
 	audio_fx_apply(audio_ctx, (sample_t *) audio_buffers[buffer_read_index].data, mask);
 
 	/*copy data into requested format type*/
-	int i = 0;
+	sample_t *buff_p = (sample_t *) audio_buffers[buffer_read_index].data;
+	int frames = audio_ctx->capture_buff_size / audio_ctx->channels;
 	switch(type)
 	{
 		case GV_SAMPLE_TYPE_FLOAT:
-		{
-			sample_t *my_data = (sample_t *) buff->data;
-			memcpy( my_data, audio_buffers[buffer_read_index].data,
+			memcpy(buff->data, buff_p,
 				audio_ctx->capture_buff_size * sizeof(sample_t));
 			break;
-		}
 		case GV_SAMPLE_TYPE_INT16:
-		{
-			int16_t *my_data = (int16_t *) buff->data;
-			sample_t *buff_p = (sample_t *) audio_buffers[buffer_read_index].data;
-			for(i = 0; i < audio_ctx->capture_buff_size; ++i)
-			{
-				my_data[i] = clip_int16( (buff_p[i]) * INT16_MAX);
-			}
+			audio_convert_float_to_s16((int16_t *) buff->data, buff_p,
+				audio_ctx->capture_buff_size);
 			break;
-		}
 		case GV_SAMPLE_TYPE_FLOATP:
-		{
-			int j=0;
-
-			float *my_data[audio_ctx->channels];
-			sample_t *buff_p = (sample_t *) audio_buffers[buffer_read_index].data;
-
-			for(j = 0; j < audio_ctx->channels; ++j)
-				my_data[j] = (float *) (((float *) buff->data) +
-					(j * audio_ctx->capture_buff_size/audio_ctx->channels));
-
-			for(i = 0; i < audio_ctx->capture_buff_size/audio_ctx->channels; ++i)
-				for(j = 0; j < audio_ctx->channels; ++j)
-				{
-					my_data[j][i] = *buff_p++;
-				}
+			audio_convert_float_to_fltp((float *) buff->data, buff_p,
+				frames, audio_ctx->channels);
 			break;
-		}
 		case GV_SAMPLE_TYPE_INT16P:
-		{
-			int j=0;
-
-			int16_t *my_data[audio_ctx->channels];
-			sample_t *buff_p = (sample_t *) audio_buffers[buffer_read_index].data;
-
-			for(j = 0; j < audio_ctx->channels; ++j)
-				my_data[j] = (int16_t *) (((int16_t *) buff->data) +
-					(j * audio_ctx->capture_buff_size/audio_ctx->channels));
-
-			for(i = 0; i < audio_ctx->capture_buff_size/audio_ctx->channels; ++i)
-				for(j = 0; j < audio_ctx->channels; ++j)
-				{
-					my_data[j][i] = clip_int16((*buff_p++) * INT16_MAX);
-				}
+			audio_convert_float_to_s16p((int16_t *) buff->data, buff_p,
+				frames, audio_ctx->channels);
 			break;
-		}
 	}
 
 	buff->timestamp = audio_buffers[buffer_read_index].timestamp;
@@ -417,10 +565,9 @@ int audio_get_next_buffer(audio_context_t *audio_ctx, audio_buff_t *buff, int ty
 	buff->level_meter[0] = audio_buffers[buffer_read_index].level_meter[0];
 	buff->level_meter[1] = audio_buffers[buffer_read_index].level_meter[1];
 
-	audio_lock_mutex(audio_ctx);
-	audio_buffers[buffer_read_index].flag = AUDIO_BUFF_FREE;
-	NEXT_IND(buffer_read_index, AUDBUFF_NUM);
-	audio_unlock_mutex(audio_ctx);
+	/*release: the producer can now reuse the slot*/
+	atomic_store_explicit(&buffer_read_count, read_count + 1,
+		memory_order_release);
 
 	return 0;
 }
@@ -751,6 +898,10 @@ int audio_start(audio_context_t *audio_ctx)
 
 	/*alloc the ring buffer*/
 	audio_init_buffers(audio_ctx);
+
+	/*alloc the fx state for this format*/
+	if(audio_ctx->api != AUDIO_NONE)
+		audio_fx_init(audio_ctx);
 	
 	/*reset timestamp values*/
 	audio_ctx->current_ts = 0;
@@ -814,6 +965,9 @@ int audio_stop(audio_context_t *audio_ctx)
 
 	/*free the ring buffer (if any)*/
 	audio_free_buffers();
+
+	/*free the fx state*/
+	audio_fx_close();
 		
 	return err;
 }
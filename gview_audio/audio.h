@@ -27,6 +27,7 @@
 #define AUDIO_H
 
 #include <inttypes.h>
+#include <stdatomic.h>
 #include <sys/types.h>
 
 #include "gviewaudio.h"
@@ -57,6 +58,12 @@ struct _audio_context_t
 	
 	pthread_mutex_t mutex;       /*audio mutex*/
 
+	/*ring buffer stats (written by the api callback)*/
+	_Atomic uint64_t stats_buffers;  /*buffers stored in the ring*/
+	_Atomic uint64_t stats_dropped;  /*buffers dropped (ring full)*/
+	_Atomic uint64_t stats_overruns; /*api overruns (data lost upstream)*/
+	_Atomic uint64_t stats_max_fill; /*max buffers in use*/
+
 };
 
 /*
@@ -72,4 +79,29 @@ struct _audio_context_t
  */
 void audio_fill_buffer(audio_context_t *audio_ctx, int64_t ts);
 
+/*
+ * count an api (device/server) overrun
+ * args:
+ *   audio_ctx - pointer to audio context data
+ *
+ * asserts:
+ *   audio_ctx is not null
+ *
+ * returns: none
+ */
+void audio_add_overrun(audio_context_t *audio_ctx);
+
+/*
+ * initialize audio fx data: allocates the state of all fx
+ *   for the current audio format (called from audio_start)
+ * args:
+ *    audio_ctx - pointer to audio context
+ *
+ * asserts:
+ *    audio_ctx is not null
+ *
+ * returns: none
+ */
+void audio_fx_init(audio_context_t *audio_ctx);
+
 #endif
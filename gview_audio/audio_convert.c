@@ -0,0 +1,662 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "gview.h"
+#include "audio_convert.h"
+#include "../config.h"
+
+/* saturate float samples to int16 limits*/
+static inline int16_t clip_int16 (float in)
+{
+	/*saturate before rounding (lroundf is undefined out of the long range)*/
+	if(in >= INT16_MAX)
+		return INT16_MAX;
+	if(in <= INT16_MIN)
+		return INT16_MIN;
+
+	return (int16_t) lroundf(in);
+}
+
+/*
+ * scalar float to int16 (also used for the simd tails)
+ * args:
+ *    out - pointer to output int16 samples
+ *    in - pointer to input float samples
+ *    samples - number of samples
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void float_to_s16_c(int16_t *out, const sample_t *in, int samples)
+{
+	int i = 0;
+	for(i = 0; i < samples; ++i)
+		out[i] = clip_int16(in[i] * INT16_MAX);
+}
+
+/*
+ * scalar deinterleave to float planes, starting at frame start
+ * args:
+ *    out - pointer to output float planes
+ *    in - pointer to input interleaved float samples
+ *    start - first frame to convert
+ *    frames - number of frames (plane size)
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void float_to_fltp_c(float *out, const sample_t *in,
+	int start, int frames, int channels)
+{
+	int i = 0, j = 0;
+	const sample_t *buff_p = in + (start * channels);
+
+	for(i = start; i < frames; ++i)
+		for(j = 0; j < channels; ++j)
+			out[(j * frames) + i] = *buff_p++;
+}
+
+/*
+ * scalar deinterleave to int16 planes, starting at frame start
+ * args:
+ *    out - pointer to output int16 planes
+ *    in - pointer to input interleaved float samples
+ *    start - first frame to convert
+ *    frames - number of frames (plane size)
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void float_to_s16p_c(int16_t *out, const sample_t *in,
+	int start, int frames, int channels)
+{
+	int i = 0, j = 0;
+	const sample_t *buff_p = in + (start * channels);
+
+	for(i = start; i < frames; ++i)
+		for(j = 0; j < channels; ++j)
+			out[(j * frames) + i] = clip_int16((*buff_p++) * INT16_MAX);
+}
+
+/*
+ * scalar interleave of float planes, starting at frame start
+ * args:
+ *    out - pointer to output interleaved float samples
+ *    in - pointer to input float planes
+ *    start - first frame to convert
+ *    frames - number of frames (plane size)
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void fltp_to_float_c(sample_t *out, const float *in,
+	int start, int frames, int channels)
+{
+	int i = 0, j = 0;
+	sample_t *buff_p = out + (start * channels);
+
+	for(i = start; i < frames; ++i)
+		for(j = 0; j < channels; ++j)
+			*buff_p++ = in[(j * frames) + i];
+}
+
+#if defined(__SSE2__)
+
+/*
+ * scale 4 float samples to int32, rounding half away from zero
+ *   (like lroundf) and saturating to the int16 range
+ * args:
+ *    x - float samples
+ *
+ * asserts:
+ *    none
+ *
+ * returns: int32 samples
+ */
+static inline __m128i float_to_s32_sse2(__m128 x)
+{
+	const __m128 scale = _mm_set1_ps((float) INT16_MAX);
+	const __m128 min = _mm_set1_ps((float) INT16_MIN);
+	const __m128 max = _mm_set1_ps((float) INT16_MAX);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 neg_half = _mm_set1_ps(-0.5f);
+
+	/*max returns the second operand for NaN: NaN -> INT16_MIN like lroundf*/
+	__m128 t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(x, scale), min), max);
+
+	/*truncate and round on the (exact) fraction*/
+	__m128i i = _mm_cvttps_epi32(t);
+	__m128 frac = _mm_sub_ps(t, _mm_cvtepi32_ps(i));
+
+	/*compare masks are -1 where true*/
+	i = _mm_sub_epi32(i, _mm_castps_si128(_mm_cmpge_ps(frac, half)));
+	i = _mm_add_epi32(i, _mm_castps_si128(_mm_cmple_ps(frac, neg_half)));
+
+	return i;
+}
+
+/*
+ * sse2 float to int16 (8 samples per iteration)
+ * args:
+ *    out - pointer to output int16 samples
+ *    in - pointer to input float samples
+ *    samples - number of samples
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void float_to_s16_sse2(int16_t *out, const sample_t *in, int samples)
+{
+	int i = 0;
+	int simd_n = samples & ~7;
+
+	for(i = 0; i < simd_n; i += 8)
+	{
+		__m128i a = float_to_s32_sse2(_mm_loadu_ps(in + i));
+		__m128i b = float_to_s32_sse2(_mm_loadu_ps(in + i + 4));
+		_mm_storeu_si128((__m128i *) (out + i), _mm_packs_epi32(a, b));
+	}
+
+	float_to_s16_c(out + simd_n, in + simd_n, samples - simd_n);
+}
+
+/*
+ * sse2 deinterleave to float planes
+ *   stereo: 4 frames per iteration
+ *   multiple of 4 channels: 4x4 transposes of 4 frames by 4 channels
+ * args:
+ *    out - pointer to output float planes
+ *    in - pointer to input interleaved float samples
+ *    frames - number of frames (plane size)
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of frames converted
+ */
+static int float_to_fltp_sse2(float *out, const sample_t *in,
+	int frames, int channels)
+{
+	int i = 0, j = 0;
+	int simd_n = frames & ~3;
+
+	if(channels == 2)
+	{
+		float *l = out;
+		float *r = out + frames;
+
+		for(i = 0; i < simd_n; i += 4)
+		{
+			__m128 a = _mm_loadu_ps(in + 2 * i);
+			__m128 b = _mm_loadu_ps(in + 2 * i + 4);
+			_mm_storeu_ps(l + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(r + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+		return simd_n;
+	}
+
+	if((channels & 3) == 0)
+	{
+		for(i = 0; i < simd_n; i += 4)
+			for(j = 0; j < channels; j += 4)
+			{
+				const sample_t *p = in + (i * channels) + j;
+				__m128 r0 = _mm_loadu_ps(p);
+				__m128 r1 = _mm_loadu_ps(p + channels);
+				__m128 r2 = _mm_loadu_ps(p + 2 * channels);
+				__m128 r3 = _mm_loadu_ps(p + 3 * channels);
+				_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+				_mm_storeu_ps(out + (j * frames) + i, r0);
+				_mm_storeu_ps(out + ((j + 1) * frames) + i, r1);
+				_mm_storeu_ps(out + ((j + 2) * frames) + i, r2);
+				_mm_storeu_ps(out + ((j + 3) * frames) + i, r3);
+			}
+		return simd_n;
+	}
+
+	return 0;
+}
+
+/*
+ * sse2 deinterleave to int16 planes
+ *   stereo: 8 frames per iteration
+ *   multiple of 4 channels: 4x4 transposes of 4 frames by 4 channels
+ * args:
+ *    out - pointer to output int16 planes
+ *    in - pointer to input interleaved float samples
+ *    frames - number of frames (plane size)
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of frames converted
+ */
+static int float_to_s16p_sse2(int16_t *out, const sample_t *in,
+	int frames, int channels)
+{
+	int i = 0, j = 0;
+
+	if(channels == 2)
+	{
+		int simd_n = frames & ~7;
+		int16_t *l = out;
+		int16_t *r = out + frames;
+
+		for(i = 0; i < simd_n; i += 8)
+		{
+			__m128 a = _mm_loadu_ps(in + 2 * i);
+			__m128 b = _mm_loadu_ps(in + 2 * i + 4);
+			__m128 c = _mm_loadu_ps(in + 2 * i + 8);
+			__m128 d = _mm_loadu_ps(in + 2 * i + 12);
+			__m128i l0 = float_to_s32_sse2(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+			__m128i l1 = float_to_s32_sse2(_mm_shuffle_ps(c, d, _MM_SHUFFLE(2, 0, 2, 0)));
+			__m128i r0 = float_to_s32_sse2(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+			__m128i r1 = float_to_s32_sse2(_mm_shuffle_ps(c, d, _MM_SHUFFLE(3, 1, 3, 1)));
+			_mm_storeu_si128((__m128i *) (l + i), _mm_packs_epi32(l0, l1));
+			_mm_storeu_si128((__m128i *) (r + i), _mm_packs_epi32(r0, r1));
+		}
+		return simd_n;
+	}
+
+	if((channels & 3) == 0)
+	{
+		int simd_n = frames & ~3;
+
+		for(i = 0; i < simd_n; i += 4)
+			for(j = 0; j < channels; j += 4)
+			{
+				const sample_t *p = in + (i * channels) + j;
+				__m128 r0 = _mm_loadu_ps(p);
+				__m128 r1 = _mm_loadu_ps(p + channels);
+				__m128 r2 = _mm_loadu_ps(p + 2 * channels);
+				__m128 r3 = _mm_loadu_ps(p + 3 * channels);
+				_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+				__m128i s0 = float_to_s32_sse2(r0);
+				__m128i s1 = float_to_s32_sse2(r1);
+				__m128i s2 = float_to_s32_sse2(r2);
+				__m128i s3 = float_to_s32_sse2(r3);
+				_mm_storel_epi64((__m128i *) (out + (j * frames) + i),
+					_mm_packs_epi32(s0, s0));
+				_mm_storel_epi64((__m128i *) (out + ((j + 1) * frames) + i),
+					_mm_packs_epi32(s1, s1));
+				_mm_storel_epi64((__m128i *) (out + ((j + 2) * frames) + i),
+					_mm_packs_epi32(s2, s2));
+				_mm_storel_epi64((__m128i *) (out + ((j + 3) * frames) + i),
+					_mm_packs_epi32(s3, s3));
+			}
+		return simd_n;
+	}
+
+	return 0;
+}
+
+/*
+ * sse2 interleave of stereo float planes (4 frames per iteration)
+ * args:
+ *    out - pointer to output interleaved float samples
+ *    in - pointer to input float planes
+ *    frames - number of frames (plane size)
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of frames converted
+ */
+static int fltp_to_float_sse2(sample_t *out, const float *in,
+	int frames, int channels)
+{
+	int i = 0;
+	int simd_n = frames & ~3;
+
+	if(channels != 2)
+		return 0;
+
+	for(i = 0; i < simd_n; i += 4)
+	{
+		__m128 l = _mm_loadu_ps(in + i);
+		__m128 r = _mm_loadu_ps(in + frames + i);
+		_mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(l, r));
+		_mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(l, r));
+	}
+	return simd_n;
+}
+
+#elif defined(__aarch64__)
+
+/*
+ * scale 4 float samples to int16, rounding half away from zero
+ *   (like lroundf) and saturating
+ * args:
+ *    x - float samples
+ *
+ * asserts:
+ *    none
+ *
+ * returns: int16 samples
+ */
+static inline int16x4_t float_to_s16x4_neon(float32x4_t x)
+{
+	return vqmovn_s32(vcvtaq_s32_f32(vmulq_n_f32(x, (float) INT16_MAX)));
+}
+
+/*
+ * neon float to int16 (8 samples per iteration)
+ * args:
+ *    out - pointer to output int16 samples
+ *    in - pointer to input float samples
+ *    samples - number of samples
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void float_to_s16_neon(int16_t *out, const sample_t *in, int samples)
+{
+	int i = 0;
+	int simd_n = samples & ~7;
+
+	for(i = 0; i < simd_n; i += 8)
+		vst1q_s16(out + i, vcombine_s16(
+			float_to_s16x4_neon(vld1q_f32(in + i)),
+			float_to_s16x4_neon(vld1q_f32(in + i + 4))));
+
+	float_to_s16_c(out + simd_n, in + simd_n, samples - simd_n);
+}
+
+/*
+ * neon deinterleave to float planes (stereo and 4 channels)
+ * args:
+ *    out - pointer to output float planes
+ *    in - pointer to input interleaved float samples
+ *    frames - number of frames (plane size)
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of frames converted
+ */
+static int float_to_fltp_neon(float *out, const sample_t *in,
+	int frames, int channels)
+{
+	int i = 0;
+	int simd_n = frames & ~3;
+
+	if(channels == 2)
+	{
+		for(i = 0; i < simd_n; i += 4)
+		{
+			float32x4x2_t v = vld2q_f32(in + 2 * i);
+			vst1q_f32(out + i, v.val[0]);
+			vst1q_f32(out + frames + i, v.val[1]);
+		}
+		return simd_n;
+	}
+
+	if(channels == 4)
+	{
+		for(i = 0; i < simd_n; i += 4)
+		{
+			float32x4x4_t v = vld4q_f32(in + 4 * i);
+			vst1q_f32(out + i, v.val[0]);
+			vst1q_f32(out + frames + i, v.val[1]);
+			vst1q_f32(out + 2 * frames + i, v.val[2]);
+			vst1q_f32(out + 3 * frames + i, v.val[3]);
+		}
+		return simd_n;
+	}
+
+	return 0;
+}
+
+/*
+ * neon deinterleave to int16 planes (stereo and 4 channels)
+ * args:
+ *    out - pointer to output int16 planes
+ *    in - pointer to input interleaved float samples
+ *    frames - number of frames (plane size)
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of frames converted
+ */
+static int float_to_s16p_neon(int16_t *out, const sample_t *in,
+	int frames, int channels)
+{
+	int i = 0;
+	int simd_n = frames & ~3;
+
+	if(channels == 2)
+	{
+		for(i = 0; i < simd_n; i += 4)
+		{
+			float32x4x2_t v = vld2q_f32(in + 2 * i);
+			vst1_s16(out + i, float_to_s16x4_neon(v.val[0]));
+			vst1_s16(out + frames + i, float_to_s16x4_neon(v.val[1]));
+		}
+		return simd_n;
+	}
+
+	if(channels == 4)
+	{
+		for(i = 0; i < simd_n; i += 4)
+		{
+			float32x4x4_t v = vld4q_f32(in + 4 * i);
+			vst1_s16(out + i, float_to_s16x4_neon(v.val[0]));
+			vst1_s16(out + frames + i, float_to_s16x4_neon(v.val[1]));
+			vst1_s16(out + 2 * frames + i, float_to_s16x4_neon(v.val[2]));
+			vst1_s16(out + 3 * frames + i, float_to_s16x4_neon(v.val[3]));
+		}
+		return simd_n;
+	}
+
+	return 0;
+}
+
+/*
+ * neon interleave of stereo float planes (4 frames per iteration)
+ * args:
+ *    out - pointer to output interleaved float samples
+ *    in - pointer to input float planes
+ *    frames - number of frames (plane size)
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of frames converted
+ */
+static int fltp_to_float_neon(sample_t *out, const float *in,
+	int frames, int channels)
+{
+	int i = 0;
+	int simd_n = frames & ~3;
+
+	if(channels != 2)
+		return 0;
+
+	for(i = 0; i < simd_n; i += 4)
+	{
+		float32x4x2_t v;
+		v.val[0] = vld1q_f32(in + i);
+		v.val[1] = vld1q_f32(in + frames + i);
+		vst2q_f32(out + 2 * i, v);
+	}
+	return simd_n;
+}
+
+#endif
+
+/*
+ * convert interleaved float samples to interleaved int16 (saturated)
+ *   rounding is bit exact with lroundf(sample * INT16_MAX)
+ * args:
+ *    out - pointer to output int16 samples
+ *    in - pointer to input float samples
+ *    samples - number of samples (frames * channels)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void audio_convert_float_to_s16(int16_t *out, const sample_t *in, int samples)
+{
+#if defined(__SSE2__)
+	float_to_s16_sse2(out, in, samples);
+#elif defined(__aarch64__)
+	float_to_s16_neon(out, in, samples);
+#else
+	float_to_s16_c(out, in, samples);
+#endif
+}
+
+/*
+ * deinterleave float samples into float planes
+ *   plane j starts at out + (j * frames)
+ * args:
+ *    out - pointer to output float planes
+ *    in - pointer to input interleaved float samples
+ *    frames - number of frames (samples per channel)
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void audio_convert_float_to_fltp(float *out, const sample_t *in,
+	int frames, int channels)
+{
+	int done = 0;
+
+	if(channels == 1)
+	{
+		memcpy(out, in, frames * sizeof(float));
+		return;
+	}
+
+#if defined(__SSE2__)
+	done = float_to_fltp_sse2(out, in, frames, channels);
+#elif defined(__aarch64__)
+	done = float_to_fltp_neon(out, in, frames, channels);
+#endif
+
+	float_to_fltp_c(out, in, done, frames, channels);
+}
+
+/*
+ * deinterleave float samples into int16 planes (saturated)
+ *   plane j starts at out + (j * frames)
+ * args:
+ *    out - pointer to output int16 planes
+ *    in - pointer to input interleaved float samples
+ *    frames - number of frames (samples per channel)
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void audio_convert_float_to_s16p(int16_t *out, const sample_t *in,
+	int frames, int channels)
+{
+	int done = 0;
+
+	if(channels == 1)
+	{
+		audio_convert_float_to_s16(out, in, frames);
+		return;
+	}
+
+#if defined(__SSE2__)
+	done = float_to_s16p_sse2(out, in, frames, channels);
+#elif defined(__aarch64__)
+	done = float_to_s16p_neon(out, in, frames, channels);
+#endif
+
+	float_to_s16p_c(out, in, done, frames, channels);
+}
+
+/*
+ * interleave float planes into float samples
+ *   plane j starts at in + (j * frames)
+ * args:
+ *    out - pointer to output interleaved float samples
+ *    in - pointer to input float planes
+ *    frames - number of frames (samples per channel)
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void audio_convert_fltp_to_float(sample_t *out, const float *in,
+	int frames, int channels)
+{
+	int done = 0;
+
+	if(channels == 1)
+	{
+		memcpy(out, in, frames * sizeof(float));
+		return;
+	}
+
+#if defined(__SSE2__)
+	done = fltp_to_float_sse2(out, in, frames, channels);
+#elif defined(__aarch64__)
+	done = fltp_to_float_neon(out, in, frames, channels);
+#endif
+
+	fltp_to_float_c(out, in, done, frames, channels);
+}
@@ -0,0 +1,96 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#ifndef AUDIO_CONVERT_H
+#define AUDIO_CONVERT_H
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+#include "gviewaudio.h"
+
+/*
+ * convert interleaved float samples to interleaved int16 (saturated)
+ *   rounding is bit exact with lroundf(sample * INT16_MAX)
+ * args:
+ *    out - pointer to output int16 samples
+ *    in - pointer to input float samples
+ *    samples - number of samples (frames * channels)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void audio_convert_float_to_s16(int16_t *out, const sample_t *in, int samples);
+
+/*
+ * deinterleave float samples into float planes
+ *   plane j starts at out + (j * frames)
+ * args:
+ *    out - pointer to output float planes
+ *    in - pointer to input interleaved float samples
+ *    frames - number of frames (samples per channel)
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void audio_convert_float_to_fltp(float *out, const sample_t *in,
+	int frames, int channels);
+
+/*
+ * deinterleave float samples into int16 planes (saturated)
+ *   plane j starts at out + (j * frames)
+ * args:
+ *    out - pointer to output int16 planes
+ *    in - pointer to input interleaved float samples
+ *    frames - number of frames (samples per channel)
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void audio_convert_float_to_s16p(int16_t *out, const sample_t *in,
+	int frames, int channels);
+
+/*
+ * interleave float planes into float samples
+ *   plane j starts at in + (j * frames)
+ * args:
+ *    out - pointer to output interleaved float samples
+ *    in - pointer to input float planes
+ *    frames - number of frames (samples per channel)
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void audio_convert_fltp_to_float(sample_t *out, const float *in,
+	int frames, int channels);
+
+#endif
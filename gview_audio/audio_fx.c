@@ -19,6 +19,10 @@
 #                                                                               #
 ********************************************************************************/
 
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/types.h>
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <sys/types.h>
@@ -35,6 +39,7 @@
 #include "../config.h"
 #include "gviewaudio.h"
 #include "audio.h"
+#include "audio_convert.h"
 #include "gview.h"
 
 #ifndef M_PI
@@ -43,129 +48,167 @@
 
 extern int audio_verbosity;
 
+/*number of fx in the chain*/
+#define AUDIO_FX_NUM (5)
+
+/*----------- fx parameters ------------*/
+
+#define ECHO_DELAY_MS    (300)
+#define ECHO_DECAY       (0.5f)
+
+#define REVERB_DELAY_MS  (50)   /*comb delays are 50, 45, 40 and 35 ms*/
+#define REVERB_IN_GAIN   (0.7f)
+#define REVERB_AP_GAIN   (0.75f)
+
+#define FUZZ_HPF_FREQ    (1000)
+#define FUZZ_HPF_RES     (0.9f)
+
+#define WAH_FREQ         (1.5f) /*LFO frequency*/
+#define WAH_STARTPHASE   (0.0f) /*LFO startphase in RADIANS*/
+#define WAH_DEPTH        (0.7f) /*from 0(min) to 1(max)*/
+#define WAH_FREQOFS      (0.3f) /*from 0(min) to 1(max)*/
+#define WAH_RES          (2.5f) /*must be greater than 0*/
+#define lfoskipsamples   (30)
+
+#define DUCKY_RATE       (2)
+#define DUCKY_WINDOW_MS  (20)
+#define DUCKY_LPF_RES    (0.9f)
+
+static const float comb_gain[4] = {0.55f, 0.6f, 0.5f, 0.45f};
+
 /*----------- structs for audio effects ------------*/
 
-/*data for Butterworth filter (LP or HP)*/
-typedef struct _fx_filt_data_t
+/*Butterworth filter coeficients (LP or HP)*/
+typedef struct _fx_filt_coef_t
 {
-	sample_t buff_in1[2];
-	sample_t buff_in2[2];
-	sample_t buff_out1[2];
-	sample_t buff_out2[2];
-	float c;
 	float a1;
 	float a2;
 	float a3;
 	float b1;
 	float b2;
-} fx_filt_data_t;
+} fx_filt_coef_t;
 
-/*data for Comb4 filter*/
-typedef struct _fx_comb4_data_t
+/*Butterworth filter state (one per channel)*/
+typedef struct _fx_filt_state_t
 {
-	int buff_size1;
-	int buff_size2;
-	int buff_size3;
-	int buff_size4;
-
-	sample_t *CombBuff10; // four parallel  comb filters - first channel
-	sample_t *CombBuff11; // four parallel comb filters - second channel
-	sample_t *CombBuff20; // four parallel  comb filters - first channel
-	sample_t *CombBuff21; // four parallel comb filters - second channel
-	sample_t *CombBuff30; // four parallel  comb filters - first channel
-	sample_t *CombBuff31; // four parallel comb filters - second channel
-	sample_t *CombBuff40; // four parallel  comb filters - first channel
-	sample_t *CombBuff41; // four parallel comb filters - second channel
-
-	int CombIndex1; //comb filter 1 index
-	int CombIndex2; //comb filter 2 index
-	int CombIndex3; //comb filter 3 index
-	int CombIndex4; //comb filter 4 index
-} fx_comb4_data_t;
-
-/* data for delay*/
-typedef struct _fx_delay_data_t
+	sample_t in1;  /*in(n-1)*/
+	sample_t in2;  /*in(n-2)*/
+	sample_t out1; /*out(n-1)*/
+	sample_t out2; /*out(n-2)*/
+} fx_filt_state_t;
+
+/*delay line (one per channel)*/
+typedef struct _fx_delay_line_t
 {
-	int buff_size;
-	sample_t *delayBuff1; // delay buffer 1 - first channel
-	sample_t *delayBuff2; // delay buffer 2 - second channel (stereo)
-	int delayIndex; // delay buffer index
-} fx_delay_data_t;
-
-/* data for WahWah effect*/
-typedef struct _fx_wah_data_t
+	sample_t *buff; /*delay buffer*/
+	int size;       /*buffer size in samples*/
+	int index;      /*current buffer index*/
+} fx_delay_line_t;
+
+/*WahWah biquad state (one per channel)*/
+typedef struct _fx_wah_state_t
 {
-	float lfoskip;
-	unsigned long skipcount;
 	float xn1;
 	float xn2;
 	float yn1;
 	float yn2;
-	float b0;
-	float b1;
-	float b2;
-	float a0;
-	float a1;
-	float a2;
-	float phase;
-} fx_wah_data_t;
+} fx_wah_state_t;
 
-typedef struct _fx_rate_data_t
+/*pitch (ducky) window state (one per channel)*/
+typedef struct _fx_pitch_state_t
 {
-	sample_t *rBuff1;
-	sample_t *rBuff2;
-	sample_t *wBuff1;
-	sample_t *wBuff2;
-	int wSize;
-	int numsamples;
-} fx_rate_data_t;
+	sample_t *win;  /*window being filled with decimated samples*/
+	sample_t *play; /*window being played*/
+} fx_pitch_state_t;
 
 typedef struct _audio_fx_t
 {
-	fx_delay_data_t *ECHO;
-	fx_delay_data_t *AP1;
-	fx_comb4_data_t *COMB4;
-	fx_filt_data_t  *HPF;
-	fx_filt_data_t  *LPF1;
-	fx_rate_data_t  *RT1;
-	fx_wah_data_t   *wahData;
+	int channels;
+	int frames;              /*frames per buffer*/
+	int samprate;
+
+	uint32_t mask;           /*fx applied to the last buffer*/
+	uint32_t chain[AUDIO_FX_NUM]; /*fx processing order*/
+
+	sample_t *mem;           /*storage for all the buffers below*/
+	sample_t **plane;        /*deinterleaved channels (frames each)*/
+
+	/*echo*/
+	fx_delay_line_t *echo;
+
+	/*reverb: 4 parallel comb filters and an all pass*/
+	fx_delay_line_t *comb[4];
+	fx_delay_line_t *ap;
+
+	/*fuzz: high pass filter*/
+	fx_filt_coef_t hpf;
+	fx_filt_state_t *hpf_state;
+
+	/*wahwah: the LFO is shared by all channels*/
+	float wah_lfoskip;
+	float wah_phase;
+	unsigned long wah_skipcount;
+	float wah_b0, wah_b1, wah_b2, wah_a1, wah_a2, wah_inv_a0;
+	fx_wah_state_t *wah_state;
+
+	/*ducky: decimate and repeat windows, then low pass filter*/
+	int pitch_wsize;         /*window size in decimated samples*/
+	int pitch_count;         /*input frames in the current window period*/
+	fx_pitch_state_t *pitch_state;
+	fx_filt_coef_t lpf;
+	fx_filt_state_t *lpf_state;
 } audio_fx_t;
 
 /*audio fx data*/
 static audio_fx_t *aud_fx = NULL;
 
+/*fx order for the next audio_fx_init*/
+static uint32_t fx_chain[AUDIO_FX_NUM] =
+{
+	AUDIO_FX_ECHO,
+	AUDIO_FX_REVERB,
+	AUDIO_FX_FUZZ,
+	AUDIO_FX_WAHWAH,
+	AUDIO_FX_DUCKY
+};
+
 /*
- * initialize audio fx data
+ * allocate zeroed fx memory
  * args:
- *    none
+ *    n - number of elements
+ *    size - element size
  *
  * asserts:
  *    none
  *
- * returns: none
+ * returns: pointer to allocated memory (exits on failure)
  */
-static void audio_fx_init ()
+static void *fx_calloc(size_t n, size_t size)
 {
-	aud_fx = calloc(1, sizeof(audio_fx_t));
-	if(aud_fx == NULL)
+	void *ptr = calloc(n, size);
+	if(ptr == NULL)
 	{
 		fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx_init): %s\n", strerror(errno));
 		exit(-1);
 	}
-	/*Echo effect data */
-	aud_fx->ECHO = NULL;
-	/* 4 parallel comb filters data*/
-	aud_fx->COMB4 = NULL;
-	/*all pass 1 filter data*/
-	aud_fx->AP1 = NULL;
-	/*WahWah effect data*/
-	aud_fx->wahData = NULL;
-	/*high pass filter data*/
-	aud_fx->HPF = NULL;
-	/*rate transposer*/
-	aud_fx->RT1 = NULL;
-	/*low pass filter*/
-	aud_fx->LPF1 = NULL;
+	return ptr;
+}
+
+/*
+ * get a delay size in samples
+ * args:
+ *    delay_ms - delay in ms
+ *    samprate - sample rate
+ *
+ * asserts:
+ *    none
+ *
+ * returns: delay size (at least 1 sample)
+ */
+static int fx_delay_size(int delay_ms, int samprate)
+{
+	int size = (int) (delay_ms * (samprate * 0.001));
+	return (size > 0) ? size : 1;
 }
 
 /*
@@ -178,58 +221,58 @@ static void audio_fx_init ()
  *
  * returns: float sample
  */
-static float clip_float (float in)
+static inline float clip_float (float in)
 {
-	in = (in < -1.0) ? -1.0 : (in > 1.0) ? 1.0 : in;
+	in = (in < -1.0f) ? -1.0f : (in > 1.0f) ? 1.0f : in;
 
 	return in;
 }
 
 /*
- * Butterworth Filter for HP or LP
+ * Butterworth Filter for HP or LP (one channel)
  * out(n) = a1 * in + a2 * in(n-1) + a3 * in(n-2) - b1*out(n-1) - b2*out(n-2)
  * args:
- *   FILT - pointer to fx_filt_data_t
- *   Buff - sampe buffer
- *   NumSamples - samples in buffer
- *   channels - number of audio channels
+ *   coef - pointer to filter coeficients
+ *   state - pointer to channel filter state
+ *   x - channel samples
+ *   frames - number of samples
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
  */
-static void Butt(fx_filt_data_t *FILT,
-	sample_t *Buff,
-	int NumSamples,
-	int channels)
+static void Butt(const fx_filt_coef_t *coef,
+	fx_filt_state_t *state,
+	sample_t *x,
+	int frames)
 {
-	int index = 0;
+	const float a1 = coef->a1, a2 = coef->a2, a3 = coef->a3;
+	const float b1 = coef->b1, b2 = coef->b2;
+	sample_t in1 = state->in1, in2 = state->in2;
+	sample_t out1 = state->out1, out2 = state->out2;
 
-	for (index = 0; index < NumSamples; index = index + channels)
+	int i = 0;
+	for(i = 0; i < frames; ++i)
 	{
-		sample_t out = FILT->a1 * Buff[index] + FILT->a2 * FILT->buff_in1[0] +
-			FILT->a3 * FILT->buff_in1[1] - FILT->b1 * FILT->buff_out1[0] -
-			FILT->b2 * FILT->buff_out1[1];
-		FILT->buff_in1[1] = FILT->buff_in1[0]; //in(n-2) = in(n-1)
-		FILT->buff_in1[0] = Buff[index]; // in(n-1) = in
-		FILT->buff_out1[1] = FILT->buff_out1[0]; //out(n-2) = out(n-1)
-		FILT->buff_out1[0] = out; //out(n-1) = out
-
-		Buff[index] = clip_float(out);
-		/*process second channel*/
-		if(channels > 1)
-		{
-			out = FILT->a1 * Buff[index+1] + FILT->a2 * FILT->buff_in2[0] +
-				FILT->a3 * FILT->buff_in2[1] - FILT->b1 * FILT->buff_out2[0] -
-				FILT->b2 * FILT->buff_out2[1];
-			FILT->buff_in2[1] = FILT->buff_in2[0]; //in(n-2) = in(n-1)
-			FILT->buff_in2[0] = Buff[index+1]; // in(n-1) = in
-			FILT->buff_out2[1] = FILT->buff_out2[0]; //out(n-2) = out(n-1)
-			FILT->buff_out2[0] = out; //out(n-1) = out
-
-			Buff[index+1] = clip_float(out);
-		}
+		sample_t in = x[i];
+		sample_t out = a1 * in + a2 * in1 + a3 * in2 - b1 * out1 - b2 * out2;
+		in2 = in1;
+		in1 = in;
+		out2 = out1;
+		out1 = out;
+
+		x[i] = clip_float(out);
 	}
+
+	state->in1 = in1;
+	state->in2 = in2;
+	state->out1 = out1;
+	state->out2 = out2;
 }
 
 /*
- * HP Filter: out(n) = a1 * in + a2 * in(n-1) + a3 * in(n-2) - b1*out(n-1) - b2*out(n-2)
+ * HP Filter coeficients
  * f - cuttof freq., from ~0 Hz to SampleRate/2 - though many synths seem to filter only  up to SampleRate/4
  * r  = rez amount, from sqrt(2) to ~ 0.1
  *
@@ -240,8 +283,8 @@ static void Butt(fx_filt_data_t *FILT,
  *  b1 = 2.0 * ( c*c - 1.0) * a1;
  *  b2 = ( 1.0 - r * c + c * c) * a1;
  * args:
- *   audio_ctx - pointer to audio context
- *   data -pointer to audio buffer to be processed
+ *   coef - pointer to filter coeficients
+ *   samprate - sample rate
  *   cutoff_freq - filter cut off frequency
  *   res - rez amount
  *
@@ -250,33 +293,21 @@ static void Butt(fx_filt_data_t *FILT,
  *
  * returns: none
  */
-static void HPF(audio_context_t *audio_ctx,
-	sample_t *data,
-	int cutoff_freq,
+static void HPF_coef(fx_filt_coef_t *coef,
+	int samprate,
+	float cutoff_freq,
 	float res)
 {
-	if(aud_fx->HPF == NULL)
-	{
-		float inv_samprate = 1.0 / audio_ctx->samprate;
-		aud_fx->HPF = calloc(1, sizeof(fx_filt_data_t));
-		if(aud_fx->HPF == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (HPF): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->HPF->c = tan(M_PI * cutoff_freq * inv_samprate);
-		aud_fx->HPF->a1 = 1.0 / (1.0 + (res * aud_fx->HPF->c) + (aud_fx->HPF->c * aud_fx->HPF->c));
-		aud_fx->HPF->a2 = -2.0 * aud_fx->HPF->a1;
-		aud_fx->HPF->a3 = aud_fx->HPF->a1;
-		aud_fx->HPF->b1 = 2.0 * ((aud_fx->HPF->c * aud_fx->HPF->c) - 1.0) * aud_fx->HPF->a1;
-		aud_fx->HPF->b2 = (1.0 - (res * aud_fx->HPF->c) + (aud_fx->HPF->c * aud_fx->HPF->c)) * aud_fx->HPF->a1;
-	}
-
-	Butt(aud_fx->HPF, data, audio_ctx->capture_buff_size, audio_ctx->channels);
+	float c = tan(M_PI * cutoff_freq / samprate);
+	coef->a1 = 1.0 / (1.0 + (res * c) + (c * c));
+	coef->a2 = -2.0 * coef->a1;
+	coef->a3 = coef->a1;
+	coef->b1 = 2.0 * ((c * c) - 1.0) * coef->a1;
+	coef->b2 = (1.0 - (res * c) + (c * c)) * coef->a1;
 }
 
 /*
- * LP Filter: out(n) = a1 * in + a2 * in(n-1) + a3 * in(n-2) - b1*out(n-1) - b2*out(n-2)
+ * LP Filter coeficients
  * f - cuttof freq., from ~0 Hz to SampleRate/2 -
  *     though many synths seem to filter only  up to SampleRate/4
  * r  = rez amount, from sqrt(2) to ~ 0.1
@@ -289,8 +320,8 @@ static void HPF(audio_context_t *audio_ctx,
  * b2 = ( 1.0 - r * c + c * c) * a1;
  *
  * args:
- *   audio_ctx - pointer to audio context
- *   data -pointer to audio buffer to be processed
+ *   coef - pointer to filter coeficients
+ *   samprate - sample rate
  *   cutoff_freq - filter cut off frequency
  *   res - rez amount
  *
@@ -299,31 +330,21 @@ static void HPF(audio_context_t *audio_ctx,
  *
  * returns: none
  */
-static void LPF(audio_context_t *audio_ctx,
-	sample_t *data,
+static void LPF_coef(fx_filt_coef_t *coef,
+	int samprate,
 	float cutoff_freq,
 	float res)
 {
-	if(aud_fx->LPF1 == NULL)
-	{
-		aud_fx->LPF1 = calloc(1, sizeof(fx_filt_data_t));
-		if(aud_fx->LPF1 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (LPF): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->LPF1->c = 1.0 / tan(M_PI * cutoff_freq / audio_ctx->samprate);
-		aud_fx->LPF1->a1 = 1.0 / (1.0 + (res * aud_fx->LPF1->c) + (aud_fx->LPF1->c * aud_fx->LPF1->c));
-		aud_fx->LPF1->a2 = 2.0 * aud_fx->LPF1->a1;
-		aud_fx->LPF1->a3 = aud_fx->LPF1->a1;
-		aud_fx->LPF1->b1 = 2.0 * (1.0 - (aud_fx->LPF1->c * aud_fx->LPF1->c)) * aud_fx->LPF1->a1;
-		aud_fx->LPF1->b2 = (1.0 - (res * aud_fx->LPF1->c) + (aud_fx->LPF1->c * aud_fx->LPF1->c)) * aud_fx->LPF1->a1;
-	}
-
-	Butt(aud_fx->LPF1, data, audio_ctx->capture_buff_size, audio_ctx->channels);
+	float c = 1.0 / tan(M_PI * cutoff_freq / samprate);
+	coef->a1 = 1.0 / (1.0 + (res * c) + (c * c));
+	coef->a2 = 2.0 * coef->a1;
+	coef->a3 = coef->a1;
+	coef->b1 = 2.0 * (1.0 - (c * c)) * coef->a1;
+	coef->b2 = (1.0 - (res * c) + (c * c)) * coef->a1;
 }
 
 /* Non-linear amplifier with soft distortion curve.
+ *   (x < 0: (x + 1)^3 - 1 ; x >= 0: (x - 1)^3 + 1)
  * args:
  *   input - sample input
  *
@@ -332,757 +353,727 @@ static void LPF(audio_context_t *audio_ctx,
  *
  * returns: processed sample
  */
-static sample_t CubicAmplifier( sample_t input )
+static inline sample_t CubicAmplifier( sample_t input )
 {
-	sample_t out;
-	float temp;
-	if( input < 0 ) /*silence*/
-	{
+	/*select instead of branch (vectorizes)*/
+	float s = (input < 0) ? -1.0f : 1.0f;
+	float temp = input - s;
 
-		temp = input + 1.0f;
-		out = (temp * temp * temp) - 1.0f;
-	}
-	else
-	{
-		temp = input - 1.0f;
-		out = (temp * temp * temp) + 1.0f;
-	}
-	return clip_float(out);
+	return clip_float((temp * temp * temp) + s);
 }
 
 /*
- * four paralell Comb filters for reverb
+ * Echo kernel
+ *   out = 0.7 * in + 0.3 * delay ; delay = in + delay * decay
  * args:
- *   audio_ctx - audio context
- *   data - audio buffer to be processed
- *   delay1_ms - delay for filter 1
- *   delay2_ms - delay for filter 2
- *   delay3_ms - delay for filter 3
- *   delay4_ms - delay for filter 4
- *   gain1 - feed gain for filter 1
- *   gain2 - feed gain for filter 2
- *   gain3 - feed gain for filter 3
- *   gain4 - feed gain for filter 4
- *   in_gain - input line gain
+ *   in - channel samples
+ *   d - delay buffer samples (no overlap with in)
+ *   n - number of samples
  *
  * asserts:
  *   none
  *
  * returns: none
  */
-static void CombFilter4 (audio_context_t *audio_ctx,
-	sample_t *data,
-	int delay1_ms,
-	int delay2_ms,
-	int delay3_ms,
-	int delay4_ms,
-	float gain1,
-	float gain2,
-	float gain3,
-	float gain4,
-	float in_gain)
+static inline void fx_echo_kernel(sample_t *restrict in,
+	sample_t *restrict d,
+	int n)
 {
-	int samp=0;
-	/*buff_size in samples*/
-
-	if (aud_fx->COMB4 == NULL)
+	int i = 0;
+	for(i = 0; i < n; ++i)
 	{
-		aud_fx->COMB4 = calloc(1, sizeof(fx_comb4_data_t));
-		if(aud_fx->COMB4 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-			exit(-1);
-		}
-		/*buff_size in samples*/
-		aud_fx->COMB4->buff_size1 = (int) delay1_ms * (audio_ctx->samprate * 0.001);
-		aud_fx->COMB4->buff_size2 = (int) delay2_ms * (audio_ctx->samprate * 0.001);
-		aud_fx->COMB4->buff_size3 = (int) delay3_ms * (audio_ctx->samprate * 0.001);
-		aud_fx->COMB4->buff_size4 = (int) delay4_ms * (audio_ctx->samprate * 0.001);
-
-		aud_fx->COMB4->CombBuff10 = calloc(aud_fx->COMB4->buff_size1, sizeof(sample_t));
-		if(aud_fx->COMB4->CombBuff10 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->COMB4->CombBuff20 = calloc(aud_fx->COMB4->buff_size2, sizeof(sample_t));
-		if(aud_fx->COMB4->CombBuff20 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->COMB4->CombBuff30 = calloc(aud_fx->COMB4->buff_size3, sizeof(sample_t));
-		if(aud_fx->COMB4->CombBuff30 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->COMB4->CombBuff40 = calloc(aud_fx->COMB4->buff_size4, sizeof(sample_t));
-		if(aud_fx->COMB4->CombBuff40 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->COMB4->CombBuff11 = NULL;
-		aud_fx->COMB4->CombBuff21 = NULL;
-		aud_fx->COMB4->CombBuff31 = NULL;
-		aud_fx->COMB4->CombBuff41 = NULL;
-		if(audio_ctx->channels > 1)
-		{
-			aud_fx->COMB4->CombBuff11 = calloc(aud_fx->COMB4->buff_size1, sizeof(sample_t));
-			if(aud_fx->COMB4->CombBuff11 == NULL)
-			{
-				fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-				exit(-1);
-			}
-			aud_fx->COMB4->CombBuff21 = calloc(aud_fx->COMB4->buff_size2, sizeof(sample_t));
-			if(aud_fx->COMB4->CombBuff21 == NULL)
-			{
-				fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-				exit(-1);
-			}
-			aud_fx->COMB4->CombBuff31 = calloc(aud_fx->COMB4->buff_size3, sizeof(sample_t));
-			if(aud_fx->COMB4->CombBuff31 == NULL)
-			{
-				fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-				exit(-1);
-			}
-			aud_fx->COMB4->CombBuff41 = calloc(aud_fx->COMB4->buff_size4, sizeof(sample_t));
-			if(aud_fx->COMB4->CombBuff41 == NULL)
-			{
-				fprintf(stderr,"AUDIO: FATAL memory allocation failure (CombFilter4): %s\n", strerror(errno));
-				exit(-1);
-			}
-		}
+		sample_t out = (0.7f * in[i]) + (0.3f * d[i]);
+		d[i] = in[i] + (d[i] * ECHO_DECAY);
+		in[i] = clip_float(out);
 	}
+}
 
-	for(samp = 0; samp < audio_ctx->capture_buff_size; samp = samp + audio_ctx->channels)
+/*
+ * Echo effect (one channel)
+ * args:
+ *   line - channel delay line
+ *   x - channel samples
+ *   frames - number of samples
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void fx_echo_channel(fx_delay_line_t *line, sample_t *x, int frames)
+{
+	int done = 0;
+	while(done < frames)
 	{
-		sample_t out1 = in_gain * data[samp] +
-			gain1 * aud_fx->COMB4->CombBuff10[aud_fx->COMB4->CombIndex1];
-		sample_t out2 = in_gain * data[samp] +
-			gain2 * aud_fx->COMB4->CombBuff20[aud_fx->COMB4->CombIndex2];
-		sample_t out3 = in_gain * data[samp] +
-			gain3 * aud_fx->COMB4->CombBuff30[aud_fx->COMB4->CombIndex3];
-		sample_t out4 = in_gain * data[samp] +
-			gain4 * aud_fx->COMB4->CombBuff40[aud_fx->COMB4->CombIndex4];
-
-		aud_fx->COMB4->CombBuff10[aud_fx->COMB4->CombIndex1] = data[samp] +
-			gain1 * aud_fx->COMB4->CombBuff10[aud_fx->COMB4->CombIndex1];
-		aud_fx->COMB4->CombBuff20[aud_fx->COMB4->CombIndex2] = data[samp] +
-			gain2 * aud_fx->COMB4->CombBuff20[aud_fx->COMB4->CombIndex2];
-		aud_fx->COMB4->CombBuff30[aud_fx->COMB4->CombIndex3] = data[samp] +
-			gain3 * aud_fx->COMB4->CombBuff30[aud_fx->COMB4->CombIndex3];
-		aud_fx->COMB4->CombBuff40[aud_fx->COMB4->CombIndex4] = data[samp] +
-			gain4 * aud_fx->COMB4->CombBuff40[aud_fx->COMB4->CombIndex4];
-
-		data[samp] = clip_float(out1 + out2 + out3 + out4);
-
-		/*if stereo process second channel */
-		if(audio_ctx->channels > 1)
-		{
-			out1 = in_gain * data[samp+1] +
-				gain1 * aud_fx->COMB4->CombBuff11[aud_fx->COMB4->CombIndex1];
-			out2 = in_gain * data[samp+1] +
-				gain2 * aud_fx->COMB4->CombBuff21[aud_fx->COMB4->CombIndex2];
-			out3 = in_gain * data[samp+1] +
-				gain3 * aud_fx->COMB4->CombBuff31[aud_fx->COMB4->CombIndex3];
-			out4 = in_gain * data[samp+1] +
-				gain4 * aud_fx->COMB4->CombBuff41[aud_fx->COMB4->CombIndex4];
-
-			aud_fx->COMB4->CombBuff11[aud_fx->COMB4->CombIndex1] = data[samp+1] +
-				gain1 * aud_fx->COMB4->CombBuff11[aud_fx->COMB4->CombIndex1];
-			aud_fx->COMB4->CombBuff21[aud_fx->COMB4->CombIndex2] = data[samp+1] +
-				gain2 * aud_fx->COMB4->CombBuff21[aud_fx->COMB4->CombIndex2];
-			aud_fx->COMB4->CombBuff31[aud_fx->COMB4->CombIndex3] = data[samp+1] +
-				gain3 * aud_fx->COMB4->CombBuff31[aud_fx->COMB4->CombIndex3];
-			aud_fx->COMB4->CombBuff41[aud_fx->COMB4->CombIndex4] = data[samp+1] +
-				gain4 * aud_fx->COMB4->CombBuff41[aud_fx->COMB4->CombIndex4];
-
-			data[samp+1] = clip_float(out1 + out2 + out3 + out4);
-		}
-
-		if(++(aud_fx->COMB4->CombIndex1) >= aud_fx->COMB4->buff_size1) aud_fx->COMB4->CombIndex1=0;
-		if(++(aud_fx->COMB4->CombIndex2) >= aud_fx->COMB4->buff_size2) aud_fx->COMB4->CombIndex2=0;
-		if(++(aud_fx->COMB4->CombIndex3) >= aud_fx->COMB4->buff_size3) aud_fx->COMB4->CombIndex3=0;
-		if(++(aud_fx->COMB4->CombIndex4) >= aud_fx->COMB4->buff_size4) aud_fx->COMB4->CombIndex4=0;
+		/*process up to the delay buffer wrap*/
+		int n = line->size - line->index;
+		if(n > frames - done)
+			n = frames - done;
+
+		sample_t *d = line->buff + line->index;
+		sample_t *in = x + done;
+
+		/*
+		 * a multiple of 4 and a tail: the first call is vectorized
+		 * at -O2 (no epilogue needed)
+		 */
+		int n4 = n & ~3;
+		fx_echo_kernel(in, d, n4);
+		fx_echo_kernel(in + n4, d + n4, n - n4);
+
+		line->index += n;
+		if(line->index >= line->size)
+			line->index = 0;
+		done += n;
 	}
 }
 
 /*
- * All pass filter
+ * four paralell Comb filters kernel
  * args:
- *   AP - pointer to fx_delay_data_t
- *   Buff -pointer to sample buffer
- *   NumSamples - number of samples in buffer
- *   channels -number of audio channels
- *   gain- filter gain
+ *   in - channel samples
+ *   d0, d1, d2, d3 - delay buffer samples of each filter
+ *   n - number of samples
  *
  * asserts:
  *   none
  *
  * returns: none
  */
-static void all_pass (fx_delay_data_t *AP,
-	sample_t *Buff,
-	int NumSamples,
-	int channels,
-	float gain)
+static inline void fx_comb4_kernel(sample_t *restrict in,
+	sample_t *restrict d0,
+	sample_t *restrict d1,
+	sample_t *restrict d2,
+	sample_t *restrict d3,
+	int n)
 {
-	int samp = 0;
-	float inv_gain = 1.0 / gain;
+	const float g0 = comb_gain[0], g1 = comb_gain[1];
+	const float g2 = comb_gain[2], g3 = comb_gain[3];
 
-	for(samp = 0; samp < NumSamples; samp += channels)
+	int i = 0;
+	for(i = 0; i < n; ++i)
 	{
-		AP->delayBuff1[AP->delayIndex] = Buff[samp] +
-			(gain * AP->delayBuff1[AP->delayIndex]);
-		Buff[samp] = ((AP->delayBuff1[AP->delayIndex] * (1 - gain*gain)) -
-			Buff[samp]) * inv_gain;
-		if(channels > 1)
-		{
-			AP->delayBuff2[AP->delayIndex] = Buff[samp+1] +
-				(gain * AP->delayBuff2[AP->delayIndex]);
-			Buff[samp+1] = ((AP->delayBuff2[AP->delayIndex] * (1 - gain*gain)) -
-				Buff[samp+1]) * inv_gain;
-		}
-
-		if(++(AP->delayIndex) >= AP->buff_size) AP->delayIndex=0;
+		sample_t s = in[i];
+		sample_t out = (4 * REVERB_IN_GAIN * s) +
+			(g0 * d0[i]) + (g1 * d1[i]) + (g2 * d2[i]) + (g3 * d3[i]);
+		d0[i] = s + (g0 * d0[i]);
+		d1[i] = s + (g1 * d1[i]);
+		d2[i] = s + (g2 * d2[i]);
+		d3[i] = s + (g3 * d3[i]);
+		in[i] = clip_float(out);
 	}
 }
 
 /*
- * All pass for reverb
+ * four paralell Comb filters for reverb (one channel)
  * args:
- * 	 audio_ctx - audio context
- *   data - audio buffer to be processed
- *   delay_ms - delay in ms
- *   gain - filter gain
+ *   line - array with the channel delay line of each filter
+ *   x - channel samples
+ *   frames - number of samples
  *
  * asserts:
  *   none
  *
  * returns: none
  */
-static void all_pass1 (audio_context_t *audio_ctx,
-	sample_t *data,
-	int delay_ms,
-	float gain)
+static void fx_comb4_channel(fx_delay_line_t **line, sample_t *x, int frames)
 {
-	if(aud_fx->AP1 == NULL)
+	int done = 0;
+	while(done < frames)
 	{
-		aud_fx->AP1 = calloc(1, sizeof(fx_delay_data_t));
-		if(aud_fx->AP1 == NULL)
+		/*process up to the first delay buffer wrap*/
+		int k = 0;
+		int n = frames - done;
+		for(k = 0; k < 4; ++k)
+			if(line[k]->size - line[k]->index < n)
+				n = line[k]->size - line[k]->index;
+
+		sample_t *d0 = line[0]->buff + line[0]->index;
+		sample_t *d1 = line[1]->buff + line[1]->index;
+		sample_t *d2 = line[2]->buff + line[2]->index;
+		sample_t *d3 = line[3]->buff + line[3]->index;
+		sample_t *in = x + done;
+
+		int n4 = n & ~3;
+		fx_comb4_kernel(in, d0, d1, d2, d3, n4);
+		fx_comb4_kernel(in + n4, d0 + n4, d1 + n4, d2 + n4, d3 + n4, n - n4);
+
+		for(k = 0; k < 4; ++k)
 		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (all_pass1): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->AP1->buff_size = (int) delay_ms  * (audio_ctx->samprate * 0.001);
-		aud_fx->AP1->delayBuff1 = calloc(aud_fx->AP1->buff_size, sizeof(sample_t));
-		if(aud_fx->AP1->delayBuff1 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (all_pass1): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->AP1->delayBuff2 = NULL;
-		if(audio_ctx->channels > 1)
-		{
-			aud_fx->AP1->delayBuff2 = calloc(aud_fx->AP1->buff_size, sizeof(sample_t));
-			if(aud_fx->AP1->delayBuff2 == NULL)
-			{
-				fprintf(stderr,"AUDIO: FATAL memory allocation failure (all_pass1): %s\n", strerror(errno));
-				exit(-1);
-			}
+			line[k]->index += n;
+			if(line[k]->index >= line[k]->size)
+				line[k]->index = 0;
 		}
+		done += n;
 	}
-
-	all_pass (aud_fx->AP1, data,
-		audio_ctx->capture_buff_size, audio_ctx->channels, gain);
 }
 
 /*
- * reduce number of samples with linear interpolation
- *    rate - rate of samples to remove [1,...[
- *    rate = 1-> XXX (splits channels) 2 -> X0X0X  3 -> X00X00X 4 -> X000X000X
+ * All pass kernel
  * args:
- *   RT - pointer to fx_rate_data_t
- *   Buff - pointer to sample buffer
- *   rate - rate of samples to remove
- *   NumSamples - samples in buffer
- *   channels - audio channels
+ *   in - channel samples
+ *   d - delay buffer samples (no overlap with in)
+ *   n - number of samples
+ *   gain - filter gain
  *
  * asserts:
+ *   none
  *
  * returns: none
  */
-static void change_rate_less(fx_rate_data_t *RT,
-	sample_t *Buff,
-	int rate,
-	int NumSamples,
-	int channels)
+static inline void fx_all_pass_kernel(sample_t *restrict in,
+	sample_t *restrict d,
+	int n,
+	float gain)
 {
-	int samp = 0;
-	int n = 0, i = 0;
+	const float inv_gain = 1.0f / gain;
+	const float out_gain = 1 - gain * gain;
 
-	for (samp = 0; samp < NumSamples; samp += channels)
+	int i = 0;
+	for(i = 0; i < n; ++i)
 	{
-		if (n==0)
-		{
-			RT->rBuff1[i] = Buff[samp];
-			if(channels > 1)
-				RT->rBuff2[i] = Buff[samp + 1];
-
-			i++;
-		}
-		if(++n >= rate) n=0;
+		d[i] = in[i] + (gain * d[i]);
+		in[i] = ((d[i] * out_gain) - in[i]) * inv_gain;
 	}
-	RT->numsamples = i;
 }
 
 /*
- * increase audio tempo by adding audio windows of wtime_ms in given rate
- *   rate: 2 -> [w1..w2][w1..w2][w2..w3][w2..w3]  3-> [w1..w2][w1..w2][w1..w2][w2..w3][w2..w3][w2..w3]
+ * All pass filter (one channel)
  * args:
- *   audio_ctx - audio context
- *   data - audio buffer to be processed
- *   rate -rate of added windows
- *   wtime_ms - window time in ms
+ *   line - channel delay line
+ *   x - channel samples
+ *   frames - number of samples
+ *   gain- filter gain
  *
  * asserts:
  *   none
  *
  * returns: none
  */
-static void change_tempo_more(audio_context_t *audio_ctx,
-	sample_t *data,
-	int rate,
-	int	wtime_ms)
+static void fx_all_pass_channel(fx_delay_line_t *line,
+	sample_t *x,
+	int frames,
+	float gain)
 {
-	int samp = 0;
-	int i = 0;
-	int r = 0;
-	int index = 0;
-
-	if(aud_fx->RT1->wBuff1 == NULL)
+	int done = 0;
+	while(done < frames)
 	{
-		aud_fx->RT1->wSize  = wtime_ms * audio_ctx->samprate * 0.001;
-		aud_fx->RT1->wBuff1 = calloc(aud_fx->RT1->wSize, sizeof(sample_t));
-		if(aud_fx->RT1->wBuff1 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (change_tempo_more): %s\n", strerror(errno));
-			exit(-1);
-		}
-		if (audio_ctx->channels >1)
-		{
-			aud_fx->RT1->wBuff2 = calloc(aud_fx->RT1->wSize, sizeof(sample_t));
-			if(aud_fx->RT1->wBuff2 == NULL)
-			{
-				fprintf(stderr,"AUDIO: FATAL memory allocation failure (change_tempo_more): %s\n", strerror(errno));
-				exit(-1);
-			}
-		}
-	}
-
-	//printf("samples  = %i\n", data->RT1->numsamples);
-	for(samp = 0; samp < aud_fx->RT1->numsamples; samp++)
-	{
-		aud_fx->RT1->wBuff1[i] = aud_fx->RT1->rBuff1[samp];
-		if(audio_ctx->channels > 1)
-			aud_fx->RT1->wBuff2[i] = aud_fx->RT1->rBuff2[samp];
-
-		if((++i) > aud_fx->RT1->wSize)
-		{
-			for (r = 0; r < rate; r++)
-			{
-				for(i = 0; i < aud_fx->RT1->wSize; i++)
-				{
-					data[index] = aud_fx->RT1->wBuff1[i];
-					if (audio_ctx->channels > 1)
-						data[index +1] = aud_fx->RT1->wBuff2[i];
-					index += audio_ctx->channels;
-				}
-			}
-			i = 0;
-		}
+		/*process up to the delay buffer wrap*/
+		int n = line->size - line->index;
+		if(n > frames - done)
+			n = frames - done;
+
+		sample_t *d = line->buff + line->index;
+		sample_t *in = x + done;
+
+		int n4 = n & ~3;
+		fx_all_pass_kernel(in, d, n4, gain);
+		fx_all_pass_kernel(in + n4, d + n4, n - n4, gain);
+
+		line->index += n;
+		if(line->index >= line->size)
+			line->index = 0;
+		done += n;
 	}
 }
 
-#define FUZZ(x) CubicAmplifier(CubicAmplifier(CubicAmplifier(CubicAmplifier(x))))
-
 /*
- * Fuzz distortion
+ * Fuzz distortion kernel: one pass of the cubic amplifier
  * args:
- *   audio_ctx - audio context
- *   data - audio buffer to be processed
+ *   x - channel samples
+ *   n - number of samples
  *
  * asserts:
- *    audio_ctx is not null
+ *   none
  *
  * returns: none
  */
-static void audio_fx_fuzz (audio_context_t *audio_ctx, sample_t *data)
+static inline void fx_fuzz_kernel(sample_t *x, int n)
 {
-	/*assertions*/
-	assert(audio_ctx != NULL);
-
-	int samp=0;
-	for(samp = 0; samp < audio_ctx->capture_buff_size; samp++)
-		data[samp] = FUZZ(data[samp]);
-	HPF(audio_ctx, data, 1000, 0.9);
+	int i = 0;
+	for(i = 0; i < n; ++i)
+		x[i] = CubicAmplifier(x[i]);
 }
 
 /*
  * Echo effect
  * args:
- *   audio_ctx - audio context
- *   data - audio buffer to be processed
- *   delay_ms - echo delay in ms (e.g: 300)
- *   decay - feedback gain (<1)  (e.g: 0.5)
+ *   plane - channel sample planes
  *
  * asserts:
- *   audio_ctx is not null
+ *   none
  *
  * returns: none
  */
-static void audio_fx_echo(audio_context_t *audio_ctx,
-	sample_t *data,
-	int delay_ms,
-	float decay)
+static void audio_fx_echo(sample_t **plane)
 {
-	/*assertions*/
-	assert(audio_ctx != NULL);
-
-	int samp = 0;
-
-	if(aud_fx->ECHO == NULL)
-	{
-		aud_fx->ECHO = calloc(1, sizeof(fx_delay_data_t));
-		if(aud_fx->ECHO == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx_echo): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->ECHO->buff_size = (int) delay_ms * audio_ctx->samprate * 0.001;
-		aud_fx->ECHO->delayBuff1 = calloc(aud_fx->ECHO->buff_size, sizeof(sample_t));
-		if(aud_fx->ECHO->delayBuff1 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx_echo): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->ECHO->delayBuff2 = NULL;
-		if(audio_ctx->channels > 1)
-		{
-			aud_fx->ECHO->delayBuff2 = calloc(aud_fx->ECHO->buff_size, sizeof(sample_t));
-			if(aud_fx->ECHO->delayBuff2 == NULL)
-			{
-				fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx_echo): %s\n", strerror(errno));
-				exit(-1);
-			}
-		}
-	}
-
-	for(samp = 0; samp < audio_ctx->capture_buff_size; samp = samp + audio_ctx->channels)
-	{
-		sample_t out = (0.7 * data[samp]) +
-			(0.3 * aud_fx->ECHO->delayBuff1[aud_fx->ECHO->delayIndex]);
-		aud_fx->ECHO->delayBuff1[aud_fx->ECHO->delayIndex] = data[samp] +
-			(aud_fx->ECHO->delayBuff1[aud_fx->ECHO->delayIndex] * decay);
-		data[samp] = clip_float(out);
-		/*if stereo process second channel in separate*/
-		if (audio_ctx->channels > 1)
-		{
-			out = (0.7 * data[samp+1]) +
-				(0.3 * aud_fx->ECHO->delayBuff2[aud_fx->ECHO->delayIndex]);
-			aud_fx->ECHO->delayBuff2[aud_fx->ECHO->delayIndex] = data[samp] +
-				(aud_fx->ECHO->delayBuff2[aud_fx->ECHO->delayIndex] * decay);
-			data[samp+1] = clip_float(out);
-		}
-
-		if(++(aud_fx->ECHO->delayIndex) >= aud_fx->ECHO->buff_size) aud_fx->ECHO->delayIndex=0;
-	}
+	int ch = 0;
+	for(ch = 0; ch < aud_fx->channels; ++ch)
+		fx_echo_channel(&aud_fx->echo[ch], plane[ch], aud_fx->frames);
 }
 
 /*
- * Reverb effect
+ * Reverb effect (4 parallel comb filters followed by an all pass)
  * args:
- *   audio_ctx - audio context
- *   data - audio buffer to be processed
- *   delay_ms - reverb delay in ms
+ *   plane - channel sample planes
  *
  * asserts:
- *   audio_ctx is not null
+ *   none
  *
  * returns: none
  */
-static void audio_fx_reverb (audio_context_t *audio_ctx,
-	sample_t *data,
-	int delay_ms)
+static void audio_fx_reverb(sample_t **plane)
 {
-	/*assertions*/
-	assert(audio_ctx != NULL);
-
-	/*4 parallel comb filters*/
-	CombFilter4 (audio_ctx, data,
-		delay_ms, delay_ms - 5, delay_ms -10, delay_ms -15,
-		0.55, 0.6, 0.5, 0.45, 0.7);
-	
-	/*all pass*/
-	all_pass1 (audio_ctx, data, delay_ms, 0.75);
+	int ch = 0;
+	for(ch = 0; ch < aud_fx->channels; ++ch)
+	{
+		fx_delay_line_t *line[4] =
+		{
+			&aud_fx->comb[0][ch],
+			&aud_fx->comb[1][ch],
+			&aud_fx->comb[2][ch],
+			&aud_fx->comb[3][ch]
+		};
+		fx_comb4_channel(line, plane[ch], aud_fx->frames);
+		fx_all_pass_channel(&aud_fx->ap[ch], plane[ch], aud_fx->frames,
+			REVERB_AP_GAIN);
+	}
 }
 
-#define lfoskipsamples 30
-
 /*
- * WahWah effect
- * 	  !!!!!!!!!!!!! IMPORTANT!!!!!!!!! :
- * 	  depth and freqofs should be from 0(min) to 1(max) !
- * 	  res should be greater than 0 !
+ * Fuzz distortion
  * args:
- *   audio_ctx - audio context
- *   data - audio buffer to be processed
- *   freq - LFO frequency (1.5)
- *   startphase - LFO startphase in RADIANS - usefull for stereo WahWah (0)
- *   depth - Wah depth (0.7)
- *   freqofs - Wah frequency offset (0.3)
- *   res - Resonance (2.5)
+ *   plane - channel sample planes
  *
  * asserts:
- *   audio_ctx is not null
+ *   none
  *
  * returns: none
  */
-static void audio_fx_wahwah (audio_context_t *audio_ctx,
-	sample_t *data,
-	float freq,
-	float startphase,
-	float depth,
-	float freqofs,
-	float res)
+static void audio_fx_fuzz(sample_t **plane)
 {
-	/*assertions*/
-	assert(audio_ctx != NULL);
-
-	float frequency, omega, sn, cs, alpha;
+	int frames = aud_fx->frames;
+	int n4 = frames & ~3;
 
-	if(aud_fx->wahData == NULL)
+	int ch = 0;
+	for(ch = 0; ch < aud_fx->channels; ++ch)
 	{
-		aud_fx->wahData = calloc(1, sizeof(fx_wah_data_t));
-		if(aud_fx->wahData == NULL)
+		sample_t *x = plane[ch];
+
+		/*
+		 * four amplifier passes over the block (nesting them
+		 * in a single loop stops the compiler from vectorizing)
+		 */
+		int k = 0;
+		for(k = 0; k < 4; ++k)
 		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx_wahwah): %s\n", strerror(errno));
-			exit(-1);
+			fx_fuzz_kernel(x, n4);
+			fx_fuzz_kernel(x + n4, frames - n4);
 		}
-		aud_fx->wahData->lfoskip = freq * 2 * M_PI / audio_ctx->samprate;
-		aud_fx->wahData->phase = startphase;
-		/*if right channel set: phase += (float)M_PI;*/
-	}
-
-	int samp = 0;
-	for(samp = 0; samp < audio_ctx->capture_buff_size; samp++)
-	{
-		float in = data[samp];
 
-		if ((aud_fx->wahData->skipcount++) % lfoskipsamples == 0)
-		{
-			frequency = (1 + cos(aud_fx->wahData->skipcount * aud_fx->wahData->lfoskip + aud_fx->wahData->phase)) * 0.5;
-			frequency = frequency * depth * (1 - freqofs) + freqofs;
-			frequency = exp((frequency - 1) * 6);
-			omega = M_PI * frequency;
-			sn = sin(omega);
-			cs = cos(omega);
-			alpha = sn / (2 * res);
-			aud_fx->wahData->b0 = (1 - cs) * 0.5;
-			aud_fx->wahData->b1 = 1 - cs;
-			aud_fx->wahData->b2 = (1 - cs) * 0.5;
-			aud_fx->wahData->a0 = 1 + alpha;
-			aud_fx->wahData->a1 = -2 * cs;
-			aud_fx->wahData->a2 = 1 - alpha;
-		}
-		float out = (aud_fx->wahData->b0 * in + aud_fx->wahData->b1 * aud_fx->wahData->xn1 +
-			aud_fx->wahData->b2 * aud_fx->wahData->xn2 - aud_fx->wahData->a1 * aud_fx->wahData->yn1 -
-			aud_fx->wahData->a2 * aud_fx->wahData->yn2) / aud_fx->wahData->a0;
-		aud_fx->wahData->xn2 = aud_fx->wahData->xn1;
-		aud_fx->wahData->xn1 = in;
-		aud_fx->wahData->yn2 = aud_fx->wahData->yn1;
-		aud_fx->wahData->yn1 = out;
-
-		data[samp] = clip_float(out);
+		Butt(&aud_fx->hpf, &aud_fx->hpf_state[ch], x, frames);
 	}
 }
 
 /*
- * change pitch effect
+ * WahWah effect
+ *   the filter coeficients are updated every lfoskipsamples frames
+ *   and shared by all channels
  * args:
- *   audio_ctx - audio context
- *   data - audio buffer to be processed
- *   rate - window rate
+ *   plane - channel sample planes
  *
  * asserts:
- *   audio_ctx is not null
+ *   none
  *
  * returns: none
  */
-static void audio_fx_change_pitch (audio_context_t *audio_ctx,
-	sample_t *data,
-	int rate)
+static void audio_fx_wahwah(sample_t **plane)
 {
-	if(aud_fx->RT1 == NULL)
+	int done = 0;
+	while(done < aud_fx->frames)
 	{
-		aud_fx->RT1 = calloc(1, sizeof(fx_rate_data_t));
-		if(aud_fx->RT1 == NULL)
+		int lfo_pos = (int) (aud_fx->wah_skipcount % lfoskipsamples);
+		if(lfo_pos == 0)
 		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx_change_pitch): %s\n", strerror(errno));
-			exit(-1);
-		}
-		aud_fx->RT1->wBuff1 = NULL;
-		aud_fx->RT1->wBuff2 = NULL;
-		aud_fx->RT1->rBuff1 = calloc(audio_ctx->capture_buff_size/audio_ctx->channels, sizeof(sample_t));
-		if(aud_fx->RT1->rBuff1 == NULL)
-		{
-			fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx_change_pitch): %s\n", strerror(errno));
-			exit(-1);
+			float frequency = (1 + cos((aud_fx->wah_skipcount + 1) * aud_fx->wah_lfoskip + aud_fx->wah_phase)) * 0.5;
+			frequency = frequency * WAH_DEPTH * (1 - WAH_FREQOFS) + WAH_FREQOFS;
+			frequency = exp((frequency - 1) * 6);
+			float omega = M_PI * frequency;
+			float sn = sin(omega);
+			float cs = cos(omega);
+			float alpha = sn / (2 * WAH_RES);
+			aud_fx->wah_b0 = (1 - cs) * 0.5;
+			aud_fx->wah_b1 = 1 - cs;
+			aud_fx->wah_b2 = (1 - cs) * 0.5;
+			aud_fx->wah_inv_a0 = 1 / (1 + alpha);
+			aud_fx->wah_a1 = -2 * cs;
+			aud_fx->wah_a2 = 1 - alpha;
 		}
-		aud_fx->RT1->rBuff2 = NULL;
-		if(audio_ctx->channels > 1)
+
+		/*process up to the next coeficients update*/
+		int n = lfoskipsamples - lfo_pos;
+		if(n > aud_fx->frames - done)
+			n = aud_fx->frames - done;
+
+		const float b0 = aud_fx->wah_b0, b1 = aud_fx->wah_b1, b2 = aud_fx->wah_b2;
+		const float a1 = aud_fx->wah_a1, a2 = aud_fx->wah_a2;
+		const float inv_a0 = aud_fx->wah_inv_a0;
+
+		int ch = 0;
+		for(ch = 0; ch < aud_fx->channels; ++ch)
 		{
-			aud_fx->RT1->rBuff2 = calloc(audio_ctx->capture_buff_size/audio_ctx->channels, sizeof(sample_t));
-			if(aud_fx->RT1->rBuff2 == NULL)
+			fx_wah_state_t *st = &aud_fx->wah_state[ch];
+			float xn1 = st->xn1, xn2 = st->xn2, yn1 = st->yn1, yn2 = st->yn2;
+			sample_t *x = plane[ch] + done;
+
+			int i = 0;
+			for(i = 0; i < n; ++i)
 			{
-				fprintf(stderr,"AUDIO: FATAL memory allocation failure (audio_fx_change_pitch): %s\n", strerror(errno));
-				exit(-1);
+				float in = x[i];
+				float out = (b0 * in + b1 * xn1 + b2 * xn2 - a1 * yn1 - a2 * yn2) * inv_a0;
+				xn2 = xn1;
+				xn1 = in;
+				yn2 = yn1;
+				yn1 = out;
+
+				x[i] = clip_float(out);
 			}
+
+			st->xn1 = xn1;
+			st->xn2 = xn2;
+			st->yn1 = yn1;
+			st->yn2 = yn2;
 		}
-	}
 
-	change_rate_less(aud_fx->RT1, data, rate, audio_ctx->capture_buff_size, audio_ctx->channels);
-	change_tempo_more(audio_ctx, data, rate, 20);
-	LPF(audio_ctx, data, audio_ctx->samprate * 0.25, 0.9);
+		aud_fx->wah_skipcount += n;
+		done += n;
+	}
 }
 
 /*
- * clean fx_delay_data_t
+ * change pitch effect (ducky)
+ *   keeps one of every DUCKY_RATE frames in a window and plays each
+ *   complete window DUCKY_RATE times (one window of latency), so the
+ *   pitch goes up and the duration stays the same; then low pass filter
  * args:
- *   DELAY - pointer to fx_delay_data_t
+ *   plane - channel sample planes
  *
  * asserts:
  *   none
  *
  * returns: none
  */
-static void close_DELAY(fx_delay_data_t *DELAY)
+static void audio_fx_change_pitch(sample_t **plane)
 {
-	if(DELAY != NULL)
+	const int rate = DUCKY_RATE;
+	const int wsize = aud_fx->pitch_wsize;
+	const int period = rate * wsize; /*input frames per window*/
+
+	int done = 0;
+	while(done < aud_fx->frames)
 	{
-		free(DELAY->delayBuff1);
-		free(DELAY->delayBuff2);
-		free(DELAY);
+		int count = aud_fx->pitch_count;
+		int n = period - count;
+		if(n > aud_fx->frames - done)
+			n = aud_fx->frames - done;
+
+		int ch = 0;
+		for(ch = 0; ch < aud_fx->channels; ++ch)
+		{
+			fx_pitch_state_t *st = &aud_fx->pitch_state[ch];
+			sample_t *x = plane[ch] + done;
+
+			/*decimate into the window*/
+			int c = ((count + rate - 1) / rate) * rate;
+			for(; c < count + n; c += rate)
+				st->win[c / rate] = x[c - count];
+
+			/*play the previous window*/
+			int i = 0;
+			while(i < n)
+			{
+				int pos = (count + i) % wsize;
+				int m = wsize - pos;
+				if(m > n - i)
+					m = n - i;
+				memcpy(x + i, st->play + pos, m * sizeof(sample_t));
+				i += m;
+			}
+		}
+
+		aud_fx->pitch_count += n;
+		if(aud_fx->pitch_count >= period)
+		{
+			/*window complete: play it next*/
+			for(ch = 0; ch < aud_fx->channels; ++ch)
+			{
+				fx_pitch_state_t *st = &aud_fx->pitch_state[ch];
+				sample_t *tmp = st->play;
+				st->play = st->win;
+				st->win = tmp;
+			}
+			aud_fx->pitch_count = 0;
+		}
+		done += n;
 	}
+
+	int ch = 0;
+	for(ch = 0; ch < aud_fx->channels; ++ch)
+		Butt(&aud_fx->lpf, &aud_fx->lpf_state[ch], plane[ch], aud_fx->frames);
 }
 
 /*
- * clean fx_comb4_data_t
+ * clear a delay line (one per channel)
  * args:
- *   COMB4 - pointer to fx_comb4_data_t
+ *   line - array of channel delay lines
  *
  * asserts:
  *   none
  *
  * returns: none
  */
-static void close_COMB4(fx_comb4_data_t *COMB4)
+static void fx_reset_delay(fx_delay_line_t *line)
 {
-	if(COMB4 != NULL)
+	int ch = 0;
+	for(ch = 0; ch < aud_fx->channels; ++ch)
 	{
-		free(COMB4->CombBuff10);
-		free(COMB4->CombBuff20);
-		free(COMB4->CombBuff30);
-		free(COMB4->CombBuff40);
-
-		free(COMB4->CombBuff11);
-		free(COMB4->CombBuff21);
-		free(COMB4->CombBuff31);
-		free(COMB4->CombBuff41);
-
-		free(COMB4);
+		memset(line[ch].buff, 0, line[ch].size * sizeof(sample_t));
+		line[ch].index = 0;
 	}
 }
 
 /*
- * clean fx_filt_data_t
+ * reset a fx state (when it gets enabled)
  * args:
- *   FILT - pointer to fx_filt_data_t
+ *   fx - fx flag (AUDIO_FX_XXX)
  *
  * asserts:
  *   none
  *
  * returns: none
  */
-static void close_FILT(fx_filt_data_t *FILT)
+static void audio_fx_reset(uint32_t fx)
 {
-	if(FILT != NULL)
+	int ch = 0;
+
+	switch(fx)
 	{
-		free(FILT);
+		case AUDIO_FX_ECHO:
+			fx_reset_delay(aud_fx->echo);
+			break;
+
+		case AUDIO_FX_REVERB:
+			for(ch = 0; ch < 4; ++ch)
+				fx_reset_delay(aud_fx->comb[ch]);
+			fx_reset_delay(aud_fx->ap);
+			break;
+
+		case AUDIO_FX_FUZZ:
+			memset(aud_fx->hpf_state, 0, aud_fx->channels * sizeof(fx_filt_state_t));
+			break;
+
+		case AUDIO_FX_WAHWAH:
+			memset(aud_fx->wah_state, 0, aud_fx->channels * sizeof(fx_wah_state_t));
+			aud_fx->wah_skipcount = 0;
+			break;
+
+		case AUDIO_FX_DUCKY:
+			for(ch = 0; ch < aud_fx->channels; ++ch)
+			{
+				memset(aud_fx->pitch_state[ch].win, 0, aud_fx->pitch_wsize * sizeof(sample_t));
+				memset(aud_fx->pitch_state[ch].play, 0, aud_fx->pitch_wsize * sizeof(sample_t));
+			}
+			aud_fx->pitch_count = 0;
+			memset(aud_fx->lpf_state, 0, aud_fx->channels * sizeof(fx_filt_state_t));
+			break;
 	}
 }
 
 /*
- * clean fx_wah_data_t
+ * process a buffer with a fx
  * args:
- *   WAH - pointer to fx_wah_data_t
+ *   fx - fx flag (AUDIO_FX_XXX)
+ *   plane - channel sample planes
  *
  * asserts:
  *   none
  *
  * returns: none
  */
-static void close_WAHWAH(fx_wah_data_t *WAH)
+static void audio_fx_process(uint32_t fx, sample_t **plane)
 {
-	if(WAH != NULL)
+	switch(fx)
 	{
-		free(WAH);
+		case AUDIO_FX_ECHO:
+			audio_fx_echo(plane);
+			break;
+		case AUDIO_FX_REVERB:
+			audio_fx_reverb(plane);
+			break;
+		case AUDIO_FX_FUZZ:
+			audio_fx_fuzz(plane);
+			break;
+		case AUDIO_FX_WAHWAH:
+			audio_fx_wahwah(plane);
+			break;
+		case AUDIO_FX_DUCKY:
+			audio_fx_change_pitch(plane);
+			break;
 	}
 }
 
 /*
- * clean reverb data
+ * set the order in which the audio fx are applied
+ *   (takes effect on the next audio_start)
  * args:
- *   none
+ *   fx_list - list of AUDIO_FX_XXX flags, first is applied first
+ *   n - number of entries in fx_list; fx not in the list are
+ *       applied after these in the default order
  *
  * asserts:
  *   none
  *
- * returns: none
+ * returns: error code (0 - OK)
  */
-static void close_reverb()
+int audio_fx_set_chain(const uint32_t *fx_list, int n)
 {
-	close_DELAY(aud_fx->AP1);
-	aud_fx->AP1 = NULL;
-	close_COMB4(aud_fx->COMB4);
-	aud_fx->COMB4 = NULL;
+	static const uint32_t default_chain[AUDIO_FX_NUM] =
+	{
+		AUDIO_FX_ECHO,
+		AUDIO_FX_REVERB,
+		AUDIO_FX_FUZZ,
+		AUDIO_FX_WAHWAH,
+		AUDIO_FX_DUCKY
+	};
+
+	uint32_t chain[AUDIO_FX_NUM];
+	uint32_t used = 0;
+	int i = 0, k = 0;
+
+	if(n < 0 || n > AUDIO_FX_NUM || (n > 0 && fx_list == NULL))
+		return -1;
+
+	for(i = 0; i < n; ++i)
+	{
+		int valid = 0;
+		for(k = 0; k < AUDIO_FX_NUM; ++k)
+			if(fx_list[i] == default_chain[k])
+				valid = 1;
+
+		if(!valid || (used & fx_list[i]))
+		{
+			fprintf(stderr, "AUDIO: (audio_fx_set_chain) invalid fx 0x%x in chain\n", fx_list[i]);
+			return -1;
+		}
+
+		chain[i] = fx_list[i];
+		used |= fx_list[i];
+	}
+
+	for(k = 0; k < AUDIO_FX_NUM; ++k)
+		if(!(used & default_chain[k]))
+			chain[i++] = default_chain[k];
+
+	memcpy(fx_chain, chain, sizeof(fx_chain));
+
+	return 0;
 }
 
 /*
- * clean pitch data
+ * initialize audio fx data: allocates the state of all fx
+ *   for the current audio format (called from audio_start)
  * args:
- *   none
+ *    audio_ctx - pointer to audio context
  *
  * asserts:
- *   none
+ *    audio_ctx is not null
  *
  * returns: none
  */
-static void close_pitch ()
+void audio_fx_init(audio_context_t *audio_ctx)
 {
-	if(aud_fx->RT1 != NULL)
+	/*assertions*/
+	assert(audio_ctx != NULL);
+
+	audio_fx_close();
+
+	if(audio_ctx->channels <= 0 || audio_ctx->samprate <= 0 ||
+		audio_ctx->capture_buff_size < audio_ctx->channels)
+		return;
+
+	int channels = audio_ctx->channels;
+	int samprate = audio_ctx->samprate;
+	int frames = audio_ctx->capture_buff_size / channels;
+	int ch = 0, k = 0;
+
+	aud_fx = fx_calloc(1, sizeof(audio_fx_t));
+	aud_fx->channels = channels;
+	aud_fx->frames = frames;
+	aud_fx->samprate = samprate;
+	aud_fx->mask = AUDIO_FX_NONE;
+	memcpy(aud_fx->chain, fx_chain, sizeof(aud_fx->chain));
+
+	int echo_size = fx_delay_size(ECHO_DELAY_MS, samprate);
+	int comb_size[4];
+	for(k = 0; k < 4; ++k)
+		comb_size[k] = fx_delay_size(REVERB_DELAY_MS - (5 * k), samprate);
+	int ap_size = fx_delay_size(REVERB_DELAY_MS, samprate);
+	aud_fx->pitch_wsize = fx_delay_size(DUCKY_WINDOW_MS, samprate);
+
+	/*one block for the planes and all the delay buffers*/
+	size_t per_channel = frames + echo_size + ap_size +
+		comb_size[0] + comb_size[1] + comb_size[2] + comb_size[3] +
+		(2 * aud_fx->pitch_wsize);
+	aud_fx->mem = fx_calloc(per_channel * channels, sizeof(sample_t));
+
+	aud_fx->plane = fx_calloc(channels, sizeof(sample_t *));
+	aud_fx->echo = fx_calloc(channels, sizeof(fx_delay_line_t));
+	for(k = 0; k < 4; ++k)
+		aud_fx->comb[k] = fx_calloc(channels, sizeof(fx_delay_line_t));
+	aud_fx->ap = fx_calloc(channels, sizeof(fx_delay_line_t));
+	aud_fx->hpf_state = fx_calloc(channels, sizeof(fx_filt_state_t));
+	aud_fx->wah_state = fx_calloc(channels, sizeof(fx_wah_state_t));
+	aud_fx->pitch_state = fx_calloc(channels, sizeof(fx_pitch_state_t));
+	aud_fx->lpf_state = fx_calloc(channels, sizeof(fx_filt_state_t));
+
+	sample_t *p = aud_fx->mem;
+	for(ch = 0; ch < channels; ++ch)
 	{
-		free(aud_fx->RT1->rBuff1);
-		free(aud_fx->RT1->rBuff2);
-		free(aud_fx->RT1->wBuff1);
-		free(aud_fx->RT1->wBuff2);
-		free(aud_fx->RT1);
-		aud_fx->RT1 = NULL;
-		close_FILT(aud_fx->LPF1);
-		aud_fx->LPF1 = NULL;
+		aud_fx->plane[ch] = p;
+		p += frames;
 	}
+	for(ch = 0; ch < channels; ++ch)
+	{
+		aud_fx->echo[ch].buff = p;
+		aud_fx->echo[ch].size = echo_size;
+		p += echo_size;
+
+		for(k = 0; k < 4; ++k)
+		{
+			aud_fx->comb[k][ch].buff = p;
+			aud_fx->comb[k][ch].size = comb_size[k];
+			p += comb_size[k];
+		}
+
+		aud_fx->ap[ch].buff = p;
+		aud_fx->ap[ch].size = ap_size;
+		p += ap_size;
+
+		aud_fx->pitch_state[ch].win = p;
+		p += aud_fx->pitch_wsize;
+		aud_fx->pitch_state[ch].play = p;
+		p += aud_fx->pitch_wsize;
+	}
+
+	HPF_coef(&aud_fx->hpf, samprate, FUZZ_HPF_FREQ, FUZZ_HPF_RES);
+	LPF_coef(&aud_fx->lpf, samprate, samprate * 0.25, DUCKY_LPF_RES);
+
+	aud_fx->wah_lfoskip = WAH_FREQ * 2 * M_PI / samprate;
+	aud_fx->wah_phase = WAH_STARTPHASE;
+
+	if(audio_verbosity > 1)
+		printf("AUDIO: fx state for %i channels, %i frames per buffer (%i kB)\n",
+			channels, frames, (int) ((per_channel * channels * sizeof(sample_t)) / 1024));
 }
 
 /*
@@ -1100,14 +1091,18 @@ void audio_fx_close()
 	if(aud_fx == NULL)
 		return;
 
-	close_DELAY(aud_fx->ECHO);
-	aud_fx->ECHO = NULL;
-	close_reverb();
-	close_WAHWAH(aud_fx->wahData);
-	aud_fx->wahData = NULL;
-	close_FILT(aud_fx->HPF);
-	aud_fx->HPF = NULL;
-	close_pitch();
+	int k = 0;
+
+	free(aud_fx->mem);
+	free(aud_fx->plane);
+	free(aud_fx->echo);
+	for(k = 0; k < 4; ++k)
+		free(aud_fx->comb[k]);
+	free(aud_fx->ap);
+	free(aud_fx->hpf_state);
+	free(aud_fx->wah_state);
+	free(aud_fx->pitch_state);
+	free(aud_fx->lpf_state);
 
 	free(aud_fx);
 	aud_fx = NULL;
@@ -1115,9 +1110,10 @@ void audio_fx_close()
 
 /*
  * apply audio fx
+ *   no allocations: all fx state is allocated by audio_fx_init
  * args:
  *   audio_ctx - pointer to audio context
- *   proc_buff - pointer to audio buffer to process
+ *   data - pointer to audio buffer to process
  *   mask - or'ed fx combination
  *
  * asserts:
@@ -1129,48 +1125,47 @@ void audio_fx_apply(audio_context_t *audio_ctx,
 	sample_t *data,
 	uint32_t mask)
 {
-	if(mask != AUDIO_FX_NONE)
-    {
-		if(audio_verbosity > 2)
-			printf("AUDIO: Apllying Fx (0x%x)\n", mask);
-			
-		if(aud_fx == NULL)
-			audio_fx_init();
-		
-		if(mask & AUDIO_FX_ECHO)
-			audio_fx_echo(audio_ctx, data, 300, 0.5);
-		else
-		{
-			close_DELAY(aud_fx->ECHO);
-			aud_fx->ECHO = NULL;
-		}
+	if(aud_fx == NULL)
+		return;
 
-		if(mask & AUDIO_FX_REVERB)
-			audio_fx_reverb(audio_ctx, data, 50);
-		else
-			close_reverb();
+	if(mask == AUDIO_FX_NONE)
+	{
+		aud_fx->mask = AUDIO_FX_NONE;
+		return;
+	}
 
-		if(mask & AUDIO_FX_FUZZ)
-			audio_fx_fuzz(audio_ctx, data);
-		else
-		{
-			close_FILT(aud_fx->HPF);
-			aud_fx->HPF = NULL;
-		}
+	if(audio_verbosity > 2)
+		printf("AUDIO: Apllying Fx (0x%x)\n", mask);
 
-		if(mask & AUDIO_FX_WAHWAH)
-			audio_fx_wahwah(audio_ctx, data, 1.5, 0, 0.7, 0.3, 2.5);
-		else
-		{
-			close_WAHWAH(aud_fx->wahData);
-			aud_fx->wahData = NULL;
-		}
+	if(audio_ctx->capture_buff_size != aud_fx->frames * aud_fx->channels)
+	{
+		fprintf(stderr, "AUDIO: (audio_fx_apply) buffer size changed (%i): fx not applied\n",
+			audio_ctx->capture_buff_size);
+		return;
+	}
+
+	int i = 0;
 
-		if(mask & AUDIO_FX_DUCKY)
-			audio_fx_change_pitch(audio_ctx, data, 2);
-		else
-			close_pitch();
+	/*fx that were just enabled start from a clean state*/
+	for(i = 0; i < AUDIO_FX_NUM; ++i)
+		if((mask & aud_fx->chain[i]) && !(aud_fx->mask & aud_fx->chain[i]))
+			audio_fx_reset(aud_fx->chain[i]);
+	aud_fx->mask = mask;
+
+	/*process each channel in its own (contiguous) plane*/
+	sample_t **plane = &data;
+	if(aud_fx->channels > 1)
+	{
+		audio_convert_float_to_fltp(aud_fx->plane[0], data,
+			aud_fx->frames, aud_fx->channels);
+		plane = aud_fx->plane;
 	}
-	else
-		audio_fx_close();
+
+	for(i = 0; i < AUDIO_FX_NUM; ++i)
+		if(mask & aud_fx->chain[i])
+			audio_fx_process(aud_fx->chain[i], plane);
+
+	if(aud_fx->channels > 1)
+		audio_convert_fltp_to_float(data, aud_fx->plane[0],
+			aud_fx->frames, aud_fx->channels);
 }
@@ -108,6 +108,7 @@ static int recordCallback (
 	if(statusFlags & paInputOverflow)
 	{
 		fprintf( stderr, "AUDIO: portaudio buffer overflow\n" );
+		audio_add_overrun(audio_ctx);
 
 		int64_t d_ts = ts - audio_ctx->last_ts;
 		uint32_t n_samples = (d_ts / frame_length) * audio_ctx->channels;
@@ -410,6 +410,27 @@ static void get_latency(pa_stream *s)
 	//printf("AUDIO: pulseaudio latency is %0.0f usec    \r", (float)latency);
 }
 
+/*
+ * audio overflow callback (server dropped data)
+ * args:
+ *   s - pointer to pa_stream
+ *   data - pointer to user data
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void stream_overflow_cb(pa_stream *s, void *data)
+{
+	audio_context_t *audio_ctx = (audio_context_t *) data;
+
+	if(audio_verbosity > 1)
+		fprintf(stderr, "AUDIO: (pulseaudio) stream overflow\n");
+
+	audio_add_overrun(audio_ctx);
+}
+
 /*
  * audio record callback
  * args:
@@ -586,6 +607,7 @@ static void *pulse_read_audio(void *data)
 
     /* define the callbacks */
     pa_stream_set_read_callback(recordstream, stream_request_cb, (void *) audio_ctx);
+    pa_stream_set_overflow_callback(recordstream, stream_overflow_cb, (void *) audio_ctx);
 
 	// Set properties of the record buffer
     pa_zero(bufattr);
@@ -46,7 +46,7 @@ __BEGIN_DECLS
 #define AUDIO_PORTAUDIO     (1)
 #define AUDIO_PULSE         (2)
 
-/*Audio Buffer flags*/
+/*Audio Buffer flags (unused: the buffer ring has no flags - kept for the api)*/
 #define AUDIO_BUFF_FREE     (0)
 #define AUDIO_BUFF_USED     (1)
 
@@ -77,10 +77,20 @@ typedef struct _audio_buff_t
 {
 	void *data; /*sample buffer - usually sample_t (float)*/
 	int64_t timestamp;
-	int flag;
+	int flag; /*unused (the buffer ring has no flags) - kept for the abi*/
 	float level_meter[2]; /*average sample level*/
 } audio_buff_t;
 
+typedef struct _audio_stats_t
+{
+	uint64_t buffers;       /*buffers stored in the ring*/
+	uint64_t dropped;       /*buffers dropped (ring full)*/
+	uint64_t overruns;      /*api overruns (data lost upstream)*/
+	int ring_size;          /*number of buffers in the ring*/
+	int ring_fill;          /*buffers waiting to be processed*/
+	int ring_max_fill;      /*max buffers waiting since audio_start*/
+} audio_stats_t;
+
 typedef struct _audio_device_t
 {
 	int id;                 /*audo device id*/
@@ -323,6 +333,33 @@ int audio_get_next_buffer(audio_context_t *audio_ctx,
 	int type,
 	uint32_t mask);
 
+/*
+ * wait for a buffer in the ring
+ * args:
+ *   audio_ctx - pointer to audio context
+ *   timeout - maximum wait time (in ms)
+ *
+ * asserts:
+ *   audio_ctx is not null
+ *
+ * returns: 1 if a buffer is available, 0 on timeout
+ */
+int audio_wait_buffer(audio_context_t *audio_ctx, int timeout);
+
+/*
+ * get the audio capture stats (reset on audio_start)
+ * args:
+ *   audio_ctx - pointer to audio context
+ *   stats - pointer to stats structure to fill
+ *
+ * asserts:
+ *   audio_ctx is not null
+ *   stats is not null
+ *
+ * returns: none
+ */
+void audio_get_stats(audio_context_t *audio_ctx, audio_stats_t *stats);
+
 /*
  * apply audio fx
  * args:
@@ -339,6 +376,21 @@ void audio_fx_apply(audio_context_t *audio_ctx,
 	sample_t *data,
 	uint32_t mask);
 
+/*
+ * set the order in which the audio fx are applied
+ *   (takes effect on the next audio_start)
+ * args:
+ *   fx_list - list of AUDIO_FX_XXX flags, first is applied first
+ *   n - number of entries in fx_list; fx not in the list are
+ *       applied after these in the default order
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code (0 - OK)
+ */
+int audio_fx_set_chain(const uint32_t *fx_list, int n);
+
 /*
  * clean audio fx data
  * args:
@@ -33,6 +33,7 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <time.h>
 /* support for internationalization - i18n */
 #include <locale.h>
 #include <libintl.h>
@@ -597,6 +598,26 @@ stream_io_t *avi_add_audio_stream(
 	return stream;
 }
 
+/*
+ * get monotonic time (for the writer flush interval)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: monotonic time in nanosec
+ */
+static int64_t avi_time_ns()
+{
+	struct timespec now;
+
+	if(clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+		return 0;
+
+	return ((int64_t) now.tv_sec * 1000000000LL + (int64_t) now.tv_nsec);
+}
+
 /*
    first function to get called
 
@@ -616,7 +637,7 @@ avi_context_t *avi_create_context(const char *filename)
 		exit(-1);
 	}
 
-	avi_ctx->writer = io_create_writer(filename, 0);
+	avi_ctx->writer = io_create_writer(filename, AVI_IO_BUFFER_SIZE);
 
 	if (avi_ctx->writer == NULL)
 	{
@@ -634,6 +655,8 @@ avi_context_t *avi_create_context(const char *filename)
 	avi_ctx->stream_list = NULL;
 	avi_ctx->stream_list_size = 0;
 
+	avi_ctx->flush_ts = avi_time_ns();
+
 	return avi_ctx;
 }
 
@@ -951,7 +974,17 @@ int avi_write_packet(
     if (size & 1)
         io_write_w8(avi_ctx->writer, 0);
 
-    io_flush_buffer(avi_ctx->writer);
+    /*
+     * packets are batched in the writer buffer (flushed when full),
+     * flush it at least every AVI_FLUSH_INTERVAL to bound the data
+     * lost if recording is interrupted
+     */
+    int64_t ts = avi_time_ns();
+    if(ts - avi_ctx->flush_ts >= AVI_FLUSH_INTERVAL)
+    {
+        io_flush_buffer(avi_ctx->writer);
+        avi_ctx->flush_ts = ts;
+    }
 
     return 0;
 }
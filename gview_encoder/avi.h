@@ -34,6 +34,9 @@
 #define AVI_MAX_TRACKS 8
 #define FRAME_RATE_SCALE 1000 //1000000
 
+#define AVI_IO_BUFFER_SIZE (1024 * 1024) /*packets are batched in the writer buffer*/
+#define AVI_FLUSH_INTERVAL (1000000000LL) /*flush at least every sec (nanosec)*/
+
 typedef struct _video_index_entry_t
 {
 	off_t key;
@@ -94,6 +97,8 @@ typedef struct avi_context_t
 
 	int64_t odml_list; /*,time_delay_off*/ ; //some file offsets
 
+	int64_t flush_ts; /*last writer flush (monotonic time in nanosec)*/
+
 } avi_context_t;
 
 avi_context_t *avi_create_context(const char *filename);
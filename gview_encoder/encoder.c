@@ -34,10 +34,14 @@
 #include <libavutil/error.h>
 #include <linux/videodev2.h>
 #include <math.h>
+#include <poll.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 /* support for internationalization - i18n */
 #include <libintl.h>
@@ -55,10 +59,6 @@
 
 int enc_verbosity = 0;
 
-/*video buffer data mutex*/
-static __MUTEX_TYPE mutex = __STATIC_MUTEX_INIT;
-#define __PMUTEX &mutex
-
 static int valid_video_codecs = 0;
 static int valid_audio_codecs = 0;
 
@@ -68,10 +68,18 @@ static int64_t reference_pts = 0;
 
 static int video_frame_max_size = 0;
 
+/*
+ * video ring buffer: lock free single producer (capture thread)
+ * single consumer (encoder thread); the frame counters only grow,
+ * the slot is counter % video_ring_buffer_size
+ */
 static int video_ring_buffer_size = 0;
 static video_buffer_t *video_ring_buffer = NULL;
-static int video_read_index = 0;
-static int video_write_index = 0;
+static _Atomic uint64_t video_read_count = 0;  /*frames consumed*/
+static _Atomic uint64_t video_write_count = 0; /*frames produced*/
+static _Atomic int video_consumer_waiting = 0; /*consumer blocked on event_fd*/
+static _Atomic int video_frame_refs = 0; /*input frame references in the ring*/
+static int video_ring_event_fd = -1; /*eventfd: wakes up the consumer*/
 static int video_scheduler = 0;
 
 /*
@@ -120,18 +128,21 @@ static void encoder_alloc_video_ring_buffer(int video_width, int video_height,
   else
     video_frame_max_size = video_width * video_height * 3; // RGB formats
 
-  int i = 0;
-  for (i = 0; i < video_ring_buffer_size; ++i) {
-    video_ring_buffer[i].frame = calloc(video_frame_max_size, sizeof(uint8_t));
-    if (video_ring_buffer[i].frame == NULL) {
-      fprintf(stderr,
-              "ENCODER: FATAL memory allocation failure "
-              "(encoder_alloc_video_ring_buffer): %s\n",
-              strerror(errno));
-      exit(-1);
-    }
-    video_ring_buffer[i].flag = VIDEO_BUFF_FREE;
-  }
+  /*
+   * frame copy buffers are only allocated on first use
+   * (slots holding frame references don't need them)
+   */
+
+  atomic_store(&video_read_count, 0);
+  atomic_store(&video_write_count, 0);
+  atomic_store(&video_consumer_waiting, 0);
+  atomic_store(&video_frame_refs, 0);
+
+  video_ring_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (video_ring_event_fd < 0)
+    fprintf(stderr,
+            "ENCODER: couldn't create video ring event (%s): polling\n",
+            strerror(errno));
 }
 
 /*
@@ -148,6 +159,18 @@ static void encoder_clean_video_ring_buffer() {
   if (!video_ring_buffer)
     return;
 
+  /*release any frame references left in the ring*/
+  uint64_t count = atomic_load(&video_read_count);
+  for (; count < atomic_load(&video_write_count); ++count) {
+    video_buffer_t *video_buff =
+        &video_ring_buffer[count % video_ring_buffer_size];
+    if (video_buff->release) {
+      video_buff->release(video_buff->release_data);
+      video_buff->release = NULL;
+      atomic_fetch_sub(&video_frame_refs, 1);
+    }
+  }
+
   int i = 0;
   for (i = 0; i < video_ring_buffer_size; ++i) {
     /*Max: (yuyv) 2 bytes per pixel*/
@@ -155,6 +178,10 @@ static void encoder_clean_video_ring_buffer() {
   }
   free(video_ring_buffer);
   video_ring_buffer = NULL;
+
+  if (video_ring_event_fd >= 0)
+    close(video_ring_event_fd);
+  video_ring_event_fd = -1;
 }
 
 /*
@@ -1068,16 +1095,14 @@ int encoder_get_max_audio_sample_fmt() { return AV_SAMPLE_FMT_NB - 1; }
  * returns: estimate sleep time (milisec)
  */
 double encoder_buff_scheduler(int mode, double thresh, double max_time) {
-  int diff_ind = 0;
   double sched_time = 0; /*in milisec*/
 
-  __LOCK_MUTEX(__PMUTEX);
   /* try to balance buffer overrun in read/write operations */
-  if (video_write_index >= video_read_index)
-    diff_ind = video_write_index - video_read_index;
-  else
-    diff_ind = (video_ring_buffer_size - video_read_index) + video_write_index;
-  __UNLOCK_MUTEX(__PMUTEX);
+  uint64_t read_count =
+      atomic_load_explicit(&video_read_count, memory_order_acquire);
+  int diff_ind = (int)(atomic_load_explicit(&video_write_count,
+                                            memory_order_relaxed) -
+                       read_count);
 
   /*clip ring buffer threshold*/
   if (thresh < 0.2)
@@ -1211,6 +1236,70 @@ encoder_context_t *encoder_init(int input_format, int video_codec_ind,
   return encoder_ctx;
 }
 
+/*
+ * get the next free slot in the video ring buffer (producer side)
+ * args:
+ *   timestamp - frame timestamp (in nanosec)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to free slot (timestamp set) or NULL if ring is full
+ */
+static video_buffer_t *encoder_get_free_video_buffer(int64_t timestamp) {
+  if (reference_pts == 0) {
+    reference_pts = timestamp; /*first frame ts*/
+    if (enc_verbosity > 0)
+      printf("ENCODER: ref ts = %" PRId64 "\n", timestamp);
+  }
+
+  /*we are the only producer: relaxed load of our own counter*/
+  uint64_t write_count =
+      atomic_load_explicit(&video_write_count, memory_order_relaxed);
+  /*acquire: the consumer is done with the slot*/
+  if (write_count -
+          atomic_load_explicit(&video_read_count, memory_order_acquire) >=
+      (uint64_t)video_ring_buffer_size) {
+    fprintf(stderr, "ENCODER: video ring buffer full - dropping frame\n");
+    return NULL;
+  }
+
+  video_buffer_t *video_buff =
+      &video_ring_buffer[write_count % video_ring_buffer_size];
+  video_buff->timestamp = timestamp - reference_pts;
+
+  return video_buff;
+}
+
+/*
+ * publish the slot returned by encoder_get_free_video_buffer (producer side)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void encoder_publish_video_buffer() {
+  uint64_t write_count =
+      atomic_load_explicit(&video_write_count, memory_order_relaxed);
+
+  /*
+   * publish the frame (seq_cst: must be ordered before the
+   * waiting flag check, see encoder_wait_video_buffer)
+   */
+  atomic_store(&video_write_count, write_count + 1);
+
+  if (atomic_load(&video_consumer_waiting) && video_ring_event_fd >= 0) {
+    uint64_t one = 1;
+    if (write(video_ring_event_fd, &one, sizeof(uint64_t)) < 0 &&
+        errno != EAGAIN)
+      fprintf(stderr, "ENCODER: couldn't signal video ring event: %s\n",
+              strerror(errno));
+  }
+}
+
 /*
  * store unprocessed input video frame in video ring buffer
  * args:
@@ -1229,21 +1318,19 @@ int encoder_add_video_frame(uint8_t *frame, int size, int64_t timestamp,
   if (!video_ring_buffer)
     return -1;
 
-  if (reference_pts == 0) {
-    reference_pts = timestamp; /*first frame ts*/
-    if (enc_verbosity > 0)
-      printf("ENCODER: ref ts = %" PRId64 "\n", timestamp);
-  }
-
-  int64_t pts = timestamp - reference_pts;
-
-  __LOCK_MUTEX(__PMUTEX);
-  int flag = video_ring_buffer[video_write_index].flag;
-  __UNLOCK_MUTEX(__PMUTEX);
-
-  if (flag != VIDEO_BUFF_FREE) {
-    fprintf(stderr, "ENCODER: video ring buffer full - dropping frame\n");
+  video_buffer_t *video_buff = encoder_get_free_video_buffer(timestamp);
+  if (!video_buff)
     return -1;
+
+  if (!video_buff->frame) {
+    video_buff->frame = calloc(video_frame_max_size, sizeof(uint8_t));
+    if (video_buff->frame == NULL) {
+      fprintf(stderr,
+              "ENCODER: FATAL memory allocation failure "
+              "(encoder_add_video_frame): %s\n",
+              strerror(errno));
+      exit(-1);
+    }
   }
 
   /*clip*/
@@ -1255,19 +1342,122 @@ int encoder_add_video_frame(uint8_t *frame, int size, int64_t timestamp,
 
     size = video_frame_max_size;
   }
-  memcpy(video_ring_buffer[video_write_index].frame, frame, size);
-  video_ring_buffer[video_write_index].frame_size = size;
-  video_ring_buffer[video_write_index].timestamp = pts;
-  video_ring_buffer[video_write_index].keyframe = isKeyframe;
+  memcpy(video_buff->frame, frame, size);
+  video_buff->data = video_buff->frame;
+  video_buff->frame_size = size;
+  video_buff->keyframe = isKeyframe;
+  video_buff->release = NULL;
+  video_buff->release_data = NULL;
 
-  __LOCK_MUTEX(__PMUTEX);
-  video_ring_buffer[video_write_index].flag = VIDEO_BUFF_USED;
-  NEXT_IND(video_write_index, video_ring_buffer_size);
-  __UNLOCK_MUTEX(__PMUTEX);
+  encoder_publish_video_buffer();
 
   return 0;
 }
 
+/*
+ * store a reference to an input video frame in video ring buffer (no copy)
+ *   the frame data must stay valid (and unchanged) until release is
+ *   called from the encoder thread
+ * args:
+ *   frame - pointer to unprocessed frame data
+ *   size - frame size (in bytes)
+ *   timestamp - frame timestamp (in nanosec)
+ *   isKeyframe - flag if it's a key(IDR) frame
+ *   release - callback releasing the frame reference
+ *   release_data - release callback data
+ *
+ * asserts:
+ *   release is not null
+ *
+ * returns: error code (release is not called on error)
+ */
+int encoder_add_video_frame_ref(uint8_t *frame, int size, int64_t timestamp,
+                                int isKeyframe,
+                                void (*release)(void *release_data),
+                                void *release_data) {
+  /*assertions*/
+  assert(release != NULL);
+
+  if (!video_ring_buffer)
+    return -1;
+
+  video_buffer_t *video_buff = encoder_get_free_video_buffer(timestamp);
+  if (!video_buff)
+    return -1;
+
+  video_buff->data = frame;
+  video_buff->frame_size = size;
+  video_buff->keyframe = isKeyframe;
+  video_buff->release = release;
+  video_buff->release_data = release_data;
+
+  atomic_fetch_add(&video_frame_refs, 1);
+
+  encoder_publish_video_buffer();
+
+  return 0;
+}
+
+/*
+ * get the number of input frame references held by the video ring buffer
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: number of frame references not yet released
+ */
+int encoder_get_video_frame_refs() { return atomic_load(&video_frame_refs); }
+
+/*
+ * wait for a video frame in the ring buffer
+ * args:
+ *   timeout - maximum wait time (in ms)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 1 if a frame is available, 0 on timeout
+ */
+int encoder_wait_video_buffer(int timeout) {
+  if (!video_ring_buffer)
+    return 0;
+
+  if (atomic_load_explicit(&video_write_count, memory_order_acquire) !=
+      atomic_load_explicit(&video_read_count, memory_order_relaxed))
+    return 1;
+
+  if (video_ring_event_fd < 0) {
+    /*no event: fall back to a short sleep*/
+    struct timespec req = {.tv_sec = 0, .tv_nsec = 1000000}; /*nanosec*/
+    nanosleep(&req, NULL);
+  } else {
+    /*
+     * announce the wait and check again: the producer either sees
+     * the flag and signals or published the frame before the check
+     */
+    atomic_store(&video_consumer_waiting, 1);
+
+    if (atomic_load(&video_write_count) ==
+        atomic_load_explicit(&video_read_count, memory_order_relaxed)) {
+      struct pollfd pfd = {.fd = video_ring_event_fd, .events = POLLIN};
+      if (poll(&pfd, 1, timeout) > 0) {
+        uint64_t count = 0;
+        if (read(video_ring_event_fd, &count, sizeof(uint64_t)) < 0 &&
+            errno != EAGAIN)
+          fprintf(stderr, "ENCODER: couldn't read video ring event: %s\n",
+                  strerror(errno));
+      }
+    }
+
+    atomic_store(&video_consumer_waiting, 0);
+  }
+
+  return (atomic_load_explicit(&video_write_count, memory_order_acquire) !=
+          atomic_load_explicit(&video_read_count, memory_order_relaxed));
+}
+
 /*
  * process next video frame on the ring buffer (encode and mux to file)
  * args:
@@ -1282,37 +1472,40 @@ int encoder_process_next_video_buffer(encoder_context_t *encoder_ctx) {
   /*assertions*/
   assert(encoder_ctx != NULL);
 
-  __LOCK_MUTEX(__PMUTEX);
-
-  int flag = video_ring_buffer[video_read_index].flag;
-
-  __UNLOCK_MUTEX(__PMUTEX);
-
-  if (flag == VIDEO_BUFF_FREE)
+  /*we are the only consumer: relaxed load of our own counter*/
+  uint64_t read_count =
+      atomic_load_explicit(&video_read_count, memory_order_relaxed);
+  /*acquire: the frame data is visible*/
+  if (read_count ==
+      atomic_load_explicit(&video_write_count, memory_order_acquire))
     return 1; /*all done*/
 
+  video_buffer_t *video_buff =
+      &video_ring_buffer[read_count % video_ring_buffer_size];
+
   /*timestamp is zero indexed*/
-  encoder_ctx->enc_video_ctx->pts =
-      video_ring_buffer[video_read_index].timestamp;
+  encoder_ctx->enc_video_ctx->pts = video_buff->timestamp;
 
   /*raw (direct input)*/
   if (encoder_ctx->video_codec_ind == 0) {
     /*outbuf_coded_size must already be set*/
-    encoder_ctx->enc_video_ctx->outbuf_coded_size =
-        video_ring_buffer[video_read_index].frame_size;
-    if (video_ring_buffer[video_read_index].keyframe)
+    encoder_ctx->enc_video_ctx->outbuf_coded_size = video_buff->frame_size;
+    if (video_buff->keyframe)
       encoder_ctx->enc_video_ctx->flags |= AV_PKT_FLAG_KEY;
   }
 
-  encoder_encode_video(encoder_ctx, video_ring_buffer[video_read_index].frame);
+  encoder_encode_video(encoder_ctx, video_buff->data);
 
-  /*mux the frame*/
-  __LOCK_MUTEX(__PMUTEX);
-
-  video_ring_buffer[video_read_index].flag = VIDEO_BUFF_FREE;
-  NEXT_IND(video_read_index, video_ring_buffer_size);
+  /*done with the input frame: drop the reference*/
+  if (video_buff->release) {
+    video_buff->release(video_buff->release_data);
+    video_buff->release = NULL;
+    atomic_fetch_sub(&video_frame_refs, 1);
+  }
 
-  __UNLOCK_MUTEX(__PMUTEX);
+  /*release the slot to the producer*/
+  atomic_store_explicit(&video_read_count, read_count + 1,
+                        memory_order_release);
 
   return 0;
 }
@@ -1331,27 +1524,16 @@ int encoder_flush_video_buffer(encoder_context_t *encoder_ctx) {
   /*assertions*/
   assert(encoder_ctx != NULL);
 
-  __LOCK_MUTEX(__PMUTEX);
-  int flag = video_ring_buffer[video_read_index].flag;
-  __UNLOCK_MUTEX(__PMUTEX);
-
   int buffer_count = video_ring_buffer_size;
   int flushed_frame_counter = buffer_count;
 
   if (enc_verbosity > 1)
     printf("ENCODER: flushing video buffer with %i frames\n", buffer_count);
 
-  while (flag != VIDEO_BUFF_FREE && buffer_count > 0) {
+  while (buffer_count > 0 &&
+         encoder_process_next_video_buffer(encoder_ctx) == 0)
     buffer_count--;
 
-    encoder_process_next_video_buffer(encoder_ctx);
-
-    /*get next buffer flag*/
-    __LOCK_MUTEX(__PMUTEX);
-    flag = video_ring_buffer[video_read_index].flag;
-    __UNLOCK_MUTEX(__PMUTEX);
-  }
-
   if (enc_verbosity > 1)
     printf("ENCODER: processed remaining %i video frames\n",
            flushed_frame_counter - buffer_count);
@@ -1610,15 +1792,6 @@ int encoder_encode_video(encoder_context_t *encoder_ctx, void *input_frame) {
     }
     /*outbuf_coded_size must already be set*/
     outsize = enc_video_ctx->outbuf_coded_size;
-    if (outsize > enc_video_ctx->outbuf_size) {
-      enc_video_ctx->outbuf_size = outsize;
-      if (enc_video_ctx->outbuf)
-        free(enc_video_ctx->outbuf);
-      enc_video_ctx->outbuf =
-          calloc(enc_video_ctx->outbuf_size, sizeof(uint8_t));
-    }
-    memcpy(enc_video_ctx->outbuf, input_frame, outsize);
-    enc_video_ctx->flags = 0;
     /*enc_video_ctx->flags must be set*/
     enc_video_ctx->dts = AV_NOPTS_VALUE;
 
@@ -1627,6 +1800,10 @@ int encoder_encode_video(encoder_context_t *encoder_ctx, void *input_frame) {
 
     enc_video_ctx->duration = enc_video_ctx->pts - last_video_pts;
     last_video_pts = enc_video_ctx->pts;
+
+    /*mux straight from the input frame (no copy to outbuf)*/
+    encoder_write_video_packet(encoder_ctx, input_frame, outsize);
+    enc_video_ctx->flags = 0;
     return (outsize);
   }
 
@@ -1637,6 +1814,12 @@ int encoder_encode_video(encoder_context_t *encoder_ctx, void *input_frame) {
     prepare_video_frame(video_codec_data, input_frame, encoder_ctx->video_width,
                         encoder_ctx->video_height);
 
+  /*force a key frame to cut the current file segment*/
+  if (input_frame != NULL)
+    video_codec_data->frame->pict_type =
+        encoder_muxer_segment_key_request(encoder_ctx) ? AV_PICTURE_TYPE_I
+                                                       : AV_PICTURE_TYPE_NONE;
+
   if (!enc_video_ctx
            ->monotonic_pts) // generate a real pts based on the frame timestamp
   {
@@ -2060,7 +2243,7 @@ void encoder_close(encoder_context_t *encoder_ctx) {
 
   video_ring_buffer_size = 0;
   video_ring_buffer = NULL;
-  video_read_index = 0;
-  video_write_index = 0;
+  atomic_store(&video_read_count, 0);
+  atomic_store(&video_write_count, 0);
   video_scheduler = 0;
 }
@@ -39,6 +39,8 @@
 #include <libavutil/avutil.h>
 #endif
 
+#include "gviewencoder.h"
+
 #define LIBAVCODEC_VER_AT_LEAST(major,minor)  (LIBAVCODEC_VERSION_MAJOR > major || \
                                               (LIBAVCODEC_VERSION_MAJOR == major && \
                                                LIBAVCODEC_VERSION_MINOR >= minor))
@@ -119,10 +121,6 @@
 #define MS_FORMAT_WMA9			(0x0163)
 #define MS_FORMAT_WMA9_PRO		(0x0162)
 
-/*video buffer flags*/
-#define VIDEO_BUFF_FREE    (0)
-#define VIDEO_BUFF_USED    (1)
-
 /*
  * codec data struct used for encoder context
  * we set all avcodec stuff here so that we don't
@@ -201,6 +199,20 @@ int avpriv_split_xiph_headers(
  */
 void prepare_video_frame(encoder_codec_data_t *encoder_ctx, uint8_t *inp, int width, int height);
 
+/*
+ * mux a video packet
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *   data - packet data
+ *   size - packet size (in bytes)
+ *
+ * asserts:
+ *   encoder_ctx is not null;
+ *
+ * returns: error code
+ */
+int encoder_write_video_packet(encoder_context_t *encoder_ctx, uint8_t *data, int size);
+
 
 /*
  * returns the real codec array index
@@ -19,6 +19,10 @@
 #                                                                               #
 ********************************************************************************/
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /*O_DIRECT*/
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <sys/types.h>
@@ -35,32 +39,833 @@
 #include "file_io.h"
 #include "gview.h"
 
+#if HAS_LIBURING
+#include <liburing.h>
+#endif
+
+
+/*file writer mode for new writers*/
+static int io_mode = ENCODER_IO_SYNC;
+
+/*
+ * open file writers and stats of the files closed since the last time
+ * no file was open (e.g. the previous segments of a recording);
+ * guards the per writer stats and reserved space too
+ */
+static io_writer_t *file_writers = NULL;
+static encoder_io_stats_t closed_stats;
+static __MUTEX_TYPE stats_mutex = __STATIC_MUTEX_INIT;
+
+/*preallocation extent for new file writers (0 - disabled)*/
+static int64_t prealloc_step = 0;
+
+/*
+ * reserve file space (without changing the file size) up to end,
+ * in steps of prealloc step
+ * args:
+ *   fd - file descriptor
+ *   reserved - pointer to the reserved file end (updated)
+ *   step - pointer to the preallocation step (set to 0 on error)
+ *   end - file end after the next write
+ *   unused - pointer to the writer reserved space not yet written (updated)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void io_preallocate(int fd, int64_t *reserved, int64_t *step, int64_t end,
+	int64_t *unused)
+{
+	if(*step <= 0)
+		return;
+
+	if(end > *reserved)
+	{
+		int64_t new_reserved = *reserved;
+		while(new_reserved < end)
+			new_reserved += *step;
+
+		/*
+		 * no emulation (posix_fallocate writes zeros if the file system
+		 * has no fallocate): just stop preallocating on any error
+		 */
+		if(fallocate(fd, FALLOC_FL_KEEP_SIZE, *reserved, new_reserved - *reserved) < 0)
+		{
+			fprintf(stderr, "ENCODER: (io_preallocate) file preallocation failed (%s): disabled\n",
+				strerror(errno));
+			*step = 0;
+			new_reserved = *reserved;
+		}
+
+		*reserved = new_reserved;
+	}
+
+	__LOCK_MUTEX(&stats_mutex);
+	*unused = (*reserved > end) ? (*reserved - end) : 0;
+	__UNLOCK_MUTEX(&stats_mutex);
+}
+
+/*
+ * release the preallocated space past the file end (on close)
+ * args:
+ *   fd - file descriptor
+ *   reserved - preallocated file end
+ *   size - file size
+ *   unused - pointer to the writer reserved space not yet written (cleared)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void io_release_reserved(int fd, int64_t reserved, int64_t size, int64_t *unused)
+{
+	/*truncating to the current size frees the blocks past it*/
+	if(reserved > size && ftruncate(fd, (off_t) size) < 0)
+		fprintf(stderr, "ENCODER: (io_release_reserved) file truncate failed: %s\n",
+			strerror(errno));
+
+	__LOCK_MUTEX(&stats_mutex);
+	*unused = 0;
+	__UNLOCK_MUTEX(&stats_mutex);
+}
+
+/*
+ * add the stats of a writer to a stats total
+ * args:
+ *   total - pointer to stats total
+ *   stats - pointer to writer stats
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void io_add_stats(encoder_io_stats_t *total, const encoder_io_stats_t *stats)
+{
+	total->queue_depth += stats->queue_depth;
+	if(stats->max_queue_depth > total->max_queue_depth)
+		total->max_queue_depth = stats->max_queue_depth;
+	total->bytes_in_flight += stats->bytes_in_flight;
+	if(stats->max_bytes_in_flight > total->max_bytes_in_flight)
+		total->max_bytes_in_flight = stats->max_bytes_in_flight;
+	total->bytes_written += stats->bytes_written;
+	total->stalls += stats->stalls;
+}
+
+/*
+ * add a file writer to the open writers list
+ *   (the closed files stats restart if no other file is open)
+ * args:
+ *   writer - pointer to io_writer
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void io_register_writer(io_writer_t *writer)
+{
+	__LOCK_MUTEX(&stats_mutex);
+	if(file_writers == NULL)
+		memset(&closed_stats, 0, sizeof(encoder_io_stats_t));
+	writer->next = file_writers;
+	file_writers = writer;
+	__UNLOCK_MUTEX(&stats_mutex);
+}
 
 /*
- * get the file position pointer
+ * remove a (closed) file writer from the open writers list
+ *   and add its stats to the closed files stats
  * args:
  *   writer - pointer to io_writer
  *
  * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void io_unregister_writer(io_writer_t *writer)
+{
+	__LOCK_MUTEX(&stats_mutex);
+	io_writer_t **link = &file_writers;
+	while(*link != NULL && *link != writer)
+		link = &(*link)->next;
+	if(*link != NULL)
+	{
+		*link = writer->next;
+		io_add_stats(&closed_stats, &writer->stats);
+	}
+	writer->next = NULL;
+	__UNLOCK_MUTEX(&stats_mutex);
+}
+
+/*
+ * write data straight to the file (empty mem buffer)
+ * args:
+ *   writer - pointer to io_writer
+ *   buf - data buffer to write
+ *   size - size of buffer
+ *
+ * asserts:
  *   writer is not null
  *
- * returns: the file position pointer
+ * returns: error code
  */
-static int64_t io_tell(io_writer_t *writer)
+static int io_write_file(io_writer_t *writer, uint8_t *buf, size_t size)
 {
 	/*assertions*/
 	assert(writer != NULL);
 
-	if(writer->fp == NULL)
+	int64_t end = writer->position + size;
+	io_preallocate(fileno(writer->fp), &writer->reserved, &writer->prealloc_step,
+		(end > writer->size) ? end : writer->size, &writer->reserved_unused);
+
+	if(fwrite(buf, 1, size, writer->fp) < size)
 	{
-		fprintf(stderr, "ENCODER: (io_tell) no file pointer associated with io_writer (mem only ?)\n");
+		fprintf(stderr, "ENCODER: (io_write_file) file write error: %s\n", strerror(errno));
 		return -1;
 	}
-	/*flush the file buffer*/
-	fflush(writer->fp);
 
-	/*return the file pointer position*/
-	return ((int64_t) ftello(writer->fp));
+	writer->position += size;
+	if(writer->position > writer->size)
+		writer->size = writer->position;
+
+	return 0;
+}
+
+typedef struct _io_block_t
+{
+	uint8_t *data;  /*aligned buffer (writer buffer size)*/
+	size_t size;    /*data size*/
+	int64_t offset; /*file offset*/
+} io_block_t;
+
+struct _io_async_t
+{
+	io_writer_t *writer; /*owner (stats and reserved space accounting)*/
+
+	int mode;      /*ENCODER_IO_THREAD, ENCODER_IO_DIRECT or ENCODER_IO_URING*/
+	int fd;        /*file descriptor*/
+	int direct_fd; /*O_DIRECT file descriptor (-1 if not used)*/
+
+	int64_t file_end;      /*end of written data (I/O thread)*/
+	int64_t prealloc_step; /*preallocation step (0 - disabled)*/
+	int64_t reserved;      /*preallocated file end*/
+
+	io_block_t blocks[IO_ASYNC_QUEUE_SIZE];
+	int queue[IO_ASYNC_QUEUE_SIZE]; /*block indexes waiting to be written (FIFO)*/
+	int queue_head;
+	int queue_count;
+	int free_blocks[IO_ASYNC_QUEUE_SIZE]; /*block indexes free for the writer*/
+	int free_count;
+	int current; /*block index used as writer buffer*/
+
+	int stop;  /*set to 1 to stop the I/O thread (after the queue drains)*/
+	int error; /*set to 1 on write errors*/
+
+	__THREAD_TYPE thread;
+	__MUTEX_TYPE mutex;
+	__COND_TYPE cond; /*signals queue changes*/
+
+#if HAS_LIBURING
+	struct io_uring ring;
+#endif
+};
+
+/*
+ * write the whole buffer at offset (retries on short writes)
+ * args:
+ *   fd - file descriptor
+ *   buf - data buffer to write
+ *   size - size of buffer
+ *   offset - file offset
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code (errno is set on error)
+ */
+static int io_pwrite_all(int fd, uint8_t *buf, size_t size, int64_t offset)
+{
+	while(size > 0)
+	{
+		ssize_t ret = pwrite(fd, buf, size, (off_t) offset);
+		if(ret < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		buf += ret;
+		size -= ret;
+		offset += ret;
+	}
+
+	return 0;
+}
+
+/*
+ * update the file end and preallocate space for a block (I/O thread)
+ * args:
+ *   async - pointer to async writer
+ *   block - pointer to block
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void io_async_reserve(io_async_t *async, io_block_t *block)
+{
+	int64_t end = block->offset + (int64_t) block->size;
+	if(end > async->file_end)
+		async->file_end = end;
+
+	io_preallocate(async->fd, &async->reserved, &async->prealloc_step, async->file_end,
+		&async->writer->reserved_unused);
+}
+
+/*
+ * write a block to file (I/O thread)
+ *   with O_DIRECT the aligned part of the block goes through the direct
+ *   descriptor and the unaligned head and tail through the buffered one
+ * args:
+ *   async - pointer to async writer
+ *   block - pointer to block
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+static int io_async_write_block(io_async_t *async, io_block_t *block)
+{
+	uint8_t *data = block->data;
+	size_t size = block->size;
+	int64_t offset = block->offset;
+
+	io_async_reserve(async, block);
+
+	if(async->direct_fd >= 0)
+	{
+		/*unaligned head (e.g. after a partial flush or a header fix-up)*/
+		size_t head = (IO_DIRECT_ALIGN - (offset % IO_DIRECT_ALIGN)) % IO_DIRECT_ALIGN;
+		if(head > size)
+			head = size;
+
+		if(head > 0)
+		{
+			if(io_pwrite_all(async->fd, data, head, offset) < 0)
+				return -1;
+			size -= head;
+			offset += head;
+			/*realign the remaining data with the (aligned) block buffer*/
+			if(size > 0)
+				memmove(block->data, data + head, size);
+		}
+
+		size_t body = size - (size % IO_DIRECT_ALIGN);
+		if(body > 0)
+		{
+			if(io_pwrite_all(async->direct_fd, data, body, offset) < 0)
+			{
+				if(errno != EINVAL)
+					return -1;
+
+				/*file system doesn't support O_DIRECT for this write*/
+				fprintf(stderr, "ENCODER: (io_async) O_DIRECT write failed: using buffered writes\n");
+				close(async->direct_fd);
+				async->direct_fd = -1;
+				return io_pwrite_all(async->fd, data, size, offset);
+			}
+			data += body;
+			size -= body;
+			offset += body;
+		}
+	}
+
+	/*unaligned tail (or the whole block)*/
+	if(size > 0)
+		return io_pwrite_all(async->fd, data, size, offset);
+
+	return 0;
+}
+
+#if HAS_LIBURING
+/*
+ * write a batch of queued blocks with io_uring (I/O thread)
+ *   blocks overlapping a block still in flight (e.g. header fix-ups)
+ *   wait for the previous writes to complete
+ * args:
+ *   async - pointer to async writer
+ *   first - queue index of first block
+ *   count - number of blocks
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+static int io_async_write_uring(io_async_t *async, int first, int count)
+{
+	io_block_t *inflight[IO_ASYNC_QUEUE_SIZE];
+	int ninflight = 0;
+	int ret = 0;
+	int i = 0;
+
+	for(i = 0; i <= count; ++i)
+	{
+		io_block_t *block = NULL;
+		int overlap = 0;
+
+		if(i < count)
+		{
+			block = &async->blocks[async->queue[(first + i) % IO_ASYNC_QUEUE_SIZE]];
+
+			int j = 0;
+			for(j = 0; j < ninflight; ++j)
+				if(block->offset < inflight[j]->offset + (int64_t) inflight[j]->size &&
+					inflight[j]->offset < block->offset + (int64_t) block->size)
+					overlap = 1;
+		}
+
+		/*submit and wait for the blocks in flight*/
+		if(ninflight > 0 && (block == NULL || overlap))
+		{
+			io_uring_submit(&async->ring);
+
+			while(ninflight > 0)
+			{
+				struct io_uring_cqe *cqe = NULL;
+				if(io_uring_wait_cqe(&async->ring, &cqe) < 0)
+					return -1;
+
+				io_block_t *done = (io_block_t *) io_uring_cqe_get_data(cqe);
+				int res = cqe->res;
+				io_uring_cqe_seen(&async->ring, cqe);
+				ninflight--;
+
+				if(res < 0)
+				{
+					errno = -res;
+					ret = -1;
+				}
+				else if((size_t) res < done->size) /*short write: finish it here*/
+					ret |= io_pwrite_all(async->fd, done->data + res,
+						done->size - res, done->offset + res);
+			}
+		}
+
+		if(block == NULL)
+			break;
+
+		struct io_uring_sqe *sqe = io_uring_get_sqe(&async->ring);
+		if(sqe == NULL) /*should never happen (ring has a slot per block)*/
+		{
+			ret |= io_async_write_block(async, block);
+			continue;
+		}
+		io_async_reserve(async, block);
+		io_uring_prep_write(sqe, async->fd, block->data, block->size, block->offset);
+		io_uring_sqe_set_data(sqe, block);
+		inflight[ninflight++] = block;
+	}
+
+	return ret;
+}
+#endif
+
+/*
+ * I/O thread loop: writes the queued blocks in order
+ * args:
+ *   data - pointer to async writer
+ *
+ * asserts:
+ *   none
+ *
+ * returns: NULL
+ */
+static void *io_async_loop(void *data)
+{
+	io_async_t *async = (io_async_t *) data;
+
+	__LOCK_MUTEX(&async->mutex);
+	while(1)
+	{
+		while(async->queue_count == 0 && !async->stop)
+			__COND_WAIT(&async->cond, &async->mutex);
+
+		if(async->queue_count == 0)
+			break; /*stopped and drained*/
+
+		/*write every queued block (the writer only appends to the queue)*/
+		int first = async->queue_head;
+		int count = async->queue_count;
+		__UNLOCK_MUTEX(&async->mutex);
+
+		int ret = 0;
+#if HAS_LIBURING
+		if(async->mode == ENCODER_IO_URING)
+			ret = io_async_write_uring(async, first, count);
+		else
+#endif
+		{
+			int i = 0;
+			for(i = 0; i < count; ++i)
+				ret |= io_async_write_block(async,
+					&async->blocks[async->queue[(first + i) % IO_ASYNC_QUEUE_SIZE]]);
+		}
+
+		if(ret < 0)
+			fprintf(stderr, "ENCODER: (io_async) file write error: %s\n", strerror(errno));
+
+		__LOCK_MUTEX(&async->mutex);
+		if(ret < 0)
+			async->error = 1;
+
+		int64_t written = 0;
+		int i = 0;
+		for(i = 0; i < count; ++i)
+		{
+			int ind = async->queue[(first + i) % IO_ASYNC_QUEUE_SIZE];
+			written += async->blocks[ind].size;
+			async->free_blocks[async->free_count++] = ind;
+		}
+		async->queue_head = (first + count) % IO_ASYNC_QUEUE_SIZE;
+		async->queue_count -= count;
+
+		__LOCK_MUTEX(&stats_mutex);
+		encoder_io_stats_t *stats = &async->writer->stats;
+		stats->queue_depth = async->queue_count;
+		stats->bytes_in_flight -= written;
+		stats->bytes_written += written;
+		__UNLOCK_MUTEX(&stats_mutex);
+
+		__COND_BCAST(&async->cond);
+	}
+	__UNLOCK_MUTEX(&async->mutex);
+
+	return NULL;
+}
+
+/*
+ * queue the writer buffer and get a free one (writer side)
+ *   waits for the I/O thread if all blocks are in flight
+ * args:
+ *   writer - pointer to io_writer
+ *   size - data size in the writer buffer
+ *
+ * asserts:
+ *   writer is not null
+ *   writer->async is not null
+ *
+ * returns: error code
+ */
+static int io_async_queue_buffer(io_writer_t *writer, size_t size)
+{
+	/*assertions*/
+	assert(writer != NULL);
+	assert(writer->async != NULL);
+
+	io_async_t *async = writer->async;
+
+	__LOCK_MUTEX(&async->mutex);
+
+	io_block_t *block = &async->blocks[async->current];
+	block->size = size;
+	block->offset = writer->position;
+
+	async->queue[(async->queue_head + async->queue_count) % IO_ASYNC_QUEUE_SIZE] = async->current;
+	async->queue_count++;
+
+	__LOCK_MUTEX(&stats_mutex);
+	encoder_io_stats_t *stats = &writer->stats;
+	stats->queue_depth = async->queue_count;
+	if(stats->queue_depth > stats->max_queue_depth)
+		stats->max_queue_depth = stats->queue_depth;
+	stats->bytes_in_flight += size;
+	if(stats->bytes_in_flight > stats->max_bytes_in_flight)
+		stats->max_bytes_in_flight = stats->bytes_in_flight;
+	if(async->free_count == 0)
+		stats->stalls++;
+	__UNLOCK_MUTEX(&stats_mutex);
+
+	__COND_BCAST(&async->cond);
+
+	/*back pressure: wait for a written block*/
+	while(async->free_count == 0)
+		__COND_WAIT(&async->cond, &async->mutex);
+
+	async->current = async->free_blocks[--async->free_count];
+	int error = async->error;
+
+	__UNLOCK_MUTEX(&async->mutex);
+
+	writer->buffer = async->blocks[async->current].data;
+	writer->buf_ptr = writer->buffer;
+	writer->buf_end = writer->buffer + writer->buffer_size;
+
+	writer->position += size;
+	if(writer->position > writer->size)
+		writer->size = writer->position;
+
+	return (error ? -1 : 0);
+}
+
+/*
+ * stop the I/O thread (after writing all queued blocks) and clean up
+ * args:
+ *   async - pointer to async writer
+ *
+ * asserts:
+ *   async is not null
+ *
+ * returns: none
+ */
+static void io_async_destroy(io_async_t *async)
+{
+	/*assertions*/
+	assert(async != NULL);
+
+	__LOCK_MUTEX(&async->mutex);
+	async->stop = 1;
+	__COND_BCAST(&async->cond);
+	__UNLOCK_MUTEX(&async->mutex);
+
+	__THREAD_JOIN(async->thread);
+
+	if(async->error)
+		fprintf(stderr, "ENCODER: (io_async) file write errors: file may be incomplete\n");
+
+	io_release_reserved(async->fd, async->reserved, async->file_end,
+		&async->writer->reserved_unused);
+
+#if HAS_LIBURING
+	if(async->mode == ENCODER_IO_URING)
+		io_uring_queue_exit(&async->ring);
+#endif
+
+	if(async->direct_fd >= 0)
+		close(async->direct_fd);
+	close(async->fd);
+
+	int i = 0;
+	for(i = 0; i < IO_ASYNC_QUEUE_SIZE; ++i)
+		free(async->blocks[i].data);
+
+	__CLOSE_COND(&async->cond);
+	__CLOSE_MUTEX(&async->mutex);
+
+	free(async);
+}
+
+/*
+ * open the file and start the I/O thread
+ * args:
+ *   writer - pointer to the owner io_writer
+ *   filename - file for write to
+ *   mode - ENCODER_IO_THREAD; ENCODER_IO_DIRECT; ENCODER_IO_URING
+ *   block_size - block (writer buffer) size: multiple of IO_DIRECT_ALIGN
+ *
+ * asserts:
+ *   writer is not null
+ *   filename is not null
+ *
+ * returns: pointer to async writer (NULL on error)
+ */
+static io_async_t *io_async_create(io_writer_t *writer, const char *filename,
+	int mode, int block_size)
+{
+	/*assertions*/
+	assert(writer != NULL);
+	assert(filename != NULL);
+
+	io_async_t *async = calloc(1, sizeof(io_async_t));
+	if(async == NULL)
+	{
+		fprintf(stderr, "ENCODER: FATAL memory allocation failure (io_async_create): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	async->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if(async->fd < 0)
+	{
+		fprintf(stderr, "ENCODER: Could not open file for writing: %s\n",
+			strerror(errno));
+		free(async);
+		return NULL;
+	}
+
+	async->writer = writer;
+	async->prealloc_step = prealloc_step;
+
+	async->direct_fd = -1;
+	if(mode == ENCODER_IO_DIRECT)
+	{
+		async->direct_fd = open(filename, O_WRONLY | O_DIRECT | O_CLOEXEC);
+		if(async->direct_fd < 0)
+			fprintf(stderr, "ENCODER: (io_async) O_DIRECT not supported (%s): using buffered writes\n",
+				strerror(errno));
+	}
+
+#if HAS_LIBURING
+	if(mode == ENCODER_IO_URING)
+	{
+		int ret = io_uring_queue_init(IO_ASYNC_QUEUE_SIZE, &async->ring, 0);
+		if(ret < 0)
+		{
+			fprintf(stderr, "ENCODER: (io_async) io_uring init failed (%s): using I/O thread\n",
+				strerror(-ret));
+			mode = ENCODER_IO_THREAD;
+		}
+	}
+#else
+	if(mode == ENCODER_IO_URING)
+	{
+		fprintf(stderr, "ENCODER: (io_async) io_uring support not built: using I/O thread\n");
+		mode = ENCODER_IO_THREAD;
+	}
+#endif
+	async->mode = mode;
+
+	int i = 0;
+	for(i = 0; i < IO_ASYNC_QUEUE_SIZE; ++i)
+	{
+		if(posix_memalign((void **) &async->blocks[i].data, IO_DIRECT_ALIGN, block_size) != 0)
+		{
+			fprintf(stderr, "ENCODER: FATAL memory allocation failure (io_async_create): %s\n", strerror(errno));
+			exit(-1);
+		}
+		if(i > 0)
+			async->free_blocks[async->free_count++] = i;
+	}
+	async->current = 0;
+
+	__INIT_MUTEX(&async->mutex);
+	__INIT_COND(&async->cond);
+
+	if(__THREAD_CREATE(&async->thread, io_async_loop, async))
+	{
+		fprintf(stderr, "ENCODER: (io_async) I/O thread creation failed\n");
+#if HAS_LIBURING
+		if(async->mode == ENCODER_IO_URING)
+			io_uring_queue_exit(&async->ring);
+#endif
+		if(async->direct_fd >= 0)
+			close(async->direct_fd);
+		close(async->fd);
+		for(i = 0; i < IO_ASYNC_QUEUE_SIZE; ++i)
+			free(async->blocks[i].data);
+		__CLOSE_COND(&async->cond);
+		__CLOSE_MUTEX(&async->mutex);
+		free(async);
+		return NULL;
+	}
+
+	return async;
+}
+
+/*
+ * set the file writer mode (used by writers created after the call)
+ * args:
+ *   mode - ENCODER_IO_SYNC; ENCODER_IO_THREAD; ENCODER_IO_DIRECT;
+ *          ENCODER_IO_URING
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void io_set_mode(int mode)
+{
+	if(mode < ENCODER_IO_SYNC || mode > ENCODER_IO_URING)
+	{
+		fprintf(stderr, "ENCODER: (io_set_mode) invalid mode %i: using sync writes\n", mode);
+		mode = ENCODER_IO_SYNC;
+	}
+
+	io_mode = mode;
+}
+
+/*
+ * get the file writer mode
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: file writer mode
+ */
+int io_get_mode()
+{
+	return io_mode;
+}
+
+/*
+ * set the file preallocation step (used by writers created after the call)
+ * args:
+ *   step - preallocation extent in bytes (0 - disabled)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void io_set_preallocation(int64_t step)
+{
+	prealloc_step = (step > 0) ? step : 0;
+}
+
+/*
+ * get the preallocated space not yet written by the open file writers
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: reserved space in bytes
+ */
+int64_t io_get_reserved_space()
+{
+	int64_t reserved = 0;
+
+	__LOCK_MUTEX(&stats_mutex);
+	io_writer_t *writer = file_writers;
+	for(; writer != NULL; writer = writer->next)
+		reserved += writer->reserved_unused;
+	__UNLOCK_MUTEX(&stats_mutex);
+
+	return reserved;
+}
+
+/*
+ * get the async file writer stats
+ *   (totals of the files open now and of the ones closed since
+ *    the last time no file was open - e.g. all recording segments)
+ * args:
+ *   stats - pointer to stats struct
+ *
+ * asserts:
+ *   stats is not null
+ *
+ * returns: none
+ */
+void io_get_stats(encoder_io_stats_t *stats)
+{
+	/*assertions*/
+	assert(stats != NULL);
+
+	__LOCK_MUTEX(&stats_mutex);
+	*stats = closed_stats;
+	io_writer_t *writer = file_writers;
+	for(; writer != NULL; writer = writer->next)
+		io_add_stats(stats, &writer->stats);
+	__UNLOCK_MUTEX(&stats_mutex);
 }
 
 /* flush a mem only writer(buf_writer) into a file writer
@@ -107,6 +912,30 @@ io_writer_t *io_create_writer(const char *filename, int max_size)
 	else
 		writer->buffer_size = IO_BUFFER_SIZE;
 
+	/*async writer: the buffer is one of the (aligned) queue blocks*/
+	if(filename != NULL && io_mode != ENCODER_IO_SYNC)
+	{
+		if(writer->buffer_size < IO_ASYNC_BLOCK_SIZE)
+			writer->buffer_size = IO_ASYNC_BLOCK_SIZE;
+		/*round up to the O_DIRECT alignment*/
+		writer->buffer_size = ((writer->buffer_size + IO_DIRECT_ALIGN - 1) / IO_DIRECT_ALIGN) * IO_DIRECT_ALIGN;
+
+		writer->async = io_async_create(writer, filename, io_mode, writer->buffer_size);
+		if(writer->async == NULL)
+		{
+			free(writer);
+			return NULL;
+		}
+		io_register_writer(writer);
+
+		writer->fp = NULL;
+		writer->buffer = writer->async->blocks[writer->async->current].data;
+		writer->buf_ptr = writer->buffer;
+		writer->buf_end = writer->buf_ptr + writer->buffer_size;
+
+		return writer;
+	}
+
 	writer->buffer = calloc(writer->buffer_size, sizeof(uint8_t));
 	if(writer->buffer == NULL)
 	{
@@ -127,6 +956,14 @@ io_writer_t *io_create_writer(const char *filename, int max_size)
 			free(writer);
 			return NULL;
 		}
+		/*
+		 * the mem buffer already batches the writes:
+		 * no need for a second (stdio) buffer
+		 */
+		setvbuf(writer->fp, NULL, _IONBF, 0);
+
+		writer->prealloc_step = prealloc_step;
+		io_register_writer(writer);
 	}
 	else
 		writer->fp = NULL; /*mem only writer (must be flushed to a file writer*/
@@ -149,14 +986,29 @@ void io_destroy_writer(io_writer_t *writer)
 	/*assertions*/
 	assert(writer != NULL);
 
+	if(writer->async != NULL)
+	{
+		/* flush the buffer to file*/
+		io_flush_buffer(writer);
+		/* write the queued blocks and close the file (frees the buffer)*/
+		io_async_destroy(writer->async);
+		writer->async = NULL;
+		io_unregister_writer(writer);
+		return;
+	}
+
 	if(writer->fp != NULL)
 	{
 		/* flush the buffer to file*/
 		io_flush_buffer(writer);
 		/* flush the file buffer*/
 		fflush(writer->fp);
+		/* release the preallocated space */
+		io_release_reserved(fileno(writer->fp), writer->reserved, writer->size,
+			&writer->reserved_unused);
 		/* close the file pointer */
 		fclose(writer->fp);
+		io_unregister_writer(writer);
 	}
 
 	/*clean the mem buffer*/
@@ -178,22 +1030,25 @@ int64_t io_flush_buffer(io_writer_t *writer)
 	/*assertions*/
 	assert(writer != NULL);
 
-	if(writer->fp == NULL)
+	if(writer->fp == NULL && writer->async == NULL)
 	{
 		fprintf(stderr, "ENCODER: (io_flush) no file pointer associated with writer (mem only ?)\n");
 		fprintf(stderr, "ENCODER: (io_flush) try to increase buffer size\n");
 		return -1;
 	}
 
-	size_t nitems = 0;
 	if (writer->buf_ptr > writer->buffer)
 	{
-		nitems= writer->buf_ptr - writer->buffer;
-		if(fwrite(writer->buffer, 1, nitems, writer->fp) < nitems)
+		size_t nitems = writer->buf_ptr - writer->buffer;
+		/*updates the file pointer position and size*/
+		if(writer->async != NULL)
 		{
-			fprintf(stderr, "ENCODER: (io_flush) file write error: %s\n", strerror(errno));
-			return -1;
+			/*hand the buffer to the I/O thread (resets buf_ptr)*/
+			if(io_async_queue_buffer(writer, nitems) < 0)
+				return -1;
 		}
+		else if(io_write_file(writer, writer->buffer, nitems) < 0)
+			return -1;
 	}
 	else if (writer->buf_ptr < writer->buffer)
 	{
@@ -202,21 +1057,8 @@ int64_t io_flush_buffer(io_writer_t *writer)
 		return -1;
 	}
 
-	int64_t size_inc = nitems - (writer->size - writer->position);
-	if(size_inc > 0)
-		writer->size += size_inc;
-
-	writer->position = io_tell(writer); /*update current file pointer position*/
-
 	writer->buf_ptr = writer->buffer;
 
-	/*should never happen*/
-	if(writer->position > writer->size)
-	{
-		fprintf(stderr, "ENCODER: (io_flush) file pointer ( %" PRIu64 " ) above expected file size ( %" PRIu64 " )\n", writer->position, writer->size);
-		writer->size = writer->position;
-	}
-
 	return writer->position;
 }
 
@@ -240,19 +1082,25 @@ int io_seek(io_writer_t *writer, int64_t position)
 
 	if(position <= writer->size) //position is on the file
 	{
-		if(writer->fp == NULL)
+		if(writer->fp == NULL && writer->async == NULL)
 		{
 			fprintf(stderr, "ENCODER: (io_seek) no file pointer associated with writer (mem only ?)\n");
 			return -1;
 		}
 		/*flush the memory buffer (we need an empty buffer)*/
 		io_flush_buffer(writer);
+		/*async blocks are written at their own offset: no file pointer*/
+		if(writer->async != NULL)
+		{
+			writer->position = position;
+			return 0;
+		}
 		/*try to move the file pointer to position*/
-		int ret = fseeko(writer->fp, position, SEEK_SET);
+		ret = fseeko(writer->fp, position, SEEK_SET);
 		if(ret != 0)
 			fprintf(stderr, "ENCODER: (io_seek) seek to file position %" PRIu64 "failed\n", position);
 		else
-			writer->position = io_tell(writer); /*update current file pointer position*/
+			writer->position = position; /*update current file pointer position*/
 
 		/*we are now on position with an empty memory buffer*/
 	}
@@ -261,7 +1109,8 @@ int io_seek(io_writer_t *writer, int64_t position)
 		/*move file pointer to EOF*/
 		if(writer->position != writer->size)
 		{
-			fseeko(writer->fp, writer->size, SEEK_SET);
+			if(writer->fp != NULL)
+				fseeko(writer->fp, writer->size, SEEK_SET);
 			writer->position = writer->size;
 		}
 		/*move buffer pointer to position*/
@@ -287,19 +1136,25 @@ int io_skip(io_writer_t *writer, int offset)
 	/*assertions*/
 	assert(writer != NULL);
 
-	if(writer->fp == NULL)
+	if(writer->fp == NULL && writer->async == NULL)
 	{
 		fprintf(stderr, "ENCODER: (io_skip) no file pointer associated with writer (mem only ?)\n");
 		return -1;
 	}
 	/*flush the memory buffer (clean buffer)*/
 	io_flush_buffer(writer);
+	/*async blocks are written at their own offset: no file pointer*/
+	if(writer->async != NULL)
+	{
+		writer->position += offset;
+		return 0;
+	}
 	/*try to move the file pointer to position*/
 	int ret = fseeko(writer->fp, offset, SEEK_CUR);
 	if(ret != 0)
 		fprintf(stderr, "ENCODER: (io_skip) skip file pointer by 0x%x failed\n", offset);
-
-	writer->position = io_tell(writer); //update current file pointer position
+	else
+		writer->position += offset; //update current file pointer position
 
 	/*we are on position with an empty memory buffer*/
 	return ret;
@@ -366,6 +1221,18 @@ void io_write_w8(io_writer_t *writer, uint8_t b)
  */
 void io_write_buf(io_writer_t *writer, uint8_t *buf, int size)
 {
+	/*
+	 * data as large as the buffer goes straight to the file
+	 * (no copy), after the pending buffer data (sync mode only:
+	 * async blocks must own their data)
+	 */
+	if(writer->fp != NULL && size >= writer->buffer_size)
+	{
+		if(io_flush_buffer(writer) >= 0)
+			io_write_file(writer, buf, size);
+		return;
+	}
+
 	while (size > 0)
 	{
 		int len = writer->buf_end - writer->buf_ptr;
@@ -27,13 +27,21 @@
 #include <stdio.h>
 
 #include "../config.h"
+#include "gviewencoder.h"
 
 
 #define IO_BUFFER_SIZE 32768
 
+#define IO_ASYNC_QUEUE_SIZE 8            /* blocks (buffers) per async writer */
+#define IO_ASYNC_BLOCK_SIZE (256 * 1024) /* min. block size in async modes */
+#define IO_DIRECT_ALIGN     4096         /* O_DIRECT offset/size/memory alignment */
+
+typedef struct _io_async_t io_async_t;
+
 typedef struct _io_writer_t
 {
-	FILE *fp;      /* file pointer     */
+	FILE *fp;      /* file pointer (sync mode) */
+	io_async_t *async; /* async writer (NULL in sync mode) */
 
 	uint8_t *buffer;  /* Start of the buffer. */
     int buffer_size;  /* Maximum buffer size */
@@ -41,9 +49,80 @@ typedef struct _io_writer_t
     uint8_t *buf_end; /* End of the buffer. */
 
 	int64_t size; //file size (end of file position)
-	int64_t position; //file pointer position (updates on buffer flush)
+	int64_t position; //file pointer position (tracked by the writer: no ftello)
+
+	int64_t prealloc_step; //preallocation step (sync mode: 0 - disabled)
+	int64_t reserved; //preallocated file end (sync mode)
+
+	/*per file accounting (stats_mutex in file_io.c)*/
+	encoder_io_stats_t stats; //async writer stats
+	int64_t reserved_unused; //preallocated space not yet written
+	struct _io_writer_t *next; //next open file writer
 } io_writer_t;
 
+/*
+ * set the file writer mode (used by writers created after the call)
+ * args:
+ *   mode - ENCODER_IO_SYNC; ENCODER_IO_THREAD; ENCODER_IO_DIRECT;
+ *          ENCODER_IO_URING
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void io_set_mode(int mode);
+
+/*
+ * get the file writer mode
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: file writer mode
+ */
+int io_get_mode();
+
+/*
+ * set the file preallocation step (used by writers created after the call)
+ * args:
+ *   step - preallocation extent in bytes (0 - disabled)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void io_set_preallocation(int64_t step);
+
+/*
+ * get the preallocated space not yet written by the open file writers
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: reserved space in bytes
+ */
+int64_t io_get_reserved_space();
+
+/*
+ * get the async file writer stats
+ *   (totals of the files open now and of the ones closed since
+ *    the last time no file was open - e.g. all recording segments)
+ * args:
+ *   stats - pointer to stats struct
+ *
+ * asserts:
+ *   stats is not null
+ *
+ * returns: none
+ */
+void io_get_stats(encoder_io_stats_t *stats);
+
 /*
  * create a new writer:
  * args:
@@ -53,6 +53,12 @@ __BEGIN_DECLS
 #define ENCODER_SCHED_LIN  (0)
 #define ENCODER_SCHED_EXP  (1)
 
+/*file writer modes*/
+#define ENCODER_IO_SYNC    (0) /*write on the encoder thread*/
+#define ENCODER_IO_THREAD  (1) /*write on a dedicated I/O thread*/
+#define ENCODER_IO_DIRECT  (2) /*I/O thread with O_DIRECT (aligned blocks)*/
+#define ENCODER_IO_URING   (3) /*I/O thread with io_uring (if available)*/
+
 /*audio sample format*/
 #ifndef GV_SAMPLE_TYPE_INT16
 #define GV_SAMPLE_TYPE_INT16  (0) //interleaved
@@ -63,14 +69,29 @@ __BEGIN_DECLS
 
 #define MAX_DELAYED_FRAMES 68  /*Maximum supported delayed frames*/
 
+/*file writer stats (async modes)*/
+typedef struct _encoder_io_stats_t
+{
+	int queue_depth;             /*blocks queued or being written*/
+	int max_queue_depth;         /*queue depth high-water mark*/
+	int64_t bytes_in_flight;     /*bytes queued or being written*/
+	int64_t max_bytes_in_flight; /*bytes in flight high-water mark*/
+	int64_t bytes_written;       /*bytes written to file*/
+	int stalls;                  /*times the encoder waited for a free block*/
+} encoder_io_stats_t;
+
 /*video buffer*/
 typedef struct _video_buffer_t
 {
-	uint8_t *frame;  /*uncompressed*/
+	uint8_t *frame;  /*uncompressed (input frame copy - allocated on first use)*/
 	int frame_size;
 	int64_t timestamp;
 	int keyframe;  /* 1-keyframe; 0-non keyframe (only for direct input)*/
-	int flag;      /*VIDEO_BUFF_FREE | VIDEO_BUFF_USED*/
+	int flag;      /*unused (the ring has no buffer flags) - kept for the abi*/
+	/*members below were added in api 3.0 (new members go at the end)*/
+	uint8_t *data;   /*frame data: frame or a referenced input frame*/
+	void (*release)(void *release_data); /*releases a referenced input frame (NULL for copies)*/
+	void *release_data;
 } video_buffer_t;
 
 /*video codec properties*/
@@ -361,6 +382,156 @@ void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename);
  */
 void encoder_muxer_close(encoder_context_t *encoder_ctx);
 
+/*
+ * start the muxer in pre-roll mode (no file)
+ *   encoded packets are kept in a memory ring (the last N seconds,
+ *   starting at a key frame) and written to the file opened by
+ *   the next call to encoder_muxer_init
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: 0 on success; -1 if pre-roll is disabled or failed
+ */
+int encoder_muxer_preroll_init(encoder_context_t *encoder_ctx);
+
+/*
+ * set the pre-roll (look-back) buffer (used by encoder_muxer_preroll_init)
+ * args:
+ *   seconds - pre-roll duration (0 - disabled)
+ *   mbytes - memory budget in Mbytes for encoded packets (0 - default)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_preroll(int seconds, int mbytes);
+
+/*
+ * enable file preallocation (used by files opened after the call)
+ *   the file grows in large extents (sized for the expected data rate),
+ *   the space not used is released when the file is closed
+ * args:
+ *   enable - 1 to preallocate; 0 to disable (def)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_file_preallocation(int enable);
+
+/*
+ * set the segment limits for segmented recording (used by the next recording)
+ *   a new file is started on the first key frame after a limit is reached
+ * args:
+ *   seconds - segment duration (0 - no limit)
+ *   mbytes - segment size in Mbytes (0 - no limit)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_segment_limits(int seconds, int mbytes);
+
+/*
+ * check if the next segment file should be opened
+ *   (once the current segment is close to its limit)
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: 1 if the next segment is needed (encoder_muxer_prepare_segment);
+ *          0 otherwise
+ */
+int encoder_muxer_need_segment(encoder_context_t *encoder_ctx);
+
+/*
+ * open the next segment file (and write its header) ahead of the cut
+ *   the muxer switches to it on the first key frame past the segment limit
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *   filename - next segment filename
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *   filename is not null
+ *
+ * returns: 0 on success; -1 on error (segmenting stops for this recording)
+ */
+int encoder_muxer_prepare_segment(encoder_context_t *encoder_ctx, const char *filename);
+
+/*
+ * check if a key frame should be forced to cut the current segment
+ *   (only returns 1 once per segment)
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: 1 if a key frame is needed; 0 otherwise
+ */
+int encoder_muxer_segment_key_request(encoder_context_t *encoder_ctx);
+
+/*
+ * get the number of finished segments in the current recording
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: number of segments closed by a file rollover
+ */
+int encoder_muxer_get_segment_count();
+
+/*
+ * set the file writer mode (used by files opened after the call)
+ * args:
+ *   mode - ENCODER_IO_SYNC; ENCODER_IO_THREAD; ENCODER_IO_DIRECT;
+ *          ENCODER_IO_URING
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_io_mode(int mode);
+
+/*
+ * get the file writer mode
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: file writer mode
+ */
+int encoder_get_io_mode();
+
+/*
+ * get the file writer stats (async modes)
+ *   totals of the open files and of the ones closed since the last
+ *   time no file was open: all the segments of the current (or last)
+ *   recording
+ * args:
+ *   stats - pointer to stats struct
+ *
+ * asserts:
+ *   stats is not null
+ *
+ * returns: none
+ */
+void encoder_get_io_stats(encoder_io_stats_t *stats);
+
 /*
  * get video list codec entry for codec index
  * args:
@@ -593,6 +764,51 @@ double encoder_buff_scheduler(int mode, double thresh, double max_time);
  */
 int encoder_add_video_frame(uint8_t *frame, int size, int64_t timestamp, int isKeyframe);
 
+/*
+ * store a reference to an input video frame in video ring buffer (no copy)
+ *   the frame data must stay valid (and unchanged) until release is
+ *   called from the encoder thread
+ * args:
+ *   frame - pointer to unprocessed frame data
+ *   size - frame size (in bytes)
+ *   timestamp - frame timestamp (in nanosec)
+ *   isKeyframe - flag if it's a key(IDR) frame
+ *   release - callback releasing the frame reference
+ *   release_data - release callback data
+ *
+ * asserts:
+ *   release is not null
+ *
+ * returns: error code (release is not called on error)
+ */
+int encoder_add_video_frame_ref(uint8_t *frame, int size, int64_t timestamp, int isKeyframe,
+	void (*release)(void *release_data), void *release_data);
+
+/*
+ * get the number of input frame references held by the video ring buffer
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: number of frame references not yet released
+ */
+int encoder_get_video_frame_refs();
+
+/*
+ * wait for a video frame in the ring buffer
+ *   (the encoder thread sleeps until encoder_add_video_frame signals it)
+ * args:
+ *   timeout - maximum wait time (in ms)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: 1 if a frame is available, 0 on timeout
+ */
+int encoder_wait_video_buffer(int timeout);
+
 /*
  * process next video frame on the ring buffer (encode and mux to file)
  * args:
@@ -896,7 +896,8 @@ int mkv_write_packet(mkv_context_t* mkv_ctx,
     int ret, keyframe = !!(flags & AV_PKT_FLAG_KEY);
     uint64_t ts = pts;
 
-	ts -= mkv_ctx->first_pts;
+	/*packets queued before a segment cut start the new file*/
+	ts = (ts > mkv_ctx->first_pts) ? ts - mkv_ctx->first_pts : 0;
 
     int cluster_size = io_get_offset(mkv_ctx->writer) - mkv_ctx->cluster_pos;
 
@@ -49,6 +49,8 @@
 #include "stream_io.h"
 #include "matroska.h"
 #include "avi.h"
+#include "file_io.h"
+#include "preroll.h"
 #include "gview.h"
 
 extern int enc_verbosity;
@@ -56,74 +58,495 @@ extern int enc_verbosity;
 static mkv_context_t *mkv_ctx = NULL;
 static avi_context_t *avi_ctx = NULL;
 
-static stream_io_t *video_stream = NULL;
-static stream_io_t *audio_stream = NULL;
-
 /*file mutex*/
 static __MUTEX_TYPE mutex = __STATIC_MUTEX_INIT;
 #define __PMUTEX &mutex
 
+/*file preallocation*/
+static int file_preallocation = 0;
+#define PREALLOC_MIN_STEP (16 * 1024 * 1024)  /*preallocation step limits*/
+#define PREALLOC_MAX_STEP (256 * 1024 * 1024)
+#define PREALLOC_STEP_TIME (60) /*sec of expected data per step*/
+
+/*segmented recording*/
+#define SEGMENT_PREPARE_PCT (75) /*open the next segment at 75% of the current one*/
+static int64_t segment_time = 0; /*segment duration limit in nanosec (0 - no limit)*/
+static int64_t segment_size = 0; /*segment size limit in bytes (0 - no limit)*/
+static int segment_disabled = 0; /*next segment failed: keep the current file*/
+static int segment_count = 0; /*finished segments in the current recording*/
+static int segment_key_requested = 0; /*a key frame was requested for the cut*/
+static int64_t segment_start_pts = 0; /*pts of the first frame in the segment*/
+static int64_t segment_start_frame = 0; /*frame count at the segment start*/
+/*next segment (opened ahead of the cut)*/
+static mkv_context_t *next_mkv_ctx = NULL;
+static avi_context_t *next_avi_ctx = NULL;
+static char *next_filename = NULL;
+/*finished segment (closed by the segment thread)*/
+static mkv_context_t *closing_mkv_ctx = NULL;
+static avi_context_t *closing_avi_ctx = NULL;
+static int closing_muxer_id = 0;
+static int64_t closing_frames = 0;
+static float closing_time = 0; /*ms*/
+static __THREAD_TYPE segment_thread;
+static int segment_thread_running = 0;
+
+/*pre-roll (look-back) ring*/
+#define PREROLL_DEF_BUDGET (64) /*default memory budget in Mbytes*/
+static int64_t preroll_time = 0; /*pre-roll duration in nanosec (0 - disabled)*/
+static int64_t preroll_budget = 0; /*pre-roll memory budget in bytes*/
+static preroll_ring_t *preroll_ring = NULL; /*encoded packets while no file is open*/
+
 /*
- * mux a video frame
+ * get the expected file data rate
  * args:
  *   encoder_ctx - pointer to encoder context
  *
  * asserts:
- *   encoder_ctx is not null;
+ *   encoder_ctx is not null
  *
- * returns: error code
+ * returns: expected data rate (bytes per sec)
  */
-int encoder_write_video_data(encoder_context_t *encoder_ctx)
+static int64_t encoder_expected_byte_rate(encoder_context_t *encoder_ctx)
 {
 	/*assertions*/
-	assert(encoder_ctx);
+	assert(encoder_ctx != NULL);
+
+	int64_t byte_rate = 0;
+	double fps = (encoder_ctx->fps_num > 0) ?
+		(double) encoder_ctx->fps_den / encoder_ctx->fps_num : 30;
+
+	encoder_codec_data_t *video_codec_data = (encoder_codec_data_t *) encoder_ctx->enc_video_ctx->codec_data;
+
+	if(encoder_ctx->video_codec_ind > 0 && video_codec_data &&
+		video_codec_data->codec_context->bit_rate > 0)
+		byte_rate = video_codec_data->codec_context->bit_rate / 8;
+	else
+	{
+		int64_t pixels = (int64_t) encoder_ctx->video_width * encoder_ctx->video_height;
+		switch(encoder_ctx->input_format)
+		{
+			case V4L2_PIX_FMT_MJPEG:
+			case V4L2_PIX_FMT_JPEG:
+			case V4L2_PIX_FMT_H264:
+				byte_rate = (int64_t) (pixels * fps / 4); /*~2 bits per pixel*/
+				break;
+			default:
+				byte_rate = (int64_t) (pixels * 2 * fps); /*raw: 2 bytes per pixel*/
+				break;
+		}
+	}
+
+	if(encoder_ctx->enc_audio_ctx != NULL && encoder_ctx->audio_channels > 0)
+	{
+		encoder_codec_data_t *audio_codec_data = (encoder_codec_data_t *) encoder_ctx->enc_audio_ctx->codec_data;
+		if(audio_codec_data && audio_codec_data->codec_context->bit_rate > 0)
+			byte_rate += audio_codec_data->codec_context->bit_rate / 8;
+		else
+			byte_rate += encoder_ctx->audio_channels * encoder_ctx->audio_samprate * 2;
+	}
+
+	return byte_rate;
+}
+
+/*
+ * get the current segment size (muxer mutex must be locked)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: bytes written to the current file
+ */
+static int64_t muxer_get_segment_bytes()
+{
+	if(avi_ctx != NULL)
+		return io_get_offset(avi_ctx->writer);
+	if(mkv_ctx != NULL)
+		return io_get_offset(mkv_ctx->writer);
+
+	return 0;
+}
+
+/*
+ * get the current segment progress
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *   bytes - bytes written to the current file
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: percentage of the closest segment limit (0 if not segmenting)
+ */
+static int muxer_get_segment_progress(encoder_context_t *encoder_ctx, int64_t bytes)
+{
+	/*assertions*/
+	assert(encoder_ctx != NULL);
+
+	int64_t progress = 0;
+
+	if(segment_time > 0)
+		progress = (encoder_ctx->enc_video_ctx->pts - segment_start_pts) * 100 / segment_time;
+
+	if(segment_size > 0 && bytes * 100 / segment_size > progress)
+		progress = bytes * 100 / segment_size;
+
+	return (int) progress;
+}
+
+/*
+ * close a muxer context (write the index and trailer) and free it
+ * args:
+ *   muxer_id - file muxer
+ *   avi - pointer to avi context (avi muxer)
+ *   mkv - pointer to matroska context (mkv and webm muxers)
+ *   frames - number of video frames in the file
+ *   tottime - video duration in ms
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void muxer_close_context(int muxer_id, avi_context_t *avi, mkv_context_t *mkv,
+	int64_t frames, float tottime)
+{
+	switch (muxer_id)
+	{
+		case ENCODER_MUX_AVI:
+			if (avi)
+			{
+				if (enc_verbosity > 0)
+					printf("ENCODER: (avi) time = %f\n", tottime);
+
+				if (tottime > 0)
+				{
+					/*try to find the real frame rate*/
+					avi->fps = (double) (frames * 1000) / tottime;
+				}
+
+				if (enc_verbosity > 0)
+					printf("ENCODER: (avi) %"PRId64" frames in %f ms [ %f fps]\n",
+						frames, tottime, avi->fps);
+
+				//close sound ??
+
+				avi_close(avi);
+
+				avi_destroy_context(avi);
+			}
+			break;
+
+		default:
+		case ENCODER_MUX_MKV:
+		case ENCODER_MUX_WEBM:
+			if(mkv != NULL)
+			{
+				mkv_close(mkv);
+
+				mkv_destroy_context(mkv);
+			}
+			break;
+	}
+}
+
+/*
+ * segment thread: close the finished segment
+ *   (the index and trailer writes stay off the encoder thread)
+ * args:
+ *   data - pointer to user data (not used)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to return code
+ */
+static void *muxer_segment_close_loop(void *data)
+{
+	muxer_close_context(closing_muxer_id, closing_avi_ctx, closing_mkv_ctx,
+		closing_frames, closing_time);
+
+	closing_avi_ctx = NULL;
+	closing_mkv_ctx = NULL;
+
+	return ((void *) 0);
+}
+
+/*
+ * wait for the segment thread to finish closing the last segment
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void muxer_join_segment_thread()
+{
+	if(!segment_thread_running)
+		return;
+
+	__THREAD_JOIN(segment_thread);
+	segment_thread_running = 0;
+}
+
+/*
+ * switch to the next segment (muxer mutex must be locked)
+ *   the current file is handed to the segment thread for closing
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: none
+ */
+static void muxer_start_next_segment(encoder_context_t *encoder_ctx)
+{
+	/*assertions*/
+	assert(encoder_ctx != NULL);
 
 	encoder_video_context_t *enc_video_ctx = encoder_ctx->enc_video_ctx;
-	assert(enc_video_ctx);
 
-	if(enc_video_ctx->outbuf_coded_size <= 0)
-		return -1;
+	/*only one segment is closed at a time*/
+	muxer_join_segment_thread();
 
-	enc_video_ctx->framecount++;
+	closing_muxer_id = encoder_ctx->muxer_id;
+	closing_avi_ctx = avi_ctx;
+	closing_mkv_ctx = mkv_ctx;
+	closing_frames = enc_video_ctx->framecount - segment_start_frame;
+	closing_time = (float) ((enc_video_ctx->pts - segment_start_pts) / 1000000);
 
-	int ret =0;
-	int block_align = 1;
+	avi_ctx = next_avi_ctx;
+	mkv_ctx = next_mkv_ctx;
+	next_avi_ctx = NULL;
+	next_mkv_ctx = NULL;
 
-	encoder_codec_data_t *video_codec_data = (encoder_codec_data_t *) enc_video_ctx->codec_data;
+	/*matroska time stamps start at the segment first frame*/
+	if(mkv_ctx != NULL)
+		mkv_ctx->first_pts = enc_video_ctx->pts;
 
-	if(video_codec_data)
-		block_align = video_codec_data->codec_context->block_align;
+	segment_start_pts = enc_video_ctx->pts;
+	segment_start_frame = enc_video_ctx->framecount;
+	segment_key_requested = 0;
+	segment_count++;
 
-	__LOCK_MUTEX( __PMUTEX );
-	switch (encoder_ctx->muxer_id)
+	if(enc_verbosity > 0)
+		printf("ENCODER: starting segment %i (%s)\n", segment_count, next_filename);
+
+	free(next_filename);
+	next_filename = NULL;
+
+	int ret = __THREAD_CREATE(&segment_thread, muxer_segment_close_loop, NULL);
+	if(ret)
+	{
+		fprintf(stderr, "ENCODER: segment thread creation failed (%i): closing segment in place\n", ret);
+		muxer_segment_close_loop(NULL);
+	}
+	else
+		segment_thread_running = 1;
+}
+
+/*
+ * write a packet to the current file (muxer mutex must be locked)
+ * args:
+ *   muxer_id - file muxer
+ *   stream_index - packet stream (0 - video; 1 - audio)
+ *   data - packet data
+ *   size - packet size
+ *   dts - packet dts (avi)
+ *   pts - packet pts (matroska)
+ *   duration - packet duration (matroska)
+ *   block_align - packet block align (avi)
+ *   flags - packet flags
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code
+ */
+static int muxer_write_packet(int muxer_id, int stream_index, uint8_t *data, int size,
+	int64_t dts, int64_t pts, int duration, int block_align, int flags)
+{
+	int ret = 0;
+
+	switch (muxer_id)
 	{
 		case ENCODER_MUX_AVI:
 			ret = avi_write_packet(
 					avi_ctx,
-					0,
-					enc_video_ctx->outbuf,
-					enc_video_ctx->outbuf_coded_size,
-					enc_video_ctx->dts,
+					stream_index,
+					data,
+					size,
+					dts,
 					block_align,
-					enc_video_ctx->flags);
+					flags);
 			break;
 
 		case ENCODER_MUX_MKV:
 		case ENCODER_MUX_WEBM:
 			ret = mkv_write_packet(
 					mkv_ctx,
-					0,
-					enc_video_ctx->outbuf,
-					enc_video_ctx->outbuf_coded_size,
-					enc_video_ctx->duration,
-					enc_video_ctx->pts,
-					enc_video_ctx->flags);
+					stream_index,
+					data,
+					size,
+					duration,
+					pts,
+					flags);
 			break;
 
 		default:
 
 			break;
 	}
+
+	return ret;
+}
+
+/*
+ * seed the new file with the pre-roll packets (muxer mutex must be locked)
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: none
+ */
+static void muxer_write_preroll(encoder_context_t *encoder_ctx)
+{
+	/*assertions*/
+	assert(encoder_ctx != NULL);
+
+	preroll_packet_t *first = preroll_get_packet(preroll_ring, 0);
+	if(first == NULL)
+		return;
+
+	/*the ring starts at a video key frame*/
+	int64_t start_pts = first->pts;
+	int64_t frames = 0;
+
+	if(mkv_ctx != NULL)
+		mkv_ctx->first_pts = start_pts;
+
+	int i = 0;
+	preroll_packet_t *packet = NULL;
+	while((packet = preroll_get_packet(preroll_ring, i++)) != NULL)
+	{
+		/*audio captured before the first key frame*/
+		if(packet->stream_index != 0 && packet->pts < start_pts)
+			continue;
+
+		if(packet->stream_index == 0)
+			frames++;
+
+		muxer_write_packet(encoder_ctx->muxer_id,
+			packet->stream_index,
+			preroll_get_packet_data(preroll_ring, packet),
+			packet->size,
+			packet->dts,
+			packet->pts,
+			packet->duration,
+			packet->block_align,
+			packet->flags);
+	}
+
+	if(enc_verbosity > 0)
+		printf("ENCODER: (preroll) %" PRId64 " frames (%" PRId64 " ms) written from the pre-roll ring\n",
+			frames, (encoder_ctx->enc_video_ctx->pts - start_pts) / 1000000);
+
+	/*the file starts at the first pre-roll frame*/
+	encoder_ctx->enc_video_ctx->framecount += frames;
+	segment_start_pts = start_pts;
+
+	preroll_reset(preroll_ring);
+}
+
+/*
+ * mux a video frame
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null;
+ *
+ * returns: error code
+ */
+int encoder_write_video_data(encoder_context_t *encoder_ctx)
+{
+	/*assertions*/
+	assert(encoder_ctx);
+
+	encoder_video_context_t *enc_video_ctx = encoder_ctx->enc_video_ctx;
+	assert(enc_video_ctx);
+
+	return encoder_write_video_packet(encoder_ctx,
+		enc_video_ctx->outbuf,
+		enc_video_ctx->outbuf_coded_size);
+}
+
+/*
+ * mux a video packet
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *   data - packet data
+ *   size - packet size (in bytes)
+ *
+ * asserts:
+ *   encoder_ctx is not null;
+ *
+ * returns: error code
+ */
+int encoder_write_video_packet(encoder_context_t *encoder_ctx, uint8_t *data, int size)
+{
+	/*assertions*/
+	assert(encoder_ctx);
+
+	encoder_video_context_t *enc_video_ctx = encoder_ctx->enc_video_ctx;
+	assert(enc_video_ctx);
+
+	if(size <= 0)
+		return -1;
+
+	int ret =0;
+	int block_align = 1;
+
+	encoder_codec_data_t *video_codec_data = (encoder_codec_data_t *) enc_video_ctx->codec_data;
+
+	if(video_codec_data)
+		block_align = video_codec_data->codec_context->block_align;
+
+	/*raw input other than h264 only has key frames*/
+	int keyframe = (enc_video_ctx->flags & AV_PKT_FLAG_KEY) ||
+		(encoder_ctx->video_codec_ind == 0 &&
+		 encoder_ctx->input_format != V4L2_PIX_FMT_H264);
+
+	__LOCK_MUTEX( __PMUTEX );
+	if(avi_ctx == NULL && mkv_ctx == NULL)
+	{
+		/*no file yet: keep the packet in the pre-roll ring*/
+		if(preroll_ring != NULL)
+			ret = preroll_add_packet(preroll_ring, 0, data, size,
+				enc_video_ctx->pts, enc_video_ctx->dts, enc_video_ctx->duration,
+				block_align, enc_video_ctx->flags, keyframe);
+		else
+			ret = -1;
+		__UNLOCK_MUTEX( __PMUTEX );
+		return ret;
+	}
+
+	/*cut to the next segment on a key frame*/
+	if(keyframe && (next_avi_ctx != NULL || next_mkv_ctx != NULL) &&
+		muxer_get_segment_progress(encoder_ctx, muxer_get_segment_bytes()) >= 100)
+		muxer_start_next_segment(encoder_ctx);
+
+	enc_video_ctx->framecount++;
+
+	ret = muxer_write_packet(encoder_ctx->muxer_id, 0, data, size,
+		enc_video_ctx->dts, enc_video_ctx->pts, enc_video_ctx->duration,
+		block_align, enc_video_ctx->flags);
 	__UNLOCK_MUTEX( __PMUTEX );
 
 	return (ret);
@@ -164,53 +587,45 @@ int encoder_write_audio_data(encoder_context_t *encoder_ctx)
 		block_align = audio_codec_data->codec_context->block_align;
 
 	__LOCK_MUTEX( __PMUTEX );
-	switch (encoder_ctx->muxer_id)
+	if(avi_ctx == NULL && mkv_ctx == NULL)
 	{
-		case ENCODER_MUX_AVI:
-			ret = avi_write_packet(
-					avi_ctx,
-					1,
-					enc_audio_ctx->outbuf,
-					enc_audio_ctx->outbuf_coded_size,
-					enc_audio_ctx->dts,
-					block_align,
-					enc_audio_ctx->flags);
-			break;
-
-		case ENCODER_MUX_MKV:
-		case ENCODER_MUX_WEBM:
-			ret = mkv_write_packet(
-					mkv_ctx,
-					1,
-					enc_audio_ctx->outbuf,
-					enc_audio_ctx->outbuf_coded_size,
-					enc_audio_ctx->duration,
-					enc_audio_ctx->pts,
-					enc_audio_ctx->flags);
-			break;
-
-		default:
-
-			break;
+		/*no file yet: keep the packet in the pre-roll ring*/
+		if(preroll_ring != NULL)
+			ret = preroll_add_packet(preroll_ring, 1, enc_audio_ctx->outbuf,
+				enc_audio_ctx->outbuf_coded_size, enc_audio_ctx->pts,
+				enc_audio_ctx->dts, enc_audio_ctx->duration,
+				block_align, enc_audio_ctx->flags, 0);
+		else
+			ret = -1;
+		__UNLOCK_MUTEX( __PMUTEX );
+		return ret;
 	}
+
+	ret = muxer_write_packet(encoder_ctx->muxer_id, 1,
+		enc_audio_ctx->outbuf, enc_audio_ctx->outbuf_coded_size,
+		enc_audio_ctx->dts, enc_audio_ctx->pts, enc_audio_ctx->duration,
+		block_align, enc_audio_ctx->flags);
 	__UNLOCK_MUTEX( __PMUTEX );
 
 	return (ret);
 }
 
 /*
- * initialization of the file muxer
+ * create a muxer context: open the file and write the header
  * args:
  *   encoder_ctx - pointer to encoder context
  *   filename - video filename
+ *   avi - pointer to avi context pointer (set for the avi muxer)
+ *   mkv - pointer to matroska context pointer (set for mkv and webm muxers)
  *
  * asserts:
  *   encoder_ctx is not null
  *   encoder_ctx->enc_video_ctx is not null
  *
- * returns: none
+ * returns: 0 on success; -1 if the file could not be created
  */
-void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename)
+static int muxer_create_context(encoder_context_t *encoder_ctx, const char *filename,
+	avi_context_t **avi, mkv_context_t **mkv)
 {
 	/*assertions*/
 	assert(encoder_ctx != NULL);
@@ -234,22 +649,21 @@ void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename)
 		video_codec_id = video_codec_data->codec_context->codec_id;
 	}
 
-	if(enc_verbosity > 1)
-		printf("ENCODER: initializing muxer(%i)\n", encoder_ctx->muxer_id);
+	avi_context_t *new_avi_ctx = NULL;
+	mkv_context_t *new_mkv_ctx = NULL;
+	stream_io_t *video_stream = NULL;
+	stream_io_t *audio_stream = NULL;
 
 	switch (encoder_ctx->muxer_id)
 	{
 		case ENCODER_MUX_AVI:
-			if(avi_ctx != NULL)
-			{
-				avi_destroy_context(avi_ctx);
-				avi_ctx = NULL;
-			}
-			avi_ctx = avi_create_context(filename);
+			new_avi_ctx = avi_create_context(filename);
+			if(new_avi_ctx == NULL)
+				return -1;
 
 			/*add video stream*/
 			video_stream = avi_add_video_stream(
-				avi_ctx,
+				new_avi_ctx,
 				encoder_ctx->video_width,
 				encoder_ctx->video_height,
 				encoder_ctx->fps_den,
@@ -276,7 +690,7 @@ void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename)
 					int32_t b_rate = encoder_get_audio_bit_rate(acodec_ind);
 
 					audio_stream = avi_add_audio_stream(
-						avi_ctx,
+						new_avi_ctx,
 						encoder_ctx->audio_channels,
 						encoder_ctx->audio_samprate,
 						a_bits,
@@ -293,23 +707,23 @@ void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename)
 			}
 
 			/* add first riff header */
-			avi_add_new_riff(avi_ctx);
+			avi_add_new_riff(new_avi_ctx);
 
 			break;
 
 		default:
 		case ENCODER_MUX_MKV:
 		case ENCODER_MUX_WEBM:
-			if(mkv_ctx != NULL)
+			new_mkv_ctx = mkv_create_context(filename, encoder_ctx->muxer_id);
+			if(new_mkv_ctx->writer == NULL)
 			{
-				mkv_destroy_context(mkv_ctx);
-				mkv_ctx = NULL;
+				mkv_destroy_context(new_mkv_ctx);
+				return -1;
 			}
-			mkv_ctx = mkv_create_context(filename, encoder_ctx->muxer_id);
 
 			/*add video stream*/
 			video_stream = mkv_add_video_stream(
-				mkv_ctx,
+				new_mkv_ctx,
 				encoder_ctx->video_width,
 				encoder_ctx->video_height,
 				encoder_ctx->fps_den,
@@ -332,7 +746,7 @@ void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename)
 				encoder_codec_data_t *audio_codec_data = (encoder_codec_data_t *) encoder_ctx->enc_audio_ctx->codec_data;
 				if(audio_codec_data)
 				{
-					mkv_ctx->audio_frame_size = audio_codec_data->codec_context->frame_size;
+					new_mkv_ctx->audio_frame_size = audio_codec_data->codec_context->frame_size;
 
 					/*sample size - only used for PCM*/
 					int32_t a_bits = encoder_get_audio_bits(encoder_ctx->audio_codec_ind);
@@ -340,7 +754,7 @@ void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename)
 					int32_t b_rate = encoder_get_audio_bit_rate(encoder_ctx->audio_codec_ind);
 
 					audio_stream = mkv_add_audio_stream(
-						mkv_ctx,
+						new_mkv_ctx,
 						encoder_ctx->audio_channels,
 						encoder_ctx->audio_samprate,
 						a_bits,
@@ -356,11 +770,121 @@ void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename)
 			}
 
 			/* write the file header */
-			mkv_write_header(mkv_ctx);
+			mkv_write_header(new_mkv_ctx);
 
 			break;
 
 	}
+
+	*avi = new_avi_ctx;
+	*mkv = new_mkv_ctx;
+
+	return 0;
+}
+
+/*
+ * initialization of the file muxer
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *   filename - video filename
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *   encoder_ctx->enc_video_ctx is not null
+ *
+ * returns: none
+ */
+void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename)
+{
+	/*assertions*/
+	assert(encoder_ctx != NULL);
+	assert(encoder_ctx->enc_video_ctx != NULL);
+
+	if(enc_verbosity > 1)
+		printf("ENCODER: initializing muxer(%i)\n", encoder_ctx->muxer_id);
+
+	/*preallocate the file in extents sized for the expected data rate*/
+	int64_t prealloc_step = 0;
+	if(file_preallocation)
+	{
+		prealloc_step = encoder_expected_byte_rate(encoder_ctx) * PREALLOC_STEP_TIME;
+		/*round up to the min step*/
+		prealloc_step = ((prealloc_step + PREALLOC_MIN_STEP - 1) / PREALLOC_MIN_STEP) * PREALLOC_MIN_STEP;
+		if(prealloc_step < PREALLOC_MIN_STEP)
+			prealloc_step = PREALLOC_MIN_STEP;
+		if(prealloc_step > PREALLOC_MAX_STEP)
+			prealloc_step = PREALLOC_MAX_STEP;
+
+		if(enc_verbosity > 0)
+			printf("ENCODER: preallocating file in %" PRId64 " MB steps\n", prealloc_step / (1024 * 1024));
+	}
+
+	/*a segment may end past its size limit (cut on a key frame)*/
+	if(segment_size > 0 && prealloc_step > segment_size)
+		prealloc_step = ((segment_size + PREALLOC_MIN_STEP - 1) / PREALLOC_MIN_STEP) * PREALLOC_MIN_STEP;
+	io_set_preallocation(prealloc_step);
+
+	if(avi_ctx != NULL)
+	{
+		avi_destroy_context(avi_ctx);
+		avi_ctx = NULL;
+	}
+	if(mkv_ctx != NULL)
+	{
+		mkv_destroy_context(mkv_ctx);
+		mkv_ctx = NULL;
+	}
+
+	segment_disabled = 0;
+	segment_count = 0;
+	segment_key_requested = 0;
+	segment_start_pts = 0;
+	segment_start_frame = 0;
+
+	__LOCK_MUTEX( __PMUTEX );
+	if(muxer_create_context(encoder_ctx, filename, &avi_ctx, &mkv_ctx) < 0)
+		fprintf(stderr, "ENCODER: couldn't create the video file %s\n", filename);
+	else if(preroll_ring != NULL)
+		muxer_write_preroll(encoder_ctx);
+
+	/*the ring is only filled while there is no file*/
+	preroll_destroy(preroll_ring);
+	preroll_ring = NULL;
+	__UNLOCK_MUTEX( __PMUTEX );
+}
+
+/*
+ * start the muxer in pre-roll mode (no file)
+ *   encoded packets are kept in a memory ring (the last N seconds,
+ *   starting at a key frame) and written to the file opened by
+ *   the next call to encoder_muxer_init
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: 0 on success; -1 if pre-roll is disabled or failed
+ */
+int encoder_muxer_preroll_init(encoder_context_t *encoder_ctx)
+{
+	/*assertions*/
+	assert(encoder_ctx != NULL);
+
+	if(preroll_time <= 0)
+		return -1;
+
+	__LOCK_MUTEX( __PMUTEX );
+	preroll_destroy(preroll_ring);
+	preroll_ring = preroll_create(preroll_budget, preroll_time);
+	int ret = (preroll_ring != NULL) ? 0 : -1;
+	__UNLOCK_MUTEX( __PMUTEX );
+
+	if(enc_verbosity > 0 && ret == 0)
+		printf("ENCODER: (preroll) keeping %" PRId64 " sec in %" PRId64 " Mbytes\n",
+			(int64_t) (preroll_time / NSEC_PER_SEC), preroll_budget / (1024 * 1024));
+
+	return ret;
 }
 
 /*
@@ -375,48 +899,271 @@ void encoder_muxer_init(encoder_context_t *encoder_ctx, const char *filename)
  */
 void encoder_muxer_close(encoder_context_t *encoder_ctx)
 {
-	switch (encoder_ctx->muxer_id)
+	encoder_video_context_t *enc_video_ctx = encoder_ctx->enc_video_ctx;
+
+	/*wait for the last finished segment*/
+	muxer_join_segment_thread();
+
+	/*frames and time (ms) since the segment start*/
+	int64_t frames = enc_video_ctx->framecount - segment_start_frame;
+	float tottime = (float) ((int64_t) (enc_video_ctx->pts - segment_start_pts) / 1000000);
+
+	muxer_close_context(encoder_ctx->muxer_id, avi_ctx, mkv_ctx, frames, tottime);
+	avi_ctx = NULL;
+	mkv_ctx = NULL;
+
+	/*pre-roll ring (no file was opened)*/
+	__LOCK_MUTEX( __PMUTEX );
+	preroll_destroy(preroll_ring);
+	preroll_ring = NULL;
+	__UNLOCK_MUTEX( __PMUTEX );
+
+	/*discard the next segment if it was already opened*/
+	if(next_avi_ctx != NULL)
 	{
-		case ENCODER_MUX_AVI:
-			if (avi_ctx)
-			{
-				/*last frame pts*/
-				float tottime = (float) ((int64_t) (encoder_ctx->enc_video_ctx->pts) / 1000000); // convert to miliseconds
+		avi_destroy_context(next_avi_ctx);
+		next_avi_ctx = NULL;
+	}
+	if(next_mkv_ctx != NULL)
+	{
+		mkv_destroy_context(next_mkv_ctx);
+		next_mkv_ctx = NULL;
+	}
+	if(next_filename != NULL)
+	{
+		unlink(next_filename);
+		free(next_filename);
+		next_filename = NULL;
+	}
 
-				if (enc_verbosity > 0)
-					printf("ENCODER: (avi) time = %f\n", tottime);
+	if(enc_verbosity > 0 && io_get_mode() != ENCODER_IO_SYNC)
+	{
+		encoder_io_stats_t stats;
+		io_get_stats(&stats);
+		printf("ENCODER: (io) %" PRId64 " bytes written: max queue depth %i (%" PRId64 " bytes in flight), %i stalls\n",
+			stats.bytes_written, stats.max_queue_depth, stats.max_bytes_in_flight, stats.stalls);
+	}
+}
 
-				if (tottime > 0)
-				{
-					/*try to find the real frame rate*/
-					avi_ctx->fps = (double) (encoder_ctx->enc_video_ctx->framecount * 1000) / tottime;
-				}
+/*
+ * enable file preallocation (used by files opened after the call)
+ *   the file grows in large extents (sized for the expected data rate),
+ *   the space not used is released when the file is closed
+ * args:
+ *   enable - 1 to preallocate; 0 to disable (def)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_file_preallocation(int enable)
+{
+	file_preallocation = enable ? 1 : 0;
+}
 
-				if (enc_verbosity > 0)
-					printf("ENCODER: (avi) %"PRId64" frames in %f ms [ %f fps]\n",
-						encoder_ctx->enc_video_ctx->framecount, tottime, avi_ctx->fps);
+/*
+ * set the segment limits for segmented recording (used by the next recording)
+ *   a new file is started on the first key frame after a limit is reached
+ * args:
+ *   seconds - segment duration (0 - no limit)
+ *   mbytes - segment size in Mbytes (0 - no limit)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_segment_limits(int seconds, int mbytes)
+{
+	segment_time = (seconds > 0) ? (int64_t) seconds * NSEC_PER_SEC : 0;
+	segment_size = (mbytes > 0) ? (int64_t) mbytes * 1024 * 1024 : 0;
+}
 
-				//close sound ??
+/*
+ * set the pre-roll (look-back) buffer (used by encoder_muxer_preroll_init)
+ * args:
+ *   seconds - pre-roll duration (0 - disabled)
+ *   mbytes - memory budget in Mbytes for encoded packets (0 - default)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_preroll(int seconds, int mbytes)
+{
+	preroll_time = (seconds > 0) ? (int64_t) seconds * NSEC_PER_SEC : 0;
+	preroll_budget = (int64_t) ((mbytes > 0) ? mbytes : PREROLL_DEF_BUDGET) * 1024 * 1024;
+}
 
-				avi_close(avi_ctx);
+/*
+ * check if the next segment file should be opened
+ *   (once the current segment is close to its limit)
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: 1 if the next segment is needed (encoder_muxer_prepare_segment);
+ *          0 otherwise
+ */
+int encoder_muxer_need_segment(encoder_context_t *encoder_ctx)
+{
+	/*assertions*/
+	assert(encoder_ctx != NULL);
 
-				avi_destroy_context(avi_ctx);
-				avi_ctx = NULL;
-			}
-			break;
+	if((segment_time <= 0 && segment_size <= 0) || segment_disabled)
+		return 0;
 
-		default:
-		case ENCODER_MUX_MKV:
-		case ENCODER_MUX_WEBM:
-			if(mkv_ctx != NULL)
-			{
-				mkv_close(mkv_ctx);
+	__LOCK_MUTEX( __PMUTEX );
+	int need = (next_avi_ctx == NULL && next_mkv_ctx == NULL &&
+		(avi_ctx != NULL || mkv_ctx != NULL) &&
+		muxer_get_segment_progress(encoder_ctx, muxer_get_segment_bytes()) >= SEGMENT_PREPARE_PCT);
+	__UNLOCK_MUTEX( __PMUTEX );
 
-				mkv_destroy_context(mkv_ctx);
-				mkv_ctx = NULL;
-			}
-			break;
+	return need;
+}
+
+/*
+ * open the next segment file (and write its header) ahead of the cut
+ *   the muxer switches to it on the first key frame past the segment limit
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *   filename - next segment filename
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *   filename is not null
+ *
+ * returns: 0 on success; -1 on error (segmenting stops for this recording)
+ */
+int encoder_muxer_prepare_segment(encoder_context_t *encoder_ctx, const char *filename)
+{
+	/*assertions*/
+	assert(encoder_ctx != NULL);
+	assert(filename != NULL);
+
+	avi_context_t *new_avi_ctx = NULL;
+	mkv_context_t *new_mkv_ctx = NULL;
+
+	if(muxer_create_context(encoder_ctx, filename, &new_avi_ctx, &new_mkv_ctx) < 0)
+	{
+		fprintf(stderr, "ENCODER: couldn't create the next segment %s: keeping the current file\n", filename);
+		segment_disabled = 1;
+		return -1;
 	}
+
+	if(enc_verbosity > 1)
+		printf("ENCODER: next segment ready (%s)\n", filename);
+
+	__LOCK_MUTEX( __PMUTEX );
+	next_avi_ctx = new_avi_ctx;
+	next_mkv_ctx = new_mkv_ctx;
+	free(next_filename);
+	next_filename = strdup(filename);
+	__UNLOCK_MUTEX( __PMUTEX );
+
+	return 0;
+}
+
+/*
+ * check if a key frame should be forced to cut the current segment
+ *   (only returns 1 once per segment)
+ * args:
+ *   encoder_ctx - pointer to encoder context
+ *
+ * asserts:
+ *   encoder_ctx is not null
+ *
+ * returns: 1 if a key frame is needed; 0 otherwise
+ */
+int encoder_muxer_segment_key_request(encoder_context_t *encoder_ctx)
+{
+	/*assertions*/
+	assert(encoder_ctx != NULL);
+
+	if((segment_time <= 0 && segment_size <= 0) || segment_disabled)
+		return 0;
+
+	__LOCK_MUTEX( __PMUTEX );
+	int request = (!segment_key_requested &&
+		(next_avi_ctx != NULL || next_mkv_ctx != NULL) &&
+		muxer_get_segment_progress(encoder_ctx, muxer_get_segment_bytes()) >= 100);
+	if(request)
+		segment_key_requested = 1;
+	__UNLOCK_MUTEX( __PMUTEX );
+
+	return request;
+}
+
+/*
+ * get the number of finished segments in the current recording
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: number of segments closed by a file rollover
+ */
+int encoder_muxer_get_segment_count()
+{
+	__LOCK_MUTEX( __PMUTEX );
+	int count = segment_count;
+	__UNLOCK_MUTEX( __PMUTEX );
+
+	return count;
+}
+
+/*
+ * set the file writer mode (used by files opened after the call)
+ * args:
+ *   mode - ENCODER_IO_SYNC; ENCODER_IO_THREAD; ENCODER_IO_DIRECT;
+ *          ENCODER_IO_URING
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void encoder_set_io_mode(int mode)
+{
+	io_set_mode(mode);
+}
+
+/*
+ * get the file writer mode
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: file writer mode
+ */
+int encoder_get_io_mode()
+{
+	return io_get_mode();
+}
+
+/*
+ * get the file writer stats (async modes)
+ *   totals of the open files and of the ones closed since the last
+ *   time no file was open: all the segments of the current (or last)
+ *   recording
+ * args:
+ *   stats - pointer to stats struct
+ *
+ * asserts:
+ *   stats is not null
+ *
+ * returns: none
+ */
+void encoder_get_io_stats(encoder_io_stats_t *stats)
+{
+	io_get_stats(stats);
 }
 
 /*
@@ -449,6 +1196,8 @@ int encoder_disk_supervisor(int treshold, const char *path)
 
     total_kbytes= buf.f_blocks * (buf.f_bsize/1024);
     free_kbytes= buf.f_bavail * (buf.f_bsize/1024);
+    /*space preallocated for the open files is still free for them*/
+    free_kbytes += io_get_reserved_space() / 1024;
 
     if(total_kbytes > 0)
         percent = (int) ((1.0f-((float)free_kbytes/(float)total_kbytes))*100.0f);
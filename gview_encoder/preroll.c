@@ -0,0 +1,347 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "preroll.h"
+#include "gview.h"
+
+#define PREROLL_MIN_PACKETS 256 /*initial packet ring size (grows as needed)*/
+
+extern int enc_verbosity;
+
+/*
+ * create a pre-roll ring of encoded packets
+ * args:
+ *   budget - memory budget for packet data (bytes)
+ *   duration - time to keep (nanosec)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to pre-roll ring (NULL on error)
+ */
+preroll_ring_t *preroll_create(int64_t budget, int64_t duration)
+{
+	if(budget <= 0 || duration <= 0)
+		return NULL;
+
+	preroll_ring_t *ring = calloc(1, sizeof(preroll_ring_t));
+	if(ring == NULL)
+	{
+		fprintf(stderr, "ENCODER: FATAL memory allocation failure (preroll_create): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	ring->data = malloc(budget);
+	if(ring->data == NULL)
+	{
+		fprintf(stderr, "ENCODER: (preroll) couldn't allocate %" PRId64 " bytes: %s\n",
+			budget, strerror(errno));
+		free(ring);
+		return NULL;
+	}
+	ring->data_size = budget;
+
+	ring->max_packets = PREROLL_MIN_PACKETS;
+	ring->packets = calloc(ring->max_packets, sizeof(preroll_packet_t));
+	if(ring->packets == NULL)
+	{
+		fprintf(stderr, "ENCODER: FATAL memory allocation failure (preroll_create): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	ring->duration = duration;
+
+	return ring;
+}
+
+/*
+ * destroy the pre-roll ring
+ * args:
+ *   ring - pointer to pre-roll ring
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void preroll_destroy(preroll_ring_t *ring)
+{
+	if(ring == NULL)
+		return;
+
+	free(ring->packets);
+	free(ring->data);
+	free(ring);
+}
+
+/*
+ * drop all packets in the ring
+ * args:
+ *   ring - pointer to pre-roll ring
+ *
+ * asserts:
+ *   ring is not null
+ *
+ * returns: none
+ */
+void preroll_reset(preroll_ring_t *ring)
+{
+	/*assertions*/
+	assert(ring != NULL);
+
+	ring->first = 0;
+	ring->count = 0;
+	ring->write_pos = 0;
+	ring->last_pts = 0;
+}
+
+/*
+ * drop the oldest GOP (and any packets before the next key frame)
+ * args:
+ *   ring - pointer to pre-roll ring
+ *
+ * asserts:
+ *   ring is not null
+ *
+ * returns: none
+ */
+static void preroll_drop_gop(preroll_ring_t *ring)
+{
+	/*assertions*/
+	assert(ring != NULL);
+
+	do
+	{
+		ring->first = (ring->first + 1) % ring->max_packets;
+		ring->count--;
+	}
+	while(ring->count > 0 &&
+		!(ring->packets[ring->first].stream_index == 0 &&
+		  ring->packets[ring->first].keyframe));
+
+	if(ring->count == 0)
+		ring->write_pos = 0;
+}
+
+/*
+ * get the data offset for a new packet
+ * args:
+ *   ring - pointer to pre-roll ring
+ *   size - packet size
+ *
+ * asserts:
+ *   ring is not null
+ *
+ * returns: data offset (-1 if there is no free space)
+ */
+static int64_t preroll_get_data_offset(preroll_ring_t *ring, int size)
+{
+	/*assertions*/
+	assert(ring != NULL);
+
+	if(ring->count == 0)
+		return (size <= ring->data_size) ? 0 : -1;
+
+	int64_t oldest = ring->packets[ring->first].offset;
+
+	if(ring->write_pos > oldest)
+	{
+		/*free space at the end, then at the start of the buffer*/
+		if(ring->write_pos + size <= ring->data_size)
+			return ring->write_pos;
+		if(size <= oldest)
+			return 0;
+	}
+	else if(ring->write_pos + size <= oldest) /*wrapped*/
+		return ring->write_pos;
+
+	return -1;
+}
+
+/*
+ * add an encoded packet to the ring
+ *   the oldest GOPs are dropped to stay within the time window
+ *   and memory budget: the ring always starts at a video key frame
+ * args:
+ *   ring - pointer to pre-roll ring
+ *   stream_index - packet stream (0 - video; 1 - audio)
+ *   data - packet data
+ *   size - packet size
+ *   pts - packet pts
+ *   dts - packet dts
+ *   duration - packet duration
+ *   block_align - packet block align
+ *   flags - packet flags
+ *   keyframe - flag if the (video) packet starts a GOP
+ *
+ * asserts:
+ *   ring is not null
+ *
+ * returns: 0 if the packet was stored; -1 if it was dropped
+ */
+int preroll_add_packet(preroll_ring_t *ring,
+	int stream_index,
+	uint8_t *data,
+	int size,
+	int64_t pts,
+	int64_t dts,
+	int duration,
+	int block_align,
+	int flags,
+	int keyframe)
+{
+	/*assertions*/
+	assert(ring != NULL);
+
+	if(size <= 0)
+		return -1;
+
+	keyframe = (stream_index == 0 && keyframe);
+
+	/*the ring must start with a key frame*/
+	if(ring->count == 0 && !keyframe)
+		return -1;
+
+	if(stream_index == 0)
+	{
+		ring->last_pts = pts;
+
+		/*drop GOPs that are older than needed to cover the time window*/
+		if(keyframe)
+		{
+			int i = 0;
+			for(i = 1; i < ring->count; i++)
+			{
+				preroll_packet_t *packet = &ring->packets[(ring->first + i) % ring->max_packets];
+				if(packet->stream_index != 0 || !packet->keyframe)
+					continue;
+				if(pts - packet->pts < ring->duration)
+					break;
+
+				/*the next GOP still covers the window*/
+				preroll_drop_gop(ring);
+				i = 0;
+			}
+		}
+	}
+
+	/*drop the oldest GOPs until the packet fits in the memory budget*/
+	int64_t offset = preroll_get_data_offset(ring, size);
+	while(offset < 0 && ring->count > 0)
+	{
+		preroll_drop_gop(ring);
+		offset = preroll_get_data_offset(ring, size);
+	}
+
+	if(offset < 0 || (ring->count == 0 && !keyframe))
+	{
+		if(enc_verbosity > 1)
+			printf("ENCODER: (preroll) memory budget too small for a GOP: dropping packet\n");
+		return -1;
+	}
+
+	/*grow the packet ring*/
+	if(ring->count == ring->max_packets)
+	{
+		int max_packets = ring->max_packets * 2;
+		preroll_packet_t *packets = calloc(max_packets, sizeof(preroll_packet_t));
+		if(packets == NULL)
+		{
+			fprintf(stderr, "ENCODER: FATAL memory allocation failure (preroll_add_packet): %s\n", strerror(errno));
+			exit(-1);
+		}
+
+		int i = 0;
+		for(i = 0; i < ring->count; i++)
+			packets[i] = ring->packets[(ring->first + i) % ring->max_packets];
+
+		free(ring->packets);
+		ring->packets = packets;
+		ring->max_packets = max_packets;
+		ring->first = 0;
+	}
+
+	preroll_packet_t *packet = &ring->packets[(ring->first + ring->count) % ring->max_packets];
+	packet->stream_index = stream_index;
+	packet->offset = offset;
+	packet->size = size;
+	packet->pts = pts;
+	packet->dts = dts;
+	packet->duration = duration;
+	packet->block_align = block_align;
+	packet->flags = flags;
+	packet->keyframe = keyframe;
+
+	memcpy(ring->data + offset, data, size);
+	ring->write_pos = offset + size;
+	ring->count++;
+
+	return 0;
+}
+
+/*
+ * get a packet from the ring
+ * args:
+ *   ring - pointer to pre-roll ring
+ *   index - packet index (0 - oldest)
+ *
+ * asserts:
+ *   ring is not null
+ *
+ * returns: pointer to packet (NULL if index is out of range)
+ */
+preroll_packet_t *preroll_get_packet(preroll_ring_t *ring, int index)
+{
+	/*assertions*/
+	assert(ring != NULL);
+
+	if(index < 0 || index >= ring->count)
+		return NULL;
+
+	return &ring->packets[(ring->first + index) % ring->max_packets];
+}
+
+/*
+ * get the packet data
+ * args:
+ *   ring - pointer to pre-roll ring
+ *   packet - pointer to packet (from preroll_get_packet)
+ *
+ * asserts:
+ *   ring is not null
+ *   packet is not null
+ *
+ * returns: pointer to packet data
+ */
+uint8_t *preroll_get_packet_data(preroll_ring_t *ring, preroll_packet_t *packet)
+{
+	/*assertions*/
+	assert(ring != NULL);
+	assert(packet != NULL);
+
+	return ring->data + packet->offset;
+}
@@ -0,0 +1,152 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#ifndef PREROLL_H
+#define PREROLL_H
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+typedef struct _preroll_packet_t
+{
+	int stream_index; /*0 - video; 1 - audio*/
+	int64_t offset;   /*packet data offset in the ring data buffer*/
+	int size;         /*packet size in bytes*/
+	int64_t pts;
+	int64_t dts;
+	int duration;
+	int block_align;
+	int flags;        /*packet flags (as muxed)*/
+	int keyframe;     /*flag if the (video) packet starts a GOP*/
+} preroll_packet_t;
+
+typedef struct _preroll_ring_t
+{
+	uint8_t *data;        /*packet data (size of the memory budget)*/
+	int64_t data_size;
+	int64_t write_pos;    /*end of the newest packet data*/
+
+	preroll_packet_t *packets; /*packet ring (oldest at first)*/
+	int max_packets;
+	int first;
+	int count;
+
+	int64_t duration;     /*time window to keep (nanosec)*/
+	int64_t last_pts;     /*pts of the newest video packet*/
+} preroll_ring_t;
+
+/*
+ * create a pre-roll ring of encoded packets
+ * args:
+ *   budget - memory budget for packet data (bytes)
+ *   duration - time to keep (nanosec)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: pointer to pre-roll ring (NULL on error)
+ */
+preroll_ring_t *preroll_create(int64_t budget, int64_t duration);
+
+/*
+ * destroy the pre-roll ring
+ * args:
+ *   ring - pointer to pre-roll ring
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void preroll_destroy(preroll_ring_t *ring);
+
+/*
+ * drop all packets in the ring
+ * args:
+ *   ring - pointer to pre-roll ring
+ *
+ * asserts:
+ *   ring is not null
+ *
+ * returns: none
+ */
+void preroll_reset(preroll_ring_t *ring);
+
+/*
+ * add an encoded packet to the ring
+ *   the oldest GOPs are dropped to stay within the time window
+ *   and memory budget: the ring always starts at a video key frame
+ * args:
+ *   ring - pointer to pre-roll ring
+ *   stream_index - packet stream (0 - video; 1 - audio)
+ *   data - packet data
+ *   size - packet size
+ *   pts - packet pts
+ *   dts - packet dts
+ *   duration - packet duration
+ *   block_align - packet block align
+ *   flags - packet flags
+ *   keyframe - flag if the (video) packet starts a GOP
+ *
+ * asserts:
+ *   ring is not null
+ *
+ * returns: 0 if the packet was stored; -1 if it was dropped
+ */
+int preroll_add_packet(preroll_ring_t *ring,
+	int stream_index,
+	uint8_t *data,
+	int size,
+	int64_t pts,
+	int64_t dts,
+	int duration,
+	int block_align,
+	int flags,
+	int keyframe);
+
+/*
+ * get a packet from the ring
+ * args:
+ *   ring - pointer to pre-roll ring
+ *   index - packet index (0 - oldest)
+ *
+ * asserts:
+ *   ring is not null
+ *
+ * returns: pointer to packet (NULL if index is out of range)
+ */
+preroll_packet_t *preroll_get_packet(preroll_ring_t *ring, int index);
+
+/*
+ * get the packet data
+ * args:
+ *   ring - pointer to pre-roll ring
+ *   packet - pointer to packet (from preroll_get_packet)
+ *
+ * asserts:
+ *   ring is not null
+ *   packet is not null
+ *
+ * returns: pointer to packet data
+ */
+uint8_t *preroll_get_packet_data(preroll_ring_t *ring, preroll_packet_t *packet);
+
+#endif
@@ -169,6 +169,43 @@ void render_set_crosshair_size(int size);
  */
 int render_get_crosshair_size();
 
+/*
+ * set the yuv color encoding for the rgb conversion
+ * args:
+ *   matrix - color matrix (YUV_MATRIX_XXX from gviewv4l2core.h)
+ *   range - quantization range (YUV_RANGE_XXX from gviewv4l2core.h)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void render_set_yuv_color_encoding(int matrix, int range);
+
+/*
+ * get the yuv color matrix for the rgb conversion
+ * args:
+ *   none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: color matrix (YUV_MATRIX_XXX from gviewv4l2core.h)
+ */
+int render_get_yuv_matrix();
+
+/*
+ * get the yuv quantization range for the rgb conversion
+ * args:
+ *   none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: quantization range (YUV_RANGE_XXX from gviewv4l2core.h)
+ */
+int render_get_yuv_range();
+
 /*
  * get render width
  * args:
@@ -65,6 +65,9 @@ static uint32_t my_osd_mask = REND_OSD_NONE;
 static uint32_t my_crosshair_color_rgb = 0x0000FF00;
 static int my_crosshair_size = 24;
 
+static int my_yuv_matrix = 0; /*YUV_MATRIX_BT601*/
+static int my_yuv_range = 0; /*YUV_RANGE_FULL*/
+
 static float osd_vu_level[2] = {0, 0};
 
 static render_events_t render_events_list[] =
@@ -221,6 +224,53 @@ int render_get_crosshair_size()
 {
 	return (my_crosshair_size);
 }
+
+/*
+ * set the yuv color encoding for the rgb conversion
+ * args:
+ *   matrix - color matrix (YUV_MATRIX_XXX from gviewv4l2core.h)
+ *   range - quantization range (YUV_RANGE_XXX from gviewv4l2core.h)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void render_set_yuv_color_encoding(int matrix, int range)
+{
+	my_yuv_matrix = matrix;
+	my_yuv_range = range;
+}
+
+/*
+ * get the yuv color matrix for the rgb conversion
+ * args:
+ *   none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: color matrix (YUV_MATRIX_XXX from gviewv4l2core.h)
+ */
+int render_get_yuv_matrix()
+{
+	return (my_yuv_matrix);
+}
+
+/*
+ * get the yuv quantization range for the rgb conversion
+ * args:
+ *   none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: quantization range (YUV_RANGE_XXX from gviewv4l2core.h)
+ */
+int render_get_yuv_range()
+{
+	return (my_yuv_range);
+}
 /*
  * set the vu level for the osd vu meter
  * args:
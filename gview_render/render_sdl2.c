@@ -28,6 +28,7 @@
 #include <math.h>
 
 #include "gview.h"
+#include "gviewv4l2core.h"
 #include "gviewrender.h"
 #include "render.h"
 #include "render_sdl2.h"
@@ -221,6 +222,19 @@ static int video_init(int width, int height, int flags, int win_w, int win_h)
 	SDL_RenderSetLogicalSize(main_renderer, width, height);
 	SDL_SetRenderDrawBlendMode(main_renderer, SDL_BLENDMODE_NONE);
 
+#if SDL_VERSION_ATLEAST(2,0,8)
+	/*
+	 * match the yuv color encoding of the software conversions
+	 * (SDL has no full range BT.709 mode - use the limited range one)
+	 */
+	if(render_get_yuv_matrix() == YUV_MATRIX_BT709)
+		SDL_SetYUVConversionMode(SDL_YUV_CONVERSION_BT709);
+	else if(render_get_yuv_range() == YUV_RANGE_LIMITED)
+		SDL_SetYUVConversionMode(SDL_YUV_CONVERSION_BT601);
+	else
+		SDL_SetYUVConversionMode(SDL_YUV_CONVERSION_JPEG);
+#endif
+
     rending_texture = SDL_CreateTexture(main_renderer,
 		SDL_PIXELFORMAT_IYUV,  /*yuv420p*/
 		SDL_TEXTUREACCESS_STREAMING,
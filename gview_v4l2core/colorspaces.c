@@ -27,6 +27,9 @@
 #include <assert.h>
 
 #include "gview.h"
+#include "gviewv4l2core.h"
+#include "colorspaces.h"
+#include "colorspaces_simd.h"
 #include "../config.h"
 
 extern int verbosity;
@@ -194,18 +197,36 @@ static void convert_border_bayer_line_to_bgr24( uint8_t* bayer, uint8_t* adjacen
 
 /*
  * From libdc1394, which on turn was based on OpenCV's Bayer decoding
+ *  only the lines in [line_start, line_end) are rendered to bgr
+ *  (neighbour lines are still read from the full bayer frame)
  */
 static void bayer_to_rgbbgr24(uint8_t *bayer,
 	uint8_t *bgr, int width, int height,
-	uint8_t start_with_green, uint8_t blue_line)
+	uint8_t start_with_green, uint8_t blue_line,
+	int line_start, int line_end)
 {
 	/* render the first line */
-	convert_border_bayer_line_to_bgr24(bayer, bayer + width, bgr, width,
-		start_with_green, blue_line);
-	bgr += width * 3;
+	if (line_start == 0)
+	{
+		convert_border_bayer_line_to_bgr24(bayer, bayer + width, bgr, width,
+			start_with_green, blue_line);
+		bgr += width * 3;
+	}
+
+	/* the top/bottom lines are special cases */
+	int first = (line_start > 1) ? line_start : 1;
+	int last = (line_end < height - 1) ? line_end : height - 1;
+	int line = 0;
 
-	/* reduce height by 2 because of the special case top/bottom line */
-	for (height -= 2; height; height--)
+	/* pattern phase of the first inner line */
+	if ((first - 1) & 1)
+	{
+		blue_line = !blue_line;
+		start_with_green = !start_with_green;
+	}
+	bayer += (first - 1) * width;
+
+	for (line = first; line < last; line++)
 	{
 		int t0, t1;
 		/* (width - 2) because of the border */
@@ -371,8 +392,9 @@ static void bayer_to_rgbbgr24(uint8_t *bayer,
 	}
 
 	/* render the last line */
-	convert_border_bayer_line_to_bgr24(bayer + width, bayer, bgr, width,
-		!start_with_green, !blue_line);
+	if (line_end == height)
+		convert_border_bayer_line_to_bgr24(bayer + width, bayer, bgr, width,
+			!start_with_green, !blue_line);
 }
 
 /*
@@ -390,28 +412,55 @@ static void bayer_to_rgbbgr24(uint8_t *bayer,
  * returns: none
  */
 void bayer_to_rgb24(uint8_t *pBay, uint8_t *pRGB24, int width, int height, int pix_order)
+{
+	bayer_lines_to_rgb24(pBay, pRGB24, width, height, pix_order, 0, height);
+}
+
+/*
+ * convert a range of lines of bayer raw data to rgb24
+ * args:
+ *   pBay: pointer to buffer containing Raw bayer data (full frame)
+ *   pRGB24: pointer to buffer for rgb24 data of line_start
+ *   width: picture width
+ *   height: picture height
+ *   pix_order: bayer pixel order (0=gb/rg   1=gr/bg  2=bg/gr  3=rg/bg)
+ *   line_start: first line to convert
+ *   line_end: line after the last one to convert
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void bayer_lines_to_rgb24(uint8_t *pBay, uint8_t *pRGB24, int width, int height,
+	int pix_order, int line_start, int line_end)
 {
 	switch (pix_order)
 	{
 		//conversion functions are build for bgr, by switching b and r lines we get rgb
 		case 0: /* gbgbgb... | rgrgrg... (V4L2_PIX_FMT_SGBRG8)*/
-			bayer_to_rgbbgr24(pBay, pRGB24, width, height, TRUE, FALSE);
+			bayer_to_rgbbgr24(pBay, pRGB24, width, height, TRUE, FALSE,
+				line_start, line_end);
 			break;
 
 		case 1: /* grgrgr... | bgbgbg... (V4L2_PIX_FMT_SGRBG8)*/
-			bayer_to_rgbbgr24(pBay, pRGB24, width, height, TRUE, TRUE);
+			bayer_to_rgbbgr24(pBay, pRGB24, width, height, TRUE, TRUE,
+				line_start, line_end);
 			break;
 
 		case 2: /* bgbgbg... | grgrgr... (V4L2_PIX_FMT_SBGGR8)*/
-			bayer_to_rgbbgr24(pBay, pRGB24, width, height, FALSE, FALSE);
+			bayer_to_rgbbgr24(pBay, pRGB24, width, height, FALSE, FALSE,
+				line_start, line_end);
 			break;
 
 		case 3: /* rgrgrg... ! gbgbgb... (V4L2_PIX_FMT_SRGGB8)*/
-			bayer_to_rgbbgr24(pBay, pRGB24, width, height, FALSE, TRUE);
+			bayer_to_rgbbgr24(pBay, pRGB24, width, height, FALSE, TRUE,
+				line_start, line_end);
 			break;
 
 		default: /* default is 0*/
-			bayer_to_rgbbgr24(pBay, pRGB24, width, height, TRUE, FALSE);
+			bayer_to_rgbbgr24(pBay, pRGB24, width, height, TRUE, FALSE,
+				line_start, line_end);
 			break;
 	}
 }
@@ -420,6 +469,7 @@ void bayer_to_rgb24(uint8_t *pBay, uint8_t *pRGB24, int width, int height, int p
 
 /*
  *convert from packed 422 yuv (yuyv) to 420 planar (yu12)
+ *  scalar reference implementation
  * args:
  *    out - pointer to output yu12 planar data buffer
  *    in - pointer to input yuyv packed data buffer
@@ -432,7 +482,7 @@ void bayer_to_rgb24(uint8_t *pBay, uint8_t *pRGB24, int width, int height, int p
  *
  * returns: none
  */
-void yuyv_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
+void yuyv_to_yu12_c(uint8_t *out, uint8_t *in, int width, int height)
 {
 	/*assertions*/
 	assert(in);
@@ -468,8 +518,36 @@ void yuyv_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
 
 }
 
+/*
+ *convert from packed 422 yuv (yuyv) to 420 planar (yu12)
+ *  (uses the simd kernels when supported by the cpu)
+ * args:
+ *    out - pointer to output yu12 planar data buffer
+ *    in - pointer to input yuyv packed data buffer
+ *    width - frame width
+ *    height - frame height
+ *
+ * asserts:
+ *    in is not null
+ *    out is not null
+ *
+ * returns: none
+ */
+void yuyv_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
+{
+	/*assertions*/
+	assert(in);
+	assert(out);
+
+	if(packed422_to_yu12_simd(out, in, width, height, PACKED422_YUYV))
+		return;
+
+	yuyv_to_yu12_c(out, in, width, height);
+}
+
 /*
  *convert from packed 422 yuv (yvyu) to 420 planar (yu12)
+ *  scalar reference implementation
  * args:
  *    out - pointer to output yu12 planar data buffer
  *    in - pointer to input yvyu packed data buffer
@@ -482,7 +560,7 @@ void yuyv_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
  *
  * returns: none
  */
-void yvyu_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
+void yvyu_to_yu12_c(uint8_t *out, uint8_t *in, int width, int height)
 {
 	/*assertions*/
 	assert(in);
@@ -517,8 +595,36 @@ void yvyu_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
 	}
 }
 
+/*
+ *convert from packed 422 yuv (yvyu) to 420 planar (yu12)
+ *  (uses the simd kernels when supported by the cpu)
+ * args:
+ *    out - pointer to output yu12 planar data buffer
+ *    in - pointer to input yvyu packed data buffer
+ *    width - frame width
+ *    height - frame height
+ *
+ * asserts:
+ *    in is not null
+ *    out is not null
+ *
+ * returns: none
+ */
+void yvyu_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
+{
+	/*assertions*/
+	assert(in);
+	assert(out);
+
+	if(packed422_to_yu12_simd(out, in, width, height, PACKED422_YVYU))
+		return;
+
+	yvyu_to_yu12_c(out, in, width, height);
+}
+
 /*
  *convert from packed 422 yuv (uyvy) to 420 planar (yu12)
+ *  scalar reference implementation
  * args:
  *    out - pointer to output yu12 planar data buffer
  *    in - pointer to input uyvy packed data buffer
@@ -531,7 +637,7 @@ void yvyu_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
  *
  * returns: none
  */
-void uyvy_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
+void uyvy_to_yu12_c(uint8_t *out, uint8_t *in, int width, int height)
 {
 	/*assertions*/
 	assert(in);
@@ -565,8 +671,36 @@ void uyvy_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
 	}
 }
 
+/*
+ *convert from packed 422 yuv (uyvy) to 420 planar (yu12)
+ *  (uses the simd kernels when supported by the cpu)
+ * args:
+ *    out - pointer to output yu12 planar data buffer
+ *    in - pointer to input uyvy packed data buffer
+ *    width - frame width
+ *    height - frame height
+ *
+ * asserts:
+ *    in is not null
+ *    out is not null
+ *
+ * returns: none
+ */
+void uyvy_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
+{
+	/*assertions*/
+	assert(in);
+	assert(out);
+
+	if(packed422_to_yu12_simd(out, in, width, height, PACKED422_UYVY))
+		return;
+
+	uyvy_to_yu12_c(out, in, width, height);
+}
+
 /*
  *convert from packed 422 yuv (vyuy) to 420 planar (yu12)
+ *  scalar reference implementation
  * args:
  *    out - pointer to output yu12 planar data buffer
  *    in - pointer to input vyuy packed data buffer
@@ -579,7 +713,7 @@ void uyvy_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
  *
  * returns: none
  */
-void vyuy_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
+void vyuy_to_yu12_c(uint8_t *out, uint8_t *in, int width, int height)
 {
 	/*assertions*/
 	assert(in);
@@ -615,6 +749,33 @@ void vyuy_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
 	}
 }
 
+/*
+ *convert from packed 422 yuv (vyuy) to 420 planar (yu12)
+ *  (uses the simd kernels when supported by the cpu)
+ * args:
+ *    out - pointer to output yu12 planar data buffer
+ *    in - pointer to input vyuy packed data buffer
+ *    width - frame width
+ *    height - frame height
+ *
+ * asserts:
+ *    in is not null
+ *    out is not null
+ *
+ * returns: none
+ */
+void vyuy_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
+{
+	/*assertions*/
+	assert(in);
+	assert(out);
+
+	if(packed422_to_yu12_simd(out, in, width, height, PACKED422_VYUY))
+		return;
+
+	vyuy_to_yu12_c(out, in, width, height);
+}
+
 
 /*
  *convert from 422 planar yuv to 420 planar (yu12)
@@ -665,6 +826,91 @@ void yuv422p_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
 
 }
 
+/*
+ * convert from planar yuv with line strides (e.g. a decoded libav frame)
+ *  to 420 planar (yu12) in a single pass
+ * args:
+ *    out - pointer to output yu12 planar data buffer
+ *    planes - pointers to the input y, u and v planes (u = NULL for grayscale)
+ *    linesizes - line size (stride) of each input plane
+ *    width - frame width
+ *    height - frame height
+ *    chroma_w_shift - input horizontal chroma subsampling (log2: 0 or 1)
+ *    chroma_h_shift - input vertical chroma subsampling (log2: 0 or 1)
+ *
+ * asserts:
+ *    out is not null
+ *    planes is not null
+ *    linesizes is not null
+ *
+ * returns: none
+ */
+void planar_to_yu12(uint8_t *out, uint8_t **planes, int *linesizes,
+	int width, int height, int chroma_w_shift, int chroma_h_shift)
+{
+	/*assertions*/
+	assert(out);
+	assert(planes);
+	assert(linesizes);
+
+	int w = 0, h = 0;
+	int c_width = width / 2;
+	int c_height = height / 2;
+
+	/*copy y data*/
+	uint8_t *py = out;
+	for(h = 0; h < height; h++)
+	{
+		memcpy(py, planes[0] + (h * linesizes[0]), width);
+		py += width;
+	}
+
+	uint8_t *pu = out + (width * height);
+	uint8_t *pv = pu + ((width * height) / 4);
+
+	if(planes[1] == NULL) /*grayscale*/
+	{
+		memset(pu, 0x80, (width * height) / 2);
+		return;
+	}
+
+	for(h = 0; h < c_height; h++)
+	{
+		/*first (and second) input chroma lines of this output line*/
+		uint8_t *inu1 = planes[1] + ((h << (1 - chroma_h_shift)) * linesizes[1]);
+		uint8_t *inv1 = planes[2] + ((h << (1 - chroma_h_shift)) * linesizes[2]);
+
+		if(chroma_h_shift && chroma_w_shift) /*420: just copy*/
+		{
+			memcpy(pu, inu1, c_width);
+			memcpy(pv, inv1, c_width);
+			pu += c_width;
+			pv += c_width;
+			continue;
+		}
+
+		uint8_t *inu2 = chroma_h_shift ? inu1 : inu1 + linesizes[1];
+		uint8_t *inv2 = chroma_h_shift ? inv1 : inv1 + linesizes[2];
+
+		if(chroma_w_shift) /*422: average u and v samples of two lines*/
+		{
+			for(w = 0; w < c_width; w++)
+			{
+				*pu++ = (inu1[w] + inu2[w]) / 2;
+				*pv++ = (inv1[w] + inv2[w]) / 2;
+			}
+		}
+		else /*444: average 2x2 samples*/
+		{
+			for(w = 0; w < c_width; w++)
+			{
+				*pu++ = (inu1[2*w] + inu1[2*w+1] + inu2[2*w] + inu2[2*w+1]) / 4;
+				*pv++ = (inv1[2*w] + inv1[2*w+1] + inv2[2*w] + inv2[2*w+1]) / 4;
+			}
+		}
+	}
+}
+
 /*
  * convert yyuv (packed) to yuv420 planar (yu12)
  * args:
@@ -2710,164 +2956,316 @@ void ba24_to_yu12(uint8_t *out, uint8_t *in, int width, int height)
 	}
 }
 
+/*------------------------- yu12 to rgb (fixed point) -----------------------*/
+
+/*(a * b) >> 16 - the high half of a 16 bit signed product (mulhi)*/
+#define MULHI16(a, b) (((a) * (b)) >> 16)
+
 /*
- * yu12 to rgb24
+ * fixed point yuv to rgb coefficients [matrix][range]
+ *   from Kr, Kb: v_r = 2(1-Kr), u_b = 2(1-Kb),
+ *   u_g = u_b*Kb/Kg, v_g = v_r*Kr/Kg (Kg = 1-Kr-Kb)
+ *   limited range scales luma by 255/219 and chroma by 255/224
+ *   results are within 1 of the rounded floating point formula (for
+ *   BT.601 full range within 2 of the previous double precision code,
+ *   that truncated) - checked by tests/test_yu12_rgb
+ */
+static const yuv_rgb_coef_t yuv_rgb_coef[2][2] =
+{
+	/*BT.601 (Kr = 0.299, Kb = 0.114)*/
+	{
+		{ 0, 2048, 1436, 352, 731, 1815 }, /*full range*/
+		{ 16, 2385, 1634, 401, 832, 2066 } /*limited range*/
+	},
+	/*BT.709 (Kr = 0.2126, Kb = 0.0722)*/
+	{
+		{ 0, 2048, 1613, 192, 479, 1900 }, /*full range*/
+		{ 16, 2385, 1836, 218, 546, 2163 } /*limited range*/
+	}
+};
+
+/*
+ * get the fixed point coefficients for a color encoding
  * args:
- *    out - pointer to output rgb data buffer
- *    in - pointer to input yu12 data buffer
+ *    matrix - color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ *    range - quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to coefficients (BT.601 full range for invalid values)
+ */
+static const yuv_rgb_coef_t *get_yuv_rgb_coef(int matrix, int range)
+{
+	if(matrix != YUV_MATRIX_BT709)
+		matrix = YUV_MATRIX_BT601;
+	if(range != YUV_RANGE_LIMITED)
+		range = YUV_RANGE_FULL;
+
+	return &yuv_rgb_coef[matrix][range];
+}
+
+/*
+ * scalar yu12 line to rgb (fixed point)
+ *   this is the reference for the simd kernels
+ * args:
+ *    out - pointer to output rgb line
+ *    py - pointer to input luma line
+ *    pu - pointer to input u line
+ *    pv - pointer to input v line
+ *    width - number of pixels to convert (even)
+ *    layout - output layout (RGB_LAYOUT_XXX)
+ *    coef - pointer to fixed point coefficients
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void yu12_line_to_rgb_c(uint8_t *out, const uint8_t *py,
+	const uint8_t *pu, const uint8_t *pv,
+	int width, int layout, const yuv_rgb_coef_t *coef)
+{
+	int w = 0, i = 0;
+
+	for(w = 0; w < width; w += 2)
+	{
+		int u = (*pu++ - 128) * 256;
+		int v = (*pv++ - 128) * 256;
+
+		int cr = MULHI16(v, coef->v_r);
+		int cg = MULHI16(u, coef->u_g) + MULHI16(v, coef->v_g);
+		int cb = MULHI16(u, coef->u_b);
+
+		for(i = 0; i < 2; i++) /*each chroma sample covers two pixels*/
+		{
+			int y = MULHI16((*py++ - coef->y_off) * 128, coef->y_mul);
+
+			/*round off the 2 fractional bits*/
+			uint8_t r = CLIP((y + cr + 2) >> 2);
+			uint8_t g = CLIP((y - cg + 2) >> 2);
+			uint8_t b = CLIP((y + cb + 2) >> 2);
+
+			switch(layout)
+			{
+				case RGB_LAYOUT_RGBA:
+					*out++ = r;
+					*out++ = g;
+					*out++ = b;
+					*out++ = 0xFF;
+					break;
+				case RGB_LAYOUT_BGR24:
+					*out++ = b;
+					*out++ = g;
+					*out++ = r;
+					break;
+				default:
+					*out++ = r;
+					*out++ = g;
+					*out++ = b;
+					break;
+			}
+		}
+	}
+}
+
+/*
+ * convert a range of lines of yu12 data to packed rgb
+ *   (fixed point, simd when supported by the cpu)
+ * args:
+ *    out - pointer to output rgb data buffer (for line_start)
+ *    in - pointer to input yu12 data buffer (full frame)
  *    width - buffer width (in pixels)
  *    height - buffer height (in pixels)
+ *    line_start - first line to convert
+ *    line_end - line after the last one to convert
+ *    layout - output layout (RGB_LAYOUT_XXX)
+ *    bottom_up - if set write the lines upside down (DIB)
+ *    matrix - color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ *    range - quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
  *
  * asserts:
- *    none
+ *    out is not null
+ *    in is not null
  *
  * returns: none
  */
-void yu12_to_rgb24 (uint8_t *out, uint8_t *in, int width, int height)
+static void yu12_lines_to_packed_rgb(uint8_t *out, uint8_t *in, int width, int height,
+	int line_start, int line_end, int layout, int bottom_up, int matrix, int range)
 {
 	/*assertions*/
 	assert(out);
 	assert(in);
-	
-	uint8_t *py1 = in; //line 1
-	uint8_t *py2 = py1 + width; //line 2
+
+	const yuv_rgb_coef_t *coef = get_yuv_rgb_coef(matrix, range);
+	int bpp = (layout == RGB_LAYOUT_RGBA) ? 4 : 3;
+
 	uint8_t *pu = in + (width * height);
 	uint8_t *pv = pu + ((width * height) / 4);
-	
-	uint8_t *pout1 = out; //first line
-	uint8_t *pout2 = out + (width * 3); //second line
-	
-	int h=0, w=0;
-	
-	for(h=0; h < height; h+=2) //every two lines
+
+	int h = 0;
+
+	for(h = line_start; h < line_end; h++)
 	{
-		py1 = in + (h * width);
-		py2 = py1 + width;
-		
-		pout1 = out + (h * width * 3);
-		pout2 = pout1 + (width * 3);
-		
-		for(w=0; w<width; w+=2) //every 2 pixels
-		{
-			/* standart: r = y0 + 1.402 (v-128) */
-			/* logitech: r = y0 + 1.370705 (v-128) */
-			*pout1++=CLIP(*py1 + 1.402 * (*pv-128));
-			*pout2++=CLIP(*py2 + 1.402 * (*pv-128));	
-			/* standart: g = y0 - 0.34414 (u-128) - 0.71414 (v-128)*/
-			/* logitech: g = y0 - 0.337633 (u-128)- 0.698001 (v-128)*/
-			*pout1++=CLIP(*py1 - 0.34414 * (*pu-128) -0.71414*(*pv-128));
-			*pout2++=CLIP(*py2 - 0.34414 * (*pu-128) -0.71414*(*pv-128));
-			/* standart: b = y0 + 1.772 (u-128) */
-			/* logitech: b = y0 + 1.732446 (u-128) */
-			*pout1++=CLIP(*py1 + 1.772 *( *pu-128));
-			*pout2++=CLIP(*py2 + 1.772 *( *pu-128));
-			
-			py1++;
-			py2++;
-			
-			/* standart: r1 =y1 + 1.402 (v-128) */
-			/* logitech: r1 = y1 + 1.370705 (v-128) */
-			*pout1++=CLIP(*py1 + 1.402 * (*pv-128));
-			*pout2++=CLIP(*py2 + 1.402 * (*pv-128));
-			/* standart: g1 = y1 - 0.34414 (u-128) - 0.71414 (v-128)*/
-			/* logitech: g1 = y1 - 0.337633 (u-128)- 0.698001 (v-128)*/
-			*pout1++=CLIP(*py1 - 0.34414 * (*pu-128) -0.71414 * (*pv-128));
-			*pout2++=CLIP(*py2 - 0.34414 * (*pu-128) -0.71414 * (*pv-128));
-			/* standart: b1 = y1 + 1.772 (u-128) */
-			/* logitech: b1 = y1 + 1.732446 (u-128) */
-			*pout1++=CLIP(*py1 + 1.772 * (*pu-128));
-			*pout2++=CLIP(*py2 + 1.772 * (*pu-128));
-			
-			py1++;
-			py2++;
-			pu++;
-			pv++;
-		}
+		uint8_t *py_line = in + (h * width);
+		uint8_t *pu_line = pu + ((h / 2) * (width / 2));
+		uint8_t *pv_line = pv + ((h / 2) * (width / 2));
+		uint8_t *pout = out +
+			((bottom_up ? (line_end - 1 - h) : (h - line_start)) * width * bpp);
+
+		int done = yu12_line_to_rgb_simd(pout, py_line, pu_line, pv_line,
+			width, layout, coef);
+
+		yu12_line_to_rgb_c(pout + (done * bpp), py_line + done,
+			pu_line + (done / 2), pv_line + (done / 2),
+			width - done, layout, coef);
 	}
 }
 
 /*
- * FIXME:  yu12 to bgr24 with lines upsidedown
+ * yu12 to packed rgb (fixed point, simd when supported by the cpu)
+ * args:
+ *    out - pointer to output rgb data buffer
+ *    in - pointer to input yu12 data buffer
+ *    width - buffer width (in pixels)
+ *    height - buffer height (in pixels)
+ *    layout - output layout (RGB_LAYOUT_XXX)
+ *    bottom_up - if set write the lines upside down (DIB)
+ *    matrix - color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ *    range - quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
+ *
+ * asserts:
+ *    out is not null
+ *    in is not null
+ *
+ * returns: none
+ */
+static void yu12_to_packed_rgb(uint8_t *out, uint8_t *in, int width, int height,
+	int layout, int bottom_up, int matrix, int range)
+{
+	yu12_lines_to_packed_rgb(out, in, width, height, 0, height,
+		layout, bottom_up, matrix, range);
+}
+
+/*
+ * yu12 to rgb24
+ * args:
+ *    out - pointer to output rgb data buffer
+ *    in - pointer to input yu12 data buffer
+ *    width - buffer width (in pixels)
+ *    height - buffer height (in pixels)
+ *    matrix - color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ *    range - quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
+ *
+ * asserts:
+ *    out is not null
+ *    in is not null
+ *
+ * returns: none
+ */
+void yu12_to_rgb24 (uint8_t *out, uint8_t *in, int width, int height,
+	int matrix, int range)
+{
+	yu12_to_packed_rgb(out, in, width, height,
+		RGB_LAYOUT_RGB24, FALSE, matrix, range);
+}
+
+/*
+ * convert a range of lines of yu12 data to rgb24
+ * args:
+ *    out - pointer to output rgb data buffer (for line_start)
+ *    in - pointer to input yu12 data buffer (full frame)
+ *    width - buffer width (in pixels)
+ *    height - buffer height (in pixels)
+ *    line_start - first line to convert
+ *    line_end - line after the last one to convert
+ *    matrix - color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ *    range - quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
+ *
+ * asserts:
+ *    out is not null
+ *    in is not null
+ *
+ * returns: none
+ */
+void yu12_lines_to_rgb24 (uint8_t *out, uint8_t *in, int width, int height,
+	int line_start, int line_end, int matrix, int range)
+{
+	yu12_lines_to_packed_rgb(out, in, width, height, line_start, line_end,
+		RGB_LAYOUT_RGB24, FALSE, matrix, range);
+}
+
+/*
+ * yu12 to bgr24 with lines upsidedown
  *   used for bitmap files (DIB24)
  * args:
  *    out - pointer to output bgr data buffer
  *    in - pointer to input yu12 data buffer
  *    width - buffer width (in pixels)
  *    height - buffer height (in pixels)
+ *    matrix - color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ *    range - quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
  *
  * asserts:
- *    none
+ *    out is not null
+ *    in is not null
  *
  * returns: none
  */
-void yu12_to_dib24 (uint8_t *out, uint8_t *in, int width, int height)
+void yu12_to_dib24 (uint8_t *out, uint8_t *in, int width, int height,
+	int matrix, int range)
 {
-	/*assertions*/
-	assert(out);
-	assert(in);
-	
-	uint8_t *py1 = in + (height * width) - width; //begin of last line
-	uint8_t *py2 = py1 - width; //last line -1
-	
-	uint8_t *pu = in + ((width * height * 5) / 4) - (width/2); //begin of last line
-	uint8_t *pv = pu + ((width * height) / 4); //begin of last line
-	
-	uint8_t *pout1 = out; //first line
-	uint8_t *pout2 = pout1 + (width * 3); //second line
-	
-	int h=0, w=0;
-	int uvline = height/2;
-	
-	for(h=height; h >0 ; h-=2) //every two lines
-	{
-		uvline--; //begin of uv line
-		
-		py1 = in + ((h-1) * width);
-		py2 = py1 - width;
-		
-		pu = in + (width * height) + ((uvline * width)/2);
-		pv = pu + ((width * height) / 4);
-		
-		pout1 = out + ((height-h) * width * 3);
-		pout2 = pout1 + (width * 3);
-		
-		for(w=0; w<width; w+=2) //every 2 pixels
-		{
-			/* standart: b = y0 + 1.772 (u-128) */
-			/* logitech: b = y0 + 1.732446 (u-128) */
-			*pout1++=CLIP(*py1 + 1.772 *( *pu-128));
-			*pout2++=CLIP(*py2 + 1.772 *( *pu-128));	
-			/* standart: g = y0 - 0.34414 (u-128) - 0.71414 (v-128)*/
-			/* logitech: g = y0 - 0.337633 (u-128)- 0.698001 (v-128)*/
-			*pout1++=CLIP(*py1 - 0.34414 * (*pu-128) -0.71414*(*pv-128));
-			*pout2++=CLIP(*py2 - 0.34414 * (*pu-128) -0.71414*(*pv-128));
-			/* standart: r = y0 + 1.402 (v-128) */
-			/* logitech: r = y0 + 1.370705 (v-128) */
-			*pout1++=CLIP(*py1 + 1.402 * (*pv-128));
-			*pout2++=CLIP(*py2 + 1.402 * (*pv-128));
-			
-			py1++;
-			py2++;
-			
-			/* standart: b = y0 + 1.772 (u-128) */
-			/* logitech: b = y0 + 1.732446 (u-128) */
-			*pout1++=CLIP(*py1 + 1.772 *( *pu-128));
-			*pout2++=CLIP(*py2 + 1.772 *( *pu-128));	
-			/* standart: g = y0 - 0.34414 (u-128) - 0.71414 (v-128)*/
-			/* logitech: g = y0 - 0.337633 (u-128)- 0.698001 (v-128)*/
-			*pout1++=CLIP(*py1 - 0.34414 * (*pu-128) -0.71414*(*pv-128));
-			*pout2++=CLIP(*py2 - 0.34414 * (*pu-128) -0.71414*(*pv-128));
-			/* standart: r = y0 + 1.402 (v-128) */
-			/* logitech: r = y0 + 1.370705 (v-128) */
-			*pout1++=CLIP(*py1 + 1.402 * (*pv-128));
-			*pout2++=CLIP(*py2 + 1.402 * (*pv-128));
-
-			py1++;
-			py2++;
-			pu++;
-			pv++;
-		}
-	}
+	yu12_to_packed_rgb(out, in, width, height,
+		RGB_LAYOUT_BGR24, TRUE, matrix, range);
+}
+
+/*
+ * convert a range of lines of yu12 data to bgr24 with lines upsidedown
+ *   (line_end - 1 first) used for streaming bitmap files (DIB24)
+ * args:
+ *    out - pointer to output bgr data buffer (for line_end - 1)
+ *    in - pointer to input yu12 data buffer (full frame)
+ *    width - buffer width (in pixels)
+ *    height - buffer height (in pixels)
+ *    line_start - first line to convert
+ *    line_end - line after the last one to convert
+ *    matrix - color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ *    range - quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
+ *
+ * asserts:
+ *    out is not null
+ *    in is not null
+ *
+ * returns: none
+ */
+void yu12_lines_to_dib24 (uint8_t *out, uint8_t *in, int width, int height,
+	int line_start, int line_end, int matrix, int range)
+{
+	yu12_lines_to_packed_rgb(out, in, width, height, line_start, line_end,
+		RGB_LAYOUT_BGR24, TRUE, matrix, range);
+}
+
+/*
+ * yu12 to rgba (rgb32, alpha set to 255)
+ * args:
+ *    out - pointer to output rgba data buffer
+ *    in - pointer to input yu12 data buffer
+ *    width - buffer width (in pixels)
+ *    height - buffer height (in pixels)
+ *    matrix - color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ *    range - quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
+ *
+ * asserts:
+ *    out is not null
+ *    in is not null
+ *
+ * returns: none
+ */
+void yu12_to_rgba (uint8_t *out, uint8_t *in, int width, int height,
+	int matrix, int range)
+{
+	yu12_to_packed_rgb(out, in, width, height,
+		RGB_LAYOUT_RGBA, FALSE, matrix, range);
 }
 
 /*
@@ -2938,7 +3336,6 @@ void yu12_to_yuyv (uint8_t *out, uint8_t *in, int width, int height)
 	}
 }
 
-#if MJPG_BUILTIN //use internal jpeg decoder
 /*
  * used for internal jpeg decoding  420 planar to 422
  * args:
@@ -3149,5 +3546,3 @@ void yuv400pto422(int *out, uint8_t *pic, int width)
 		pic1 += 2 * (width -8);
 	}
 }
-
-#endif
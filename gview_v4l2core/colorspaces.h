@@ -27,6 +27,7 @@
 
 /*
  *convert from packed 422 yuv (yuyv) to 420 planar (yu12)
+ *  (uses the simd kernels when supported by the cpu)
  * args:
  *    out - pointer to output yu12 planar data buffer
  *    in - pointer to input yuyv packed data buffer
@@ -41,8 +42,26 @@
  */
 void yuyv_to_yu12(uint8_t *out, uint8_t *in, int width, int height);
 
+/*
+ *convert from packed 422 yuv (yuyv) to 420 planar (yu12)
+ *  scalar reference implementation
+ * args:
+ *    out - pointer to output yu12 planar data buffer
+ *    in - pointer to input yuyv packed data buffer
+ *    width - frame width
+ *    height - frame height
+ *
+ * asserts:
+ *    in is not null
+ *    out is not null
+ *
+ * returns: none
+ */
+void yuyv_to_yu12_c(uint8_t *out, uint8_t *in, int width, int height);
+
 /*
  *convert from packed 422 yuv (yvyu) to 420 planar (yu12)
+ *  (uses the simd kernels when supported by the cpu)
  * args:
  *    out - pointer to output yu12 planar data buffer
  *    in - pointer to input yvyu packed data buffer
@@ -57,8 +76,26 @@ void yuyv_to_yu12(uint8_t *out, uint8_t *in, int width, int height);
  */
 void yvyu_to_yu12(uint8_t *out, uint8_t *in, int width, int height);
 
+/*
+ *convert from packed 422 yuv (yvyu) to 420 planar (yu12)
+ *  scalar reference implementation
+ * args:
+ *    out - pointer to output yu12 planar data buffer
+ *    in - pointer to input yvyu packed data buffer
+ *    width - frame width
+ *    height - frame height
+ *
+ * asserts:
+ *    in is not null
+ *    out is not null
+ *
+ * returns: none
+ */
+void yvyu_to_yu12_c(uint8_t *out, uint8_t *in, int width, int height);
+
 /*
  *convert from packed 422 yuv (uyvy) to 420 planar (yu12)
+ *  (uses the simd kernels when supported by the cpu)
  * args:
  *    out - pointer to output yu12 planar data buffer
  *    in - pointer to input uyvy packed data buffer
@@ -73,8 +110,26 @@ void yvyu_to_yu12(uint8_t *out, uint8_t *in, int width, int height);
  */
 void uyvy_to_yu12(uint8_t *out, uint8_t *in, int width, int height);
 
+/*
+ *convert from packed 422 yuv (uyvy) to 420 planar (yu12)
+ *  scalar reference implementation
+ * args:
+ *    out - pointer to output yu12 planar data buffer
+ *    in - pointer to input uyvy packed data buffer
+ *    width - frame width
+ *    height - frame height
+ *
+ * asserts:
+ *    in is not null
+ *    out is not null
+ *
+ * returns: none
+ */
+void uyvy_to_yu12_c(uint8_t *out, uint8_t *in, int width, int height);
+
 /*
  *convert from packed 422 yuv (vyuy) to 420 planar (yu12)
+ *  (uses the simd kernels when supported by the cpu)
  * args:
  *    out - pointer to output yu12 planar data buffer
  *    in - pointer to input vyuy packed data buffer
@@ -89,6 +144,23 @@ void uyvy_to_yu12(uint8_t *out, uint8_t *in, int width, int height);
  */
 void vyuy_to_yu12(uint8_t *out, uint8_t *in, int width, int height);
 
+/*
+ *convert from packed 422 yuv (vyuy) to 420 planar (yu12)
+ *  scalar reference implementation
+ * args:
+ *    out - pointer to output yu12 planar data buffer
+ *    in - pointer to input vyuy packed data buffer
+ *    width - frame width
+ *    height - frame height
+ *
+ * asserts:
+ *    in is not null
+ *    out is not null
+ *
+ * returns: none
+ */
+void vyuy_to_yu12_c(uint8_t *out, uint8_t *in, int width, int height);
+
 /*
  *convert from 422 planar yuv to 420 planar (yu12)
  * args:
@@ -105,6 +177,28 @@ void vyuy_to_yu12(uint8_t *out, uint8_t *in, int width, int height);
  */
 void yuv422p_to_yu12(uint8_t *out, uint8_t *in, int width, int height);
 
+/*
+ * convert from planar yuv with line strides (e.g. a decoded libav frame)
+ *  to 420 planar (yu12) in a single pass
+ * args:
+ *    out - pointer to output yu12 planar data buffer
+ *    planes - pointers to the input y, u and v planes (u = NULL for grayscale)
+ *    linesizes - line size (stride) of each input plane
+ *    width - frame width
+ *    height - frame height
+ *    chroma_w_shift - input horizontal chroma subsampling (log2: 0 or 1)
+ *    chroma_h_shift - input vertical chroma subsampling (log2: 0 or 1)
+ *
+ * asserts:
+ *    out is not null
+ *    planes is not null
+ *    linesizes is not null
+ *
+ * returns: none
+ */
+void planar_to_yu12(uint8_t *out, uint8_t **planes, int *linesizes,
+	int width, int height, int chroma_w_shift, int chroma_h_shift);
+
 /*
  * convert yyuv (packed) to yuv420 planar (yu12)
  * args:
@@ -613,29 +707,99 @@ void ba24_to_yu12(uint8_t *out, uint8_t *in, int width, int height);
  *    in - pointer to input yu12 data buffer
  *    width - buffer width (in pixels)
  *    height - buffer height (in pixels)
+ *    matrix - color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ *    range - quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
  *
  * asserts:
- *    none
+ *    out is not null
+ *    in is not null
+ *
+ * returns: none
+ */
+void yu12_to_rgb24 (uint8_t *out, uint8_t *in, int width, int height,
+	int matrix, int range);
+
+/*
+ * convert a range of lines of yu12 data to rgb24
+ * args:
+ *    out - pointer to output rgb data buffer (for line_start)
+ *    in - pointer to input yu12 data buffer (full frame)
+ *    width - buffer width (in pixels)
+ *    height - buffer height (in pixels)
+ *    line_start - first line to convert
+ *    line_end - line after the last one to convert
+ *    matrix - color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ *    range - quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
+ *
+ * asserts:
+ *    out is not null
+ *    in is not null
  *
  * returns: none
  */
-void yu12_to_rgb24 (uint8_t *out, uint8_t *in, int width, int height);
+void yu12_lines_to_rgb24 (uint8_t *out, uint8_t *in, int width, int height,
+	int line_start, int line_end, int matrix, int range);
 
 /*
- * FIXME:  yu12 to bgr24 with lines upsidedown
+ * yu12 to bgr24 with lines upsidedown
  *   used for bitmap files (DIB24)
  * args:
  *    out - pointer to output bgr data buffer
  *    in - pointer to input yu12 data buffer
  *    width - buffer width (in pixels)
  *    height - buffer height (in pixels)
+ *    matrix - color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ *    range - quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
  *
  * asserts:
- *    none
+ *    out is not null
+ *    in is not null
  *
  * returns: none
  */
-void yu12_to_dib24 (uint8_t *out, uint8_t *in, int width, int height);
+void yu12_to_dib24 (uint8_t *out, uint8_t *in, int width, int height,
+	int matrix, int range);
+
+/*
+ * convert a range of lines of yu12 data to bgr24 with lines upsidedown
+ *   (line_end - 1 first) used for streaming bitmap files (DIB24)
+ * args:
+ *    out - pointer to output bgr data buffer (for line_end - 1)
+ *    in - pointer to input yu12 data buffer (full frame)
+ *    width - buffer width (in pixels)
+ *    height - buffer height (in pixels)
+ *    line_start - first line to convert
+ *    line_end - line after the last one to convert
+ *    matrix - color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ *    range - quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
+ *
+ * asserts:
+ *    out is not null
+ *    in is not null
+ *
+ * returns: none
+ */
+void yu12_lines_to_dib24 (uint8_t *out, uint8_t *in, int width, int height,
+	int line_start, int line_end, int matrix, int range);
+
+/*
+ * yu12 to rgba (rgb32, alpha set to 255)
+ * args:
+ *    out - pointer to output rgba data buffer
+ *    in - pointer to input yu12 data buffer
+ *    width - buffer width (in pixels)
+ *    height - buffer height (in pixels)
+ *    matrix - color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ *    range - quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
+ *
+ * asserts:
+ *    out is not null
+ *    in is not null
+ *
+ * returns: none
+ */
+void yu12_to_rgba (uint8_t *out, uint8_t *in, int width, int height,
+	int matrix, int range);
 
 /*
  * convert yuv 420 planar (yu12) to yuv 422 (save_image_jpeg)
@@ -669,7 +833,24 @@ void yu12_to_yuyv (uint8_t *out, uint8_t *in, int width, int height);
  */
 void bayer_to_rgb24(uint8_t *pBay, uint8_t *pRGB24, int width, int height, int pix_order);
 
-#if MJPG_BUILTIN
+/*
+ * convert a range of lines of bayer raw data to rgb24
+ * args:
+ *   pBay: pointer to buffer containing Raw bayer data (full frame)
+ *   pRGB24: pointer to buffer for rgb24 data of line_start
+ *   width: picture width
+ *   height: picture height
+ *   pix_order: bayer pixel order (0=gb/rg   1=gr/bg  2=bg/gr  3=rg/bg)
+ *   line_start: first line to convert
+ *   line_end: line after the last one to convert
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void bayer_lines_to_rgb24(uint8_t *pBay, uint8_t *pRGB24, int width, int height,
+	int pix_order, int line_start, int line_end);
 
 /*
  * used for internal jpeg decoding  420 planar to 422
@@ -727,7 +908,6 @@ void yuv444pto422(int *out, uint8_t *pic, int width);
  */
 void yuv400pto422(int *out, uint8_t *pic, int width);
 
-#endif
 
 #endif
 
@@ -0,0 +1,852 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "gview.h"
+#include "colorspaces_simd.h"
+#include "cpu_features.h"
+#include "../config.h"
+
+extern int verbosity;
+
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+
+/*
+ * scalar conversion of the last columns of a line pair
+ *  (the ones that don't fill a whole simd vector)
+ * args:
+ *    py1 - pointer to first output luma line
+ *    py2 - pointer to second output luma line
+ *    pu - pointer to output u line
+ *    pv - pointer to output v line
+ *    in1 - pointer to first input packed line
+ *    in2 - pointer to second input packed line
+ *    npix - number of pixels to convert (even)
+ *    y_off, u_off, v_off - component byte offsets in the macropixel
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void packed422_line_pair_c(uint8_t *py1, uint8_t *py2,
+	uint8_t *pu, uint8_t *pv,
+	const uint8_t *in1, const uint8_t *in2,
+	int npix, int y_off, int u_off, int v_off)
+{
+	int w = 0;
+	for(w = 0; w < npix; w += 2)
+	{
+		*py1++ = in1[y_off];
+		*py1++ = in1[y_off + 2];
+		*py2++ = in2[y_off];
+		*py2++ = in2[y_off + 2];
+		*pu++ = (in1[u_off] + in2[u_off]) /2; //average u samples
+		*pv++ = (in1[v_off] + in2[v_off]) /2; //average v samples
+		in1 += 4;
+		in2 += 4;
+	}
+}
+
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/*
+ * sse2 packed 422 to yu12 (16 pixels per iteration)
+ * args:
+ *    out - pointer to output yu12 planar data buffer
+ *    in - pointer to input packed 422 data buffer
+ *    width - frame width
+ *    height - frame height
+ *    y_off, u_off, v_off - component byte offsets in the macropixel
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+__attribute__((target("sse2")))
+static void packed422_to_yu12_sse2(uint8_t *out, uint8_t *in, int width, int height,
+	int y_off, int u_off, int v_off)
+{
+	int w = 0, h = 0;
+	int simd_w = width & ~15;
+
+	uint8_t *pu = out + (width * height);
+	uint8_t *pv = pu + ((width * height) / 4);
+
+	const __m128i mask16 = _mm_set1_epi16(0x00FF);
+	const __m128i mask32 = _mm_set1_epi32(0x0000FFFF);
+
+	for(h = 0; h < height; h += 2)
+	{
+		uint8_t *in1 = in + (h * width * 2);
+		uint8_t *in2 = in1 + (width * 2);
+		uint8_t *py1 = out + (h * width);
+		uint8_t *py2 = py1 + width;
+
+		for(w = 0; w < simd_w; w += 16)
+		{
+			__m128i a0 = _mm_loadu_si128((const __m128i *) (in1 + 2 * w));
+			__m128i a1 = _mm_loadu_si128((const __m128i *) (in1 + 2 * w + 16));
+			__m128i b0 = _mm_loadu_si128((const __m128i *) (in2 + 2 * w));
+			__m128i b1 = _mm_loadu_si128((const __m128i *) (in2 + 2 * w + 16));
+
+			__m128i ya0, ya1, yb0, yb1, ca0, ca1, cb0, cb1;
+			if(y_off == 0)
+			{
+				ya0 = _mm_and_si128(a0, mask16);
+				ya1 = _mm_and_si128(a1, mask16);
+				yb0 = _mm_and_si128(b0, mask16);
+				yb1 = _mm_and_si128(b1, mask16);
+				ca0 = _mm_srli_epi16(a0, 8);
+				ca1 = _mm_srli_epi16(a1, 8);
+				cb0 = _mm_srli_epi16(b0, 8);
+				cb1 = _mm_srli_epi16(b1, 8);
+			}
+			else
+			{
+				ya0 = _mm_srli_epi16(a0, 8);
+				ya1 = _mm_srli_epi16(a1, 8);
+				yb0 = _mm_srli_epi16(b0, 8);
+				yb1 = _mm_srli_epi16(b1, 8);
+				ca0 = _mm_and_si128(a0, mask16);
+				ca1 = _mm_and_si128(a1, mask16);
+				cb0 = _mm_and_si128(b0, mask16);
+				cb1 = _mm_and_si128(b1, mask16);
+			}
+
+			_mm_storeu_si128((__m128i *) (py1 + w), _mm_packus_epi16(ya0, ya1));
+			_mm_storeu_si128((__m128i *) (py2 + w), _mm_packus_epi16(yb0, yb1));
+
+			/*average the two lines in 16 bit (truncated, like the scalar code)*/
+			__m128i c0 = _mm_srli_epi16(_mm_add_epi16(ca0, cb0), 1);
+			__m128i c1 = _mm_srli_epi16(_mm_add_epi16(ca1, cb1), 1);
+
+			/*chroma words alternate between the first and second component*/
+			__m128i c_first = _mm_packs_epi32(
+				_mm_and_si128(c0, mask32),
+				_mm_and_si128(c1, mask32));
+			__m128i c_second = _mm_packs_epi32(
+				_mm_srli_epi32(c0, 16),
+				_mm_srli_epi32(c1, 16));
+			c_first = _mm_packus_epi16(c_first, c_first);
+			c_second = _mm_packus_epi16(c_second, c_second);
+
+			if(u_off < v_off)
+			{
+				_mm_storel_epi64((__m128i *) pu, c_first);
+				_mm_storel_epi64((__m128i *) pv, c_second);
+			}
+			else
+			{
+				_mm_storel_epi64((__m128i *) pv, c_first);
+				_mm_storel_epi64((__m128i *) pu, c_second);
+			}
+			pu += 8;
+			pv += 8;
+		}
+
+		packed422_line_pair_c(py1 + simd_w, py2 + simd_w, pu, pv,
+			in1 + 2 * simd_w, in2 + 2 * simd_w,
+			width - simd_w, y_off, u_off, v_off);
+		pu += (width - simd_w) / 2;
+		pv += (width - simd_w) / 2;
+	}
+}
+
+/*
+ * avx2 packed 422 to yu12 (32 pixels per iteration)
+ * args:
+ *    out - pointer to output yu12 planar data buffer
+ *    in - pointer to input packed 422 data buffer
+ *    width - frame width
+ *    height - frame height
+ *    y_off, u_off, v_off - component byte offsets in the macropixel
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+__attribute__((target("avx2")))
+static void packed422_to_yu12_avx2(uint8_t *out, uint8_t *in, int width, int height,
+	int y_off, int u_off, int v_off)
+{
+	int w = 0, h = 0;
+	int simd_w = width & ~31;
+
+	uint8_t *pu = out + (width * height);
+	uint8_t *pv = pu + ((width * height) / 4);
+
+	const __m256i mask16 = _mm256_set1_epi16(0x00FF);
+	const __m256i mask32 = _mm256_set1_epi32(0x0000FFFF);
+
+	for(h = 0; h < height; h += 2)
+	{
+		uint8_t *in1 = in + (h * width * 2);
+		uint8_t *in2 = in1 + (width * 2);
+		uint8_t *py1 = out + (h * width);
+		uint8_t *py2 = py1 + width;
+
+		for(w = 0; w < simd_w; w += 32)
+		{
+			__m256i a0 = _mm256_loadu_si256((const __m256i *) (in1 + 2 * w));
+			__m256i a1 = _mm256_loadu_si256((const __m256i *) (in1 + 2 * w + 32));
+			__m256i b0 = _mm256_loadu_si256((const __m256i *) (in2 + 2 * w));
+			__m256i b1 = _mm256_loadu_si256((const __m256i *) (in2 + 2 * w + 32));
+
+			__m256i ya0, ya1, yb0, yb1, ca0, ca1, cb0, cb1;
+			if(y_off == 0)
+			{
+				ya0 = _mm256_and_si256(a0, mask16);
+				ya1 = _mm256_and_si256(a1, mask16);
+				yb0 = _mm256_and_si256(b0, mask16);
+				yb1 = _mm256_and_si256(b1, mask16);
+				ca0 = _mm256_srli_epi16(a0, 8);
+				ca1 = _mm256_srli_epi16(a1, 8);
+				cb0 = _mm256_srli_epi16(b0, 8);
+				cb1 = _mm256_srli_epi16(b1, 8);
+			}
+			else
+			{
+				ya0 = _mm256_srli_epi16(a0, 8);
+				ya1 = _mm256_srli_epi16(a1, 8);
+				yb0 = _mm256_srli_epi16(b0, 8);
+				yb1 = _mm256_srli_epi16(b1, 8);
+				ca0 = _mm256_and_si256(a0, mask16);
+				ca1 = _mm256_and_si256(a1, mask16);
+				cb0 = _mm256_and_si256(b0, mask16);
+				cb1 = _mm256_and_si256(b1, mask16);
+			}
+
+			/*packs work per 128 bit lane - restore the qword order*/
+			__m256i y1 = _mm256_permute4x64_epi64(_mm256_packus_epi16(ya0, ya1), 0xD8);
+			__m256i y2 = _mm256_permute4x64_epi64(_mm256_packus_epi16(yb0, yb1), 0xD8);
+			_mm256_storeu_si256((__m256i *) (py1 + w), y1);
+			_mm256_storeu_si256((__m256i *) (py2 + w), y2);
+
+			/*average the two lines in 16 bit (truncated, like the scalar code)*/
+			__m256i c0 = _mm256_srli_epi16(_mm256_add_epi16(ca0, cb0), 1);
+			__m256i c1 = _mm256_srli_epi16(_mm256_add_epi16(ca1, cb1), 1);
+
+			/*chroma words alternate between the first and second component*/
+			__m256i c_first = _mm256_permute4x64_epi64(_mm256_packs_epi32(
+				_mm256_and_si256(c0, mask32),
+				_mm256_and_si256(c1, mask32)), 0xD8);
+			__m256i c_second = _mm256_permute4x64_epi64(_mm256_packs_epi32(
+				_mm256_srli_epi32(c0, 16),
+				_mm256_srli_epi32(c1, 16)), 0xD8);
+			c_first = _mm256_permute4x64_epi64(
+				_mm256_packus_epi16(c_first, c_first), 0xD8);
+			c_second = _mm256_permute4x64_epi64(
+				_mm256_packus_epi16(c_second, c_second), 0xD8);
+
+			if(u_off < v_off)
+			{
+				_mm_storeu_si128((__m128i *) pu, _mm256_castsi256_si128(c_first));
+				_mm_storeu_si128((__m128i *) pv, _mm256_castsi256_si128(c_second));
+			}
+			else
+			{
+				_mm_storeu_si128((__m128i *) pv, _mm256_castsi256_si128(c_first));
+				_mm_storeu_si128((__m128i *) pu, _mm256_castsi256_si128(c_second));
+			}
+			pu += 16;
+			pv += 16;
+		}
+
+		packed422_line_pair_c(py1 + simd_w, py2 + simd_w, pu, pv,
+			in1 + 2 * simd_w, in2 + 2 * simd_w,
+			width - simd_w, y_off, u_off, v_off);
+		pu += (width - simd_w) / 2;
+		pv += (width - simd_w) / 2;
+	}
+}
+
+#elif defined(__aarch64__)
+
+/*
+ * neon packed 422 to yu12 (32 pixels per iteration)
+ * args:
+ *    out - pointer to output yu12 planar data buffer
+ *    in - pointer to input packed 422 data buffer
+ *    width - frame width
+ *    height - frame height
+ *    y_off, u_off, v_off - component byte offsets in the macropixel
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void packed422_to_yu12_neon(uint8_t *out, uint8_t *in, int width, int height,
+	int y_off, int u_off, int v_off)
+{
+	int w = 0, h = 0;
+	int simd_w = width & ~31;
+
+	uint8_t *pu = out + (width * height);
+	uint8_t *pv = pu + ((width * height) / 4);
+
+	for(h = 0; h < height; h += 2)
+	{
+		uint8_t *in1 = in + (h * width * 2);
+		uint8_t *in2 = in1 + (width * 2);
+		uint8_t *py1 = out + (h * width);
+		uint8_t *py2 = py1 + width;
+
+		for(w = 0; w < simd_w; w += 32)
+		{
+			/*deinterleave the four macropixel bytes*/
+			uint8x16x4_t a = vld4q_u8(in1 + 2 * w);
+			uint8x16x4_t b = vld4q_u8(in2 + 2 * w);
+
+			uint8x16x2_t y1 = {{ a.val[y_off], a.val[y_off + 2] }};
+			uint8x16x2_t y2 = {{ b.val[y_off], b.val[y_off + 2] }};
+			vst2q_u8(py1 + w, y1);
+			vst2q_u8(py2 + w, y2);
+
+			/*halving add truncates, like the scalar code*/
+			vst1q_u8(pu, vhaddq_u8(a.val[u_off], b.val[u_off]));
+			vst1q_u8(pv, vhaddq_u8(a.val[v_off], b.val[v_off]));
+			pu += 16;
+			pv += 16;
+		}
+
+		packed422_line_pair_c(py1 + simd_w, py2 + simd_w, pu, pv,
+			in1 + 2 * simd_w, in2 + 2 * simd_w,
+			width - simd_w, y_off, u_off, v_off);
+		pu += (width - simd_w) / 2;
+		pv += (width - simd_w) / 2;
+	}
+}
+
+#endif
+
+/*
+ * convert from packed 422 yuv to 420 planar (yu12) using simd
+ *   results are bit exact with the scalar conversion functions
+ * args:
+ *    out - pointer to output yu12 planar data buffer
+ *    in - pointer to input packed 422 data buffer
+ *    width - frame width
+ *    height - frame height
+ *    y_off - byte offset of the first luma sample in the macropixel (0 or 1)
+ *    u_off - byte offset of the u sample in the macropixel
+ *    v_off - byte offset of the v sample in the macropixel
+ *
+ * asserts:
+ *    in is not null
+ *    out is not null
+ *
+ * returns: TRUE if the frame was converted
+ *          FALSE if no simd kernel is available for the cpu
+ */
+int packed422_to_yu12_simd(uint8_t *out, uint8_t *in, int width, int height,
+	int y_off, int u_off, int v_off)
+{
+	/*assertions*/
+	assert(in);
+	assert(out);
+
+	uint32_t features = get_cpu_features();
+
+#if defined(__x86_64__) || defined(__i386__)
+	if(features & CPU_FEATURE_AVX2)
+	{
+		packed422_to_yu12_avx2(out, in, width, height, y_off, u_off, v_off);
+		return TRUE;
+	}
+	if(features & CPU_FEATURE_SSE2)
+	{
+		packed422_to_yu12_sse2(out, in, width, height, y_off, u_off, v_off);
+		return TRUE;
+	}
+#elif defined(__aarch64__)
+	if(features & CPU_FEATURE_NEON)
+	{
+		packed422_to_yu12_neon(out, in, width, height, y_off, u_off, v_off);
+		return TRUE;
+	}
+#endif
+
+	(void) features; /*no simd kernels for this architecture*/
+
+	return FALSE;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/*
+ * broadcast fixed point coefficients
+ */
+typedef struct _yuv_rgb_vec_t
+{
+	__m128i y_off;
+	__m128i y_mul;
+	__m128i v_r;
+	__m128i u_g;
+	__m128i v_g;
+	__m128i u_b;
+} yuv_rgb_vec_t;
+
+/*
+ * add (or subtract) the chroma term to a 16 luma sample pair of vectors
+ *  and round/saturate the result to 8 bit
+ * args:
+ *    ylo - luma for pixels 0-7 (Q2)
+ *    yhi - luma for pixels 8-15 (Q2)
+ *    c - chroma term for pixels 0-15 (one per pixel pair, Q2)
+ *    sub - if set subtract the chroma term
+ *
+ * asserts:
+ *    none
+ *
+ * returns: 16 component values
+ */
+__attribute__((target("sse2"), always_inline))
+static inline __m128i yuv_rgb_component_sse2(__m128i ylo, __m128i yhi,
+	__m128i c, int sub)
+{
+	const __m128i round = _mm_set1_epi16(2);
+
+	/*each chroma sample covers two luma samples*/
+	__m128i clo = _mm_unpacklo_epi16(c, c);
+	__m128i chi = _mm_unpackhi_epi16(c, c);
+
+	clo = sub ? _mm_sub_epi16(ylo, clo) : _mm_add_epi16(ylo, clo);
+	chi = sub ? _mm_sub_epi16(yhi, chi) : _mm_add_epi16(yhi, chi);
+
+	clo = _mm_srai_epi16(_mm_add_epi16(clo, round), 2);
+	chi = _mm_srai_epi16(_mm_add_epi16(chi, round), 2);
+
+	return _mm_packus_epi16(clo, chi); /*clip to [0-255]*/
+}
+
+/*
+ * convert 16 yu12 pixels to rgb planes (fixed point)
+ * args:
+ *    py - pointer to 16 luma samples
+ *    pu - pointer to 8 u samples
+ *    pv - pointer to 8 v samples
+ *    k - pointer to broadcast coefficients
+ *    r - pointer to red output vector
+ *    g - pointer to green output vector
+ *    b - pointer to blue output vector
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+__attribute__((target("sse2"), always_inline))
+static inline void yu12_16px_to_rgb_sse2(const uint8_t *py,
+	const uint8_t *pu, const uint8_t *pv, const yuv_rgb_vec_t *k,
+	__m128i *r, __m128i *g, __m128i *b)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i c128 = _mm_set1_epi16(128);
+
+	__m128i y = _mm_loadu_si128((const __m128i *) py);
+	__m128i u = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) pu), zero);
+	__m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) pv), zero);
+
+	__m128i ylo = _mm_sub_epi16(_mm_unpacklo_epi8(y, zero), k->y_off);
+	__m128i yhi = _mm_sub_epi16(_mm_unpackhi_epi8(y, zero), k->y_off);
+	ylo = _mm_mulhi_epi16(_mm_slli_epi16(ylo, 7), k->y_mul);
+	yhi = _mm_mulhi_epi16(_mm_slli_epi16(yhi, 7), k->y_mul);
+
+	u = _mm_slli_epi16(_mm_sub_epi16(u, c128), 8);
+	v = _mm_slli_epi16(_mm_sub_epi16(v, c128), 8);
+
+	__m128i cr = _mm_mulhi_epi16(v, k->v_r);
+	__m128i cg = _mm_add_epi16(_mm_mulhi_epi16(u, k->u_g), _mm_mulhi_epi16(v, k->v_g));
+	__m128i cb = _mm_mulhi_epi16(u, k->u_b);
+
+	*r = yuv_rgb_component_sse2(ylo, yhi, cr, 0);
+	*g = yuv_rgb_component_sse2(ylo, yhi, cg, 1);
+	*b = yuv_rgb_component_sse2(ylo, yhi, cb, 0);
+}
+
+/*
+ * interleave 16 pixels into four vectors of 4 byte pixels
+ * args:
+ *    c0 - first component
+ *    c1 - second component
+ *    c2 - third component
+ *    c3 - fourth component
+ *    px - array of 4 output vectors (pixels 0-3, 4-7, 8-11, 12-15)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+__attribute__((target("sse2"), always_inline))
+static inline void interleave_4x16_sse2(__m128i c0, __m128i c1,
+	__m128i c2, __m128i c3, __m128i px[4])
+{
+	__m128i c01_lo = _mm_unpacklo_epi8(c0, c1);
+	__m128i c01_hi = _mm_unpackhi_epi8(c0, c1);
+	__m128i c23_lo = _mm_unpacklo_epi8(c2, c3);
+	__m128i c23_hi = _mm_unpackhi_epi8(c2, c3);
+
+	px[0] = _mm_unpacklo_epi16(c01_lo, c23_lo);
+	px[1] = _mm_unpackhi_epi16(c01_lo, c23_lo);
+	px[2] = _mm_unpacklo_epi16(c01_hi, c23_hi);
+	px[3] = _mm_unpackhi_epi16(c01_hi, c23_hi);
+}
+
+/*
+ * set the broadcast coefficients
+ * args:
+ *    k - pointer to broadcast coefficients
+ *    coef - pointer to fixed point coefficients
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+__attribute__((target("sse2")))
+static void yuv_rgb_vec_init_sse2(yuv_rgb_vec_t *k, const yuv_rgb_coef_t *coef)
+{
+	k->y_off = _mm_set1_epi16(coef->y_off);
+	k->y_mul = _mm_set1_epi16(coef->y_mul);
+	k->v_r = _mm_set1_epi16(coef->v_r);
+	k->u_g = _mm_set1_epi16(coef->u_g);
+	k->v_g = _mm_set1_epi16(coef->v_g);
+	k->u_b = _mm_set1_epi16(coef->u_b);
+}
+
+/*
+ * sse2 yu12 line to rgb (16 pixels per iteration)
+ *   24 bit layouts are packed through a small stack buffer
+ * args:
+ *    out - pointer to output rgb line
+ *    py - pointer to input luma line
+ *    pu - pointer to input u line
+ *    pv - pointer to input v line
+ *    width - line width (in pixels)
+ *    layout - output layout (RGB_LAYOUT_XXX)
+ *    coef - pointer to fixed point coefficients
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of converted pixels
+ */
+__attribute__((target("sse2")))
+static int yu12_line_to_rgb_sse2(uint8_t *out, const uint8_t *py,
+	const uint8_t *pu, const uint8_t *pv,
+	int width, int layout, const yuv_rgb_coef_t *coef)
+{
+	int w = 0, i = 0;
+	int simd_w = width & ~15;
+
+	yuv_rgb_vec_t k;
+	yuv_rgb_vec_init_sse2(&k, coef);
+
+	const __m128i alpha = _mm_set1_epi8((char) 0xFF);
+
+	for(w = 0; w < simd_w; w += 16)
+	{
+		__m128i r, g, b;
+		__m128i px[4];
+
+		yu12_16px_to_rgb_sse2(py + w, pu + w/2, pv + w/2, &k, &r, &g, &b);
+
+		if(layout == RGB_LAYOUT_BGR24)
+			interleave_4x16_sse2(b, g, r, alpha, px);
+		else
+			interleave_4x16_sse2(r, g, b, alpha, px);
+
+		if(layout == RGB_LAYOUT_RGBA)
+		{
+			for(i = 0; i < 4; i++)
+				_mm_storeu_si128((__m128i *) (out + 4 * w + 16 * i), px[i]);
+		}
+		else
+		{
+			uint8_t tmp[64] __attribute__((aligned(16)));
+			uint8_t *pout = out + 3 * w;
+
+			for(i = 0; i < 4; i++)
+				_mm_store_si128((__m128i *) (tmp + 16 * i), px[i]);
+			/*drop the alpha byte*/
+			for(i = 0; i < 64; i += 4)
+			{
+				*pout++ = tmp[i];
+				*pout++ = tmp[i + 1];
+				*pout++ = tmp[i + 2];
+			}
+		}
+	}
+
+	return simd_w;
+}
+
+/*
+ * ssse3 yu12 line to rgb (16 pixels per iteration)
+ *   24 bit layouts are packed in register with pshufb
+ * args:
+ *    out - pointer to output rgb line
+ *    py - pointer to input luma line
+ *    pu - pointer to input u line
+ *    pv - pointer to input v line
+ *    width - line width (in pixels)
+ *    layout - output layout (RGB_LAYOUT_XXX)
+ *    coef - pointer to fixed point coefficients
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of converted pixels
+ */
+__attribute__((target("ssse3")))
+static int yu12_line_to_rgb_ssse3(uint8_t *out, const uint8_t *py,
+	const uint8_t *pu, const uint8_t *pv,
+	int width, int layout, const yuv_rgb_coef_t *coef)
+{
+	int w = 0;
+	int simd_w = width & ~15;
+
+	if(layout == RGB_LAYOUT_RGBA)
+		return yu12_line_to_rgb_sse2(out, py, pu, pv, width, layout, coef);
+
+	yuv_rgb_vec_t k;
+	yuv_rgb_vec_init_sse2(&k, coef);
+
+	const __m128i alpha = _mm_setzero_si128();
+	/*squeeze 4 byte pixels into the 12 low bytes*/
+	const __m128i pack3 = _mm_setr_epi8(
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+	for(w = 0; w < simd_w; w += 16)
+	{
+		__m128i r, g, b;
+		__m128i px[4];
+
+		yu12_16px_to_rgb_sse2(py + w, pu + w/2, pv + w/2, &k, &r, &g, &b);
+
+		if(layout == RGB_LAYOUT_BGR24)
+			interleave_4x16_sse2(b, g, r, alpha, px);
+		else
+			interleave_4x16_sse2(r, g, b, alpha, px);
+
+		__m128i p0 = _mm_shuffle_epi8(px[0], pack3);
+		__m128i p1 = _mm_shuffle_epi8(px[1], pack3);
+		__m128i p2 = _mm_shuffle_epi8(px[2], pack3);
+		__m128i p3 = _mm_shuffle_epi8(px[3], pack3);
+
+		uint8_t *pout = out + 3 * w;
+		_mm_storeu_si128((__m128i *) pout,
+			_mm_or_si128(p0, _mm_slli_si128(p1, 12)));
+		_mm_storeu_si128((__m128i *) (pout + 16),
+			_mm_or_si128(_mm_srli_si128(p1, 4), _mm_slli_si128(p2, 8)));
+		_mm_storeu_si128((__m128i *) (pout + 32),
+			_mm_or_si128(_mm_srli_si128(p2, 8), _mm_slli_si128(p3, 4)));
+	}
+
+	return simd_w;
+}
+
+#elif defined(__aarch64__)
+
+/*
+ * (a * b) >> 16 for 8 signed 16 bit lanes
+ * args:
+ *    a - first operand
+ *    b - second operand
+ *
+ * asserts:
+ *    none
+ *
+ * returns: high half of the products
+ */
+static inline int16x8_t mulhi_s16_neon(int16x8_t a, int16x8_t b)
+{
+	return vcombine_s16(
+		vshrn_n_s32(vmull_s16(vget_low_s16(a), vget_low_s16(b)), 16),
+		vshrn_n_s32(vmull_high_s16(a, b), 16));
+}
+
+/*
+ * add (or subtract) the chroma term to 16 luma samples
+ *  and round/saturate the result to 8 bit
+ * args:
+ *    ylo - luma for pixels 0-7 (Q2)
+ *    yhi - luma for pixels 8-15 (Q2)
+ *    c - chroma term for pixels 0-15 (one per pixel pair, Q2)
+ *    sub - if set subtract the chroma term
+ *
+ * asserts:
+ *    none
+ *
+ * returns: 16 component values
+ */
+static inline uint8x16_t yuv_rgb_component_neon(int16x8_t ylo, int16x8_t yhi,
+	int16x8_t c, int sub)
+{
+	/*each chroma sample covers two luma samples*/
+	int16x8_t clo = vzip1q_s16(c, c);
+	int16x8_t chi = vzip2q_s16(c, c);
+
+	clo = sub ? vsubq_s16(ylo, clo) : vaddq_s16(ylo, clo);
+	chi = sub ? vsubq_s16(yhi, chi) : vaddq_s16(yhi, chi);
+
+	/*rounding shift and clip to [0-255]*/
+	return vcombine_u8(
+		vqmovun_s16(vrshrq_n_s16(clo, 2)),
+		vqmovun_s16(vrshrq_n_s16(chi, 2)));
+}
+
+/*
+ * neon yu12 line to rgb (16 pixels per iteration)
+ * args:
+ *    out - pointer to output rgb line
+ *    py - pointer to input luma line
+ *    pu - pointer to input u line
+ *    pv - pointer to input v line
+ *    width - line width (in pixels)
+ *    layout - output layout (RGB_LAYOUT_XXX)
+ *    coef - pointer to fixed point coefficients
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of converted pixels
+ */
+static int yu12_line_to_rgb_neon(uint8_t *out, const uint8_t *py,
+	const uint8_t *pu, const uint8_t *pv,
+	int width, int layout, const yuv_rgb_coef_t *coef)
+{
+	int w = 0;
+	int simd_w = width & ~15;
+
+	const int16x8_t y_off = vdupq_n_s16(coef->y_off);
+	const int16x8_t y_mul = vdupq_n_s16(coef->y_mul);
+	const int16x8_t v_r = vdupq_n_s16(coef->v_r);
+	const int16x8_t u_g = vdupq_n_s16(coef->u_g);
+	const int16x8_t v_g = vdupq_n_s16(coef->v_g);
+	const int16x8_t u_b = vdupq_n_s16(coef->u_b);
+	const int16x8_t c128 = vdupq_n_s16(128);
+
+	for(w = 0; w < simd_w; w += 16)
+	{
+		uint8x16_t y = vld1q_u8(py + w);
+		int16x8_t u = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(pu + w/2)));
+		int16x8_t v = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(pv + w/2)));
+
+		int16x8_t ylo = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(y))), y_off);
+		int16x8_t yhi = vsubq_s16(vreinterpretq_s16_u16(vmovl_high_u8(y)), y_off);
+		ylo = mulhi_s16_neon(vshlq_n_s16(ylo, 7), y_mul);
+		yhi = mulhi_s16_neon(vshlq_n_s16(yhi, 7), y_mul);
+
+		u = vshlq_n_s16(vsubq_s16(u, c128), 8);
+		v = vshlq_n_s16(vsubq_s16(v, c128), 8);
+
+		int16x8_t cr = mulhi_s16_neon(v, v_r);
+		int16x8_t cg = vaddq_s16(mulhi_s16_neon(u, u_g), mulhi_s16_neon(v, v_g));
+		int16x8_t cb = mulhi_s16_neon(u, u_b);
+
+		uint8x16_t r = yuv_rgb_component_neon(ylo, yhi, cr, 0);
+		uint8x16_t g = yuv_rgb_component_neon(ylo, yhi, cg, 1);
+		uint8x16_t b = yuv_rgb_component_neon(ylo, yhi, cb, 0);
+
+		switch(layout)
+		{
+			case RGB_LAYOUT_RGBA:
+			{
+				uint8x16x4_t px = {{ r, g, b, vdupq_n_u8(0xFF) }};
+				vst4q_u8(out + 4 * w, px);
+				break;
+			}
+			case RGB_LAYOUT_BGR24:
+			{
+				uint8x16x3_t px = {{ b, g, r }};
+				vst3q_u8(out + 3 * w, px);
+				break;
+			}
+			default:
+			{
+				uint8x16x3_t px = {{ r, g, b }};
+				vst3q_u8(out + 3 * w, px);
+				break;
+			}
+		}
+	}
+
+	return simd_w;
+}
+
+#endif
+
+/*
+ * convert a yu12 line to packed rgb using simd
+ *   results are bit exact with the scalar fixed point conversion
+ * args:
+ *    out - pointer to output rgb line
+ *    py - pointer to input luma line
+ *    pu - pointer to input u line
+ *    pv - pointer to input v line
+ *    width - line width (in pixels)
+ *    layout - output layout (RGB_LAYOUT_XXX)
+ *    coef - pointer to fixed point coefficients
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of converted pixels (a multiple of 16)
+ *          the caller converts the remaining ones
+ */
+int yu12_line_to_rgb_simd(uint8_t *out, const uint8_t *py,
+	const uint8_t *pu, const uint8_t *pv,
+	int width, int layout, const yuv_rgb_coef_t *coef)
+{
+	uint32_t features = get_cpu_features();
+
+#if defined(__x86_64__) || defined(__i386__)
+	if(features & CPU_FEATURE_SSSE3)
+		return yu12_line_to_rgb_ssse3(out, py, pu, pv, width, layout, coef);
+	if(features & CPU_FEATURE_SSE2)
+		return yu12_line_to_rgb_sse2(out, py, pu, pv, width, layout, coef);
+#elif defined(__aarch64__)
+	if(features & CPU_FEATURE_NEON)
+		return yu12_line_to_rgb_neon(out, py, pu, pv, width, layout, coef);
+#endif
+
+	(void) features; /*no simd kernels for this architecture*/
+
+	return 0;
+}
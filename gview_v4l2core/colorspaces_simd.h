@@ -0,0 +1,104 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#ifndef COLORSPACES_SIMD_H
+#define COLORSPACES_SIMD_H
+
+#include "gview.h"
+#include "../config.h"
+
+/*
+ * byte offsets of the components in a packed 422 macropixel
+ *  (two pixels in four bytes: Y0 C Y1 C or C Y0 C Y1)
+ */
+#define PACKED422_YUYV 0, 1, 3
+#define PACKED422_YVYU 0, 3, 1
+#define PACKED422_UYVY 1, 0, 2
+#define PACKED422_VYUY 1, 2, 0
+
+/*
+ * convert from packed 422 yuv to 420 planar (yu12) using simd
+ *   results are bit exact with the scalar conversion functions
+ * args:
+ *    out - pointer to output yu12 planar data buffer
+ *    in - pointer to input packed 422 data buffer
+ *    width - frame width
+ *    height - frame height
+ *    y_off - byte offset of the first luma sample in the macropixel (0 or 1)
+ *    u_off - byte offset of the u sample in the macropixel
+ *    v_off - byte offset of the v sample in the macropixel
+ *
+ * asserts:
+ *    in is not null
+ *    out is not null
+ *
+ * returns: TRUE if the frame was converted
+ *          FALSE if no simd kernel is available for the cpu
+ */
+int packed422_to_yu12_simd(uint8_t *out, uint8_t *in, int width, int height,
+	int y_off, int u_off, int v_off);
+
+/*
+ * output layouts for the yu12 to rgb line kernels
+ */
+#define RGB_LAYOUT_RGB24 (0) //r, g, b
+#define RGB_LAYOUT_BGR24 (1) //b, g, r
+#define RGB_LAYOUT_RGBA  (2) //r, g, b, a (a = 0xFF)
+
+/*
+ * fixed point yuv to rgb coefficients
+ *   all products are (a * b) >> 16 (mulhi) on 16 bit values:
+ *   luma is ((y - y_off) << 7) * y_mul (Q11) and chroma is
+ *   ((c - 128) << 8) * coef (Q10), giving rgb with 2 fractional bits
+ */
+typedef struct _yuv_rgb_coef_t
+{
+	int16_t y_off; //luma black level (0 or 16)
+	int16_t y_mul; //luma scale (Q11)
+	int16_t v_r;   //v contribution to red (Q10)
+	int16_t u_g;   //u contribution to green (Q10)
+	int16_t v_g;   //v contribution to green (Q10)
+	int16_t u_b;   //u contribution to blue (Q10)
+} yuv_rgb_coef_t;
+
+/*
+ * convert a yu12 line to packed rgb using simd
+ *   results are bit exact with the scalar fixed point conversion
+ * args:
+ *    out - pointer to output rgb line
+ *    py - pointer to input luma line
+ *    pu - pointer to input u line
+ *    pv - pointer to input v line
+ *    width - line width (in pixels)
+ *    layout - output layout (RGB_LAYOUT_XXX)
+ *    coef - pointer to fixed point coefficients
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of converted pixels (a multiple of 16)
+ *          the caller converts the remaining ones
+ */
+int yu12_line_to_rgb_simd(uint8_t *out, const uint8_t *py,
+	const uint8_t *pu, const uint8_t *pv,
+	int width, int layout, const yuv_rgb_coef_t *coef);
+
+#endif
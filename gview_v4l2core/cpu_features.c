@@ -0,0 +1,112 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "cpu_features.h"
+#include "gview.h"
+#include "../config.h"
+
+extern int verbosity;
+
+/*detected features (set once by detect_cpu_features)*/
+static uint32_t cpu_features = CPU_FEATURE_NONE;
+static __ONCE_TYPE cpu_features_once = __STATIC_ONCE_INIT;
+
+/*features allowed by set_cpu_features_mask (default: all)*/
+static uint32_t cpu_features_mask = ~((uint32_t) 0);
+
+/*
+ * detect the SIMD features supported by the running cpu
+ *   (run only once, through __ONCE)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+static void detect_cpu_features()
+{
+	uint32_t features = CPU_FEATURE_NONE;
+
+#if defined(__x86_64__) || defined(__i386__)
+	/*cpuid based detection*/
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse2"))
+		features |= CPU_FEATURE_SSE2;
+	if(__builtin_cpu_supports("ssse3"))
+		features |= CPU_FEATURE_SSSE3;
+	if(__builtin_cpu_supports("avx2"))
+		features |= CPU_FEATURE_AVX2;
+#elif defined(__aarch64__)
+	/*advanced simd is mandatory in armv8-a*/
+	features |= CPU_FEATURE_NEON;
+#endif
+
+	if(verbosity > 1)
+		printf("V4L2_CORE: cpu simd features: sse2=%i ssse3=%i avx2=%i neon=%i\n",
+			(features & CPU_FEATURE_SSE2) ? 1 : 0,
+			(features & CPU_FEATURE_SSSE3) ? 1 : 0,
+			(features & CPU_FEATURE_AVX2) ? 1 : 0,
+			(features & CPU_FEATURE_NEON) ? 1 : 0);
+
+	cpu_features = features;
+}
+
+/*
+ * get the SIMD features supported by the running cpu
+ *   (detected once, on the first call, from any thread)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: bitmask of CPU_FEATURE_XXX flags
+ */
+uint32_t get_cpu_features()
+{
+	__ONCE(&cpu_features_once, detect_cpu_features);
+
+	return cpu_features & cpu_features_mask;
+}
+
+/*
+ * restrict the SIMD features returned by get_cpu_features
+ *   used by the tests and benchmarks to run every kernel;
+ *   must be called before any conversion thread is started
+ * args:
+ *   mask - bitmask of allowed CPU_FEATURE_XXX flags
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void set_cpu_features_mask(uint32_t mask)
+{
+	cpu_features_mask = mask;
+}
@@ -0,0 +1,64 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+/*
+ * SIMD instruction sets usable by the colorspace kernels
+ */
+#define CPU_FEATURE_NONE  (0)
+#define CPU_FEATURE_SSE2  (1 << 0)
+#define CPU_FEATURE_AVX2  (1 << 1)
+#define CPU_FEATURE_NEON  (1 << 2)
+#define CPU_FEATURE_SSSE3 (1 << 3)
+
+/*
+ * get the SIMD features supported by the running cpu
+ *   (detected once, on the first call, from any thread)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: bitmask of CPU_FEATURE_XXX flags
+ */
+uint32_t get_cpu_features();
+
+/*
+ * restrict the SIMD features returned by get_cpu_features
+ *   used by the tests and benchmarks to run every kernel;
+ *   must be called before any conversion thread is started
+ * args:
+ *   mask - bitmask of allowed CPU_FEATURE_XXX flags
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void set_cpu_features_mask(uint32_t mask);
+
+#endif
@@ -34,10 +34,24 @@
 #include <math.h>
 #include <assert.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 #include "gviewv4l2core.h"
 #include "dct.h"
+#include "cpu_features.h"
 #include "gview.h"
 
+/*  DCT coeficients: all values are shifted left by 10 */
+/*  and rounded off to nearest integer                 */
+#define DCT_C1 (1420)    /* cos PI/16 * root(2)  */
+#define DCT_C2 (1338)    /* cos PI/8 * root(2)   */
+#define DCT_C3 (1204)    /* cos 3PI/16 * root(2) */
+#define DCT_C5 (805)     /* cos 5PI/16 * root(2) */
+#define DCT_C6 (554)     /* cos 3PI/8 * root(2)  */
+#define DCT_C7 (283)     /* cos 7PI/16 * root(2) */
+
 
 /*
  * Level shifting to get 8 bit SIGNED values for the data
@@ -162,4 +176,220 @@ void DCT (int16_t *data)
 
 		data++;
 	}
-}
\ No newline at end of file
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/*interleaved coeficient pair (ca, cb) for _mm_madd_epi16*/
+#define DCT_PAIR(ca, cb) _mm_set_epi16(cb, ca, cb, ca, cb, ca, cb, ca)
+
+/*
+ * transpose a 8x8 block of 16 bit values
+ * args:
+ *    v - pointer to the 8 block rows (replaced by the columns)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+__attribute__((target("sse2"), always_inline))
+static inline void transpose_8x8_sse2(__m128i *v)
+{
+	__m128i a0 = _mm_unpacklo_epi16(v[0], v[1]);
+	__m128i a1 = _mm_unpackhi_epi16(v[0], v[1]);
+	__m128i a2 = _mm_unpacklo_epi16(v[2], v[3]);
+	__m128i a3 = _mm_unpackhi_epi16(v[2], v[3]);
+	__m128i a4 = _mm_unpacklo_epi16(v[4], v[5]);
+	__m128i a5 = _mm_unpackhi_epi16(v[4], v[5]);
+	__m128i a6 = _mm_unpacklo_epi16(v[6], v[7]);
+	__m128i a7 = _mm_unpackhi_epi16(v[6], v[7]);
+
+	__m128i b0 = _mm_unpacklo_epi32(a0, a2);
+	__m128i b1 = _mm_unpackhi_epi32(a0, a2);
+	__m128i b2 = _mm_unpacklo_epi32(a1, a3);
+	__m128i b3 = _mm_unpackhi_epi32(a1, a3);
+	__m128i b4 = _mm_unpacklo_epi32(a4, a6);
+	__m128i b5 = _mm_unpackhi_epi32(a4, a6);
+	__m128i b6 = _mm_unpacklo_epi32(a5, a7);
+	__m128i b7 = _mm_unpackhi_epi32(a5, a7);
+
+	v[0] = _mm_unpacklo_epi64(b0, b4);
+	v[1] = _mm_unpackhi_epi64(b0, b4);
+	v[2] = _mm_unpacklo_epi64(b1, b5);
+	v[3] = _mm_unpackhi_epi64(b1, b5);
+	v[4] = _mm_unpacklo_epi64(b2, b6);
+	v[5] = _mm_unpackhi_epi64(b2, b6);
+	v[6] = _mm_unpacklo_epi64(b3, b7);
+	v[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+/*
+ * sum of two 16 bit products (a * ca + b * cb) >> shift
+ *   products are 32 bit, the result is packed back to 16 bit
+ * args:
+ *    a, b - 16 bit values
+ *    cab - interleaved coeficients (ca, cb)
+ *    c, d - 16 bit values (second pair)
+ *    ccd - interleaved coeficients (cc, cd)
+ *    shift - result shift
+ *
+ * asserts:
+ *    none
+ *
+ * returns: 8 16 bit results
+ */
+__attribute__((target("sse2"), always_inline))
+static inline __m128i madd4_sse2(__m128i a, __m128i b, __m128i cab,
+	__m128i c, __m128i d, __m128i ccd, __m128i shift)
+{
+	__m128i lo = _mm_add_epi32(
+		_mm_madd_epi16(_mm_unpacklo_epi16(a, b), cab),
+		_mm_madd_epi16(_mm_unpacklo_epi16(c, d), ccd));
+	__m128i hi = _mm_add_epi32(
+		_mm_madd_epi16(_mm_unpackhi_epi16(a, b), cab),
+		_mm_madd_epi16(_mm_unpackhi_epi16(c, d), ccd));
+
+	return _mm_packs_epi32(_mm_sra_epi32(lo, shift), _mm_sra_epi32(hi, shift));
+}
+
+/*
+ * one DCT pass over 8 lanes (the scalar row or column pass)
+ *   all intermediate values fit in 16 bits (8 bit input)
+ * args:
+ *    v - pointer to the 8 input vectors (replaced by the output)
+ *    dc_shift - shift for the 0 and 4 coeficients
+ *    shift - shift for the other coeficients
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+__attribute__((target("sse2"), always_inline))
+static inline void dct_pass_sse2(__m128i *v, int dc_shift, int shift)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i sh = _mm_cvtsi32_si128(shift);
+	const __m128i dc_sh = _mm_cvtsi32_si128(dc_shift);
+
+	/*coeficient pairs (a * ca + b * cb)*/
+	const __m128i c2_c6 = DCT_PAIR(DCT_C2, DCT_C6);
+	const __m128i c6_mc2 = DCT_PAIR(DCT_C6, -DCT_C2);
+
+	const __m128i c7_mc5 = DCT_PAIR(DCT_C7, -DCT_C5);
+	const __m128i c3_mc1 = DCT_PAIR(DCT_C3, -DCT_C1);
+	const __m128i c5_mc1 = DCT_PAIR(DCT_C5, -DCT_C1);
+	const __m128i c7_c3 = DCT_PAIR(DCT_C7, DCT_C3);
+	const __m128i c3_mc7 = DCT_PAIR(DCT_C3, -DCT_C7);
+	const __m128i mc1_mc5 = DCT_PAIR(-DCT_C1, -DCT_C5);
+	const __m128i c1_c3 = DCT_PAIR(DCT_C1, DCT_C3);
+	const __m128i c5_c7 = DCT_PAIR(DCT_C5, DCT_C7);
+
+	__m128i x8 = _mm_add_epi16(v[0], v[7]);
+	__m128i x0 = _mm_sub_epi16(v[0], v[7]);
+
+	__m128i x7 = _mm_add_epi16(v[1], v[6]);
+	__m128i x1 = _mm_sub_epi16(v[1], v[6]);
+
+	__m128i x6 = _mm_add_epi16(v[2], v[5]);
+	__m128i x2 = _mm_sub_epi16(v[2], v[5]);
+
+	__m128i x5 = _mm_add_epi16(v[3], v[4]);
+	__m128i x3 = _mm_sub_epi16(v[3], v[4]);
+
+	__m128i x4 = _mm_add_epi16(x8, x5);
+	x8 = _mm_sub_epi16(x8, x5);
+
+	x5 = _mm_add_epi16(x7, x6);
+	x7 = _mm_sub_epi16(x7, x6);
+
+	v[0] = _mm_sra_epi16(_mm_add_epi16(x4, x5), dc_sh);
+	v[4] = _mm_sra_epi16(_mm_sub_epi16(x4, x5), dc_sh);
+
+	v[2] = madd4_sse2(x8, x7, c2_c6, zero, zero, zero, sh);
+	v[6] = madd4_sse2(x8, x7, c6_mc2, zero, zero, zero, sh);
+
+	v[7] = madd4_sse2(x0, x1, c7_mc5, x2, x3, c3_mc1, sh);
+	v[5] = madd4_sse2(x0, x1, c5_mc1, x2, x3, c7_c3, sh);
+	v[3] = madd4_sse2(x0, x1, c3_mc7, x2, x3, mc1_mc5, sh);
+	v[1] = madd4_sse2(x0, x1, c1_c3, x2, x3, c5_c7, sh);
+}
+
+/*
+ * DCT for One block(8x8) and quantization using sse2
+ *   (bit exact with the scalar code)
+ * args:
+ *    data - pointer to level shifted block data
+ *           (replaced by the quantized coefficients, natural order)
+ *    quant - pointer to reciprocal quantization table (Q15, < 0x8000)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+__attribute__((target("sse2")))
+static void DCT_quant_sse2(int16_t *data, const uint16_t *quant)
+{
+	__m128i v[8];
+	const __m128i round = _mm_set1_epi32(0x4000);
+
+	int i = 0;
+	for(i = 0; i < 8; i++)
+		v[i] = _mm_loadu_si128((__m128i *) (data + 8 * i));
+
+	/*row pass: lane i is row i*/
+	transpose_8x8_sse2(v);
+	dct_pass_sse2(v, 0, 10);
+
+	/*column pass: lane j is column j*/
+	transpose_8x8_sse2(v);
+	dct_pass_sse2(v, 3, 13);
+
+	/*quantization: (coef * quant + 0x4000) >> 15*/
+	for(i = 0; i < 8; i++)
+	{
+		__m128i q = _mm_loadu_si128((__m128i *) (quant + 8 * i));
+		__m128i lo = _mm_mullo_epi16(v[i], q);
+		__m128i hi = _mm_mulhi_epi16(v[i], q);
+
+		__m128i p0 = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round), 15);
+		__m128i p1 = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round), 15);
+
+		_mm_storeu_si128((__m128i *) (data + 8 * i), _mm_packs_epi32(p0, p1));
+	}
+}
+
+#endif
+
+/*
+ * DCT for One block(8x8) and quantization (jpeg encoder)
+ *   each coefficient is then (coef * quant + 0x4000) >> 15
+ *   uses simd if available (bit exact with the scalar code)
+ * args:
+ *    data - pointer to level shifted block data
+ *           (replaced by the quantized coefficients, natural order)
+ *    quant - pointer to reciprocal quantization table (Q15, < 0x8000)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void DCT_quant (int16_t *data, const uint16_t *quant)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	if(get_cpu_features() & CPU_FEATURE_SSE2)
+	{
+		DCT_quant_sse2(data, quant);
+		return;
+	}
+#endif
+
+	DCT(data);
+
+	int i = 0;
+	for(i = 0; i < 64; i++)
+		data[i] = (int16_t) ((data[i] * quant[i] + 0x4000) >> 15);
+}
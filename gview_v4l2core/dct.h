@@ -56,4 +56,20 @@ void levelshift (int16_t * const data);
  */
 void DCT (int16_t *data);
 
+/*
+ * DCT for One block(8x8) and quantization (jpeg encoder)
+ *   each coefficient is then (coef * quant + 0x4000) >> 15
+ *   uses simd if available (bit exact with the scalar code)
+ * args:
+ *    data - pointer to level shifted block data
+ *           (replaced by the quantized coefficients, natural order)
+ *    quant - pointer to reciprocal quantization table (Q15, < 0x8000)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void DCT_quant (int16_t *data, const uint16_t *quant);
+
 #endif
\ No newline at end of file
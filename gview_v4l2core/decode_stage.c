@@ -0,0 +1,381 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "gview.h"
+#include "gviewv4l2core.h"
+#include "v4l2_core.h"
+#include "frame_decoder.h"
+#include "jpeg_decoder.h"
+#include "decode_stage.h"
+#include "../config.h"
+
+extern int verbosity;
+
+typedef struct _decode_worker_t
+{
+	decode_stage_t *stage;
+	jpeg_decoder_context_t *jpeg_ctx; //worker (m)jpeg decoder (NULL if not needed)
+} decode_worker_t;
+
+typedef struct _decode_job_t
+{
+	v4l2_frame_buff_t *frame;          //frame to decode
+	int done;                          //flag set when decoding finished
+} decode_job_t;
+
+struct _decode_stage_t
+{
+	v4l2_dev_t *vd;                    //device data
+
+	int nworkers;                      //number of decoding threads
+	__THREAD_TYPE threads[DECODE_STAGE_MAX_WORKERS];
+	decode_worker_t workers[DECODE_STAGE_MAX_WORKERS];
+
+	__MUTEX_TYPE mutex;                //protects the job ring
+	__COND_TYPE job_cond;              //signals a new job (or quit)
+	__COND_TYPE done_cond;             //signals a decoded frame
+
+	int quit;                          //flag workers to exit
+
+	decode_job_t *jobs;                //job ring (one entry per frame queue slot)
+	int njobs;                         //job ring size
+	uint64_t head;                     //oldest job not yet returned
+	uint64_t next;                     //next job to decode
+	uint64_t tail;                     //next free job entry
+
+	uint8_t **raw_buff;                //raw frame copies (one per frame queue slot)
+	size_t *raw_buff_size;             //raw frame copies size
+};
+
+/*
+ * decode stage worker thread loop
+ * args:
+ *    arg - pointer to worker data
+ *
+ * asserts:
+ *    none
+ *
+ * returns: NULL
+ */
+static void *decode_worker_loop(void *arg)
+{
+	decode_worker_t *worker = (decode_worker_t *) arg;
+	decode_stage_t *stage = worker->stage;
+
+	__LOCK_MUTEX(&stage->mutex);
+	while(!stage->quit)
+	{
+		if(stage->next == stage->tail)
+		{
+			__COND_WAIT(&stage->job_cond, &stage->mutex);
+			continue;
+		}
+
+		decode_job_t *job = &stage->jobs[stage->next % stage->njobs];
+		stage->next++;
+		__UNLOCK_MUTEX(&stage->mutex);
+
+		if(decode_v4l2_frame_ctx(stage->vd, job->frame, worker->jpeg_ctx) != E_OK)
+			fprintf(stderr, "V4L2_CORE: Error - Couldn't decode frame\n");
+
+		__LOCK_MUTEX(&stage->mutex);
+		job->done = 1;
+		__COND_BCAST(&stage->done_cond);
+	}
+	__UNLOCK_MUTEX(&stage->mutex);
+
+	return NULL;
+}
+
+/*
+ * create a decode stage (pipelined frame decoding)
+ *   frames are decoded by the stage workers and returned in capture order
+ * args:
+ *    vd - pointer to v4l2 device handler
+ *    nworkers - number of decoding threads
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns: pointer to decode stage (NULL on error)
+ */
+decode_stage_t *decode_stage_create(v4l2_dev_t *vd, int nworkers)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	if(nworkers > DECODE_STAGE_MAX_WORKERS)
+		nworkers = DECODE_STAGE_MAX_WORKERS;
+	if(nworkers < 1)
+		nworkers = 1;
+
+	decode_stage_t *stage = calloc(1, sizeof(decode_stage_t));
+	if(stage == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (decode_stage_create): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	stage->vd = vd;
+	stage->njobs = vd->frame_queue_size;
+	stage->jobs = calloc(stage->njobs, sizeof(decode_job_t));
+	stage->raw_buff = calloc(stage->njobs, sizeof(uint8_t *));
+	stage->raw_buff_size = calloc(stage->njobs, sizeof(size_t));
+	if(stage->jobs == NULL || stage->raw_buff == NULL || stage->raw_buff_size == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (decode_stage_create): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	__INIT_MUTEX(&stage->mutex);
+	__INIT_COND(&stage->job_cond);
+	__INIT_COND(&stage->done_cond);
+
+	int use_jpeg_ctx = (vd->requested_fmt == V4L2_PIX_FMT_JPEG ||
+		vd->requested_fmt == V4L2_PIX_FMT_MJPEG);
+
+	int i = 0;
+	for(i = 0; i < nworkers; i++)
+	{
+		stage->workers[i].stage = stage;
+		stage->workers[i].jpeg_ctx = NULL;
+
+		/*each worker needs its own (m)jpeg decoder*/
+		if(use_jpeg_ctx)
+		{
+			stage->workers[i].jpeg_ctx = jpeg_init_decoder_ctx(
+				vd->format.fmt.pix.width,
+				vd->format.fmt.pix.height);
+			if(stage->workers[i].jpeg_ctx == NULL)
+			{
+				fprintf(stderr, "V4L2_CORE: (decode stage) couldn't init jpeg decoder for worker %i\n", i);
+				break;
+			}
+		}
+
+		if(__THREAD_CREATE(&stage->threads[i], decode_worker_loop, &stage->workers[i]))
+		{
+			fprintf(stderr, "V4L2_CORE: (decode stage) couldn't create worker thread %i\n", i);
+			jpeg_close_decoder_ctx(stage->workers[i].jpeg_ctx);
+			stage->workers[i].jpeg_ctx = NULL;
+			break;
+		}
+		stage->nworkers++;
+	}
+
+	if(stage->nworkers < 1)
+	{
+		decode_stage_destroy(stage);
+		return NULL;
+	}
+
+	if(verbosity > 0)
+		printf("V4L2_CORE: (decode stage) %i frame queue with %i decoding threads\n",
+			stage->njobs, stage->nworkers);
+
+	return stage;
+}
+
+/*
+ * stop the stage workers and free the decode stage
+ *   frames still in the stage are flagged as ready (free)
+ * args:
+ *    stage - pointer to decode stage (can be NULL)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void decode_stage_destroy(decode_stage_t *stage)
+{
+	if(stage == NULL)
+		return;
+
+	__LOCK_MUTEX(&stage->mutex);
+	stage->quit = 1;
+	__COND_BCAST(&stage->job_cond);
+	__UNLOCK_MUTEX(&stage->mutex);
+
+	int i = 0;
+	for(i = 0; i < stage->nworkers; i++)
+	{
+		__THREAD_JOIN(stage->threads[i]);
+		jpeg_close_decoder_ctx(stage->workers[i].jpeg_ctx);
+	}
+
+	/*frames not returned yet are free again*/
+	for(; stage->head < stage->tail; stage->head++)
+	{
+		v4l2_frame_buff_t *frame = stage->jobs[stage->head % stage->njobs].frame;
+		frame->raw_frame = NULL;
+		frame->raw_frame_size = 0;
+		frame->status = FRAME_READY;
+	}
+
+	for(i = 0; i < stage->njobs; i++)
+		if(stage->raw_buff[i])
+			free(stage->raw_buff[i]);
+
+	__CLOSE_COND(&stage->done_cond);
+	__CLOSE_COND(&stage->job_cond);
+	__CLOSE_MUTEX(&stage->mutex);
+
+	free(stage->raw_buff_size);
+	free(stage->raw_buff);
+	free(stage->jobs);
+	free(stage);
+}
+
+/*
+ * get the number of decode stage workers
+ * args:
+ *    stage - pointer to decode stage (can be NULL)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of workers (0 if stage is NULL)
+ */
+int decode_stage_get_workers(decode_stage_t *stage)
+{
+	if(stage == NULL)
+		return 0;
+
+	return stage->nworkers;
+}
+
+/*
+ * submit a captured frame for decoding
+ *   the raw frame data is copied to a stage buffer, so the
+ *   driver buffer can be requeued right after this call
+ * args:
+ *    stage - pointer to decode stage
+ *    frame - pointer to captured frame (from the device frame queue)
+ *
+ * asserts:
+ *    stage is not null
+ *    frame is not null
+ *
+ * returns: none
+ */
+void decode_stage_submit(decode_stage_t *stage, v4l2_frame_buff_t *frame)
+{
+	/*assertions*/
+	assert(stage != NULL);
+	assert(frame != NULL);
+
+	int qind = frame - stage->vd->frame_queue;
+	assert(qind >= 0 && qind < stage->njobs);
+
+	if(frame->raw_frame_size > stage->raw_buff_size[qind])
+	{
+		/*compressed frame sizes change, so allocate the maximum size once*/
+		size_t size = frame->raw_frame_size;
+		if(size < stage->vd->format.fmt.pix.sizeimage)
+			size = stage->vd->format.fmt.pix.sizeimage;
+
+		if(stage->raw_buff[qind])
+			free(stage->raw_buff[qind]);
+		stage->raw_buff[qind] = malloc(size);
+		if(stage->raw_buff[qind] == NULL)
+		{
+			fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (decode_stage_submit): %s\n", strerror(errno));
+			exit(-1);
+		}
+		stage->raw_buff_size[qind] = size;
+		decoder_count_alloc();
+	}
+
+	if(frame->raw_frame && frame->raw_frame_size > 0)
+		memcpy(stage->raw_buff[qind], frame->raw_frame, frame->raw_frame_size);
+	frame->raw_frame = stage->raw_buff[qind];
+
+	__LOCK_MUTEX(&stage->mutex);
+	/*each frame queue slot is in the ring at most once*/
+	assert(stage->tail - stage->head < (uint64_t) stage->njobs);
+	decode_job_t *job = &stage->jobs[stage->tail % stage->njobs];
+	job->frame = frame;
+	job->done = 0;
+	stage->tail++;
+	__COND_SIGNAL(&stage->job_cond);
+	__UNLOCK_MUTEX(&stage->mutex);
+}
+
+/*
+ * get the oldest submitted frame (waits for it to be decoded)
+ * args:
+ *    stage - pointer to decode stage
+ *
+ * asserts:
+ *    stage is not null
+ *
+ * returns: pointer to decoded frame (NULL if no frame was submitted)
+ */
+v4l2_frame_buff_t *decode_stage_get_frame(decode_stage_t *stage)
+{
+	/*assertions*/
+	assert(stage != NULL);
+
+	v4l2_frame_buff_t *frame = NULL;
+
+	__LOCK_MUTEX(&stage->mutex);
+	if(stage->head < stage->tail)
+	{
+		decode_job_t *job = &stage->jobs[stage->head % stage->njobs];
+		while(!job->done)
+			__COND_WAIT(&stage->done_cond, &stage->mutex);
+
+		frame = job->frame;
+		stage->head++;
+	}
+	__UNLOCK_MUTEX(&stage->mutex);
+
+	return frame;
+}
+
+/*
+ * get the number of submitted frames not yet returned
+ * args:
+ *    stage - pointer to decode stage
+ *
+ * asserts:
+ *    stage is not null
+ *
+ * returns: number of frames in the stage
+ */
+int decode_stage_get_pending(decode_stage_t *stage)
+{
+	/*assertions*/
+	assert(stage != NULL);
+
+	__LOCK_MUTEX(&stage->mutex);
+	int pending = (int) (stage->tail - stage->head);
+	__UNLOCK_MUTEX(&stage->mutex);
+
+	return pending;
+}
@@ -0,0 +1,113 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#ifndef DECODE_STAGE_H
+#define DECODE_STAGE_H
+
+#include "gviewv4l2core.h"
+
+/*
+ * maximum number of decode stage workers
+ */
+#define DECODE_STAGE_MAX_WORKERS (8)
+
+typedef struct _decode_stage_t decode_stage_t;
+
+/*
+ * create a decode stage (pipelined frame decoding)
+ *   frames are decoded by the stage workers and returned in capture order
+ * args:
+ *    vd - pointer to v4l2 device handler
+ *    nworkers - number of decoding threads
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns: pointer to decode stage (NULL on error)
+ */
+decode_stage_t *decode_stage_create(v4l2_dev_t *vd, int nworkers);
+
+/*
+ * stop the stage workers and free the decode stage
+ *   frames still in the stage are flagged as ready (free)
+ * args:
+ *    stage - pointer to decode stage (can be NULL)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void decode_stage_destroy(decode_stage_t *stage);
+
+/*
+ * get the number of decode stage workers
+ * args:
+ *    stage - pointer to decode stage (can be NULL)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of workers (0 if stage is NULL)
+ */
+int decode_stage_get_workers(decode_stage_t *stage);
+
+/*
+ * submit a captured frame for decoding
+ *   the raw frame data is copied to a stage buffer, so the
+ *   driver buffer can be requeued right after this call
+ * args:
+ *    stage - pointer to decode stage
+ *    frame - pointer to captured frame (from the device frame queue)
+ *
+ * asserts:
+ *    stage is not null
+ *    frame is not null
+ *
+ * returns: none
+ */
+void decode_stage_submit(decode_stage_t *stage, v4l2_frame_buff_t *frame);
+
+/*
+ * get the oldest submitted frame (waits for it to be decoded)
+ * args:
+ *    stage - pointer to decode stage
+ *
+ * asserts:
+ *    stage is not null
+ *
+ * returns: pointer to decoded frame (NULL if no frame was submitted)
+ */
+v4l2_frame_buff_t *decode_stage_get_frame(decode_stage_t *stage);
+
+/*
+ * get the number of submitted frames not yet returned
+ * args:
+ *    stage - pointer to decode stage
+ *
+ * asserts:
+ *    stage is not null
+ *
+ * returns: number of frames in the stage
+ */
+int decode_stage_get_pending(decode_stage_t *stage);
+
+#endif
@@ -0,0 +1,394 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "gview.h"
+#include "gviewv4l2core.h"
+#include "decoder_pool.h"
+#include "frame_decoder.h"
+#include "../config.h"
+
+typedef struct _decoder_worker_t
+{
+	decoder_pool_t *pool;
+	int index; //scratch buffer index
+} decoder_worker_t;
+
+struct _decoder_pool_t
+{
+	int nthreads;                      //decoding threads (workers + caller)
+	__THREAD_TYPE threads[DECODER_MAX_THREADS];
+	decoder_worker_t workers[DECODER_MAX_THREADS];
+
+	__MUTEX_TYPE run_mutex;            //serializes decoder_pool_run calls
+	__MUTEX_TYPE mutex;                //protects the job data
+	__COND_TYPE job_cond;              //signals a new job (or quit)
+	__COND_TYPE done_cond;             //signals the last worker finished
+
+	int quit;                          //flag workers to exit
+	uint32_t job_id;                   //current job sequence number
+	decoder_stripe_func func;          //current job function
+	void *data;                        //current job data
+	int height;                        //current job frame height
+	int stripe_lines;                  //current job stripe height
+	int next_line;                     //first line of the next free stripe
+	int busy_workers;                  //workers still running the current job
+
+	uint8_t *scratch[DECODER_MAX_THREADS]; //per thread scratch buffers
+	size_t scratch_size;               //size of each scratch buffer
+};
+
+/*
+ * get the next free stripe of the current job
+ * args:
+ *    pool - pointer to pool
+ *    line_start - pointer to stripe first line
+ *    line_end - pointer to stripe end line
+ *
+ * asserts:
+ *    none
+ *
+ * returns: TRUE if a stripe was assigned, FALSE if none is left
+ */
+static int get_next_stripe(decoder_pool_t *pool, int *line_start, int *line_end)
+{
+	int ret = FALSE;
+
+	__LOCK_MUTEX(&pool->mutex);
+	if(pool->next_line < pool->height)
+	{
+		*line_start = pool->next_line;
+		*line_end = pool->next_line + pool->stripe_lines;
+		if(*line_end > pool->height)
+			*line_end = pool->height;
+		pool->next_line = *line_end;
+		ret = TRUE;
+	}
+	__UNLOCK_MUTEX(&pool->mutex);
+
+	return ret;
+}
+
+/*
+ * process stripes of the current job until none is left
+ * args:
+ *    pool - pointer to pool
+ *    index - scratch buffer index of the calling thread
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void run_stripes(decoder_pool_t *pool, int index)
+{
+	int line_start = 0;
+	int line_end = 0;
+
+	while(get_next_stripe(pool, &line_start, &line_end))
+		pool->func(pool->data, line_start, line_end, pool->scratch[index]);
+}
+
+/*
+ * decoder worker thread loop
+ * args:
+ *    arg - pointer to worker data
+ *
+ * asserts:
+ *    none
+ *
+ * returns: NULL
+ */
+static void *decoder_worker_loop(void *arg)
+{
+	decoder_worker_t *worker = (decoder_worker_t *) arg;
+	decoder_pool_t *pool = worker->pool;
+
+	uint32_t last_job = 0;
+
+	__LOCK_MUTEX(&pool->mutex);
+	while(!pool->quit)
+	{
+		if(pool->job_id == last_job)
+		{
+			__COND_WAIT(&pool->job_cond, &pool->mutex);
+			continue;
+		}
+		last_job = pool->job_id;
+		__UNLOCK_MUTEX(&pool->mutex);
+
+		run_stripes(pool, worker->index);
+
+		__LOCK_MUTEX(&pool->mutex);
+		pool->busy_workers--;
+		if(pool->busy_workers <= 0)
+			__COND_SIGNAL(&pool->done_cond);
+	}
+	__UNLOCK_MUTEX(&pool->mutex);
+
+	return NULL;
+}
+
+/*
+ * create a persistent pool of decoder threads
+ * args:
+ *    nthreads - total number of decoding threads (including the caller)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to pool (NULL if nthreads < 2 or on error)
+ */
+decoder_pool_t *decoder_pool_create(int nthreads)
+{
+	if(nthreads > DECODER_MAX_THREADS)
+		nthreads = DECODER_MAX_THREADS;
+
+	if(nthreads < 2)
+		return NULL;
+
+	decoder_pool_t *pool = calloc(1, sizeof(decoder_pool_t));
+	if(pool == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (decoder_pool_create): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	__INIT_MUTEX(&pool->run_mutex);
+	__INIT_MUTEX(&pool->mutex);
+	__INIT_COND(&pool->job_cond);
+	__INIT_COND(&pool->done_cond);
+
+	/*index 0 is the calling thread*/
+	pool->nthreads = 1;
+
+	int i = 0;
+	for(i = 1; i < nthreads; i++)
+	{
+		pool->workers[i].pool = pool;
+		pool->workers[i].index = i;
+
+		if(__THREAD_CREATE(&pool->threads[i], decoder_worker_loop, &pool->workers[i]))
+		{
+			fprintf(stderr, "V4L2_CORE: (decoder pool) couldn't create worker thread %i\n", i);
+			break;
+		}
+		pool->nthreads++;
+	}
+
+	if(pool->nthreads < 2)
+	{
+		decoder_pool_destroy(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+/*
+ * stop the pool threads and free the pool
+ * args:
+ *    pool - pointer to pool (can be NULL)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void decoder_pool_destroy(decoder_pool_t *pool)
+{
+	if(pool == NULL)
+		return;
+
+	__LOCK_MUTEX(&pool->mutex);
+	pool->quit = 1;
+	__COND_BCAST(&pool->job_cond);
+	__UNLOCK_MUTEX(&pool->mutex);
+
+	int i = 0;
+	for(i = 1; i < pool->nthreads; i++)
+		__THREAD_JOIN(pool->threads[i]);
+
+	for(i = 0; i < DECODER_MAX_THREADS; i++)
+		if(pool->scratch[i])
+			free(pool->scratch[i]);
+
+	__CLOSE_COND(&pool->done_cond);
+	__CLOSE_COND(&pool->job_cond);
+	__CLOSE_MUTEX(&pool->mutex);
+	__CLOSE_MUTEX(&pool->run_mutex);
+
+	free(pool);
+}
+
+/*
+ * get the number of decoding threads (including the caller)
+ * args:
+ *    pool - pointer to pool (can be NULL)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of threads (1 if pool is NULL)
+ */
+int decoder_pool_get_threads(decoder_pool_t *pool)
+{
+	if(pool == NULL)
+		return 1;
+
+	return pool->nthreads;
+}
+
+/*
+ * process [0, height) in stripes on the pool threads and
+ *  on the calling thread (blocks until done)
+ * args:
+ *    pool - pointer to pool
+ *    func - stripe job function
+ *    data - job data
+ *    height - total number of lines (or jobs)
+ *    stripe_lines - lines (or jobs) in each stripe
+ *    scratch_size - per thread scratch buffer size (bytes)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: error code (E_OK)
+ */
+static int run_job(decoder_pool_t *pool, decoder_stripe_func func, void *data,
+	int height, int stripe_lines, size_t scratch_size)
+{
+	__LOCK_MUTEX(&pool->run_mutex);
+
+	/*workers are idle here, so scratch buffers can be resized*/
+	if(scratch_size > pool->scratch_size)
+	{
+		int i = 0;
+		for(i = 0; i < pool->nthreads; i++)
+		{
+			if(pool->scratch[i])
+				free(pool->scratch[i]);
+			pool->scratch[i] = malloc(scratch_size);
+			if(pool->scratch[i] == NULL)
+			{
+				fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (decoder_pool): %s\n", strerror(errno));
+				exit(-1);
+			}
+			decoder_count_alloc();
+		}
+		pool->scratch_size = scratch_size;
+	}
+
+	__LOCK_MUTEX(&pool->mutex);
+	pool->func = func;
+	pool->data = data;
+	pool->height = height;
+	pool->stripe_lines = stripe_lines;
+	pool->next_line = 0;
+	pool->busy_workers = pool->nthreads - 1;
+	pool->job_id++;
+	__COND_BCAST(&pool->job_cond);
+	__UNLOCK_MUTEX(&pool->mutex);
+
+	/*the caller also decodes stripes*/
+	run_stripes(pool, 0);
+
+	__LOCK_MUTEX(&pool->mutex);
+	while(pool->busy_workers > 0)
+		__COND_WAIT(&pool->done_cond, &pool->mutex);
+	__UNLOCK_MUTEX(&pool->mutex);
+
+	__UNLOCK_MUTEX(&pool->run_mutex);
+
+	return E_OK;
+}
+
+/*
+ * split a frame in stripes of 2 line aligned height and process them
+ *  on the pool threads and on the calling thread (blocks until done)
+ * args:
+ *    pool - pointer to pool
+ *    func - stripe job function
+ *    data - job data
+ *    height - frame height (in lines)
+ *    line_scratch_size - per thread scratch needed for each stripe line (bytes)
+ *
+ * asserts:
+ *    pool is not null
+ *    func is not null
+ *
+ * returns: error code (E_OK)
+ */
+int decoder_pool_run(decoder_pool_t *pool, decoder_stripe_func func, void *data,
+	int height, size_t line_scratch_size)
+{
+	/*assertions*/
+	assert(pool != NULL);
+	assert(func != NULL);
+
+	/*
+	 * a few stripes per thread balance the load, the
+	 * stripe height must be even (chroma is subsampled)
+	 */
+	int stripe_lines = (height / (pool->nthreads * 4)) & ~1;
+	if(stripe_lines < 16)
+		stripe_lines = 16;
+
+	return run_job(pool, func, data, height, stripe_lines,
+		stripe_lines * line_scratch_size);
+}
+
+/*
+ * process njobs independent jobs on the pool threads and
+ *  on the calling thread (blocks until done)
+ *  func is called with consecutive job ranges [start, end)
+ * args:
+ *    pool - pointer to pool
+ *    func - job function
+ *    data - job data
+ *    njobs - number of jobs
+ *    scratch_size - per thread scratch buffer size (bytes)
+ *
+ * asserts:
+ *    pool is not null
+ *    func is not null
+ *
+ * returns: error code (E_OK)
+ */
+int decoder_pool_run_jobs(decoder_pool_t *pool, decoder_stripe_func func, void *data,
+	int njobs, size_t scratch_size)
+{
+	/*assertions*/
+	assert(pool != NULL);
+	assert(func != NULL);
+
+	/*a few ranges per thread balance the load*/
+	int range = njobs / (pool->nthreads * 4);
+	if(range < 1)
+		range = 1;
+
+	return run_job(pool, func, data, njobs, range, scratch_size);
+}
@@ -0,0 +1,121 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#ifndef DECODER_POOL_H
+#define DECODER_POOL_H
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+/*
+ * maximum number of decoder threads (including the calling thread)
+ */
+#define DECODER_MAX_THREADS (16)
+
+/*
+ * stripe job: process lines [line_start, line_end) of a frame
+ * args:
+ *    data - job data
+ *    line_start - first line of the stripe (even)
+ *    line_end - line after the last one of the stripe
+ *    scratch - per thread scratch buffer (as requested in decoder_pool_run)
+ */
+typedef void (*decoder_stripe_func)(void *data, int line_start, int line_end,
+	uint8_t *scratch);
+
+typedef struct _decoder_pool_t decoder_pool_t;
+
+/*
+ * create a persistent pool of decoder threads
+ * args:
+ *    nthreads - total number of decoding threads (including the caller)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to pool (NULL if nthreads < 2 or on error)
+ */
+decoder_pool_t *decoder_pool_create(int nthreads);
+
+/*
+ * stop the pool threads and free the pool
+ * args:
+ *    pool - pointer to pool (can be NULL)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void decoder_pool_destroy(decoder_pool_t *pool);
+
+/*
+ * get the number of decoding threads (including the caller)
+ * args:
+ *    pool - pointer to pool (can be NULL)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of threads (1 if pool is NULL)
+ */
+int decoder_pool_get_threads(decoder_pool_t *pool);
+
+/*
+ * split a frame in stripes of 2 line aligned height and process them
+ *  on the pool threads and on the calling thread (blocks until done)
+ * args:
+ *    pool - pointer to pool
+ *    func - stripe job function
+ *    data - job data
+ *    height - frame height (in lines)
+ *    line_scratch_size - per thread scratch needed for each stripe line (bytes)
+ *
+ * asserts:
+ *    pool is not null
+ *    func is not null
+ *
+ * returns: error code (E_OK)
+ */
+int decoder_pool_run(decoder_pool_t *pool, decoder_stripe_func func, void *data,
+	int height, size_t line_scratch_size);
+
+/*
+ * process njobs independent jobs on the pool threads and
+ *  on the calling thread (blocks until done)
+ *  func is called with consecutive job ranges [start, end)
+ * args:
+ *    pool - pointer to pool
+ *    func - job function
+ *    data - job data
+ *    njobs - number of jobs
+ *    scratch_size - per thread scratch buffer size (bytes)
+ *
+ * asserts:
+ *    pool is not null
+ *    func is not null
+ *
+ * returns: error code (E_OK)
+ */
+int decoder_pool_run_jobs(decoder_pool_t *pool, decoder_stripe_func func, void *data,
+	int njobs, size_t scratch_size);
+
+#endif
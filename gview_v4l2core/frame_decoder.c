@@ -36,10 +36,16 @@
 #include "frame_decoder.h"
 #include "jpeg_decoder.h"
 #include "colorspaces.h"
+#include "decoder_pool.h"
+#include "gview.h"
 #include "../config.h"
 
 extern int verbosity;
 
+/*heap allocations done while decoding frames*/
+static uint64_t decoder_allocs = 0;
+static __MUTEX_TYPE decoder_allocs_mutex = __STATIC_MUTEX_INIT;
+
 /*
  * Alloc image buffers for decoding video stream
  * args:
@@ -461,6 +467,7 @@ static int parse_NALU(uint8_t type, uint8_t **NALU, uint8_t *buff, int size)
 		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (parse_NALU): %s\n", strerror(errno));
 		exit(-1);
 	}
+	decoder_count_alloc();
 	memcpy(*NALU, nal, nal_size);
 
 	//char test_filename2[20];
@@ -725,6 +732,273 @@ static int demux_h264(uint8_t* h264_data, uint8_t* buffer, int size, int h264_ma
 
 }
 
+/*
+ * slice-parallel conversion of a raw frame
+ */
+typedef struct _stripe_conv_t
+{
+	void (*convert)(uint8_t *out, uint8_t *in, int width, int height); //*_to_yu12
+	uint8_t *out;      //yu12 frame
+	uint8_t *in;       //raw frame
+	int width;         //frame width
+	int height;        //frame height
+	int in_line_size;  //bytes per raw frame line
+	int bayer_order;   //bayer pixel order (-1 if not bayer)
+} stripe_conv_t;
+
+/*
+ * convert a stripe of the raw frame into the yu12 frame
+ *   the stripe is converted into the thread scratch buffer as a
+ *   small yu12 frame and its planes are then copied into place
+ * args:
+ *    data - pointer to stripe conversion data (stripe_conv_t)
+ *    line_start - first line of the stripe (even)
+ *    line_end - line after the last one of the stripe
+ *    scratch - thread scratch buffer
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void convert_stripe(void *data, int line_start, int line_end, uint8_t *scratch)
+{
+	stripe_conv_t *conv = (stripe_conv_t *) data;
+
+	int width = conv->width;
+	int lines = line_end - line_start;
+
+	if(conv->bayer_order >= 0)
+	{
+		/*bayer needs the neighbour lines, so it reads the full frame*/
+		uint8_t *rgb = scratch + ((width * lines * 3) / 2);
+		bayer_lines_to_rgb24(conv->in, rgb, width, conv->height,
+			conv->bayer_order, line_start, line_end);
+		rgb24_to_yu12(scratch, rgb, width, lines);
+	}
+	else
+		conv->convert(scratch, conv->in + (line_start * conv->in_line_size),
+			width, lines);
+
+	int c_size = (width / 2) * (lines / 2);
+	int c_offset = (width / 2) * (line_start / 2);
+	uint8_t *pu = conv->out + (width * conv->height);
+	uint8_t *pv = pu + ((width * conv->height) / 4);
+
+	memcpy(conv->out + (line_start * width), scratch, width * lines);
+	memcpy(pu + c_offset, scratch + (width * lines), c_size);
+	memcpy(pv + c_offset, scratch + (width * lines) + c_size, c_size);
+}
+
+/*
+ * convert a raw frame to yu12 using the decoder threads
+ *   only single plane formats with a fixed line size are split,
+ *   planar formats are plain copies and stay on the calling thread
+ * args:
+ *    vd - pointer to device data
+ *    frame - pointer to frame buffer
+ *    format - raw frame pixel format
+ *
+ * asserts:
+ *    none
+ *
+ * returns: TRUE if the frame was converted, FALSE otherwise
+ */
+static int decode_frame_stripes(v4l2_dev_t *vd, v4l2_frame_buff_t *frame, int format)
+{
+	int width = vd->format.fmt.pix.width;
+	int height = vd->format.fmt.pix.height;
+
+	if(vd->decoder_pool == NULL || (width & 1) || (height & 1))
+		return FALSE;
+
+	stripe_conv_t conv;
+	conv.convert = NULL;
+	conv.out = frame->yuv_frame;
+	conv.in = frame->raw_frame;
+	conv.width = width;
+	conv.height = height;
+	conv.in_line_size = 0;
+	conv.bayer_order = -1;
+
+	switch (format)
+	{
+		case V4L2_PIX_FMT_YUYV:
+			if(vd->isbayer > 0)
+				conv.bayer_order = vd->bayer_pix_order;
+			else
+			{
+				conv.convert = yuyv_to_yu12;
+				conv.in_line_size = width * 2;
+			}
+			break;
+
+		case V4L2_PIX_FMT_SGBRG8:
+			conv.bayer_order = 0;
+			break;
+
+		case V4L2_PIX_FMT_SGRBG8:
+			conv.bayer_order = 1;
+			break;
+
+		case V4L2_PIX_FMT_SBGGR8:
+			conv.bayer_order = 2;
+			break;
+
+		case V4L2_PIX_FMT_SRGGB8:
+			conv.bayer_order = 3;
+			break;
+
+		case V4L2_PIX_FMT_UYVY:
+			conv.convert = uyvy_to_yu12;
+			conv.in_line_size = width * 2;
+			break;
+
+		case V4L2_PIX_FMT_VYUY:
+			conv.convert = vyuy_to_yu12;
+			conv.in_line_size = width * 2;
+			break;
+
+		case V4L2_PIX_FMT_YVYU:
+			conv.convert = yvyu_to_yu12;
+			conv.in_line_size = width * 2;
+			break;
+
+		case V4L2_PIX_FMT_YYUV:
+			conv.convert = yyuv_to_yu12;
+			conv.in_line_size = width * 2;
+			break;
+
+		case V4L2_PIX_FMT_YUV444:
+			conv.convert = y444_to_yu12;
+			conv.in_line_size = width * 2;
+			break;
+
+		case V4L2_PIX_FMT_YUV555:
+			conv.convert = yuvo_to_yu12;
+			conv.in_line_size = width * 2;
+			break;
+
+		case V4L2_PIX_FMT_YUV565:
+			conv.convert = yuvp_to_yu12;
+			conv.in_line_size = width * 2;
+			break;
+
+		case V4L2_PIX_FMT_YUV32:
+			conv.convert = yuv4_to_yu12;
+			conv.in_line_size = width * 4;
+			break;
+
+		case V4L2_PIX_FMT_Y41P:
+			conv.convert = y41p_to_yu12;
+			conv.in_line_size = (width * 3) / 2;
+			break;
+
+		case V4L2_PIX_FMT_GREY:
+			conv.convert = grey_to_yu12;
+			conv.in_line_size = width;
+			break;
+
+		case V4L2_PIX_FMT_Y16:
+			conv.convert = y16_to_yu12;
+			conv.in_line_size = width * 2;
+			break;
+#ifdef V4L2_PIX_FMT_Y16_BE
+		case V4L2_PIX_FMT_Y16_BE:
+			conv.convert = y16x_to_yu12;
+			conv.in_line_size = width * 2;
+			break;
+#endif
+		case V4L2_PIX_FMT_RGB24:
+			conv.convert = rgb24_to_yu12;
+			conv.in_line_size = width * 3;
+			break;
+
+		case V4L2_PIX_FMT_BGR24:
+			conv.convert = bgr24_to_yu12;
+			conv.in_line_size = width * 3;
+			break;
+
+		case V4L2_PIX_FMT_RGB332:
+			conv.convert = rgb1_to_yu12;
+			conv.in_line_size = width;
+			break;
+
+		case V4L2_PIX_FMT_RGB565:
+			conv.convert = rgbp_to_yu12;
+			conv.in_line_size = width * 2;
+			break;
+
+		case V4L2_PIX_FMT_RGB565X:
+			conv.convert = rgbr_to_yu12;
+			conv.in_line_size = width * 2;
+			break;
+
+		case V4L2_PIX_FMT_RGB444:
+#ifdef V4L2_PIX_FMT_ARGB444
+		case V4L2_PIX_FMT_ARGB444:
+		case V4L2_PIX_FMT_XRGB444:
+#endif
+			conv.convert = ar12_to_yu12;
+			conv.in_line_size = width * 2;
+			break;
+
+		case V4L2_PIX_FMT_RGB555:
+#ifdef V4L2_PIX_FMT_ARGB555
+		case V4L2_PIX_FMT_ARGB555:
+		case V4L2_PIX_FMT_XRGB555:
+#endif
+			conv.convert = ar15_to_yu12;
+			conv.in_line_size = width * 2;
+			break;
+
+		case V4L2_PIX_FMT_RGB555X:
+#ifdef V4L2_PIX_FMT_ARGB4555X
+		case V4L2_PIX_FMT_ARGB555X:
+		case V4L2_PIX_FMT_XRGB555X:
+#endif
+			conv.convert = ar15x_to_yu12;
+			conv.in_line_size = width * 2;
+			break;
+
+		case V4L2_PIX_FMT_BGR666:
+			conv.convert = bgrh_to_yu12;
+			conv.in_line_size = width * 4;
+			break;
+
+		case V4L2_PIX_FMT_BGR32:
+#ifdef V4L2_PIX_FMT_ABGR32
+		case V4L2_PIX_FMT_ABGR32:
+		case V4L2_PIX_FMT_XBGR32:
+#endif
+			conv.convert = ar24_to_yu12;
+			conv.in_line_size = width * 4;
+			break;
+
+		case V4L2_PIX_FMT_RGB32:
+#ifdef V4L2_PIX_FMT_ARGB32
+		case V4L2_PIX_FMT_ARGB32:
+		case V4L2_PIX_FMT_XRGB32:
+#endif
+			conv.convert = ba24_to_yu12;
+			conv.in_line_size = width * 4;
+			break;
+
+		default:
+			return FALSE;
+	}
+
+	/*yu12 stripe + (bayer) rgb24 stripe per line*/
+	size_t line_scratch_size = (width * 3) / 2;
+	if(conv.bayer_order >= 0)
+		line_scratch_size += width * 3;
+
+	decoder_pool_run(vd->decoder_pool, convert_stripe, &conv, height,
+		line_scratch_size);
+
+	return TRUE;
+}
+
 /*
  * decode video stream ( from raw_frame to frame buffer (yuyv format))
  * args:
@@ -737,6 +1011,25 @@ static int demux_h264(uint8_t* h264_data, uint8_t* buffer, int size, int h264_ma
  * returns: error code ( 0 - E_OK)
 */
 int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
+{
+	return decode_v4l2_frame_ctx(vd, frame, NULL);
+}
+
+/*
+ * decode video stream using a given (m)jpeg decoder context
+ *   (frames can be decoded concurrently if each thread has its own context)
+ * args:
+ *    vd - pointer to device data
+ *    frame - pointer to frame buffer
+ *    jpeg_ctx - pointer to (m)jpeg decoder context (NULL - use default context)
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int decode_v4l2_frame_ctx(v4l2_dev_t *vd, v4l2_frame_buff_t *frame,
+	jpeg_decoder_context_t *jpeg_ctx)
 {
 	/*asserts*/
 	assert(vd != NULL);
@@ -763,8 +1056,14 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 	 * from format.fmt.pix.pixelformat (muxed H264)
 	 */
 	int format = vd->requested_fmt;
+	frame->raw_format = format;
 
 	int framesizeIn =(width * height << 1);//2 bytes per pixel
+
+	/*split raw format conversions over the decoder threads*/
+	if(decode_frame_stripes(vd, frame, format))
+		return ret;
+
 	switch (format)
 	{
 		case V4L2_PIX_FMT_H264:
@@ -806,7 +1105,14 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 				return (ret);
 			}
 
-			ret = jpeg_decode(frame->yuv_frame, frame->raw_frame, frame->raw_frame_size);
+			if(jpeg_ctx)
+				ret = jpeg_decode_ctx(jpeg_ctx, frame->yuv_frame, frame->raw_frame, frame->raw_frame_size);
+			else
+			{
+				/*the decoder threads may change between frames*/
+				jpeg_set_decoder_pool(NULL, vd->decoder_pool);
+				ret = jpeg_decode(frame->yuv_frame, frame->raw_frame, frame->raw_frame_size);
+			}
 
 			//memcpy(frame->tmp_buffer, frame->raw_frame, frame->raw_frame_size);
 			//ret = jpeg_decode(&frame->yuv_frame, frame->tmp_buffer, width, height);
@@ -935,6 +1241,7 @@ int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 						fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (v4l2core_frame_decode): %s\n", strerror(errno));
 						exit(-1);
 					}
+					decoder_count_alloc();
 				}
 				/*convert raw bayer to iyuv*/
 				bayer_to_rgb24 (frame->raw_frame, frame->tmp_buffer, width, height, vd->bayer_pix_order);
@@ -1067,3 +1374,43 @@ int libav_decode(AVCodecContext *avctx, AVFrame *frame, int *got_frame, AVPacket
 
 #endif
 }
+
+/*
+ * count a heap allocation done while decoding frames
+ *   (see v4l2core_get_decoder_allocs)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void decoder_count_alloc()
+{
+	__LOCK_MUTEX(&decoder_allocs_mutex);
+	decoder_allocs++;
+	__UNLOCK_MUTEX(&decoder_allocs_mutex);
+}
+
+/*
+ * get the number of heap allocations done while decoding frames
+ *   (buffers grown or allocated on demand by the frame decoders,
+ *   decoder setup and libav internal buffers are not counted)
+ *   once streaming is stable this value must stop increasing
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: number of allocations
+ */
+uint64_t v4l2core_get_decoder_allocs()
+{
+	__LOCK_MUTEX(&decoder_allocs_mutex);
+	uint64_t allocs = decoder_allocs;
+	__UNLOCK_MUTEX(&decoder_allocs_mutex);
+
+	return allocs;
+}
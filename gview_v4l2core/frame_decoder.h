@@ -26,6 +26,7 @@
 
 #include "gviewv4l2core.h"
 #include "v4l2_core.h"
+#include "jpeg_decoder.h"
 
 /*h264 and jpeg decoder (libavcodec)*/
 #ifdef HAVE_FFMPEG_AVCODEC_H
@@ -53,6 +54,19 @@
 
 int libav_decode(AVCodecContext *avctx, AVFrame *frame, int *got_frame, AVPacket *pkt);
 
+/*
+ * count a heap allocation done while decoding frames
+ *   (see v4l2core_get_decoder_allocs)
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void decoder_count_alloc();
+
 /*
  * Alloc image buffers for decoding video stream
  * args:
@@ -77,6 +91,22 @@ int alloc_v4l2_frames(v4l2_dev_t *vd);
  */
 int decode_v4l2_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame);
 
+/*
+ * decode video stream using a given (m)jpeg decoder context
+ *   (frames can be decoded concurrently if each thread has its own context)
+ * args:
+ *    vd - pointer to device data
+ *    frame - pointer to frame buffer
+ *    jpeg_ctx - pointer to (m)jpeg decoder context (NULL - use default context)
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int decode_v4l2_frame_ctx(v4l2_dev_t *vd, v4l2_frame_buff_t *frame,
+	jpeg_decoder_context_t *jpeg_ctx);
+
 /*
  * free image buffers for decoding video stream
  * args:
@@ -88,6 +88,8 @@ __BEGIN_DECLS
 #define E_WRONG_MARKER_ERR        (-29)
 #define E_NO_EOI_ERR              (-30)
 #define E_FILE_IO_ERR             (-31)
+#define E_EXPBUF_ERR              (-32)
+#define E_QUEUE_FULL_ERR          (-33)
 #define E_UNKNOWN_ERR    		  (-40)
 
 /*
@@ -102,6 +104,14 @@ __BEGIN_DECLS
  */
 #define IO_MMAP 1
 #define IO_READ 2
+#define IO_USERPTR 3 /*streaming into our own (page aligned) buffers*/
+#define IO_DMABUF 4  /*mmap with driver buffers exported as dmabuf (VIDIOC_EXPBUF)*/
+
+/*
+ * core events (see v4l2core_set_event_callback)
+ */
+#define EV_CONTROLS 1 /*control events pending: call v4l2core_check_control_events*/
+#define EV_DEVICES  2 /*device events pending: call v4l2core_check_device_list_events*/
 
 /*
  * Frame status
@@ -130,11 +140,41 @@ __BEGIN_DECLS
 #define IMG_FMT_PNG     (2)
 #define IMG_FMT_BMP     (3)
 
+/*
+ * Image format flags (or'ed with the image format)
+ *   IMG_FLAG_PASSTHROUGH - jpeg: save the camera (m)jpeg bitstream
+ *                          if the frame has one (no re-encoding)
+ */
+#define IMG_FLAG_PASSTHROUGH (0x0100)
+#define IMG_FMT_MASK         (0x00FF)
+
+/*
+ * png row filters (v4l2core_set_png_options)
+ *   IMG_PNG_FILTER_ADAPTIVE - choose the best filter for each row
+ */
+#define IMG_PNG_FILTER_NONE     (0)
+#define IMG_PNG_FILTER_SUB      (1)
+#define IMG_PNG_FILTER_UP       (2)
+#define IMG_PNG_FILTER_AVG      (3)
+#define IMG_PNG_FILTER_PAETH    (4)
+#define IMG_PNG_FILTER_ADAPTIVE (5)
+
+/*
+ * yuv color encoding (for yuv to rgb conversions)
+ */
+#define YUV_MATRIX_BT601  (0)
+#define YUV_MATRIX_BT709  (1)
+
+#define YUV_RANGE_FULL    (0)
+#define YUV_RANGE_LIMITED (1)
+
 
 /*
  * buffer number (for driver mmap ops)
+ *   default and maximum (see v4l2core_set_buffer_count)
  */
 #define NB_BUFFER 4
+#define NB_BUFFER_MAX 32
 
 /*jpeg header def*/
 #define HEADERFRAME1 0xaf
@@ -263,6 +303,16 @@ typedef struct _v4l2_frame_buff_t
 	uint8_t *h264_frame; // pointer to regular or demultiplexed h264 frame
 	uint8_t *tmp_buffer; //temporary buffer used in decoding
 
+	/*members below were added in api 3.0 (new members go at the end)*/
+	int raw_format; //pixel format of raw_frame (v4l2 fourcc, as requested)
+
+	int yuv_matrix; //color matrix of yuv frame (YUV_MATRIX_XXX)
+	int yuv_range; //quantization range of yuv frame (YUV_RANGE_XXX)
+
+	int dmabuf_fd; //dmabuf fd of the driver buffer holding raw_frame (IO_DMABUF) or -1
+
+	int refcount; //frame references: recycled when the last one is released
+
 } v4l2_frame_buff_t;
 
 /*
@@ -285,6 +335,20 @@ typedef struct _v4l2_dev_sys_data_t
 /* v4l2 device handler - opaque data structure*/
 typedef struct _v4l2_dev_t v4l2_dev_t;
 
+/*
+ * core event callback
+ *   called from the thread waiting for frames (v4l2core_get_frame)
+ *   as soon as control (EV_CONTROLS) or device (EV_DEVICES) events are pending
+ */
+typedef void (*v4l2core_event_callback_t)(v4l2_dev_t *vd, int event, void *data);
+
+/*
+ * save image callback
+ *   called from a save queue worker thread when a queued image
+ *   (v4l2core_save_image_async) was saved, ret is the save error code
+ */
+typedef void (*v4l2core_save_image_callback_t)(const char *filename, int ret, void *data);
+
 /*
  * ioctl with a number of retries in the case of I/O failure
  * args:
@@ -311,6 +375,35 @@ int xioctl(int fd, int IOCTL_X, void *arg);
  */
 void v4l2core_set_verbosity(int level);
 
+/*
+ * set frame queue size (set before v4l2core_init_dev)
+ *   a size above 1 enables pipelined decoding in v4l2core_get_decoded_frame:
+ *   frames are decoded by (size - 1) threads while the next ones are captured
+ * args:
+ *   size - size in frames of frame queue (def = 1)
+ *
+ * asserts:
+ *   none
+ *
+ * returns void
+ */
+void v4l2core_set_frame_queue_size(int size);
+
+/*
+ * set the number of extra frames in queue for consumers holding
+ * frame references (set before v4l2core_init_dev)
+ *   e.g. the video encoder can keep a reference to a frame instead of
+ *   copying it, as long as v4l2core_get_free_frames is not 0
+ * args:
+ *   count - number of extra frames (def = 0)
+ *
+ * asserts:
+ *   none
+ *
+ * returns void
+ */
+void v4l2core_set_frame_hold_count(int count);
+
 /*
  * define fps values
  * args:
@@ -475,7 +568,7 @@ double v4l2core_get_realfps(v4l2_dev_t *vd);
  * set v4l2 capture method to use
  * args:
  *   vd - pointer to v4l2 device handler
- *   method - capture method (IO_READ or IO_MMAP)
+ *   method - capture method (IO_READ, IO_MMAP, IO_USERPTR or IO_DMABUF)
  *
  * asserts:
  *   vd is not null
@@ -484,6 +577,32 @@ double v4l2core_get_realfps(v4l2_dev_t *vd);
 */
 void v4l2core_set_capture_method(v4l2_dev_t *vd, int method);
 
+/*
+ * set the number of driver buffers to request (set before the format)
+ *   more buffers absorb longer processing hiccups before the driver drops frames
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   count - number of buffers [2 - NB_BUFFER_MAX]
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+*/
+void v4l2core_set_buffer_count(v4l2_dev_t *vd, int count);
+
+/*
+ * get the number of driver buffers in use
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: number of buffers granted by the driver (requested count if none yet)
+*/
+int v4l2core_get_buffer_count(v4l2_dev_t *vd);
+
 /*
  * Initiate video device handler with default values
  * args:
@@ -631,6 +750,24 @@ int v4l2core_get_device_index(const char *videodevice);
  */
 int v4l2core_check_device_list_events();
 
+/*
+ * set the core event callback
+ *   the frame wait also watches control and device events and calls
+ *   the callback as soon as they are pending; the callback runs in the
+ *   capture thread, so it should only schedule the matching
+ *   v4l2core_check_xxx_events call (watching stops until it's made)
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   callback - event callback (NULL to disable)
+ *   data - user data passed to the callback
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2core_set_event_callback(v4l2_dev_t *vd, v4l2core_event_callback_t callback, void *data);
+
 /*
  * check for control events
  * args:
@@ -703,6 +840,103 @@ int v4l2core_get_frame_width(v4l2_dev_t *vd);
  */
 int v4l2core_get_frame_height(v4l2_dev_t *vd);
 
+/*
+ * set the yuv color encoding (used for yuv to rgb conversions)
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   matrix - color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ *   range - quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2core_set_yuv_color_encoding(v4l2_dev_t *vd, int matrix, int range);
+
+/*
+ * get the yuv color matrix
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ */
+int v4l2core_get_yuv_matrix(v4l2_dev_t *vd);
+
+/*
+ * get the yuv quantization range
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
+ */
+int v4l2core_get_yuv_range(v4l2_dev_t *vd);
+
+/*
+ * set the number of threads used for decoding raw frames
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   nthreads - number of threads (0 - auto: one per online cpu)
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2core_set_decoder_threads(v4l2_dev_t *vd, int nthreads);
+
+/*
+ * get the number of threads used for decoding raw frames
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: number of decoder threads
+ */
+int v4l2core_get_decoder_threads(v4l2_dev_t *vd);
+
+/*
+ * get the number of heap allocations done while decoding frames
+ *   (buffers grown or allocated on demand by the frame decoders,
+ *   decoder setup and libav internal buffers are not counted)
+ *   once streaming is stable this value must stop increasing
+ * args:
+ *   none
+ *
+ * asserts:
+ *   none
+ *
+ * returns: number of allocations
+ */
+uint64_t v4l2core_get_decoder_allocs();
+
+/*
+ * convert a yu12 frame to rgba (rgb32, alpha set to 255)
+ * args:
+ *   out - pointer to output rgba data buffer (width * height * 4)
+ *   in - pointer to input yu12 data buffer
+ *   width - frame width (in pixels)
+ *   height - frame height (in pixels)
+ *   matrix - color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ *   range - quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
+ *
+ * asserts:
+ *   out is not null
+ *   in is not null
+ *
+ * returns: none
+ */
+void v4l2core_yu12_to_rgba(uint8_t *out, uint8_t *in, int width, int height,
+	int matrix, int range);
+
 /* get frame format index from format list
  * args:
  *   vd - pointer to v4l2 device handler
@@ -808,7 +1042,8 @@ int v4l2core_update_current_format(v4l2_dev_t *vd);
 v4l2_frame_buff_t *v4l2core_get_frame(v4l2_dev_t *vd);
 
 /*
- * releases the video frame (so that it can be reused by the driver)
+ * releases a video frame reference
+ *   the frame is reused by the driver when the last reference is released
  * args:
  *   vd - pointer to v4l2 device handler
  *   frame - pointer to decoded frame buffer
@@ -820,6 +1055,38 @@ v4l2_frame_buff_t *v4l2core_get_frame(v4l2_dev_t *vd);
  */
 int v4l2core_release_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame);
 
+/*
+ * take a new video frame reference (released with v4l2core_release_frame)
+ *   the decoded data (yuv or h264) stays valid until the last reference
+ *   is released, from any thread; a frame still holding a driver buffer
+ *   gives it back right away (raw_frame is set to NULL), pipelined frames
+ *   keep their raw data copy
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   frame - pointer to frame buffer (with at least one reference)
+ *
+ * asserts:
+ *   vd is not null
+ *   frame is not null
+ *
+ * returns: none
+ */
+void v4l2core_frame_ref(v4l2_dev_t *vd, v4l2_frame_buff_t *frame);
+
+/*
+ * get the number of free frames in queue
+ *   a new frame reference should only be kept (beyond the capture
+ *   loop) if this is not 0, or capture runs out of frames
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: number of free frames
+ */
+int v4l2core_get_free_frames(v4l2_dev_t *vd);
+
 /*
  * gets the next video frame and decodes it
  * args:
@@ -1396,6 +1663,7 @@ int v4l2core_save_data_to_file(const char *filename, uint8_t *data, int size);
  *    filename - output file name
  *    format - image type
  *           (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP)
+ *           can be or'ed with IMG_FLAG_PASSTHROUGH
  *
  * asserts:
  *    none
@@ -1407,6 +1675,79 @@ int v4l2core_save_image(
 	const char *filename,
 	int format);
 
+/*
+ * queue the frame to be saved to file by the save queue workers
+ *   (image encoding and file writing don't block the caller)
+ *   the frame is referenced if it leaves a free frame for capture,
+ *   or else its data is copied, so it can be released right after this call
+ * args:
+ *    vd - pointer to v4l2 device handler
+ *    frame - pointer to frame buffer
+ *    filename - output file name
+ *    format - image type
+ *           (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP)
+ *           can be or'ed with IMG_FLAG_PASSTHROUGH
+ *    copy - copy the frame data, even if it could be referenced
+ *           (set it if the frame data is changed after this call)
+ *    callback - called (from a worker thread) when the image is saved (can be NULL)
+ *    data - callback user data
+ *
+ * asserts:
+ *    vd is not null
+ *    frame is not null
+ *    filename is not null
+ *
+ * returns: error code (E_QUEUE_FULL_ERR if too many images are pending)
+ */
+int v4l2core_save_image_async(
+	v4l2_dev_t *vd,
+	v4l2_frame_buff_t *frame,
+	const char *filename,
+	int format,
+	int copy,
+	v4l2core_save_image_callback_t callback,
+	void *data);
+
+/*
+ * get the number of queued images (v4l2core_save_image_async) not yet saved
+ * args:
+ *    vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns: number of pending images
+ */
+int v4l2core_get_save_image_pending(v4l2_dev_t *vd);
+
+/*
+ * wait for all the queued images (v4l2core_save_image_async) to be saved
+ * args:
+ *    vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns: none
+ */
+void v4l2core_flush_save_image(v4l2_dev_t *vd);
+
+/*
+ * set the png compression options (used by all png snapshots)
+ * args:
+ *    level - zlib compression level [0 - 9] (-1 - zlib default)
+ *    filter - row filter (IMG_PNG_FILTER_XXX)
+ *    nthreads - compression threads (0 - auto: one per online cpu)
+ *               with more than one thread (fast png) row bands are
+ *               compressed in parallel into a single standard png stream
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void v4l2core_set_png_options(int level, int filter, int nthreads);
+
 /*
  * ############### TIME DATA ##############
  */
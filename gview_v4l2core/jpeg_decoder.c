@@ -41,9 +41,22 @@
 #include "colorspaces.h"
 #include "frame_decoder.h"
 #include "jpeg_decoder.h"
+#include "decoder_pool.h"
 #include "gview.h"
 #include "../config.h"
 
+/*
+ * jpeg decoder backend: builtin or libavcodec (configure option);
+ * the benchmarks (bench/) define it to build both
+ */
+#ifndef JPEG_DECODER_BUILTIN
+	#if MJPG_BUILTIN
+		#define JPEG_DECODER_BUILTIN 1
+	#else
+		#define JPEG_DECODER_BUILTIN 0
+	#endif
+#endif
+
 extern int verbosity;
 
 /* default Huffman table*/
@@ -111,7 +124,7 @@ const uint8_t jpeg_huffman_table[JPG_HUFFMAN_TABLE_LENGTH] =
 	0xF9, 0xFA
 };
 
-typedef struct _jpeg_decoder_context_t
+struct _jpeg_decoder_context_t
 {
 	void *codec_data;
 
@@ -119,13 +132,15 @@ typedef struct _jpeg_decoder_context_t
 	int height;
 	int pic_size;
 
-	uint8_t *tmp_frame; //temp frame buffer
+	uint8_t *tmp_frame; //compressed data copy (builtin decoder)
 
-} jpeg_decoder_context_t;
+	decoder_pool_t *pool; //decoding threads (can be NULL)
+};
 
+/*default context used by the single context api*/
 static jpeg_decoder_context_t *jpeg_ctx = NULL;
 
-#if MJPG_BUILTIN //use internal jpeg decoder
+#if JPEG_DECODER_BUILTIN //use internal jpeg decoder
 
 #define ISHIFT 11
 
@@ -269,17 +284,39 @@ struct jpginfo
 	int rm;			/* next restart marker */
 };
 
-static struct jpginfo info;
-static struct comp comps[MAXCOMP];
+/*
+ * restart interval segment (entropy coded data between RSTn markers)
+ */
+struct jpeg_segment
+{
+	uint8_t *start;		/* first byte of entropy coded data */
+	int err;		/* decoding error code (0 - OK) */
+};
+
+/*
+ * builtin decoder state (one per decoder context)
+ */
+typedef struct _codec_data_t
+{
+	struct jpginfo info;
+	struct comp comps[MAXCOMP];
+	struct scan dscans[MAXCOMP];
+
+	uint8_t quant[4][64];
+	struct dec_hufftbl dhuff[4];
 
-static struct scan dscans[MAXCOMP];
+	uint8_t *datap;                  //pointer to compressed data
+	struct in inp;                   //input bit stream
+	struct jpeg_decdata decdata;     //mcu and quantization data
 
-static uint8_t quant[4][64];
+	uint8_t *pic;                    //decoded picture (yuyv)
 
-static struct dec_hufftbl dhuff[4];
+	struct jpeg_segment *segs;       //restart interval segments
+	int segs_size;                   //allocated segments
+} codec_data_t;
 
-#define dec_huffdc (dhuff + 0)
-#define dec_huffac (dhuff + 2)
+#define dec_huffdc(cd) ((cd)->dhuff + 0)
+#define dec_huffac(cd) ((cd)->dhuff + 2)
 
 /*
  * build huffman data
@@ -355,14 +392,14 @@ static void dec_makehuff(struct dec_hufftbl *hu, int *hufflen, uint8_t *huffvals
 /*
  * huffman decoder initialization
  * args:
- *    none
+ *    cd - pointer to decoder state
  *
  * asserts:
  *    none
  *
  * returns: error code (0 - OK)
  */
-static int huffman_init(void)
+static int huffman_init(codec_data_t *cd)
 {
 	uint8_t *ptr= (uint8_t *) jpeg_huffman_table ;
 	int i, j, l;
@@ -388,7 +425,7 @@ static int huffman_init(void)
 				huffvals[k++] = *ptr++;
 			l -= hufflen[i];
 		}
-		dec_makehuff(dhuff + tt, hufflen, huffvals);
+		dec_makehuff(cd->dhuff + tt, hufflen, huffvals);
 	}
 	return 0;
 }
@@ -752,39 +789,30 @@ inline static void idct(int *inp, int *out, int *quant, long off, int max)
 typedef void (*ftopict) (int * out, uint8_t *pic, int width) ;
 
 /*********************************/
-/*
- * pointer to pixel data
- */
-static uint8_t *datap;
-
-/*
- * input structure (in)
- */
-static struct in inp;
-
 
 /*
  * get byte (8 bit) from datap
  */
-static int getbyte(void)
+static int getbyte(codec_data_t *cd)
 {
-	return *datap++;
+	return *cd->datap++;
 }
 
 /*
  * get word (16 bit) from datap
  */
-static int getword(void)
+static int getword(codec_data_t *cd)
 {
 	int c1, c2;
-	c1 = *datap++;
-	c2 = *datap++;
+	c1 = *cd->datap++;
+	c2 = *cd->datap++;
 	return c1 << 8 | c2;
 }
 
 /*
  * read jpeg tables (huffman and quantization)
  * args:
+ *    cd - pointer to decoder state
  *    till - Marker (frame - SOF0   scan - SOS)
  *    isDHT - flag indicating the presence of huffman tables (if 0 must use default ones - MJPG frame)
  * asserts:
@@ -792,19 +820,19 @@ static int getword(void)
  *
  * returns: error code (0 - OK)
  */
-static int readtables(int till, int *isDHT)
+static int readtables(codec_data_t *cd, int till, int *isDHT)
 {
 	int l, i, j, lq, pq, tq;
 	int tc, th, tt;
 
 	for (;;)
 	{
-		if (getbyte() != 0xff)
+		if (getbyte(cd) != 0xff)
 			return -1;
 
 		int m = 0;
 
-		if ((m = getbyte()) == till)
+		if ((m = getbyte(cd)) == till)
 			break;
 
 		switch (m)
@@ -813,10 +841,10 @@ static int readtables(int till, int *isDHT)
 				return 0;
 			/*read quantization tables (Lqt and Cqt)*/
 			case M_DQT:
-				lq = getword();
+				lq = getword(cd);
 				while (lq > 2)
 				{
-					pq = getbyte();
+					pq = getbyte(cd);
 					/*Lqt=0x00   Cqt=0x01*/
 					tq = pq & 15;
 					if (tq > 3)
@@ -825,19 +853,19 @@ static int readtables(int till, int *isDHT)
 					if (pq != 0)
 					return -1;
 					for (i = 0; i < 64; i++)
-						quant[tq][i] = getbyte();
+						cd->quant[tq][i] = getbyte(cd);
 					lq -= 64 + 1;
 				}
 				break;
 			/*read huffman table*/
 			case M_DHT:
-				l = getword();
+				l = getword(cd);
 				while (l > 2)
 				{
 					int hufflen[16], k;
 					uint8_t huffvals[256];
 
-					tc = getbyte();
+					tc = getbyte(cd);
 					th = tc & 15;
 					tc >>= 4;
 					tt = tc * 2 + th;
@@ -845,30 +873,30 @@ static int readtables(int till, int *isDHT)
 					return -1;
 
 					for (i = 0; i < 16; i++)
-						hufflen[i] = getbyte();
+						hufflen[i] = getbyte(cd);
 					l -= 1 + 16;
 					k = 0;
 					for (i = 0; i < 16; i++)
 					{
 						for (j = 0; j < hufflen[i]; j++)
-							huffvals[k++] = getbyte();
+							huffvals[k++] = getbyte(cd);
 						l -= hufflen[i];
 					}
-					dec_makehuff(dhuff + tt, hufflen, huffvals);
+					dec_makehuff(cd->dhuff + tt, hufflen, huffvals);
 				}
 				/* has huffman tables defined (JPEG)*/
 				*isDHT= 1;
 				break;
 			/*restart interval*/
 			case M_DRI:
-				l = getword();
-				info.dri = getword();
+				l = getword(cd);
+				cd->info.dri = getword(cd);
 				break;
 
 			default:
-				l = getword();
+				l = getword(cd);
 				while (l-- > 2)
-					getbyte();
+					getbyte(cd);
 				break;
 		}
 	}
@@ -878,43 +906,43 @@ static int readtables(int till, int *isDHT)
 /*
  * init dscans
  * args:
- *    none
+ *    cd - pointer to decoder state
  *
  * asserts:
  *    none
  *
  * returns: none
  */
-static void dec_initscans(void)
+static void dec_initscans(codec_data_t *cd)
 {
 	int i;
 
-	info.nm = info.dri + 1;
-	info.rm = M_RST0;
-	for (i = 0; i < info.ns; i++)
-		dscans[i].dc = 0;
+	cd->info.nm = cd->info.dri + 1;
+	cd->info.rm = M_RST0;
+	for (i = 0; i < cd->info.ns; i++)
+		cd->dscans[i].dc = 0;
 }
 
 /*
  * check markers
  * args:
- *    none
+ *    cd - pointer to decoder state
  *
  * asserts:
  *    none
  *
  * returns: error code (0 - OK)
  */
-static int dec_checkmarker(void)
+static int dec_checkmarker(codec_data_t *cd)
 {
 	int i;
 
-	if (dec_readmarker(&inp) != info.rm)
+	if (dec_readmarker(&cd->inp) != cd->info.rm)
 		return -1;
-	info.nm = info.dri;
-	info.rm = (info.rm + 1) & ~0x08;
-	for (i = 0; i < info.ns; i++)
-		dscans[i].dc = 0;
+	cd->info.nm = cd->info.dri;
+	cd->info.rm = (cd->info.rm + 1) & ~0x08;
+	for (i = 0; i < cd->info.ns; i++)
+		cd->dscans[i].dc = 0;
 	return 0;
 }
 
@@ -965,6 +993,314 @@ static int dec_rec2(struct in *inp, struct dec_hufftbl *hu, int *runp, int c, in
 	return c;
 }
 
+/*
+ * mcu geometry of the decoded picture
+ */
+typedef struct _mcu_layout_t
+{
+	int mb;          //blocks per mcu
+	int mcusx;       //mcus per row
+	int mcusy;       //mcu rows
+	int xpitch;      //mcu width (bytes)
+	int ypitch;      //mcu row size (bytes)
+	int pitch;       //picture line size (bytes)
+	ftopict convert; //mcu to yuyv conversion
+} mcu_layout_t;
+
+/*
+ * decode a mcu (entropy decoding and idct)
+ * args:
+ *    inp - pointer to input bit stream
+ *    scans - pointer to scans data
+ *    decdata - pointer to mcu and quantization data
+ *    mb - number of blocks in mcu
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void decode_mcu(struct in *inp, struct scan *scans,
+	struct jpeg_decdata *decdata, int mb)
+{
+	int max[6] = {0, 0, 0, 0, 0, 0};
+
+	switch (mb)
+	{
+		case 6:
+			decode_mcus(inp, decdata->dcts, mb, scans, max);
+			idct(decdata->dcts, decdata->out, decdata->dquant[0],
+				IFIX(128.5), max[0]);
+			idct(decdata->dcts + 64, decdata->out + 64,
+				decdata->dquant[0], IFIX(128.5), max[1]);
+			idct(decdata->dcts + 128, decdata->out + 128,
+				decdata->dquant[0], IFIX(128.5), max[2]);
+			idct(decdata->dcts + 192, decdata->out + 192,
+				decdata->dquant[0], IFIX(128.5), max[3]);
+			idct(decdata->dcts + 256, decdata->out + 256,
+				decdata->dquant[1], IFIX(0.5), max[4]);
+			idct(decdata->dcts + 320, decdata->out + 320,
+				decdata->dquant[2], IFIX(0.5), max[5]);
+			break;
+
+		case 4:
+			decode_mcus(inp, decdata->dcts, mb, scans, max);
+			idct(decdata->dcts, decdata->out, decdata->dquant[0],
+				IFIX(128.5), max[0]);
+			idct(decdata->dcts + 64, decdata->out + 64,
+				decdata->dquant[0], IFIX(128.5), max[1]);
+			idct(decdata->dcts + 128, decdata->out + 256,
+					decdata->dquant[1], IFIX(0.5), max[4]);
+			idct(decdata->dcts + 192, decdata->out + 320,
+				decdata->dquant[2], IFIX(0.5), max[5]);
+			break;
+
+		case 3:
+			decode_mcus(inp, decdata->dcts, mb, scans, max);
+			idct(decdata->dcts, decdata->out, decdata->dquant[0],
+				IFIX(128.5), max[0]);
+			idct(decdata->dcts + 64, decdata->out + 256,
+				decdata->dquant[1], IFIX(0.5), max[4]);
+			idct(decdata->dcts + 128, decdata->out + 320,
+				decdata->dquant[2], IFIX(0.5), max[5]);
+			break;
+
+		case 1:
+			decode_mcus(inp, decdata->dcts, mb, scans, max);
+			idct(decdata->dcts, decdata->out, decdata->dquant[0],
+				IFIX(128.5), max[0]);
+			break;
+	} // switch enc411
+}
+
+/*
+ * locate the restart interval segments of the entropy coded data
+ * args:
+ *    cd - pointer to decoder state (datap at the scan data)
+ *    end - pointer to the end of the compressed data
+ *    nsegs - expected number of segments
+ *
+ * asserts:
+ *    none
+ *
+ * returns: error code (0 - OK; -1 - markers don't match the restart interval)
+ */
+static int find_segments(codec_data_t *cd, uint8_t *end, int nsegs)
+{
+	if(nsegs > cd->segs_size)
+	{
+		struct jpeg_segment *segs = realloc(cd->segs, nsegs * sizeof(struct jpeg_segment));
+		if(segs == NULL)
+		{
+			fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (find_segments): %s\n", strerror(errno));
+			exit(-1);
+		}
+		cd->segs = segs;
+		cd->segs_size = nsegs;
+		decoder_count_alloc();
+	}
+
+	int n = 0;
+	uint8_t *p = cd->datap;
+	cd->segs[n++].start = p;
+
+	while((p = memchr(p, 0xff, end - p)) != NULL && p + 1 < end)
+	{
+		int m = p[1];
+
+		if(m == 0x00 || m == 0xff) /*stuffed byte or fill byte*/
+		{
+			p += (m == 0x00) ? 2 : 1;
+			continue;
+		}
+
+		if(m == M_EOI)
+			return (n == nsegs) ? 0 : -1;
+
+		/*markers must follow the sequence RST0 ... RST7 RST0 ...*/
+		if(n >= nsegs || m != M_RST0 + ((n - 1) & 7))
+			return -1;
+
+		p += 2;
+		cd->segs[n++].start = p;
+	}
+
+	return -1; /*no EOI*/
+}
+
+/*
+ * restart interval segments decoding job
+ */
+typedef struct _segment_job_t
+{
+	codec_data_t *cd;
+	mcu_layout_t *layout;
+	int nsegs;
+} segment_job_t;
+
+/*
+ * per thread segment decoding state (pool scratch)
+ */
+typedef struct _segment_state_t
+{
+	struct in inp;
+	struct scan dscans[MAXCOMP];
+	struct jpeg_decdata decdata;
+} segment_state_t;
+
+/*
+ * decode a range of restart interval segments (decoder pool job)
+ * args:
+ *    data - pointer to segment_job_t
+ *    first - first segment
+ *    last - segment after the last one
+ *    scratch - per thread segment_state_t
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void decode_segments(void *data, int first, int last, uint8_t *scratch)
+{
+	segment_job_t *job = (segment_job_t *) data;
+	codec_data_t *cd = job->cd;
+	mcu_layout_t *layout = job->layout;
+	segment_state_t *st = (segment_state_t *) scratch;
+
+	int total = layout->mcusx * layout->mcusy;
+
+	/*huffman and quantization tables are shared (read only)*/
+	memcpy(st->dscans, cd->dscans, sizeof(st->dscans));
+	memcpy(st->decdata.dquant, cd->decdata.dquant, sizeof(st->decdata.dquant));
+
+	int s = 0;
+	for(s = first; s < last; s++)
+	{
+		int i = 0;
+		/*dc prediction restarts on every segment*/
+		for (i = 0; i < cd->info.ns; i++)
+			st->dscans[i].dc = 0;
+		setinput(&st->inp, cd->segs[s].start);
+
+		int mcu = s * cd->info.dri;
+		int mcu_end = mcu + cd->info.dri;
+		if(mcu_end > total)
+			mcu_end = total;
+
+		for(; mcu < mcu_end; mcu++)
+		{
+			int mx = mcu % layout->mcusx;
+			int my = mcu / layout->mcusx;
+
+			decode_mcu(&st->inp, st->dscans, &st->decdata, layout->mb);
+			layout->convert(st->decdata.out,
+				cd->pic + (my * layout->ypitch) + (mx * layout->xpitch),
+				layout->pitch);
+		}
+
+		/*the segment must end at the next restart marker (or EOI)*/
+		int m = dec_readmarker(&st->inp);
+		if(s < job->nsegs - 1)
+			cd->segs[s].err = (m == M_RST0 + (s & 7)) ? 0 : E_WRONG_MARKER_ERR;
+		else
+			cd->segs[s].err = (m == M_EOI) ? 0 : E_NO_EOI_ERR;
+	}
+}
+
+/*
+ * decode the restart interval segments of the frame on the decoder pool
+ * args:
+ *    ctx - pointer to decoder context
+ *    layout - pointer to mcu layout
+ *    end - pointer to the end of the compressed data
+ *
+ * asserts:
+ *    none
+ *
+ * returns: error code (0 - OK; 1 - not possible, must decode sequentially)
+ */
+static int decode_segments_parallel(jpeg_decoder_context_t *ctx,
+	mcu_layout_t *layout, uint8_t *end)
+{
+	codec_data_t *cd = (codec_data_t *) ctx->codec_data;
+
+	if(ctx->pool == NULL || cd->info.dri <= 0)
+		return 1;
+
+	int total = layout->mcusx * layout->mcusy;
+	int nsegs = (total + cd->info.dri - 1) / cd->info.dri;
+	if(nsegs < 2)
+		return 1;
+
+	/*corrupted or truncated frames are left to the sequential decoder*/
+	if(find_segments(cd, end, nsegs) != 0)
+	{
+		if(verbosity > 2)
+			printf("V4L2_CORE: (jpeg decoder) restart markers don't match, decoding sequentially\n");
+		return 1;
+	}
+
+	segment_job_t job =
+	{
+		.cd = cd,
+		.layout = layout,
+		.nsegs = nsegs,
+	};
+	decoder_pool_run_jobs(ctx->pool, decode_segments, &job, nsegs,
+		sizeof(segment_state_t));
+
+	int s = 0;
+	for(s = 0; s < nsegs; s++)
+		if(cd->segs[s].err)
+			return cd->segs[s].err;
+
+	return 0;
+}
+
+/*
+ * yuyv to yu12 conversion job
+ */
+typedef struct _yuyv_conv_t
+{
+	uint8_t *out;
+	uint8_t *in;
+	int width;
+	int height;
+} yuyv_conv_t;
+
+/*
+ * convert a stripe of the yuyv picture to yu12 (decoder pool job)
+ * args:
+ *    data - pointer to yuyv_conv_t
+ *    line_start - first line of the stripe (even)
+ *    line_end - line after the last one of the stripe
+ *    scratch - per thread yu12 stripe buffer
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void convert_yuyv_stripe(void *data, int line_start, int line_end, uint8_t *scratch)
+{
+	yuyv_conv_t *conv = (yuyv_conv_t *) data;
+
+	int width = conv->width;
+	int lines = line_end - line_start;
+
+	yuyv_to_yu12(scratch, conv->in + (line_start * width * 2), width, lines);
+
+	int c_size = (width / 2) * (lines / 2);
+	int c_offset = (width / 2) * (line_start / 2);
+	uint8_t *pu = conv->out + (width * conv->height);
+	uint8_t *pv = pu + ((width * conv->height) / 4);
+
+	memcpy(conv->out + (line_start * width), scratch, width * lines);
+	memcpy(pu + c_offset, scratch + (width * lines), c_size);
+	memcpy(pv + c_offset, scratch + (width * lines) + c_size, c_size);
+}
+
 /*
  * init (m)jpeg decoder context
  * args:
@@ -974,161 +1310,160 @@ static int dec_rec2(struct in *inp, struct dec_hufftbl *hu, int *runp, int c, in
  * asserts:
  *    none
  *
- * returns: error code (0 - E_OK)
+ * returns: pointer to decoder context (NULL on error)
  */
-int jpeg_init_decoder(int width, int height)
+jpeg_decoder_context_t *jpeg_init_decoder_ctx(int width, int height)
 {
-	if(jpeg_ctx != NULL)
-		jpeg_close_decoder();
+	jpeg_decoder_context_t *ctx = calloc(1, sizeof(jpeg_decoder_context_t));
+	if(ctx == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_init_decoder_ctx): %s\n", strerror(errno));
+		exit(-1);
+	}
 
-	jpeg_ctx = calloc(1, sizeof(jpeg_decoder_context_t));
-	if(jpeg_ctx == NULL)
+	codec_data_t *codec_data = calloc(1, sizeof(codec_data_t));
+	if(codec_data == NULL)
 	{
-		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_init_decoder): %s\n", strerror(errno));
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_init_decoder_ctx): %s\n", strerror(errno));
 		exit(-1);
 	}
 
-	jpeg_ctx->width = width;
-	jpeg_ctx->height = height;
-	jpeg_ctx->pic_size = width * height * 2; //yuyv
-	jpeg_ctx->codec_data = NULL;
+	ctx->width = width;
+	ctx->height = height;
+	ctx->pic_size = width * height * 2; //yuyv
+	ctx->codec_data = codec_data;
 
-	jpeg_ctx->tmp_frame = calloc(jpeg_ctx->pic_size, sizeof(uint8_t));
-	if(jpeg_ctx->tmp_frame == NULL)
+	ctx->tmp_frame = calloc(ctx->pic_size, sizeof(uint8_t));
+	if(ctx->tmp_frame == NULL)
 	{
-		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_init_decoder): %s\n", strerror(errno));
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_init_decoder_ctx): %s\n", strerror(errno));
 		exit(-1);
 	}
 
-	return E_OK;
+	codec_data->pic = calloc(ctx->pic_size, sizeof(uint8_t));
+	if(codec_data->pic == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_init_decoder_ctx): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	return ctx;
 }
 
 /*
  * jpeg decode
  * args:
- *   out_buf -  pointer to picture data ( decoded image - yuyv format)
+ *   ctx - pointer to decoder context
+ *   out_buf -  pointer to picture data ( decoded image - yu12 format)
  *   in_buf -  pointer to input data ( compressed jpeg )
  *   size - picture size
  *
  * asserts:
+ *   ctx not null
  *   out_buf not null
  *   in_buf not null
  *
  * returns: error code (0 - OK)
  */
-//int jpeg_decode(uint8_t **pic, uint8_t *buf, int width, int height)
-int jpeg_decode(uint8_t *out_buf, uint8_t *in_buf, int size)
+int jpeg_decode_ctx(jpeg_decoder_context_t *ctx, uint8_t *out_buf, uint8_t *in_buf, int size)
 {
 	/*asserts*/
+	assert(ctx != NULL);
 	assert(in_buf != NULL);
 	assert(out_buf != NULL);
 
-	memcpy(jpeg_ctx->tmp_frame, in_buf, size);
+	codec_data_t *cd = (codec_data_t *) ctx->codec_data;
+	struct jpeg_decdata *decdata = &cd->decdata;
+
+	if(size > ctx->pic_size)
+		size = ctx->pic_size;
+	memcpy(ctx->tmp_frame, in_buf, size);
 
-	struct jpeg_decdata *decdata;
 	int i=0, j=0, m=0, tac=0, tdc=0;
 	int intwidth=0, intheight=0;
-	int mcusx=0, mcusy=0, mx=0, my=0;
-	int ypitch=0 ,xpitch=0,bpp=0,pitch=0,x=0,y=0;
-	int mb=0;
-	int max[6];
-	ftopict convert;
+	int mx=0, my=0;
+	int bpp=0,x=0,y=0;
 	int err = 0;
 	int isInitHuffman = 0;
-	decdata = calloc(1, sizeof(struct jpeg_decdata));
-	if(decdata == NULL)
-	{
-		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_decode): %s\n", strerror(errno));
-		exit(-1);
-	}
 
-	for(i=0;i<6;i++)
-		max[i]=0;
-
-	if (!decdata)
-	{
-		err = E_ALLOC_ERR;
-		goto error;
-	}
-
-	datap = jpeg_ctx->tmp_frame;
+	cd->datap = ctx->tmp_frame;
 	/*check SOI (0xFFD8)*/
-	if (getbyte() != 0xff)
+	if (getbyte(cd) != 0xff)
 	{
 		err = E_NO_SOI_ERR;
 		goto error;
 	}
-	if (getbyte() != M_SOI)
+	if (getbyte(cd) != M_SOI)
 	{
 		err = E_NO_SOI_ERR;
 		goto error;
 	}
 	/*read tables - if exist, up to start frame marker (0xFFC0)*/
-	if (readtables(M_SOF0, &isInitHuffman))
+	if (readtables(cd, M_SOF0, &isInitHuffman))
 	{
 		err = E_BAD_TABLES_ERR;
 		goto error;
 	}
-	getword();     /*header lenght*/
-	i = getbyte(); /*precision (8 bit)*/
+	getword(cd);     /*header lenght*/
+	i = getbyte(cd); /*precision (8 bit)*/
 	if (i != 8)
 	{
 		err = E_NOT_8BIT_ERR;
 		goto error;
 	}
-	intheight = getword(); /*height*/
-	intwidth = getword();  /*width */
+	intheight = getword(cd); /*height*/
+	intwidth = getword(cd);  /*width */
 
 	if ((intheight & 7) || (intwidth & 7)) /*must be even*/
 	{
 		err = E_BAD_WIDTH_OR_HEIGHT_ERR;
 		goto error;
 	}
-	info.nc = getbyte(); /*number of components*/
-	if (info.nc > MAXCOMP)
+	cd->info.nc = getbyte(cd); /*number of components*/
+	if (cd->info.nc > MAXCOMP)
 	{
 		err = E_TOO_MANY_COMPPS_ERR;
 		goto error;
 	}
 	/*for each component*/
-	for (i = 0; i < info.nc; i++)
+	for (i = 0; i < cd->info.nc; i++)
 	{
 		int h, v;
-		comps[i].cid = getbyte(); /*component id*/
-		comps[i].hv = getbyte();
-		v = comps[i].hv & 15; /*vertical sampling   */
-		h = comps[i].hv >> 4; /*horizontal sampling */
-		comps[i].tq = getbyte(); /*quantization table used*/
+		cd->comps[i].cid = getbyte(cd); /*component id*/
+		cd->comps[i].hv = getbyte(cd);
+		v = cd->comps[i].hv & 15; /*vertical sampling   */
+		h = cd->comps[i].hv >> 4; /*horizontal sampling */
+		cd->comps[i].tq = getbyte(cd); /*quantization table used*/
 		if (h > 3 || v > 3)
 		{
 			err = E_ILLEGAL_HV_ERR;
 			goto error;
 		}
-		if (comps[i].tq > 3)
+		if (cd->comps[i].tq > 3)
 		{
 			err = E_QUANT_TBL_SEL_ERR;
 			goto error;
 		}
 	}
 	/*read tables - if exist, up to start of scan marker (0xFFDA)*/
-	if (readtables(M_SOS,&isInitHuffman))
+	if (readtables(cd, M_SOS, &isInitHuffman))
 	{
 		err = E_BAD_TABLES_ERR;
 		goto error;
 	}
-	getword(); /* header lenght */
-	info.ns = getbyte(); /* number of scans */
-	if (!info.ns)
+	getword(cd); /* header lenght */
+	cd->info.ns = getbyte(cd); /* number of scans */
+	if (!cd->info.ns)
 	{
-		printf("V4L2_CORE: (jpeg decoder) info ns %d/n",info.ns);
+		printf("V4L2_CORE: (jpeg decoder) info ns %d/n",cd->info.ns);
 		err = E_NOT_YCBCR_ERR;
 		goto error;
 	}
 	/*for each scan*/
-	for (i = 0; i < info.ns; i++)
+	for (i = 0; i < cd->info.ns; i++)
 	{
-		dscans[i].cid = getbyte(); /*component id*/
-		tdc = getbyte();
+		cd->dscans[i].cid = getbyte(cd); /*component id*/
+		tdc = getbyte(cd);
 		tac = tdc & 15; /*ac table*/
 		tdc >>= 4;      /*dc table*/
 		if (tdc > 1 || tac > 1)
@@ -1136,23 +1471,23 @@ int jpeg_decode(uint8_t *out_buf, uint8_t *in_buf, int size)
 			err = E_QUANT_TBL_SEL_ERR;
 			goto error;
 		}
-		for (j = 0; j < info.nc; j++)
-			if (comps[j].cid == dscans[i].cid)
+		for (j = 0; j < cd->info.nc; j++)
+			if (cd->comps[j].cid == cd->dscans[i].cid)
 				break;
-		if (j == info.nc)
+		if (j == cd->info.nc)
 		{
 			err = E_UNKNOWN_CID_ERR;
 			goto error;
 		}
-		dscans[i].hv = comps[j].hv;
-		dscans[i].tq = comps[j].tq;
-		dscans[i].hudc.dhuff = dec_huffdc + tdc;
-		dscans[i].huac.dhuff = dec_huffac + tac;
+		cd->dscans[i].hv = cd->comps[j].hv;
+		cd->dscans[i].tq = cd->comps[j].tq;
+		cd->dscans[i].hudc.dhuff = dec_huffdc(cd) + tdc;
+		cd->dscans[i].huac.dhuff = dec_huffac(cd) + tac;
 	}
 
-	i = getbyte(); /*0 */
-	j = getbyte(); /*63*/
-	m = getbyte(); /*0 */
+	i = getbyte(cd); /*0 */
+	j = getbyte(cd); /*63*/
+	m = getbyte(cd); /*0 */
 
 	if (i != 0 || j != 63 || m != 0)
 	{
@@ -1162,17 +1497,20 @@ int jpeg_decode(uint8_t *out_buf, uint8_t *in_buf, int size)
 	/*build huffman tables*/
 	if(!isInitHuffman)
 	{
-		if(huffman_init() < 0)
-			return E_BAD_TABLES_ERR;
+		if(huffman_init(cd) < 0)
+		{
+			err = E_BAD_TABLES_ERR;
+			goto error;
+		}
 	}
 	/*
-	if (dscans[0].cid != 1 || dscans[1].cid != 2 || dscans[2].cid != 3)
+	if (cd->dscans[0].cid != 1 || cd->dscans[1].cid != 2 || cd->dscans[2].cid != 3)
 	{
 		err = ERR_NOT_YCBCR_221111;
 		goto error;
 	}
 
-	if (dscans[1].hv != 0x11 || dscans[2].hv != 0x11)
+	if (cd->dscans[1].hv != 0x11 || cd->dscans[2].hv != 0x11)
 	{
 		err = ERR_NOT_YCBCR_221111;
 		goto error;
@@ -1197,44 +1535,47 @@ int jpeg_decode(uint8_t *out_buf, uint8_t *in_buf, int size)
 	//	}
 	//}
 
-	switch (dscans[0].hv)
+	mcu_layout_t layout;
+	memset(&layout, 0, sizeof(mcu_layout_t));
+
+	switch (cd->dscans[0].hv)
 	{
 		case 0x22: // 411
-			mb=6;
-			mcusx = jpeg_ctx->width >> 4;
-			mcusy = jpeg_ctx->height >> 4;
+			layout.mb=6;
+			layout.mcusx = ctx->width >> 4;
+			layout.mcusy = ctx->height >> 4;
 			bpp=2;
-			xpitch = 16 * bpp;
-			pitch = jpeg_ctx->width * bpp; // YUYV out
-			ypitch = 16 * pitch;
-			convert = yuv420pto422; //choose the right conversion function
+			layout.xpitch = 16 * bpp;
+			layout.pitch = ctx->width * bpp; // YUYV out
+			layout.ypitch = 16 * layout.pitch;
+			layout.convert = yuv420pto422; //choose the right conversion function
 			break;
 		case 0x21: //422
-			mb=4;
-			mcusx = jpeg_ctx->width >> 4;
-			mcusy = jpeg_ctx->height >> 3;
+			layout.mb=4;
+			layout.mcusx = ctx->width >> 4;
+			layout.mcusy = ctx->height >> 3;
 			bpp=2;
-			xpitch = 16 * bpp;
-			pitch = jpeg_ctx->width * bpp; // YUYV out
-			ypitch = 8 * pitch;
-			convert = yuv422pto422; //choose the right conversion function
+			layout.xpitch = 16 * bpp;
+			layout.pitch = ctx->width * bpp; // YUYV out
+			layout.ypitch = 8 * layout.pitch;
+			layout.convert = yuv422pto422; //choose the right conversion function
 			break;
 		case 0x11: //444
-			mcusx = jpeg_ctx->width >> 3;
-			mcusy = jpeg_ctx->height >> 3;
+			layout.mcusx = ctx->width >> 3;
+			layout.mcusy = ctx->height >> 3;
 			bpp=2;
-			xpitch = 8 * bpp;
-			pitch = jpeg_ctx->width * bpp; // YUYV out
-			ypitch = 8 * pitch;
-			if (info.ns==1)
+			layout.xpitch = 8 * bpp;
+			layout.pitch = ctx->width * bpp; // YUYV out
+			layout.ypitch = 8 * layout.pitch;
+			if (cd->info.ns==1)
 			{
-				mb = 1;
-				convert = yuv400pto422; //choose the right conversion function
+				layout.mb = 1;
+				layout.convert = yuv400pto422; //choose the right conversion function
 			}
 			else
 			{
-				mb=3;
-				convert = yuv444pto422; //choose the right conversion function
+				layout.mb=3;
+				layout.convert = yuv444pto422; //choose the right conversion function
 			}
 			break;
 		default:
@@ -1243,107 +1584,99 @@ int jpeg_decode(uint8_t *out_buf, uint8_t *in_buf, int size)
 			break;
 	}
 
-	idctqtab(quant[dscans[0].tq], decdata->dquant[0]);
-	idctqtab(quant[dscans[1].tq], decdata->dquant[1]);
-	idctqtab(quant[dscans[2].tq], decdata->dquant[2]);
-	setinput(&inp, datap);
-	dec_initscans();
+	idctqtab(cd->quant[cd->dscans[0].tq], decdata->dquant[0]);
+	idctqtab(cd->quant[cd->dscans[1].tq], decdata->dquant[1]);
+	idctqtab(cd->quant[cd->dscans[2].tq], decdata->dquant[2]);
+
+	cd->dscans[0].next = 2;
+	cd->dscans[1].next = 1;
+	cd->dscans[2].next = 0;	/* 4xx encoding */
 
-	dscans[0].next = 2;
-	dscans[1].next = 1;
-	dscans[2].next = 0;	/* 4xx encoding */
-	for (my = 0,y=0; my < mcusy; my++,y+=ypitch)
+	/*
+	 * restart interval segments are independent (dc prediction
+	 * restarts on every RSTn marker) so they can be decoded in parallel
+	 */
+	err = decode_segments_parallel(ctx, &layout, ctx->tmp_frame + size);
+	if(err < 0)
+		goto error;
+
+	if(err == 1) /*sequential decoding*/
 	{
-		for (mx = 0,x=0; mx < mcusx; mx++,x+=xpitch)
+		err = 0;
+
+		setinput(&cd->inp, cd->datap);
+		dec_initscans(cd);
+
+		for (my = 0,y=0; my < layout.mcusy; my++,y+=layout.ypitch)
 		{
-			if (info.dri && !--info.nm)
-				if (dec_checkmarker())
-				{
-					err = E_WRONG_MARKER_ERR;
-					goto error;
-				}
-			switch (mb)
+			for (mx = 0,x=0; mx < layout.mcusx; mx++,x+=layout.xpitch)
 			{
-				case 6:
-					decode_mcus(&inp, decdata->dcts, mb, dscans, max);
-					idct(decdata->dcts, decdata->out, decdata->dquant[0],
-						IFIX(128.5), max[0]);
-					idct(decdata->dcts + 64, decdata->out + 64,
-						decdata->dquant[0], IFIX(128.5), max[1]);
-					idct(decdata->dcts + 128, decdata->out + 128,
-						decdata->dquant[0], IFIX(128.5), max[2]);
-					idct(decdata->dcts + 192, decdata->out + 192,
-						decdata->dquant[0], IFIX(128.5), max[3]);
-					idct(decdata->dcts + 256, decdata->out + 256,
-						decdata->dquant[1], IFIX(0.5), max[4]);
-					idct(decdata->dcts + 320, decdata->out + 320,
-						decdata->dquant[2], IFIX(0.5), max[5]);
-					break;
-
-				case 4:
-					decode_mcus(&inp, decdata->dcts, mb, dscans, max);
-					idct(decdata->dcts, decdata->out, decdata->dquant[0],
-						IFIX(128.5), max[0]);
-					idct(decdata->dcts + 64, decdata->out + 64,
-						decdata->dquant[0], IFIX(128.5), max[1]);
-					idct(decdata->dcts + 128, decdata->out + 256,
-							decdata->dquant[1], IFIX(0.5), max[4]);
-					idct(decdata->dcts + 192, decdata->out + 320,
-						decdata->dquant[2], IFIX(0.5), max[5]);
-					break;
-
-				case 3:
-					decode_mcus(&inp, decdata->dcts, mb, dscans, max);
-					idct(decdata->dcts, decdata->out, decdata->dquant[0],
-						IFIX(128.5), max[0]);
-					idct(decdata->dcts + 64, decdata->out + 256,
-						decdata->dquant[1], IFIX(0.5), max[4]);
-					idct(decdata->dcts + 128, decdata->out + 320,
-						decdata->dquant[2], IFIX(0.5), max[5]);
-					break;
-
-				case 1:
-					decode_mcus(&inp, decdata->dcts, mb, dscans, max);
-					idct(decdata->dcts, decdata->out, decdata->dquant[0],
-						IFIX(128.5), max[0]);
-					break;
-			} // switch enc411
-			convert(decdata->out, out_buf+y+x, pitch); //convert to 422
+				if (cd->info.dri && !--cd->info.nm)
+					if (dec_checkmarker(cd))
+					{
+						err = E_WRONG_MARKER_ERR;
+						goto error;
+					}
+				decode_mcu(&cd->inp, cd->dscans, decdata, layout.mb);
+				layout.convert(decdata->out, cd->pic + y + x, layout.pitch); //convert to 422
+			}
+		}
+
+		m = dec_readmarker(&cd->inp);
+		if (m != M_EOI)
+		{
+			err = E_NO_EOI_ERR;
+			goto error;
 		}
 	}
 
-	m = dec_readmarker(&inp);
-	if (m != M_EOI)
+	/*the idct output is packed yuyv*/
+	if(ctx->pool)
 	{
-		err = E_NO_EOI_ERR;
-		goto error;
+		yuyv_conv_t conv =
+		{
+			.out = out_buf,
+			.in = cd->pic,
+			.width = ctx->width,
+			.height = ctx->height,
+		};
+		decoder_pool_run(ctx->pool, convert_yuyv_stripe, &conv, ctx->height,
+			(ctx->width * 3) / 2);
 	}
-	free(decdata);
+	else
+		yuyv_to_yu12(out_buf, cd->pic, ctx->width, ctx->height);
+
 	return 0;
 error:
-	free(decdata);
 	return err;
 }
 
 /*
  * close (m)jpeg decoder context
  * args:
- *    none
+ *    ctx - pointer to decoder context
  *
  * asserts:
  *    none
  *
  * returns: none
  */
-void jpeg_close_decoder()
+void jpeg_close_decoder_ctx(jpeg_decoder_context_t *ctx)
 {
-	if(jpeg_ctx == NULL)
+	if(ctx == NULL)
 		return;
 
-	free(jpeg_ctx->tmp_frame);
-	free(jpeg_ctx);
+	codec_data_t *codec_data = (codec_data_t *) ctx->codec_data;
 
-	jpeg_ctx = NULL;
+	if(codec_data)
+	{
+		free(codec_data->pic);
+		free(codec_data->segs);
+		free(codec_data);
+	}
+
+	free(ctx->tmp_frame);
+	free(ctx);
 }
 
 #else  //use libavcodec to decode mjpeg data
@@ -1353,6 +1686,9 @@ typedef struct _codec_data_t
 	const AVCodec *codec;
 	AVCodecContext *context;
 	AVFrame *picture;
+#if LIBAVCODEC_VER_AT_LEAST(58,129)
+	AVPacket *packet; //reused for every frame
+#endif
 } codec_data_t;
 
 /*
@@ -1364,9 +1700,9 @@ typedef struct _codec_data_t
  * asserts:
  *    none
  *
- * returns: error code (0 - E_OK)
+ * returns: pointer to decoder context (NULL on error)
  */
-int jpeg_init_decoder(int width, int height)
+jpeg_decoder_context_t *jpeg_init_decoder_ctx(int width, int height)
 {
 #if !LIBAVCODEC_VER_AT_LEAST(53,34)
 	avcodec_init();
@@ -1380,20 +1716,17 @@ int jpeg_init_decoder(int width, int height)
 #endif
 	av_log_set_level(AV_LOG_PANIC);
 
-	if(jpeg_ctx != NULL)
-		jpeg_close_decoder();
-
-	jpeg_ctx = calloc(1, sizeof(jpeg_decoder_context_t));
-	if(jpeg_ctx == NULL)
+	jpeg_decoder_context_t *ctx = calloc(1, sizeof(jpeg_decoder_context_t));
+	if(ctx == NULL)
 	{
-		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_init_decoder): %s\n", strerror(errno));
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_init_decoder_ctx): %s\n", strerror(errno));
 		exit(-1);
 	}
 
 	codec_data_t *codec_data = calloc(1, sizeof(codec_data_t));
 	if(codec_data == NULL)
 	{
-		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_init_decoder): %s\n", strerror(errno));
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_init_decoder_ctx): %s\n", strerror(errno));
 		exit(-1);
 	}
 
@@ -1401,10 +1734,9 @@ int jpeg_init_decoder(int width, int height)
 	if(!codec_data->codec)
 	{
 		fprintf(stderr, "V4L2_CORE: (mjpeg decoder) codec not found\n");
-		free(jpeg_ctx);
+		free(ctx);
 		free(codec_data);
-		jpeg_ctx = NULL;
-		return E_NO_CODEC;
+		return NULL;
 	}
 
 #if LIBAVCODEC_VER_AT_LEAST(57, 107)
@@ -1425,7 +1757,7 @@ int jpeg_init_decoder(int width, int height)
 	codec_data->context->pix_fmt = AV_PIX_FMT_YUV422P;
 	codec_data->context->width = width;
 	codec_data->context->height = height;
-	//jpeg_ctx->context->dsp_mask = (FF_MM_MMX | FF_MM_MMXEXT | FF_MM_SSE);
+	//ctx->context->dsp_mask = (FF_MM_MMX | FF_MM_MMXEXT | FF_MM_SSE);
 
 #if LIBAVCODEC_VER_AT_LEAST(53,6)
 	if (avcodec_open2(codec_data->context, codec_data->codec, NULL) < 0)
@@ -1437,9 +1769,8 @@ int jpeg_init_decoder(int width, int height)
 		avcodec_close(codec_data->context);
 		free(codec_data->context);
 		free(codec_data);
-		free(jpeg_ctx);
-		jpeg_ctx = NULL;
-		return E_NO_CODEC;
+		free(ctx);
+		return NULL;
 	}
 
 #if LIBAVCODEC_VER_AT_LEAST(55,28)
@@ -1450,63 +1781,61 @@ int jpeg_init_decoder(int width, int height)
 	avcodec_get_frame_defaults(codec_data->picture);
 #endif
 
-	/*alloc temp buffer*/
-	jpeg_ctx->tmp_frame = calloc(width*height*2, sizeof(uint8_t));
-	if(jpeg_ctx->tmp_frame == NULL)
+#if LIBAVCODEC_VER_AT_LEAST(58,129)
+	codec_data->packet = av_packet_alloc();
+	if(codec_data->packet == NULL)
 	{
-		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_init_decoder): %s\n", strerror(errno));
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (jpeg_init_decoder_ctx): %s\n", strerror(errno));
 		exit(-1);
 	}
+#endif
+
 #if LIBAVUTIL_VER_AT_LEAST(54,6)
-	jpeg_ctx->pic_size = av_image_get_buffer_size(codec_data->context->pix_fmt, width, height, 1);
+	ctx->pic_size = av_image_get_buffer_size(codec_data->context->pix_fmt, width, height, 1);
 #else
-	jpeg_ctx->pic_size = avpicture_get_size(codec_data->context->pix_fmt, width, height);
+	ctx->pic_size = avpicture_get_size(codec_data->context->pix_fmt, width, height);
 #endif
-	jpeg_ctx->width = width;
-	jpeg_ctx->height = height;
-	jpeg_ctx->codec_data = codec_data;
+	ctx->width = width;
+	ctx->height = height;
+	ctx->codec_data = codec_data;
 
-	return E_OK;
+	return ctx;
 }
 
 /*
  * decode (m)jpeg frame
  * args:
+ *    ctx - pointer to decoder context
  *    out_buf - pointer to decoded data
  *    in_buf - pointer to h264 data
  *    size - in_buf size
  *
  * asserts:
- *    jpeg_ctx is not null
+ *    ctx is not null
  *    in_buf is not null
  *    out_buf is not null
  *
  * returns: decoded data size
  */
-int jpeg_decode(uint8_t *out_buf, uint8_t *in_buf, int size)
+int jpeg_decode_ctx(jpeg_decoder_context_t *ctx, uint8_t *out_buf, uint8_t *in_buf, int size)
 {
 	/*asserts*/
-	assert(jpeg_ctx != NULL);
+	assert(ctx != NULL);
 	assert(in_buf != NULL);
 	assert(out_buf != NULL);
 
 	int got_frame = 0;
-	codec_data_t *codec_data = (codec_data_t *) jpeg_ctx->codec_data;
+	codec_data_t *codec_data = (codec_data_t *) ctx->codec_data;
 
 #if LIBAVCODEC_VER_AT_LEAST(58,129)
-	AVPacket *avpkt = av_packet_alloc();
-	if (!avpkt) 
-	{
-        fprintf(stderr, "V4L2_CORE uvc_H264: could not allocate av_packet\n");
-        return -1;
-    }
-
-	avpkt->size = size;
-	avpkt->data = in_buf;
+	/*the packet only points to in_buf (no data is owned)*/
+	codec_data->packet->size = size;
+	codec_data->packet->data = in_buf;
 
-	int ret = libav_decode(codec_data->context, codec_data->picture, &got_frame, avpkt);
+	int ret = libav_decode(codec_data->context, codec_data->picture, &got_frame, codec_data->packet);
 
-	av_packet_free(&avpkt);
+	codec_data->packet->size = 0;
+	codec_data->packet->data = NULL;
 #else
 	AVPacket avpkt;
 	av_init_packet(&avpkt);
@@ -1522,18 +1851,36 @@ int jpeg_decode(uint8_t *out_buf, uint8_t *in_buf, int size)
 
 	if(got_frame)
 	{
-#if LIBAVUTIL_VER_AT_LEAST(54,6)
-		av_image_copy_to_buffer(jpeg_ctx->tmp_frame, jpeg_ctx->pic_size,
-                             (const uint8_t * const*) codec_data->picture->data, codec_data->picture->linesize,
-                             codec_data->context->pix_fmt, jpeg_ctx->width, jpeg_ctx->height, 1);
-#else
-		avpicture_layout((AVPicture *) codec_data->picture, codec_data->context->pix_fmt,
-			jpeg_ctx->width, jpeg_ctx->height, jpeg_ctx->tmp_frame, jpeg_ctx->pic_size);
-#endif
-		/* libavcodec output is in yuv422p */
-        yuv422p_to_yu12(out_buf, jpeg_ctx->tmp_frame, jpeg_ctx->width, jpeg_ctx->height);
+		/*convert straight from the decoded planes (the pixel format depends on the camera)*/
+		switch(codec_data->context->pix_fmt)
+		{
+			case AV_PIX_FMT_YUV420P:
+			case AV_PIX_FMT_YUVJ420P:
+				planar_to_yu12(out_buf, codec_data->picture->data, codec_data->picture->linesize,
+					ctx->width, ctx->height, 1, 1);
+				break;
+
+			case AV_PIX_FMT_YUV444P:
+			case AV_PIX_FMT_YUVJ444P:
+				planar_to_yu12(out_buf, codec_data->picture->data, codec_data->picture->linesize,
+					ctx->width, ctx->height, 0, 0);
+				break;
 
-		return jpeg_ctx->pic_size;
+			case AV_PIX_FMT_GRAY8:
+			{
+				uint8_t *planes[3] = {codec_data->picture->data[0], NULL, NULL};
+				planar_to_yu12(out_buf, planes, codec_data->picture->linesize,
+					ctx->width, ctx->height, 1, 1);
+				break;
+			}
+
+			default: /* yuv422p */
+				planar_to_yu12(out_buf, codec_data->picture->data, codec_data->picture->linesize,
+					ctx->width, ctx->height, 1, 0);
+				break;
+		}
+
+		return ctx->pic_size;
 	}
 	else
 		return 0;
@@ -1543,19 +1890,19 @@ int jpeg_decode(uint8_t *out_buf, uint8_t *in_buf, int size)
 /*
  * close (m)jpeg decoder context
  * args:
- *    none
+ *    ctx - pointer to decoder context
  *
  * asserts:
  *    none
  *
  * returns: none
  */
-void jpeg_close_decoder()
+void jpeg_close_decoder_ctx(jpeg_decoder_context_t *ctx)
 {
-	if(jpeg_ctx == NULL)
+	if(ctx == NULL)
 		return;
 
-	codec_data_t *codec_data = (codec_data_t *) jpeg_ctx->codec_data;
+	codec_data_t *codec_data = (codec_data_t *) ctx->codec_data;
 
 	avcodec_close(codec_data->context);
 
@@ -1571,13 +1918,94 @@ void jpeg_close_decoder()
 	#endif
 #endif
 
-	if(jpeg_ctx->tmp_frame)
-		free(jpeg_ctx->tmp_frame);
+#if LIBAVCODEC_VER_AT_LEAST(58,129)
+	av_packet_free(&codec_data->packet);
+#endif
 
 	free(codec_data);
-	free(jpeg_ctx);
-
-	jpeg_ctx = NULL;
+	free(ctx);
 }
 
 #endif
+
+/*
+ * set the decoder threads used by a (m)jpeg decoder context
+ *   the builtin decoder splits frames with restart markers (DRI)
+ *   in segments decoded by the pool threads
+ * args:
+ *    ctx - pointer to decoder context (NULL - default context)
+ *    pool - pointer to decoder pool (NULL - single thread)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void jpeg_set_decoder_pool(jpeg_decoder_context_t *ctx, decoder_pool_t *pool)
+{
+	if(ctx == NULL)
+		ctx = jpeg_ctx;
+
+	if(ctx != NULL)
+		ctx->pool = pool;
+}
+
+/*
+ * init the default (m)jpeg decoder context
+ * args:
+ *    width - image width
+ *    height - image height
+ *
+ * asserts:
+ *    none
+ *
+ * returns: error code (0 - E_OK)
+ */
+int jpeg_init_decoder(int width, int height)
+{
+	if(jpeg_ctx != NULL)
+		jpeg_close_decoder();
+
+	jpeg_ctx = jpeg_init_decoder_ctx(width, height);
+	if(jpeg_ctx == NULL)
+		return E_NO_CODEC;
+
+	return E_OK;
+}
+
+/*
+ * jpeg decode using the default context
+ * args:
+ *   out_buf -  pointer to picture data ( decoded image - yu12 format)
+ *   in_buf -  pointer to input data ( compressed jpeg )
+ *   size - picture size
+ *
+ * asserts:
+ *   default context not null
+ *
+ * returns: error code (0 - OK) for the builtin decoder or
+ *          decoded data size for libavcodec
+ */
+int jpeg_decode(uint8_t *out_buf, uint8_t *in_buf, int size)
+{
+	/*asserts*/
+	assert(jpeg_ctx != NULL);
+
+	return jpeg_decode_ctx(jpeg_ctx, out_buf, in_buf, size);
+}
+
+/*
+ * close the default (m)jpeg decoder context
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void jpeg_close_decoder()
+{
+	jpeg_close_decoder_ctx(jpeg_ctx);
+	jpeg_ctx = NULL;
+}
@@ -28,6 +28,8 @@
 #ifndef JPEG_DECODER_H
 #define JPEG_DECODER_H
 
+#include "decoder_pool.h"
+
 #define HEADERFRAME1 0xaf
 
 /*******Error codes *******/
@@ -47,6 +49,13 @@
 #define ERR_BAD_TABLES 14
 #define ERR_DEPTH_MISMATCH 15
 
+/*
+ * (m)jpeg decoder context (opaque)
+ *   each context holds all the decoder state, so different
+ *   contexts can be used concurrently from different threads
+ */
+typedef struct _jpeg_decoder_context_t jpeg_decoder_context_t;
+
 /*
  * init (m)jpeg decoder context
  * args:
@@ -56,28 +65,86 @@
  * asserts:
  *    none
  *
- * returns: error code (0 - E_OK)
+ * returns: pointer to decoder context (NULL on error)
  */
-int jpeg_init_decoder(int width, int height);
+jpeg_decoder_context_t *jpeg_init_decoder_ctx(int width, int height);
 
 /*
  * jpeg decode
  * args:
- *   out_buf -  pointer to picture data ( decoded image - yuyv format)
+ *   ctx - pointer to decoder context
+ *   out_buf -  pointer to picture data ( decoded image - yu12 format)
  *   in_buf -  pointer to input data ( compressed jpeg )
  *   size - picture size
  *
  * asserts:
+ *   ctx not null
  *   out_buf not null
  *   in_buf not null
  *
- * returns: error code (0 - OK)
+ * returns: error code (0 - OK) for the builtin decoder or
+ *          decoded data size for libavcodec
  */
-int jpeg_decode(uint8_t *out_buf, uint8_t *in_buf, int size);
+int jpeg_decode_ctx(jpeg_decoder_context_t *ctx, uint8_t *out_buf, uint8_t *in_buf, int size);
 
 /*
  * close (m)jpeg decoder context
  * args:
+ *    ctx - pointer to decoder context
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void jpeg_close_decoder_ctx(jpeg_decoder_context_t *ctx);
+
+/*
+ * set the decoder threads used by a (m)jpeg decoder context
+ *   the builtin decoder splits frames with restart markers (DRI)
+ *   in segments decoded by the pool threads
+ * args:
+ *    ctx - pointer to decoder context (NULL - default context)
+ *    pool - pointer to decoder pool (NULL - single thread)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void jpeg_set_decoder_pool(jpeg_decoder_context_t *ctx, decoder_pool_t *pool);
+
+/*
+ * init the default (m)jpeg decoder context
+ * args:
+ *    width - image width
+ *    height - image height
+ *
+ * asserts:
+ *    none
+ *
+ * returns: error code (0 - E_OK)
+ */
+int jpeg_init_decoder(int width, int height);
+
+/*
+ * jpeg decode using the default context
+ * args:
+ *   out_buf -  pointer to picture data ( decoded image - yu12 format)
+ *   in_buf -  pointer to input data ( compressed jpeg )
+ *   size - picture size
+ *
+ * asserts:
+ *   default context not null
+ *
+ * returns: error code (0 - OK) for the builtin decoder or
+ *          decoded data size for libavcodec
+ */
+int jpeg_decode(uint8_t *out_buf, uint8_t *in_buf, int size);
+
+/*
+ * close the default (m)jpeg decoder context
+ * args:
  *    none
  *
  * asserts:
@@ -82,6 +82,7 @@ int v4l2core_save_data_to_file(const char *filename, uint8_t *data, int size)
  *    filename - output file name
  *    format - image type
  *           (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP)
+ *           can be or'ed with IMG_FLAG_PASSTHROUGH
  *
  * asserts:
  *    none
@@ -92,7 +93,7 @@ int save_frame_image(v4l2_frame_buff_t *frame, const char *filename, int format)
 {
 	int ret= E_OK;
 
-	switch(format)
+	switch(format & IMG_FMT_MASK)
 	{
 		case IMG_FMT_RAW:
 			if(verbosity > 0)
@@ -101,6 +102,16 @@ int save_frame_image(v4l2_frame_buff_t *frame, const char *filename, int format)
 			break;
 
 		case IMG_FMT_JPG:
+			/*camera (m)jpeg bitstream: save it as is*/
+			if((format & IMG_FLAG_PASSTHROUGH) &&
+				save_image_jpeg_can_passthrough(frame))
+			{
+				if(verbosity > 0)
+					printf("V4L2_CORE: saving jpeg bitstream to %s\n", filename);
+				ret = save_image_jpeg_passthrough(frame, filename);
+				break;
+			}
+
 			if(verbosity > 0)
 				printf("V4L2_CORE: saving jpeg frame to %s\n", filename);
 		    ret = save_image_jpeg(frame, filename);
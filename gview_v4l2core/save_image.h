@@ -34,6 +34,7 @@
  *    filename - output file name
  *    format - image type
  *           (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP)
+ *           can be or'ed with IMG_FLAG_PASSTHROUGH
  *
  * asserts:
  *    vd is not null
@@ -55,6 +56,45 @@ int save_frame_image(v4l2_frame_buff_t *frame, const char *filename, int format)
  */
 int save_image_jpeg(v4l2_frame_buff_t *frame, const char *filename);
 
+/*
+ * free the cached jpeg encoder contexts
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void save_image_jpeg_clean_cache();
+
+/*
+ * check if the frame raw data can be saved as is to a jpeg file
+ * args:
+ *    frame - pointer to frame buffer
+ *
+ * asserts:
+ *    frame is not null
+ *
+ * returns: 1 if the raw data is a (m)jpeg bitstream, 0 otherwise
+ */
+int save_image_jpeg_can_passthrough(v4l2_frame_buff_t *frame);
+
+/*
+ * save the frame (m)jpeg bitstream to a jpeg file (no re-encoding)
+ *   uvc mjpeg frames usually omit the huffman tables, in that case
+ *   the standard tables (DHT) are inserted before the scan
+ * args:
+ *    frame - pointer to frame buffer
+ *    filename - filename string
+ *
+ * asserts:
+ *    frame is not null
+ *
+ * returns: error code
+ */
+int save_image_jpeg_passthrough(v4l2_frame_buff_t *frame, const char *filename);
+
 /*
  * save frame data to a bmp file
  * args:
@@ -81,4 +121,16 @@ int save_image_bmp(v4l2_frame_buff_t *frame, const char *filename);
  */
 int save_image_png(v4l2_frame_buff_t *frame, const char *filename);
 
+/*
+ * free the png compression threads
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void save_image_png_clean();
+
 #endif
\ No newline at end of file
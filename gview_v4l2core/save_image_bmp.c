@@ -28,6 +28,7 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <sys/uio.h>
 
 #include "gviewv4l2core.h"
 #include "save_image.h"
@@ -63,30 +64,88 @@ typedef struct _bmp_info_header_t
 
 
 /*
- * save bmp data to file
+ * bmp lines are converted and written in blocks of about
+ * BMP_BLOCK_SIZE bytes (at most BMP_MAX_BLOCK_LINES lines)
+ */
+#define BMP_BLOCK_SIZE (128 * 1024)
+#define BMP_MAX_BLOCK_LINES (256)
+
+/*
+ * write all the data of an iovec array to file (retries partial writes)
+ * args:
+ *   fd - file descriptor
+ *   iov - pointer to iovec array (changed on partial writes)
+ *   iovcnt - number of iovec entries
+ *
+ * asserts:
+ *   iov is not null
+ *
+ * returns: error code
+ */
+static int writev_all(int fd, struct iovec *iov, int iovcnt)
+{
+	/*assertions*/
+	assert(iov != NULL);
+
+	while(iovcnt > 0)
+	{
+		ssize_t ret = writev(fd, iov, iovcnt);
+		if(ret < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return E_FILE_IO_ERR;
+		}
+
+		/*skip the written entries*/
+		while(iovcnt > 0 && (size_t) ret >= iov->iov_len)
+		{
+			ret -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+
+		if(iovcnt > 0)
+		{
+			iov->iov_base = (uint8_t *) iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
+	}
+
+	return E_OK;
+}
+
+/*
+ * save frame data to a 24 bit bmp file
+ *   lines are converted and written bottom-up in small blocks,
+ *   so memory use doesn't depend on the image size
  * args:
  *   filename - bmp file name
- *   data - pixel data (rgb form)
- *   width - image width
- *   height - image height
- *   BitCount - bits per pixel
+ *   frame - pointer to frame buffer
  *
  * asserts:
- *     data is not null
+ *     frame is not null
  *
  * returns: error code
  */
-static int save_bmp(const char *filename, uint8_t *data, int width, int height, int BitCount)
+static int save_bmp(const char *filename, v4l2_frame_buff_t *frame)
 {
 	/*assertions*/
-	assert(data != NULL);
+	assert(frame != NULL);
 
 	int ret = E_OK;
 	bmp_file_header_t BmpFileh;
 	bmp_info_header_t BmpInfoh;
-	FILE *fp;
 
-	int imgsize = width * height * BitCount / 8;
+	int width = frame->width;
+	int height = frame->height;
+
+	/*bmp lines are padded to 4 bytes*/
+	int line_size = width * 3;
+	int stride = (line_size + 3) & ~3;
+	int imgsize = stride * height;
+
+	static const uint8_t pad[4] = {0, 0, 0, 0};
 
 	BmpFileh.bfType=0x4d42;//must be BM (x4d42)
 	/*Specifies the size, in bytes, of the bitmap file*/
@@ -102,7 +161,7 @@ static int save_bmp(const char *filename, uint8_t *data, int width, int height,
 	BmpInfoh.biWidth=width;
 	BmpInfoh.biHeight=height;
 	BmpInfoh.biPlanes=1;
-	BmpInfoh.biBitCount=BitCount;
+	BmpInfoh.biBitCount=24;
 	BmpInfoh.biCompression=0; // 0
 	BmpInfoh.biSizeImage=imgsize;
 	BmpInfoh.biXPelsPerMeter=0;
@@ -110,30 +169,79 @@ static int save_bmp(const char *filename, uint8_t *data, int width, int height,
 	BmpInfoh.biClrUsed=0;
 	BmpInfoh.biClrImportant=0;
 
-	if ((fp = fopen(filename, "wb")) != NULL)
-	{	// (wb) write in binary mode
-		ret=fwrite(&BmpFileh, sizeof(bmp_file_header_t), 1, fp);
-		ret+=fwrite(&BmpInfoh, sizeof(bmp_info_header_t),1,fp);
-		ret+=fwrite(data, imgsize, 1, fp);
-		if (ret < 3)
-			ret = E_FILE_IO_ERR;//write error
-		else
-			ret = E_OK;
-
-		fflush(fp); //flush data stream to file system
-		if(fsync(fileno(fp)) || fclose(fp))
-		{
-			fprintf(stderr, "V4L2_CORE: (save bmp) couldn't write to file %s: %s\n",
-				filename, strerror(errno));
-			ret = E_FILE_IO_ERR;
-		}
-	}
-	else
+	int block_lines = BMP_BLOCK_SIZE / line_size;
+	if(block_lines > BMP_MAX_BLOCK_LINES)
+		block_lines = BMP_MAX_BLOCK_LINES;
+	if(block_lines > height)
+		block_lines = height;
+	if(block_lines < 1)
+		block_lines = 1;
+
+	/*headers + (line + padding) for each block line*/
+	struct iovec iov[2 + 2 * BMP_MAX_BLOCK_LINES];
+
+	int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if(fd < 0)
 	{
-		ret=1;
 		fprintf(stderr, "V4L2_CORE: (save bmp) could not open file %s for write \n",
 			filename);
+		return E_FILE_IO_ERR;
+	}
+
+	uint8_t *block = malloc(block_lines * line_size);
+	if(block == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (save_bmp): %s\n", strerror(errno));
+		exit(-1);
 	}
+
+	int iovcnt = 0;
+	iov[iovcnt].iov_base = &BmpFileh;
+	iov[iovcnt++].iov_len = sizeof(bmp_file_header_t);
+	iov[iovcnt].iov_base = &BmpInfoh;
+	iov[iovcnt++].iov_len = sizeof(bmp_info_header_t);
+
+	/*bottom-up: the last image line is the first in the file*/
+	int line_end = height;
+	while(line_end > 0 && ret == E_OK)
+	{
+		int line_start = line_end - block_lines;
+		if(line_start < 0)
+			line_start = 0;
+
+		yu12_lines_to_dib24(block, frame->yuv_frame, width, height,
+			line_start, line_end, frame->yuv_matrix, frame->yuv_range);
+
+		int i = 0;
+		for(i = 0; i < line_end - line_start; i++)
+		{
+			iov[iovcnt].iov_base = block + i * line_size;
+			iov[iovcnt++].iov_len = line_size;
+			if(stride > line_size)
+			{
+				iov[iovcnt].iov_base = (void *) pad;
+				iov[iovcnt++].iov_len = stride - line_size;
+			}
+		}
+
+		ret = writev_all(fd, iov, iovcnt);
+
+		iovcnt = 0;
+		line_end = line_start;
+	}
+
+	free(block);
+
+	/*flush data stream to file system*/
+	if(ret == E_OK && fsync(fd))
+		ret = E_FILE_IO_ERR;
+	if(close(fd) && ret == E_OK)
+		ret = E_FILE_IO_ERR;
+
+	if(ret != E_OK)
+		fprintf(stderr, "V4L2_CORE: (save bmp) couldn't write to file %s: %s\n",
+			filename, strerror(errno));
+
 	return ret;
 }
 
@@ -150,20 +258,5 @@ static int save_bmp(const char *filename, uint8_t *data, int width, int height,
  */
 int save_image_bmp(v4l2_frame_buff_t *frame, const char *filename)
 {
-	int ret = E_OK;
-	int width = frame->width;
-	int height = frame->height;
-
-	uint8_t *bmp = calloc(width * height * 3, sizeof(uint8_t));
-	if(bmp == NULL)
-	{
-		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (save_img_bmp): %s\n", strerror(errno));
-		exit(-1);
-	}
-	yu12_to_dib24(bmp, frame->yuv_frame, width, height);
-
-	ret = save_bmp(filename, bmp, width, height, 24);
-	free(bmp);
-	
-	return ret;
+	return save_bmp(filename, frame);
 }
@@ -31,10 +31,12 @@
 
 #include "gviewv4l2core.h"
 #include "save_image.h"
-#include "colorspaces.h"
 #include "dct.h"
+#include "gview.h"
 #include "../config.h"
 
+extern int verbosity;
+
 /*huffman table from jpeg decoder*/
 #define JPG_HUFFMAN_TABLE_LENGTH 0x01A0
 extern const uint8_t jpeg_huffman_table[JPG_HUFFMAN_TABLE_LENGTH];
@@ -59,67 +61,85 @@ typedef struct _jpeg_file_header_t
 	uint8_t HTN;/*height Thumbnail 0*/
 } __attribute__ ((packed)) jpeg_file_header_t;
 
+/*output buffer size: data is flushed to file when full*/
+#define JPEG_OUT_BUFF_SIZE (64 * 1024)
+/*
+ * max size of a coded 420 MCU (6 blocks):
+ *  a block is at most 20 + 63 * 26 bits (416 bytes with 0xFF stuffing)
+ */
+#define JPEG_MCU_MAX_SIZE (6 * 416 + 8)
+
 typedef struct _jpeg_encoder_ctx_t
 {
-	uint16_t	image_width;
-	uint16_t	image_height;
-	uint16_t	mcu_width;
-	uint16_t	mcu_height;
-	uint16_t	horizontal_mcus;
-	uint16_t	vertical_mcus;
-
-	uint16_t	rows;
-	uint16_t	cols;
-
-	uint16_t	length_minus_mcu_width;
-	uint16_t	length_minus_width;
-	uint16_t	incr;
-	uint16_t	mcu_width_size;
-	uint16_t	offset;
+	int		image_width;
+	int		image_height;
 
 	int16_t		ldc1;
 	int16_t		ldc2;
 	int16_t		ldc3;
 
-	uint32_t	lcode;
-	uint16_t	bitindex;
+	/* bit writer */
+	uint64_t	bit_buff;
+	int		bit_count;
 
-	/* MCUs */
-	int16_t		Y1 [64];
-	int16_t		Y2 [64];
-	int16_t		Temp [64];
-	int16_t		CB [64];
-	int16_t		CR [64];
+	/* output */
+	FILE		*fp;
+	int		io_error;
+	uint8_t		*out; /*current position in out_buff*/
+
+	/* MCU block (level shifted data, then quantized coefficients) */
+	int16_t		block [64] __attribute__ ((aligned (16)));
 
 	/* Quantization Tables */
 	uint8_t		Lqt [64];
 	uint8_t		Cqt [64];
-	uint16_t	ILqt [64];
-	uint16_t	ICqt [64];
+	uint16_t	ILqt [64] __attribute__ ((aligned (16)));
+	uint16_t	ICqt [64] __attribute__ ((aligned (16)));
+
+	uint8_t		out_buff [JPEG_OUT_BUFF_SIZE];
+
+	/* next free context (context cache) */
+	struct _jpeg_encoder_ctx_t *next;
 
 } jpeg_encoder_ctx_t;
 
+/*free encoder contexts: reused between images (and saving threads)*/
+static jpeg_encoder_ctx_t *jpeg_ctx_cache = NULL;
+static __MUTEX_TYPE jpeg_ctx_mutex = __STATIC_MUTEX_INIT;
+
+/*
+ * add numbits of data to the bitstream (bit_buff, bit_count, output)
+ *   writes 32 bit words with 0xFF byte stuffing
+ */
 #define PUTBITS	\
 {	\
-	bits_in_next_word = (int16_t) (jpeg_ctx->bitindex + numbits - 32);	\
-	if (bits_in_next_word < 0)	\
-	{	\
-		jpeg_ctx->lcode = (jpeg_ctx->lcode << numbits) | data;	\
-		jpeg_ctx->bitindex += numbits;	\
-	}	\
-	else	\
+	bit_buff = (bit_buff << numbits) | data;	\
+	bit_count += numbits;	\
+	if (bit_count >= 32)	\
 	{	\
-		jpeg_ctx->lcode = (jpeg_ctx->lcode << (32 - jpeg_ctx->bitindex)) | (data >> bits_in_next_word);	\
-		if ((*output++ = (uint8_t)(jpeg_ctx->lcode >> 24)) == 0xff)	\
-			*output++ = 0;	\
-		if ((*output++ = (uint8_t)(jpeg_ctx->lcode >> 16)) == 0xff)	\
-			*output++ = 0;	\
-		if ((*output++ = (uint8_t)(jpeg_ctx->lcode >> 8)) == 0xff)	\
-			*output++ = 0;	\
-		if ((*output++ = (uint8_t) jpeg_ctx->lcode) == 0xff)	\
-			*output++ = 0;	\
-		jpeg_ctx->lcode = data;	\
-		jpeg_ctx->bitindex = bits_in_next_word;	\
+		bit_count -= 32;	\
+		uint32_t word = (uint32_t) (bit_buff >> bit_count);	\
+		uint32_t nword = ~word;	\
+		if (((nword - 0x01010101) & word & 0x80808080) == 0)	\
+		{	\
+			/*no 0xff bytes*/	\
+			output[0] = (uint8_t) (word >> 24);	\
+			output[1] = (uint8_t) (word >> 16);	\
+			output[2] = (uint8_t) (word >> 8);	\
+			output[3] = (uint8_t) word;	\
+			output += 4;	\
+		}	\
+		else	\
+		{	\
+			if ((*output++ = (uint8_t) (word >> 24)) == 0xff)	\
+				*output++ = 0;	\
+			if ((*output++ = (uint8_t) (word >> 16)) == 0xff)	\
+				*output++ = 0;	\
+			if ((*output++ = (uint8_t) (word >> 8)) == 0xff)	\
+				*output++ = 0;	\
+			if ((*output++ = (uint8_t) word) == 0xff)	\
+				*output++ = 0;	\
+		}	\
 	}	\
 }
 
@@ -287,6 +307,19 @@ static uint8_t zigzag_table [] =
 	35, 36, 48, 49, 57, 58, 62, 63
 };
 
+/* natural order index of each zigzag position (inverse of zigzag_table) */
+static const uint8_t unzigzag_table [64] =
+{
+	0,  1,  8,  16, 9,  2,  3,  10,
+	17, 24, 32, 25, 18, 11, 4,  5,
+	12, 19, 26, 33, 40, 48, 41, 34,
+	27, 20, 13, 6,  7,  14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36,
+	29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46,
+	53, 60, 61, 54, 47, 55, 62, 63
+};
+
 /* quickcam 5000pro tables (very good quality) */
 static uint8_t luminance_quant_table [] =
 {
@@ -348,55 +381,53 @@ static uint16_t DSP_Division (uint32_t numer, uint32_t denom)
 }
 
 /*
- * split yuyv data into YCBr planes
- *   and fill matching encoder context fields
+ * read a 8x8 block from an image plane and level shift it (-128)
+ *   pixels outside the plane replicate the last row/column
  * args:
- *    jpeg_ctx - pointer to jpeg encoder context
- *    input - pointer to input data
+ *    block - pointer to 64 int16 block
+ *    plane - pointer to image plane
+ *    width - plane width (also the line stride)
+ *    height - plane height
+ *    x - block horizontal position (pixels)
+ *    y - block vertical position (pixels)
  *
  * asserts:
- *    jpeg_ctx is not null
- *    input is not null
+ *    none
  *
  * returns: none
  */
-static void read_422_format (jpeg_encoder_ctx_t *jpeg_ctx, uint8_t *input)
+static void read_block (int16_t *block, const uint8_t *plane,
+	int width, int height, int x, int y)
 {
-	/*assertions*/
-	assert(jpeg_ctx != NULL);
-	assert(input != NULL);
-
-	int32_t i, j;
-
-	int16_t *Y1 = jpeg_ctx->Y1; /*64 int16 block*/
-	int16_t *Y2 = jpeg_ctx->Y2;
-	int16_t *CB = jpeg_ctx->CB;
-	int16_t *CR = jpeg_ctx->CR;
+	int i, j;
 
-	uint16_t incr = jpeg_ctx->incr;
-
-	uint8_t *tmp = NULL;
-	tmp = input;
-
-	for (i=8; i>0; i--) /*8 rows*/
+	if(x + 8 <= width && y + 8 <= height)
 	{
-		for (j=4; j>0; j--) /* 8 cols*/
+		const uint8_t *line = plane + y * width + x;
+		for (i = 0; i < 8; i++)
 		{
-			*Y1++ = *tmp++;
-			*CB++ = *tmp++;
-			*Y1++ = *tmp++;
-			*CR++ = *tmp++;
+			for (j = 0; j < 8; j++)
+				block[j] = (int16_t) (line[j] - 128);
+
+			block += 8;
+			line += width;
 		}
+		return;
+	}
 
-		for (j=4; j>0; j--) /* 8 cols*/
+	/*partial block (image edge)*/
+	for (i = 0; i < 8; i++)
+	{
+		int sy = (y + i < height) ? y + i : height - 1;
+		const uint8_t *line = plane + sy * width;
+
+		for (j = 0; j < 8; j++)
 		{
-			*Y2++ = *tmp++;
-			*CB++ = *tmp++;
-			*Y2++ = *tmp++;
-			*CR++ = *tmp++;
+			int sx = (x + j < width) ? x + j : width - 1;
+			block[j] = (int16_t) (line[sx] - 128);
 		}
 
-		tmp += incr; /* next row (width - mcu_width)*/
+		block += 8;
 	}
 }
 
@@ -435,73 +466,41 @@ static void initialize_quantization_tables (jpeg_encoder_ctx_t *jpeg_ctx)
 	}
 }
 
-/*
- * multiply DCT Coefficients with Quantization table
- *  and store in ZigZag location
- * args:
- *    jpeg_ctx - pointer to jpeg encoder context
- *    data - pointer to data for quantization (from DCT)
- *    quant_table_ptr - pointer to quantization table
- *
- * asserts:
- *    jpeg_ctx is not null
- *    data is not null
- *    quant_table_ptr is not null
- *
- * returns: none
- */
-static void quantization (jpeg_encoder_ctx_t *jpeg_ctx, int16_t * const data, uint16_t * const quant_table_ptr)
-{
-	/*assertions*/
-	assert(jpeg_ctx != NULL);
-	assert(data != NULL);
-	assert(quant_table_ptr != NULL);
-
-	int16_t i;
-	int32_t value;
-
-	for (i=63; i>=0; i--)
-	{
-		value = data [i] * quant_table_ptr [i];
-		value = (value + 0x4000) >> 15;
-
-		jpeg_ctx->Temp [zigzag_table [i]] = (int16_t) value;
-	}
-}
-
 /*
  * add/code huffman table
+ *   codes the quantized block (natural order) in zigzag order
  * args:
  *    jpeg_ctx - pointer to jpeg encoder context
  *    component - image component
- *    output - pointer to output buffer
  *
  * asserts:
  *    jpeg_ctx is not null
- *    output is not null
  *
- * returns: pointer to output buffer
+ * returns: none
  */
-static uint8_t *huffman (jpeg_encoder_ctx_t *jpeg_ctx, uint16_t component, uint8_t *output)
+static void huffman (jpeg_encoder_ctx_t *jpeg_ctx, uint16_t component)
 {
 	/*assertions*/
 	assert(jpeg_ctx != NULL);
-	assert(output != NULL);
 
 	uint16_t i;
 	uint16_t *DcCodeTable, *DcSizeTable, *AcCodeTable, *AcSizeTable;
 
-	int16_t *Temp_Ptr, Coeff, LastDc;
+	const int16_t *block = jpeg_ctx->block;
+	int16_t Coeff, LastDc;
 	uint16_t AbsCoeff, HuffCode, HuffSize, RunLength=0, DataSize=0, index;
 
-	int16_t bits_in_next_word;
 	uint16_t numbits;
 	uint32_t data;
 
-	Temp_Ptr = jpeg_ctx->Temp;
-	Coeff = *Temp_Ptr++;/* Coeff = DC */
+	/*bit writer state*/
+	uint64_t bit_buff = jpeg_ctx->bit_buff;
+	int bit_count = jpeg_ctx->bit_count;
+	uint8_t *output = jpeg_ctx->out;
+
+	Coeff = block[0];/* Coeff = DC */
 
-	/* code DC - Temp[0] */
+	/* code DC - block[0] */
 	if (component == 1)/* luminance - Y */
 	{
 		DcCodeTable = luminance_dc_code_table;
@@ -552,10 +551,10 @@ static uint8_t *huffman (jpeg_encoder_ctx_t *jpeg_ctx, uint16_t component, uint8
 	PUTBITS
 
     /* code AC */
-	for (i=63; i>0; i--)
+	for (i=1; i<64; i++)
 	{
 
-		if ((Coeff = *Temp_Ptr++) != 0)
+		if ((Coeff = block[unzigzag_table[i]]) != 0)
 		{
 			while (RunLength > 15)
 			{
@@ -595,94 +594,74 @@ static uint8_t *huffman (jpeg_encoder_ctx_t *jpeg_ctx, uint16_t component, uint8
 		numbits = AcSizeTable [0];/* EOB                     */
 		PUTBITS
 	}
-	return output;
+
+	jpeg_ctx->bit_buff = bit_buff;
+	jpeg_ctx->bit_count = bit_count;
+	jpeg_ctx->out = output;
 }
 
 /*
- * For bit Stuffing and EOI marker
+ * write the output buffer to file
  * args:
- *     jpeg_ctx - pointer to jpeg encoder context
- *     output - pointer to output buffer
+ *    jpeg_ctx - pointer to jpeg encoder context
  *
  * asserts:
- *     jpeg_ctx is not null
- *     output is not null
+ *    jpeg_ctx is not null
  *
- * returns: pointer to output buffer
+ * returns: none (sets jpeg_ctx->io_error on failure)
  */
-static uint8_t *close_bitstream (jpeg_encoder_ctx_t *jpeg_ctx, uint8_t *output)
+static void flush_output (jpeg_encoder_ctx_t *jpeg_ctx)
 {
 	/*assertions*/
 	assert(jpeg_ctx != NULL);
-	assert(output != NULL);
 
-	if (jpeg_ctx->bitindex > 0)
-	{
-		jpeg_ctx->lcode <<= (32 - jpeg_ctx->bitindex);
-		uint16_t count = (jpeg_ctx->bitindex + 7) >> 3;
-		uint16_t i = 0;
+	size_t size = jpeg_ctx->out - jpeg_ctx->out_buff;
 
-		uint8_t *ptr = (uint8_t *) &jpeg_ctx->lcode + 3;
+	if(size > 0 && !jpeg_ctx->io_error &&
+		fwrite(jpeg_ctx->out_buff, 1, size, jpeg_ctx->fp) != size)
+		jpeg_ctx->io_error = 1;
 
-		for (i=count; i>0; i--)
-		{
-			if ((*output++ = *ptr--) == 0xff)
-				*output++ = 0;
-		}
-	}
-
-	/* End of image marker (EOI) */
-	*output++ = 0xFF;
-	*output++ = 0xD9;
-	return output;
+	jpeg_ctx->out = jpeg_ctx->out_buff;
 }
 
 /*
- * init jpeg encoder context
+ * For bit Stuffing and EOI marker
  * args:
- *    jpeg_ctx - pointer to jpeg encoder context
- *    image_width - image width (in pixels)
- *    image_height - image height (in pixels)
+ *     jpeg_ctx - pointer to jpeg encoder context
  *
  * asserts:
- *    jpeg_ctx is not null
+ *     jpeg_ctx is not null
  *
  * returns: none
  */
-static void initialization (jpeg_encoder_ctx_t *jpeg_ctx, int image_width, int image_height)
+static void close_bitstream (jpeg_encoder_ctx_t *jpeg_ctx)
 {
 	/*assertions*/
 	assert(jpeg_ctx != NULL);
 
-	uint16_t mcu_width, mcu_height, bytes_per_pixel;
-
-	jpeg_ctx->image_width = image_width;
-	jpeg_ctx->image_height = image_height;
-
-	jpeg_ctx->mcu_width = mcu_width = 16;
-	jpeg_ctx->horizontal_mcus = (uint16_t) (image_width >> 4);/* width/16 */
+	uint8_t *output = jpeg_ctx->out;
 
-	jpeg_ctx->mcu_height = mcu_height = 8;
-	jpeg_ctx->vertical_mcus = (uint16_t) (image_height >> 3); /* height/8 */
-
-	bytes_per_pixel = 2;
-
-	jpeg_ctx->length_minus_mcu_width = (uint16_t) ((image_width - mcu_width) * bytes_per_pixel);
-	jpeg_ctx->length_minus_width = (uint16_t) (image_width * bytes_per_pixel);
-
-	jpeg_ctx->mcu_width_size = (uint16_t) (mcu_width * bytes_per_pixel);
+	if (jpeg_ctx->bit_count > 0)
+	{
+		/*pad the last byte with 1 bits*/
+		int pad = (8 - (jpeg_ctx->bit_count & 0x07)) & 0x07;
+		uint64_t bits = (jpeg_ctx->bit_buff << pad) | ((1 << pad) - 1);
+		int count = (jpeg_ctx->bit_count + pad) >> 3;
 
-	jpeg_ctx->rows = jpeg_ctx->mcu_height;
-	jpeg_ctx->cols = jpeg_ctx->mcu_width;
-	jpeg_ctx->incr = jpeg_ctx->length_minus_mcu_width;
-	jpeg_ctx->offset = (uint16_t) ((image_width * mcu_height) * bytes_per_pixel);
+		for (; count > 0; count--)
+		{
+			if ((*output++ = (uint8_t) (bits >> ((count - 1) * 8))) == 0xff)
+				*output++ = 0;
+		}
+	}
 
-	jpeg_ctx->ldc1 = 0;
-	jpeg_ctx->ldc2 = 0;
-	jpeg_ctx->ldc3 = 0;
+	/* End of image marker (EOI) */
+	*output++ = 0xFF;
+	*output++ = 0xD9;
 
-	jpeg_ctx->lcode = 0;
-	jpeg_ctx->bitindex = 0;
+	jpeg_ctx->out = output;
+	jpeg_ctx->bit_buff = 0;
+	jpeg_ctx->bit_count = 0;
 }
 
 /*
@@ -704,60 +683,57 @@ static void jpeg_restart (jpeg_encoder_ctx_t *jpeg_ctx)
 	jpeg_ctx->ldc2 = 0;
 	jpeg_ctx->ldc3 = 0;
 
-	jpeg_ctx->lcode = 0;
-	jpeg_ctx->bitindex = 0;
+	jpeg_ctx->bit_buff = 0;
+	jpeg_ctx->bit_count = 0;
+
+	jpeg_ctx->io_error = 0;
+	jpeg_ctx->out = jpeg_ctx->out_buff;
 }
 
 /*
- * encode single MCU
+ * encode single MCU (420: 4 Y blocks, 1 U block, 1 V block)
  * args:
  *    jpeg_ctx - pointer to jpeg encoder context
- *    output - pointer to output buffer
+ *    input - pointer to input buffer (yu12 format)
+ *    x - MCU horizontal position (luma pixels)
+ *    y - MCU vertical position (luma pixels)
  *
  * asserts:
  *    jpeg_ctx is not null
- *    output is not null
+ *    input is not null
  *
- * returns: pointer to ouptut buffer
+ * returns: none
  */
-static uint8_t* encode_MCU (jpeg_encoder_ctx_t *jpeg_ctx, uint8_t *output)
+static void encode_MCU (jpeg_encoder_ctx_t *jpeg_ctx, const uint8_t *input, int x, int y)
 {
 	/*assertions*/
 	assert(jpeg_ctx != NULL);
-	assert(output != NULL);
-
-	levelshift (jpeg_ctx->Y1);
-	DCT (jpeg_ctx->Y1);
-
-	quantization (jpeg_ctx, jpeg_ctx->Y1, jpeg_ctx->ILqt);
-
-	output = huffman (jpeg_ctx, 1, output);
-
-	levelshift (jpeg_ctx->Y2);
-	DCT (jpeg_ctx->Y2);
-
-	quantization (jpeg_ctx, jpeg_ctx->Y2,
-		jpeg_ctx->ILqt);
-
-	output = huffman (jpeg_ctx, 1, output);
-
-	levelshift (jpeg_ctx->CB);
-	DCT (jpeg_ctx->CB);
-
-	quantization (jpeg_ctx, jpeg_ctx->CB,
-		jpeg_ctx->ICqt);
+	assert(input != NULL);
 
-	output = huffman (jpeg_ctx, 2, output);
+	int width = jpeg_ctx->image_width;
+	int height = jpeg_ctx->image_height;
+	int c_width = width >> 1;
+	int c_height = height >> 1;
 
-	levelshift (jpeg_ctx->CR);
-	DCT (jpeg_ctx->CR);
+	const uint8_t *u_plane = input + (width * height);
+	const uint8_t *v_plane = u_plane + (c_width * c_height);
 
-	quantization (jpeg_ctx, jpeg_ctx->CR,
-		jpeg_ctx->ICqt);
+	int i = 0;
+	for(i = 0; i < 4; i++)
+	{
+		read_block (jpeg_ctx->block, input, width, height,
+			x + ((i & 1) << 3), y + ((i >> 1) << 3));
+		DCT_quant (jpeg_ctx->block, jpeg_ctx->ILqt);
+		huffman (jpeg_ctx, 1);
+	}
 
-	output = huffman (jpeg_ctx, 3, output);
+	read_block (jpeg_ctx->block, u_plane, c_width, c_height, x >> 1, y >> 1);
+	DCT_quant (jpeg_ctx->block, jpeg_ctx->ICqt);
+	huffman (jpeg_ctx, 2);
 
-	return output;
+	read_block (jpeg_ctx->block, v_plane, c_width, c_height, x >> 1, y >> 1);
+	DCT_quant (jpeg_ctx->block, jpeg_ctx->ICqt);
+	huffman (jpeg_ctx, 3);
 }
 
 /*
@@ -897,9 +873,9 @@ static uint8_t *write_markers(jpeg_encoder_ctx_t *jpeg_ctx, uint8_t *output, int
 	// Nf
 	*output++ = number_of_components;
 
-	/* type 422 */
+	/* type 420 */
 	*output++ = 0x01; /*id (y)*/
-	*output++ = 0x21; /*horiz|vertical */
+	*output++ = 0x22; /*horiz|vertical */
 	*output++ = 0x00; /*quantization table used*/
 
 	*output++ = 0x02; /*id (u)*/
@@ -926,7 +902,7 @@ static uint8_t *write_markers(jpeg_encoder_ctx_t *jpeg_ctx, uint8_t *output, int
 	// Ns = number of scans
 	*output++ = number_of_components;
 
-	/* type 422*/
+	/* type 420*/
 	*output++ = 0x01; /*component id (y)*/
 	*output++ = 0x00; /*dc|ac tables*/
 
@@ -945,82 +921,129 @@ static uint8_t *write_markers(jpeg_encoder_ctx_t *jpeg_ctx, uint8_t *output, int
 
 /*
  * encode jpeg
+ *   the output is written to jpeg_ctx->fp
  * args:
- *    input - pointer to input buffer (yuyv format)
- *    output - pointer to output buffer (jpeg format)
+ *    input - pointer to input buffer (yu12 format)
  *    jpeg_ctx - pointer to jpeg encoder context
  *    huff - huffman flag
  *
  *
  * asserts:
  *    input is not null
- *    ouput is not null
  *    jpeg_ctx is not null
  *
- * returns: ouput size
+ * returns: error code
  */
-static int encode_jpeg (uint8_t *input, uint8_t *output,
-	jpeg_encoder_ctx_t *jpeg_ctx, int huff)
+static int encode_jpeg (const uint8_t *input, jpeg_encoder_ctx_t *jpeg_ctx, int huff)
 {
 	/*assertions*/
 	assert(input != NULL);
-	assert(output != NULL);
 	assert(jpeg_ctx != NULL);
 
-	int size;
-	uint16_t i, j;
-	uint8_t *tmp_ptr=NULL;
-	uint8_t *tmp_iptr = input;
-	uint8_t *tmp_optr = output;
+	int x, y;
 
 	/* clean jpeg parameters*/
 	jpeg_restart(jpeg_ctx);
 
 	/* Writing Marker Data */
-	tmp_optr = write_markers (jpeg_ctx, tmp_optr, huff);
-
-	uint8_t *yuv422 = calloc(jpeg_ctx->image_width * jpeg_ctx->image_height * 2, sizeof(uint8_t));
-	if(yuv422 == NULL)
-	{
-		fprintf(stderr, "V4L2_CORE: couldn't allocate memory for jpeg encoder (fatal)\n");
-		exit(-1);
-	}
-	yu12_to_yuyv(yuv422, input, jpeg_ctx->image_width, jpeg_ctx->image_height);
-	tmp_iptr = yuv422;
+	jpeg_ctx->out = write_markers (jpeg_ctx, jpeg_ctx->out, huff);
 
-	for (i=0; i < jpeg_ctx->vertical_mcus; i++) /* height /8 */
+	for (y = 0; y < jpeg_ctx->image_height; y += 16)
 	{
-		tmp_ptr = tmp_iptr;
-		for (j=0; j< jpeg_ctx->horizontal_mcus; j++) /* width /16 */
+		for (x = 0; x < jpeg_ctx->image_width; x += 16)
 		{
-			/*reads a block*/
-			read_422_format (jpeg_ctx, tmp_iptr); /*YUYV*/
-
 			/* Encode the data in MCU */
-			tmp_optr = encode_MCU (jpeg_ctx, tmp_optr);
+			encode_MCU (jpeg_ctx, input, x, y);
 
-			if(j < (jpeg_ctx->horizontal_mcus -1))
-			{
-				tmp_iptr += jpeg_ctx->mcu_width_size;
-			}
-			else
-			{
-				tmp_iptr=tmp_ptr;
-			}
+			if(jpeg_ctx->out - jpeg_ctx->out_buff > JPEG_OUT_BUFF_SIZE - JPEG_MCU_MAX_SIZE)
+				flush_output(jpeg_ctx);
 		}
-		tmp_iptr += jpeg_ctx->offset;
-
 	}
 
 	/* Close Routine */
-	free(yuv422);
+	close_bitstream (jpeg_ctx);
+	flush_output(jpeg_ctx);
 
-	tmp_optr = close_bitstream (jpeg_ctx, tmp_optr);
-	size = tmp_optr - output;
-	tmp_iptr = NULL;
-	tmp_optr = NULL;
+	return (jpeg_ctx->io_error ? E_FILE_IO_ERR : E_OK);
+}
 
-	return (size);
+/*
+ * get a jpeg encoder context from the cache (allocates a new one if empty)
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to jpeg encoder context
+ */
+static jpeg_encoder_ctx_t *get_encoder_ctx()
+{
+	__LOCK_MUTEX(&jpeg_ctx_mutex);
+	jpeg_encoder_ctx_t *jpeg_ctx = jpeg_ctx_cache;
+	if(jpeg_ctx)
+		jpeg_ctx_cache = jpeg_ctx->next;
+	__UNLOCK_MUTEX(&jpeg_ctx_mutex);
+
+	if(jpeg_ctx)
+		return jpeg_ctx;
+
+	jpeg_ctx = calloc(1, sizeof(jpeg_encoder_ctx_t));
+	if(jpeg_ctx == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (get_encoder_ctx): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	/* Initialization of Quantization Tables  */
+	initialize_quantization_tables (jpeg_ctx);
+
+	return jpeg_ctx;
+}
+
+/*
+ * return a jpeg encoder context to the cache
+ * args:
+ *    jpeg_ctx - pointer to jpeg encoder context
+ *
+ * asserts:
+ *    jpeg_ctx is not null
+ *
+ * returns: none
+ */
+static void release_encoder_ctx(jpeg_encoder_ctx_t *jpeg_ctx)
+{
+	/*assertions*/
+	assert(jpeg_ctx != NULL);
+
+	jpeg_ctx->fp = NULL;
+
+	__LOCK_MUTEX(&jpeg_ctx_mutex);
+	jpeg_ctx->next = jpeg_ctx_cache;
+	jpeg_ctx_cache = jpeg_ctx;
+	__UNLOCK_MUTEX(&jpeg_ctx_mutex);
+}
+
+/*
+ * free the cached jpeg encoder contexts
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void save_image_jpeg_clean_cache()
+{
+	__LOCK_MUTEX(&jpeg_ctx_mutex);
+	while(jpeg_ctx_cache)
+	{
+		jpeg_encoder_ctx_t *jpeg_ctx = jpeg_ctx_cache;
+		jpeg_ctx_cache = jpeg_ctx->next;
+		free(jpeg_ctx);
+	}
+	__UNLOCK_MUTEX(&jpeg_ctx_mutex);
 }
 
 /*
@@ -1038,38 +1061,184 @@ int save_image_jpeg(v4l2_frame_buff_t *frame, const char *filename)
 {
 	int ret = E_OK;
 
-	jpeg_encoder_ctx_t *jpeg_ctx = calloc(1, sizeof(jpeg_encoder_ctx_t));
-	if(jpeg_ctx == NULL)
+	FILE *fp = fopen(filename, "wb");
+	if(fp == NULL)
 	{
-		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (save_image_jpeg): %s\n", strerror(errno));
-		exit(-1);
+		fprintf (stderr, "V4L2_CORE: (save_image_jpeg) couldn't open %s: %s\n",
+			filename, strerror(errno));
+		return E_FILE_IO_ERR;
 	}
 
-	uint8_t *jpeg = calloc((frame->width * frame->height) >> 1, sizeof(uint8_t));
-	if(jpeg == NULL)
+	jpeg_encoder_ctx_t *jpeg_ctx = get_encoder_ctx();
+
+	jpeg_ctx->image_width = frame->width;
+	jpeg_ctx->image_height = frame->height;
+	jpeg_ctx->fp = fp;
+
+	ret = encode_jpeg(frame->yuv_frame, jpeg_ctx, 1);
+
+	release_encoder_ctx(jpeg_ctx);
+
+	if(fclose(fp) != 0)
+		ret = E_FILE_IO_ERR;
+
+	if(ret != E_OK)
+		fprintf (stderr, "V4L2_CORE: (save_image_jpeg) couldn't capture Image to %s \n",
+			filename);
+	else if(verbosity > 0)
+		printf("V4L2_CORE: saved data to %s\n", filename);
+
+	return ret;
+}
+
+/*
+ * find the start of scan (SOS) marker of a jpeg bitstream
+ * args:
+ *    data - pointer to jpeg data
+ *    size - jpeg data size (bytes)
+ *    has_dht - pointer to flag set if the header has a DHT (huffman table) segment
+ *
+ * asserts:
+ *    none
+ *
+ * returns: offset of the SOS marker (-1 if not a valid jpeg header)
+ */
+static int jpeg_find_sos(const uint8_t *data, size_t size, int *has_dht)
+{
+	*has_dht = 0;
+
+	/*must start with SOI*/
+	if(data == NULL || size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+		return -1;
+
+	size_t pos = 2;
+	while(pos + 4 <= size)
 	{
-		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (save_image_jpeg): %s\n", strerror(errno));
-		exit(-1);
+		if(data[pos] != 0xFF)
+			return -1;
+
+		uint8_t marker = data[pos + 1];
+
+		if(marker == 0xFF) /*fill byte*/
+		{
+			pos++;
+			continue;
+		}
+
+		if(marker == 0xDA) /*SOS*/
+			return (int) pos;
+
+		if(marker == 0xD8 || marker == 0xD9) /*SOI or EOI before the scan*/
+			return -1;
+
+		if(marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+		{
+			/*no segment data*/
+			pos += 2;
+			continue;
+		}
+
+		size_t length = (data[pos + 2] << 8) | data[pos + 3];
+		if(length < 2)
+			return -1;
+
+		if(marker == 0xC4)
+			*has_dht = 1;
+
+		pos += 2 + length;
 	}
 
-	/* Initialization of JPEG control structure */
-	initialization (jpeg_ctx, frame->width, frame->height);
+	return -1;
+}
 
-	/* Initialization of Quantization Tables  */
-	initialize_quantization_tables (jpeg_ctx);
+/*
+ * check if the frame raw data can be saved as is to a jpeg file
+ * args:
+ *    frame - pointer to frame buffer
+ *
+ * asserts:
+ *    frame is not null
+ *
+ * returns: 1 if the raw data is a (m)jpeg bitstream, 0 otherwise
+ */
+int save_image_jpeg_can_passthrough(v4l2_frame_buff_t *frame)
+{
+	/*assertions*/
+	assert(frame != NULL);
 
-	int jpeg_size = encode_jpeg(frame->yuv_frame, jpeg, jpeg_ctx, 1);
+	if(frame->raw_format != V4L2_PIX_FMT_MJPEG &&
+		frame->raw_format != V4L2_PIX_FMT_JPEG)
+		return 0;
 
-	if(v4l2core_save_data_to_file(filename, jpeg, jpeg_size))
+	int has_dht = 0;
+	return (jpeg_find_sos(frame->raw_frame, frame->raw_frame_size, &has_dht) > 0);
+}
+
+/*
+ * save the frame (m)jpeg bitstream to a jpeg file (no re-encoding)
+ *   uvc mjpeg frames usually omit the huffman tables, in that case
+ *   the standard tables (DHT) are inserted before the scan
+ * args:
+ *    frame - pointer to frame buffer
+ *    filename - filename string
+ *
+ * asserts:
+ *    frame is not null
+ *
+ * returns: error code
+ */
+int save_image_jpeg_passthrough(v4l2_frame_buff_t *frame, const char *filename)
+{
+	/*assertions*/
+	assert(frame != NULL);
+
+	int has_dht = 0;
+	int sos = jpeg_find_sos(frame->raw_frame, frame->raw_frame_size, &has_dht);
+	if(sos < 0)
 	{
-		fprintf (stderr, "V4L2_CORE: (save_image_jpeg) couldn't capture Image to %s \n",
+		fprintf(stderr, "V4L2_CORE: (save_image_jpeg) raw frame is not a valid jpeg bitstream\n");
+		return E_FORMAT_ERR;
+	}
+
+	if(has_dht)
+	{
+		if(v4l2core_save_data_to_file(filename, frame->raw_frame, frame->raw_frame_size))
+		{
+			fprintf (stderr, "V4L2_CORE: (save_image_jpeg) couldn't capture Image to %s \n",
 					filename);
-		ret = E_FILE_IO_ERR;
+			return E_FILE_IO_ERR;
+		}
+		return E_OK;
+	}
+
+	/*DHT marker and segment length (includes the 2 length bytes)*/
+	uint8_t dht[4] = {0xFF, 0xC4, 0x01, 0xA2};
+
+	FILE *fp = fopen(filename, "wb");
+	if(fp == NULL)
+	{
+		fprintf (stderr, "V4L2_CORE: (save_image_jpeg) couldn't open %s: %s\n",
+			filename, strerror(errno));
+		return E_FILE_IO_ERR;
 	}
 
-	/*clean up*/
-	free(jpeg);
-	free(jpeg_ctx);
+	int ret = E_OK;
+
+	/*header, standard huffman tables, scan*/
+	if(fwrite(frame->raw_frame, sos, 1, fp) < 1 ||
+		fwrite(dht, sizeof(dht), 1, fp) < 1 ||
+		fwrite(jpeg_huffman_table, JPG_HUFFMAN_TABLE_LENGTH, 1, fp) < 1 ||
+		fwrite(frame->raw_frame + sos, frame->raw_frame_size - sos, 1, fp) < 1)
+		ret = E_FILE_IO_ERR;
+
+	if(fclose(fp) != 0)
+		ret = E_FILE_IO_ERR;
+
+	if(ret != E_OK)
+		fprintf (stderr, "V4L2_CORE: (save_image_jpeg) couldn't capture Image to %s \n",
+			filename);
+	else if(verbosity > 0)
+		printf("V4L2_CORE: saved data to %s\n", filename);
 
 	return ret;
 }
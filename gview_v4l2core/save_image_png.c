@@ -29,28 +29,549 @@
 #include <errno.h>
 #include <assert.h>
 #include <png.h>
+#include <zlib.h>
 
 #include "gviewv4l2core.h"
 #include "save_image.h"
 #include "colorspaces.h"
+#include "decoder_pool.h"
+#include "gview.h"
+
+extern int verbosity;
+
+/*deflate window (and max dictionary) size*/
+#define PNG_WINDOW_SIZE (32768)
+/*min size of filtered data in a compressed band*/
+#define PNG_MIN_BAND_SIZE (128 * 1024)
+
+/*png options (v4l2core_set_png_options)*/
+static int png_level = Z_DEFAULT_COMPRESSION;
+static int png_filter = IMG_PNG_FILTER_ADAPTIVE;
+static int png_threads = 1;
+
+/*band compression threads (fast png)*/
+static decoder_pool_t *png_pool = NULL;
+static int png_pool_users = 0;
+static __MUTEX_TYPE png_mutex = __STATIC_MUTEX_INIT;
+
+typedef struct _png_band_t
+{
+	uint8_t *data;  //compressed data (raw deflate)
+	size_t size;    //compressed data size
+	size_t alloc;   //compressed data buffer size
+	size_t in_size; //filtered data size
+	uLong adler;    //adler32 of the filtered data
+	int error;      //zlib error
+} png_band_t;
+
+typedef struct _png_bands_t
+{
+	v4l2_frame_buff_t *frame;
+	int level;
+	int filter;
+	int band_lines;   //image lines in each band
+	int dict_lines;   //lines needed for the band dictionary
+	int nbands;
+	png_band_t *band;
+} png_bands_t;
+
+/*
+ * paeth predictor (png spec)
+ * args:
+ *    a - left byte
+ *    b - up byte
+ *    c - upper left byte
+ *
+ * asserts:
+ *    none
+ *
+ * returns: predictor
+ */
+static inline uint8_t paeth_predictor(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a);
+	int pb = abs(p - b);
+	int pc = abs(p - c);
+
+	if(pa <= pb && pa <= pc)
+		return (uint8_t) a;
+	if(pb <= pc)
+		return (uint8_t) b;
+	return (uint8_t) c;
+}
+
+/*
+ * filter a rgb24 row
+ * args:
+ *    out - pointer to filtered row (filter type byte + row_bytes)
+ *    row - pointer to rgb row
+ *    prev - pointer to previous rgb row (zeros for the first image row)
+ *    row_bytes - rgb row size in bytes
+ *    type - filter type (IMG_PNG_FILTER_NONE to IMG_PNG_FILTER_PAETH)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void filter_row(uint8_t *out, const uint8_t *row, const uint8_t *prev,
+	int row_bytes, int type)
+{
+	int i = 0;
+
+	*out++ = (uint8_t) type;
+
+	switch(type)
+	{
+		case IMG_PNG_FILTER_SUB:
+			for(i = 0; i < 3; i++)
+				out[i] = row[i];
+			for(; i < row_bytes; i++)
+				out[i] = row[i] - row[i - 3];
+			break;
+
+		case IMG_PNG_FILTER_UP:
+			for(i = 0; i < row_bytes; i++)
+				out[i] = row[i] - prev[i];
+			break;
+
+		case IMG_PNG_FILTER_AVG:
+			for(i = 0; i < 3; i++)
+				out[i] = row[i] - (prev[i] >> 1);
+			for(; i < row_bytes; i++)
+				out[i] = row[i] - ((row[i - 3] + prev[i]) >> 1);
+			break;
+
+		case IMG_PNG_FILTER_PAETH:
+			for(i = 0; i < 3; i++)
+				out[i] = row[i] - prev[i];
+			for(; i < row_bytes; i++)
+				out[i] = row[i] - paeth_predictor(row[i - 3], prev[i], prev[i - 3]);
+			break;
+
+		default:
+			memcpy(out, row, row_bytes);
+			break;
+	}
+}
+
+/*
+ * filter a rgb24 row with the configured filter
+ *   adaptive: the filter with the lowest sum of absolute (signed)
+ *   values is used (the libpng heuristic)
+ * args:
+ *    out - pointer to filtered row (filter type byte + row_bytes)
+ *    row - pointer to rgb row
+ *    prev - pointer to previous rgb row (zeros for the first image row)
+ *    row_bytes - rgb row size in bytes
+ *    filter - filter (IMG_PNG_FILTER_XXX)
+ *    tmp - pointer to scratch buffer (row_bytes + 1)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void filter_row_adaptive(uint8_t *out, const uint8_t *row, const uint8_t *prev,
+	int row_bytes, int filter, uint8_t *tmp)
+{
+	if(filter != IMG_PNG_FILTER_ADAPTIVE)
+	{
+		filter_row(out, row, prev, row_bytes, filter);
+		return;
+	}
+
+	uint32_t best_sum = UINT32_MAX;
+	uint8_t *best = out;
+	uint8_t *cand = tmp;
+	int type = 0, i = 0, j = 0;
+
+	for(type = IMG_PNG_FILTER_NONE; type <= IMG_PNG_FILTER_PAETH; type++)
+	{
+		filter_row(cand, row, prev, row_bytes, type);
+
+		/*sum in blocks, stop as soon as it can't be the best*/
+		uint32_t sum = 0;
+		for(i = 1; i <= row_bytes && sum < best_sum; i += 256)
+		{
+			int end = (i + 256 <= row_bytes + 1) ? i + 256 : row_bytes + 1;
+			for(j = i; j < end; j++)
+				sum += abs((int8_t) cand[j]);
+		}
+
+		if(sum < best_sum)
+		{
+			best_sum = sum;
+			uint8_t *swap = best;
+			best = cand;
+			cand = swap;
+		}
+	}
+
+	if(best != out)
+		memcpy(out, best, row_bytes + 1);
+}
+
+/*
+ * filter and compress a band of image lines into a raw deflate stream
+ *   the deflate dictionary is primed with the filtered lines of the
+ *   previous band, so bands compress almost as well as a single stream
+ * args:
+ *    bands - pointer to png bands data
+ *    index - band index
+ *    scratch - per thread scratch buffer
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none (sets band error on failure)
+ */
+static void compress_band(png_bands_t *bands, int index, uint8_t *scratch)
+{
+	v4l2_frame_buff_t *frame = bands->frame;
+	png_band_t *band = &bands->band[index];
+
+	int width = frame->width;
+	int height = frame->height;
+	int row_bytes = width * 3;
+
+	int line_start = index * bands->band_lines;
+	int line_end = line_start + bands->band_lines;
+	if(line_end > height)
+		line_end = height;
+
+	int dict_start = line_start - bands->dict_lines;
+	if(dict_start < 0)
+		dict_start = 0;
+
+	/*scratch: 2 rgb rows, filtered dictionary lines, filter row, adaptive tmp*/
+	uint8_t *rgb[2] = {scratch, scratch + row_bytes};
+	uint8_t *dict = scratch + 2 * row_bytes;
+	uint8_t *filtered = dict + bands->dict_lines * (row_bytes + 1);
+	uint8_t *tmp = filtered + row_bytes + 1;
+
+	z_stream strm;
+	memset(&strm, 0, sizeof(z_stream));
+
+	band->error = deflateInit2(&strm, bands->level, Z_DEFLATED, -15, 8,
+		(bands->filter == IMG_PNG_FILTER_NONE) ? Z_DEFAULT_STRATEGY : Z_FILTERED);
+	if(band->error != Z_OK)
+		return;
+
+	band->alloc = deflateBound(&strm, (line_end - line_start) * (row_bytes + 1)) + 64;
+	band->data = malloc(band->alloc);
+	if(band->data == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (save_image_png): %s\n", strerror(errno));
+		exit(-1);
+	}
+	band->size = 0;
+	band->in_size = 0;
+	band->adler = adler32(0L, Z_NULL, 0);
+
+	/*previous line of the first converted one (zeros for the first image line)*/
+	int cur = 0;
+	if(dict_start > 0)
+		yu12_lines_to_rgb24(rgb[1], frame->yuv_frame, width, height,
+			dict_start - 1, dict_start, frame->yuv_matrix, frame->yuv_range);
+	else
+		memset(rgb[1], 0, row_bytes);
+
+	int line = 0;
+	uint8_t *dict_ptr = dict;
+	for(line = dict_start; line < line_end && band->error == Z_OK; line++)
+	{
+		yu12_lines_to_rgb24(rgb[cur], frame->yuv_frame, width, height,
+			line, line + 1, frame->yuv_matrix, frame->yuv_range);
+
+		if(line < line_start)
+		{
+			filter_row_adaptive(dict_ptr, rgb[cur], rgb[cur ^ 1], row_bytes,
+				bands->filter, tmp);
+			dict_ptr += row_bytes + 1;
+
+			if(line == line_start - 1)
+			{
+				size_t dict_size = dict_ptr - dict;
+				if(dict_size > PNG_WINDOW_SIZE)
+					dict_size = PNG_WINDOW_SIZE;
+				band->error = deflateSetDictionary(&strm, dict_ptr - dict_size, dict_size);
+			}
+		}
+		else
+		{
+			filter_row_adaptive(filtered, rgb[cur], rgb[cur ^ 1], row_bytes,
+				bands->filter, tmp);
+
+			band->adler = adler32(band->adler, filtered, row_bytes + 1);
+			band->in_size += row_bytes + 1;
+
+			int last = (line == line_end - 1);
+			int flush = !last ? Z_NO_FLUSH :
+				((index == bands->nbands - 1) ? Z_FINISH : Z_SYNC_FLUSH);
+
+			strm.next_in = filtered;
+			strm.avail_in = row_bytes + 1;
+			do
+			{
+				if(band->size == band->alloc)
+				{
+					band->alloc += band->alloc / 2;
+					band->data = realloc(band->data, band->alloc);
+					if(band->data == NULL)
+					{
+						fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (save_image_png): %s\n", strerror(errno));
+						exit(-1);
+					}
+				}
+				strm.next_out = band->data + band->size;
+				strm.avail_out = band->alloc - band->size;
+
+				int ret = deflate(&strm, flush);
+				band->size = band->alloc - strm.avail_out;
+				if(ret == Z_STREAM_ERROR)
+				{
+					band->error = ret;
+					break;
+				}
+			}
+			while(strm.avail_out == 0 || strm.avail_in > 0);
+		}
+
+		cur ^= 1;
+	}
+
+	deflateEnd(&strm);
+}
+
+/*
+ * compress bands job (decoder pool)
+ * args:
+ *    data - pointer to png bands data
+ *    start - first band
+ *    end - band after the last one
+ *    scratch - per thread scratch buffer
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void compress_bands_job(void *data, int start, int end, uint8_t *scratch)
+{
+	png_bands_t *bands = (png_bands_t *) data;
+
+	int i = 0;
+	for(i = start; i < end; i++)
+		compress_band(bands, i, scratch);
+}
+
+/*
+ * get the png compression pool (created if needed)
+ * args:
+ *    nthreads - number of compression threads
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to pool (NULL if not available)
+ *          must be released with release_png_pool
+ */
+static decoder_pool_t *get_png_pool(int nthreads)
+{
+	__LOCK_MUTEX(&png_mutex);
+
+	/*the pool can only be changed when not in use*/
+	if(png_pool && png_pool_users == 0 &&
+		decoder_pool_get_threads(png_pool) != nthreads)
+	{
+		decoder_pool_destroy(png_pool);
+		png_pool = NULL;
+	}
+
+	if(png_pool == NULL)
+		png_pool = decoder_pool_create(nthreads);
+
+	decoder_pool_t *pool = png_pool;
+	if(pool)
+		png_pool_users++;
+
+	__UNLOCK_MUTEX(&png_mutex);
+
+	return pool;
+}
+
+/*
+ * release the png compression pool (get_png_pool)
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void release_png_pool()
+{
+	__LOCK_MUTEX(&png_mutex);
+	png_pool_users--;
+	__UNLOCK_MUTEX(&png_mutex);
+}
+
+/*
+ * free png compressed bands
+ * args:
+ *    bands - pointer to png bands data
+ *
+ * asserts:
+ *    bands is not null
+ *
+ * returns: none
+ */
+static void free_png_bands(png_bands_t *bands)
+{
+	/*assertions*/
+	assert(bands != NULL);
+
+	int i = 0;
+	if(bands->band)
+	{
+		for(i = 0; i < bands->nbands; i++)
+			if(bands->band[i].data)
+				free(bands->band[i].data);
+		free(bands->band);
+	}
+	bands->band = NULL;
+}
 
 /*
- * save rgb data into png format file
+ * filter and compress the frame in row bands on the png pool threads
+ * args:
+ *    bands - pointer to png bands data (frame, level and filter set)
+ *    pool - pointer to png pool
+ *
+ * asserts:
+ *    bands is not null
+ *    pool is not null
+ *
+ * returns: error code
+ */
+static int compress_png_bands(png_bands_t *bands, decoder_pool_t *pool)
+{
+	/*assertions*/
+	assert(bands != NULL);
+	assert(pool != NULL);
+
+	int height = bands->frame->height;
+	int row_bytes = bands->frame->width * 3;
+
+	/*a few bands per thread, but big enough to compress well*/
+	int nthreads = decoder_pool_get_threads(pool);
+	bands->band_lines = (height + (nthreads * 4) - 1) / (nthreads * 4);
+	int min_lines = (PNG_MIN_BAND_SIZE + row_bytes) / (row_bytes + 1);
+	if(bands->band_lines < min_lines)
+		bands->band_lines = min_lines;
+	if(bands->band_lines > height)
+		bands->band_lines = height;
+
+	bands->nbands = (height + bands->band_lines - 1) / bands->band_lines;
+	bands->dict_lines = (PNG_WINDOW_SIZE + row_bytes) / (row_bytes + 1);
+	if(bands->dict_lines > bands->band_lines)
+		bands->dict_lines = bands->band_lines;
+
+	bands->band = calloc(bands->nbands, sizeof(png_band_t));
+	if(bands->band == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (save_image_png): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	size_t scratch_size = 2 * row_bytes +
+		(bands->dict_lines + 2) * (row_bytes + 1);
+
+	decoder_pool_run_jobs(pool, compress_bands_job, bands,
+		bands->nbands, scratch_size);
+
+	int i = 0;
+	for(i = 0; i < bands->nbands; i++)
+	{
+		if(bands->band[i].error != Z_OK)
+		{
+			fprintf(stderr, "V4L2_CORE: (save png) zlib error %i\n", bands->band[i].error);
+			return E_ALLOC_ERR;
+		}
+	}
+
+	return E_OK;
+}
+
+/*
+ * write the compressed bands as png image data (IDAT chunks)
+ *   the bands are a single zlib stream: zlib header, the raw
+ *   deflate data of each band and the combined adler32
+ * args:
+ *    png_ptr - pointer to png write struct
+ *    bands - pointer to png bands data
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void write_png_bands(png_structp png_ptr, png_bands_t *bands)
+{
+	/*zlib header: deflate, 32K window, compression level hint*/
+	int level = bands->level < 0 ? 6 : bands->level;
+	int flevel = (level < 2) ? 0 : (level < 6) ? 1 : (level == 6) ? 2 : 3;
+	uint8_t header[2] = {0x78, (uint8_t) (flevel << 6)};
+	header[1] += (31 - (((header[0] << 8) | header[1]) % 31)) % 31;
+
+	png_write_chunk(png_ptr, (png_const_bytep) "IDAT", header, 2);
+
+	uLong adler = adler32(0L, Z_NULL, 0);
+
+	int i = 0;
+	for(i = 0; i < bands->nbands; i++)
+	{
+		png_band_t *band = &bands->band[i];
+
+		png_write_chunk(png_ptr, (png_const_bytep) "IDAT", band->data, band->size);
+		adler = adler32_combine(adler, band->adler, band->in_size);
+	}
+
+	uint8_t trailer[4] =
+	{
+		(uint8_t) (adler >> 24),
+		(uint8_t) (adler >> 16),
+		(uint8_t) (adler >> 8),
+		(uint8_t) adler
+	};
+	png_write_chunk(png_ptr, (png_const_bytep) "IDAT", trailer, 4);
+
+	png_write_chunk(png_ptr, (png_const_bytep) "IEND", NULL, 0);
+}
+
+/*
+ * save frame data into png format file
  * args:
  *    filename - string with filename
- *    width - image width (in pixels)
- *    height - image height (in pixels)
- *    data -pointer to rgb data to save
+ *    frame - pointer to frame buffer
+ *    level - zlib compression level
+ *    filter - row filter (IMG_PNG_FILTER_XXX)
+ *    bands - pointer to compressed bands (NULL - compress with libpng)
+ *    line - pointer to rgb line buffer (libpng compression)
  *
  * asserts:
- *   data is not null
+ *   frame is not null
  *
  * returns: error code
  */
-static int save_png(const char *filename, int width, int height, uint8_t *data)
+static int save_png(const char *filename, v4l2_frame_buff_t *frame,
+	int level, int filter, png_bands_t *bands, uint8_t *line)
 {
 	/*assertions*/
-	assert(data != NULL);
+	assert(frame != NULL);
 
 	int l=0;
 	FILE *fp;
@@ -58,7 +579,9 @@ static int save_png(const char *filename, int width, int height, uint8_t *data)
 	png_infop info_ptr;
 	png_text text_ptr[3];
 
-	png_bytep row_pointers[height];
+	int width = frame->width;
+	int height = frame->height;
+
 	/* open the file */
 	fp = fopen(filename, "wb");
 	if (fp == NULL)
@@ -108,17 +631,30 @@ static int save_png(const char *filename, int width, int height, uint8_t *data)
 	 * PNG_FILTER_VALUE_NAME or the bitwise OR of one
 	 * or more PNG_FILTER_NAME masks.
 	 */
-	//png_set_filter(png_ptr, 0,
-	//	PNG_FILTER_NONE  | PNG_FILTER_VALUE_NONE |
-	//	PNG_FILTER_SUB   | PNG_FILTER_VALUE_SUB  |
-	//	PNG_FILTER_UP    | PNG_FILTER_VALUE_UP   |
-	//	PNG_FILTER_AVE   | PNG_FILTER_VALUE_AVE  |
-	//	PNG_FILTER_PAETH | PNG_FILTER_VALUE_PAETH|
-	//	PNG_ALL_FILTERS);
+	switch(filter)
+	{
+		case IMG_PNG_FILTER_NONE:
+			png_set_filter(png_ptr, 0, PNG_FILTER_NONE);
+			break;
+		case IMG_PNG_FILTER_SUB:
+			png_set_filter(png_ptr, 0, PNG_FILTER_SUB);
+			break;
+		case IMG_PNG_FILTER_UP:
+			png_set_filter(png_ptr, 0, PNG_FILTER_UP);
+			break;
+		case IMG_PNG_FILTER_AVG:
+			png_set_filter(png_ptr, 0, PNG_FILTER_AVG);
+			break;
+		case IMG_PNG_FILTER_PAETH:
+			png_set_filter(png_ptr, 0, PNG_FILTER_PAETH);
+			break;
+		default:
+			png_set_filter(png_ptr, 0, PNG_ALL_FILTERS);
+			break;
+	}
 
 	/* set the zlib compression level */
-	//png_set_compression_level(png_ptr,
-	//	Z_BEST_COMPRESSION);
+	png_set_compression_level(png_ptr, level);
 
 	/* set other zlib parameters */
 	//png_set_compression_mem_level(png_ptr, 8);
@@ -161,21 +697,24 @@ static int save_png(const char *filename, int width, int height, uint8_t *data)
 	/* flip BGR pixels to RGB */
 	//png_set_bgr(png_ptr); /*?no longuer required?*/
 
-	/* Write the image data.*/
-	for (l = 0; l < height; l++)
-		row_pointers[l] = data + l * width * 3;
-
-	png_write_image(png_ptr, row_pointers);
-
-	/*
-	 * You can write optional chunks like tEXt, zTXt, and tIME at the end
-	 * as well.  Shouldn't be necessary in 1.1.0 and up as all the public
-	 * chunks are supported and you can use png_set_unknown_chunks() to
-	 * register unknown chunks into the info structure to be written out.
-	 */
-
-	/* It is REQUIRED to call this to finish writing the rest of the file */
-	png_write_end(png_ptr, info_ptr);
+	if(bands)
+	{
+		/* Write the image data (compressed bands) and the end of image*/
+		write_png_bands(png_ptr, bands);
+	}
+	else
+	{
+		/* Write the image data (line by line).*/
+		for (l = 0; l < height; l++)
+		{
+			yu12_lines_to_rgb24(line, frame->yuv_frame, width, height,
+				l, l + 1, frame->yuv_matrix, frame->yuv_range);
+			png_write_row(png_ptr, line);
+		}
+
+		/* It is REQUIRED to call this to finish writing the rest of the file */
+		png_write_end(png_ptr, info_ptr);
+	}
 
 	/*
 	 * If you png_malloced a palette, free it here
@@ -211,6 +750,69 @@ static int save_png(const char *filename, int width, int height, uint8_t *data)
 	return (E_OK);
 }
 
+/*
+ * set the png compression options (used by all png snapshots)
+ * args:
+ *    level - zlib compression level [0 - 9] (-1 - zlib default)
+ *    filter - row filter (IMG_PNG_FILTER_XXX)
+ *    nthreads - compression threads (0 - auto: one per online cpu)
+ *               with more than one thread (fast png) row bands are
+ *               compressed in parallel into a single standard png stream
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void v4l2core_set_png_options(int level, int filter, int nthreads)
+{
+	if(level < 0 || level > 9)
+		level = Z_DEFAULT_COMPRESSION;
+
+	if(filter < IMG_PNG_FILTER_NONE || filter > IMG_PNG_FILTER_ADAPTIVE)
+		filter = IMG_PNG_FILTER_ADAPTIVE;
+
+	if(nthreads <= 0)
+	{
+		long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = (ncpu > 0) ? (int) ncpu : 1;
+	}
+
+	if(nthreads > DECODER_MAX_THREADS)
+		nthreads = DECODER_MAX_THREADS;
+
+	__LOCK_MUTEX(&png_mutex);
+	png_level = level;
+	png_filter = filter;
+	png_threads = nthreads;
+	__UNLOCK_MUTEX(&png_mutex);
+
+	if(verbosity > 0)
+		printf("V4L2_CORE: png compression level %i filter %i threads %i\n",
+			level, filter, nthreads);
+}
+
+/*
+ * free the png compression threads
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void save_image_png_clean()
+{
+	__LOCK_MUTEX(&png_mutex);
+	if(png_pool && png_pool_users == 0)
+	{
+		decoder_pool_destroy(png_pool);
+		png_pool = NULL;
+	}
+	__UNLOCK_MUTEX(&png_mutex);
+}
+
 /*
  * save frame data into a png file
  * args:
@@ -224,21 +826,47 @@ static int save_png(const char *filename, int width, int height, uint8_t *data)
  */
 int save_image_png(v4l2_frame_buff_t *frame, const char *filename)
 {
-	int width = frame->width;
-	int height = frame->height;
+	int ret = E_OK;
+
+	__LOCK_MUTEX(&png_mutex);
+	int level = png_level;
+	int filter = png_filter;
+	int nthreads = png_threads;
+	__UNLOCK_MUTEX(&png_mutex);
 
-	uint8_t *rgb = calloc( width * height * 3, sizeof(uint8_t));
-	if(rgb == NULL)
+	decoder_pool_t *pool = NULL;
+	if(nthreads > 1 && frame->height > 1)
+		pool = get_png_pool(nthreads);
+
+	if(pool)
 	{
-		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (save_image_png): %s\n", strerror(errno));
-		exit(-1);
-	}
+		png_bands_t bands;
+		memset(&bands, 0, sizeof(png_bands_t));
+		bands.frame = frame;
+		bands.level = level;
+		bands.filter = filter;
+
+		ret = compress_png_bands(&bands, pool);
+		release_png_pool();
+
+		if(ret == E_OK)
+			ret = save_png(filename, frame, level, filter, &bands, NULL);
 
-	yu12_to_rgb24(rgb, frame->yuv_frame, width, height);
+		free_png_bands(&bands);
+	}
+	else
+	{
+		uint8_t *line = calloc(frame->width * 3, sizeof(uint8_t));
+		if(line == NULL)
+		{
+			fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (save_image_png): %s\n", strerror(errno));
+			exit(-1);
+		}
 
-	int ret = save_png(filename, width, height, rgb);
+		ret = save_png(filename, frame, level, filter, NULL, line);
 
-	free(rgb);
+		free(line);
+	}
 
 	return ret;
 }
@@ -0,0 +1,453 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "gview.h"
+#include "gviewv4l2core.h"
+#include "v4l2_core.h"
+#include "save_image.h"
+#include "save_queue.h"
+#include "../config.h"
+
+extern int verbosity;
+
+/*save job states*/
+#define SAVE_JOB_FREE    (0)
+#define SAVE_JOB_FILL    (1) //reserved, frame data being copied
+#define SAVE_JOB_QUEUED  (2)
+#define SAVE_JOB_BUSY    (3) //being saved by a worker
+
+typedef struct _save_job_t
+{
+	int state;                         //job state (SAVE_JOB_XXX)
+	uint64_t seq;                      //job sequence number (jobs are started in order)
+
+	v4l2_frame_buff_t frame;           //frame copy (frame data in the job buffers)
+	v4l2_frame_buff_t *ref;            //referenced device frame (NULL if copied)
+
+	char *filename;                    //output file name
+	int format;                        //image type (IMG_FMT_XXX)
+
+	v4l2core_save_image_callback_t callback; //completion callback (can be NULL)
+	void *data;                        //callback user data
+
+	uint8_t *buff;                     //frame data copy (kept for the next jobs)
+	size_t buff_size;                  //frame data copy size
+} save_job_t;
+
+struct _save_queue_t
+{
+	v4l2_dev_t *vd;                    //device data
+
+	int nworkers;                      //number of worker threads
+	__THREAD_TYPE threads[SAVE_QUEUE_MAX_WORKERS];
+
+	__MUTEX_TYPE mutex;                //protects the jobs
+	__COND_TYPE job_cond;              //signals a new job (or quit)
+	__COND_TYPE done_cond;             //signals a saved image
+
+	int quit;                          //flag workers to exit
+
+	save_job_t jobs[SAVE_QUEUE_SIZE];
+	uint64_t seq;                      //next job sequence number
+	int pending;                       //jobs not yet saved
+};
+
+/*
+ * get the oldest queued job (must be called with the queue mutex locked)
+ * args:
+ *    queue - pointer to save queue
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to job (NULL if no job is queued)
+ */
+static save_job_t *get_queued_job(save_queue_t *queue)
+{
+	save_job_t *job = NULL;
+
+	int i = 0;
+	for(i = 0; i < SAVE_QUEUE_SIZE; i++)
+	{
+		if(queue->jobs[i].state != SAVE_JOB_QUEUED)
+			continue;
+
+		if(job == NULL || queue->jobs[i].seq < job->seq)
+			job = &queue->jobs[i];
+	}
+
+	return job;
+}
+
+/*
+ * save queue worker thread loop
+ * args:
+ *    arg - pointer to save queue
+ *
+ * asserts:
+ *    none
+ *
+ * returns: NULL
+ */
+static void *save_worker_loop(void *arg)
+{
+	save_queue_t *queue = (save_queue_t *) arg;
+
+	__LOCK_MUTEX(&queue->mutex);
+	while(1)
+	{
+		save_job_t *job = get_queued_job(queue);
+		if(job == NULL)
+		{
+			/*only exit when the queue is empty*/
+			if(queue->quit)
+				break;
+
+			__COND_WAIT(&queue->job_cond, &queue->mutex);
+			continue;
+		}
+
+		job->state = SAVE_JOB_BUSY;
+		__UNLOCK_MUTEX(&queue->mutex);
+
+		v4l2_frame_buff_t *frame = job->ref ? job->ref : &job->frame;
+
+		int ret = E_OK;
+		if((job->format & IMG_FMT_MASK) == IMG_FMT_RAW && frame->raw_frame == NULL)
+			ret = E_NO_DATA;
+		else
+			ret = save_frame_image(frame, job->filename, job->format);
+
+		if(ret != E_OK)
+			fprintf(stderr, "V4L2_CORE: (save queue) couldn't save image to %s (error %i)\n",
+				job->filename, ret);
+
+		if(job->ref)
+			v4l2core_release_frame(queue->vd, job->ref);
+
+		if(job->callback)
+			job->callback(job->filename, ret, job->data);
+
+		__LOCK_MUTEX(&queue->mutex);
+		free(job->filename);
+		job->filename = NULL;
+		job->ref = NULL;
+		job->state = SAVE_JOB_FREE;
+		queue->pending--;
+		__COND_BCAST(&queue->done_cond);
+	}
+	__UNLOCK_MUTEX(&queue->mutex);
+
+	return NULL;
+}
+
+/*
+ * create a save queue (images are encoded and written by the queue workers)
+ * args:
+ *    vd - pointer to v4l2 device handler
+ *    nworkers - number of worker threads
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns: pointer to save queue (NULL on error)
+ */
+save_queue_t *save_queue_create(v4l2_dev_t *vd, int nworkers)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	if(nworkers > SAVE_QUEUE_MAX_WORKERS)
+		nworkers = SAVE_QUEUE_MAX_WORKERS;
+	if(nworkers < 1)
+		nworkers = 1;
+
+	save_queue_t *queue = calloc(1, sizeof(save_queue_t));
+	if(queue == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (save_queue_create): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	queue->vd = vd;
+
+	__INIT_MUTEX(&queue->mutex);
+	__INIT_COND(&queue->job_cond);
+	__INIT_COND(&queue->done_cond);
+
+	int i = 0;
+	for(i = 0; i < nworkers; i++)
+	{
+		if(__THREAD_CREATE(&queue->threads[i], save_worker_loop, queue))
+		{
+			fprintf(stderr, "V4L2_CORE: (save queue) couldn't create worker thread %i\n", i);
+			break;
+		}
+		queue->nworkers++;
+	}
+
+	if(queue->nworkers < 1)
+	{
+		save_queue_destroy(queue);
+		return NULL;
+	}
+
+	if(verbosity > 0)
+		printf("V4L2_CORE: (save queue) %i entries with %i worker threads\n",
+			SAVE_QUEUE_SIZE, queue->nworkers);
+
+	return queue;
+}
+
+/*
+ * wait for the queued images and free the save queue
+ * args:
+ *    queue - pointer to save queue (can be NULL)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void save_queue_destroy(save_queue_t *queue)
+{
+	if(queue == NULL)
+		return;
+
+	/*workers save all queued images before exiting*/
+	__LOCK_MUTEX(&queue->mutex);
+	queue->quit = 1;
+	__COND_BCAST(&queue->job_cond);
+	__UNLOCK_MUTEX(&queue->mutex);
+
+	int i = 0;
+	for(i = 0; i < queue->nworkers; i++)
+		__THREAD_JOIN(queue->threads[i]);
+
+	for(i = 0; i < SAVE_QUEUE_SIZE; i++)
+		if(queue->jobs[i].buff)
+			free(queue->jobs[i].buff);
+
+	__CLOSE_COND(&queue->done_cond);
+	__CLOSE_COND(&queue->job_cond);
+	__CLOSE_MUTEX(&queue->mutex);
+
+	free(queue);
+}
+
+/*
+ * copy the frame data needed for the image to the job buffer
+ * args:
+ *    job - pointer to save job
+ *    frame - pointer to frame buffer
+ *    use_raw - the image is saved from the raw frame data
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void copy_job_frame(save_job_t *job, v4l2_frame_buff_t *frame, int use_raw)
+{
+	uint8_t *src = frame->yuv_frame;
+	size_t size = (frame->width * frame->height * 3) / 2;
+
+	if(use_raw)
+	{
+		src = frame->raw_frame;
+		size = frame->raw_frame_size;
+	}
+
+	if(size > job->buff_size)
+	{
+		if(job->buff)
+			free(job->buff);
+		job->buff = malloc(size);
+		if(job->buff == NULL)
+		{
+			fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (save_queue_add): %s\n", strerror(errno));
+			exit(-1);
+		}
+		job->buff_size = size;
+	}
+
+	job->frame = *frame;
+	/*only the data needed for the image type is kept*/
+	job->frame.yuv_frame = NULL;
+	job->frame.raw_frame = NULL;
+	job->frame.raw_frame_size = 0;
+	job->frame.h264_frame = NULL;
+	job->frame.tmp_buffer = NULL;
+
+	if(src == NULL)
+		return;
+
+	memcpy(job->buff, src, size);
+
+	if(use_raw)
+	{
+		job->frame.raw_frame = job->buff;
+		job->frame.raw_frame_size = size;
+	}
+	else
+		job->frame.yuv_frame = job->buff;
+}
+
+/*
+ * queue a frame to be saved to file
+ *   the frame is referenced if possible or else its data is copied,
+ *   so the caller can release it right after this call
+ * args:
+ *    queue - pointer to save queue
+ *    frame - pointer to frame buffer
+ *    filename - output file name
+ *    format - image type
+ *           (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP)
+ *           can be or'ed with IMG_FLAG_PASSTHROUGH
+ *    copy - copy the frame data, even if it could be referenced
+ *           (the data is changed after this call)
+ *    callback - called (from a worker thread) when the image is saved (can be NULL)
+ *    data - callback user data
+ *
+ * asserts:
+ *    queue is not null
+ *    frame is not null
+ *    filename is not null
+ *
+ * returns: error code (E_QUEUE_FULL_ERR if no queue entry is free)
+ */
+int save_queue_add(save_queue_t *queue,
+	v4l2_frame_buff_t *frame,
+	const char *filename,
+	int format,
+	int copy,
+	v4l2core_save_image_callback_t callback,
+	void *data)
+{
+	/*assertions*/
+	assert(queue != NULL);
+	assert(frame != NULL);
+	assert(filename != NULL);
+
+	save_job_t *job = NULL;
+
+	__LOCK_MUTEX(&queue->mutex);
+	int i = 0;
+	for(i = 0; i < SAVE_QUEUE_SIZE; i++)
+	{
+		if(queue->jobs[i].state == SAVE_JOB_FREE)
+		{
+			job = &queue->jobs[i];
+			job->state = SAVE_JOB_FILL;
+			queue->pending++;
+			break;
+		}
+	}
+	__UNLOCK_MUTEX(&queue->mutex);
+
+	if(job == NULL)
+		return E_QUEUE_FULL_ERR;
+
+	/*raw images and jpeg passthrough are saved from the raw data*/
+	int use_raw = ((format & IMG_FMT_MASK) == IMG_FMT_RAW);
+	if((format & IMG_FMT_MASK) == IMG_FMT_JPG && (format & IMG_FLAG_PASSTHROUGH))
+		use_raw = save_image_jpeg_can_passthrough(frame);
+
+	/*
+	 * reference the frame if it leaves a free frame for capture;
+	 * referencing gives back the driver buffer (raw data), so images
+	 * saved from the raw data of frames still holding one must be copied
+	 */
+	int zero_copy = !copy && (v4l2core_get_free_frames(queue->vd) > 0);
+	if(use_raw)
+		zero_copy = zero_copy && (frame->index < 0);
+
+	job->ref = NULL;
+	if(zero_copy)
+	{
+		v4l2core_frame_ref(queue->vd, frame);
+		job->ref = frame;
+	}
+	else
+		copy_job_frame(job, frame, use_raw);
+
+	job->filename = strdup(filename);
+	job->format = format;
+	job->callback = callback;
+	job->data = data;
+
+	__LOCK_MUTEX(&queue->mutex);
+	job->seq = queue->seq++;
+	job->state = SAVE_JOB_QUEUED;
+	__COND_SIGNAL(&queue->job_cond);
+	__UNLOCK_MUTEX(&queue->mutex);
+
+	return E_OK;
+}
+
+/*
+ * get the number of queued images not yet saved
+ * args:
+ *    queue - pointer to save queue (can be NULL)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of pending images
+ */
+int save_queue_get_pending(save_queue_t *queue)
+{
+	if(queue == NULL)
+		return 0;
+
+	__LOCK_MUTEX(&queue->mutex);
+	int pending = queue->pending;
+	__UNLOCK_MUTEX(&queue->mutex);
+
+	return pending;
+}
+
+/*
+ * wait for all the queued images to be saved
+ * args:
+ *    queue - pointer to save queue (can be NULL)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void save_queue_flush(save_queue_t *queue)
+{
+	if(queue == NULL)
+		return;
+
+	__LOCK_MUTEX(&queue->mutex);
+	while(queue->pending > 0)
+		__COND_WAIT(&queue->done_cond, &queue->mutex);
+	__UNLOCK_MUTEX(&queue->mutex);
+}
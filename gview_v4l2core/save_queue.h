@@ -0,0 +1,119 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+#ifndef SAVE_QUEUE_H
+#define SAVE_QUEUE_H
+
+#include "gviewv4l2core.h"
+
+/*
+ * maximum number of save queue workers
+ */
+#define SAVE_QUEUE_MAX_WORKERS (4)
+
+/*
+ * number of snapshots that can wait in the queue
+ */
+#define SAVE_QUEUE_SIZE (16)
+
+typedef struct _save_queue_t save_queue_t;
+
+/*
+ * create a save queue (images are encoded and written by the queue workers)
+ * args:
+ *    vd - pointer to v4l2 device handler
+ *    nworkers - number of worker threads
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns: pointer to save queue (NULL on error)
+ */
+save_queue_t *save_queue_create(v4l2_dev_t *vd, int nworkers);
+
+/*
+ * wait for the queued images and free the save queue
+ * args:
+ *    queue - pointer to save queue (can be NULL)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void save_queue_destroy(save_queue_t *queue);
+
+/*
+ * queue a frame to be saved to file
+ *   the frame is referenced if possible or else its data is copied,
+ *   so the caller can release it right after this call
+ * args:
+ *    queue - pointer to save queue
+ *    frame - pointer to frame buffer
+ *    filename - output file name
+ *    format - image type
+ *           (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP)
+ *           can be or'ed with IMG_FLAG_PASSTHROUGH
+ *    copy - copy the frame data, even if it could be referenced
+ *           (the data is changed after this call)
+ *    callback - called (from a worker thread) when the image is saved (can be NULL)
+ *    data - callback user data
+ *
+ * asserts:
+ *    queue is not null
+ *    frame is not null
+ *    filename is not null
+ *
+ * returns: error code (E_QUEUE_FULL_ERR if no queue entry is free)
+ */
+int save_queue_add(save_queue_t *queue,
+	v4l2_frame_buff_t *frame,
+	const char *filename,
+	int format,
+	int copy,
+	v4l2core_save_image_callback_t callback,
+	void *data);
+
+/*
+ * get the number of queued images not yet saved
+ * args:
+ *    queue - pointer to save queue (can be NULL)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of pending images
+ */
+int save_queue_get_pending(save_queue_t *queue);
+
+/*
+ * wait for all the queued images to be saved
+ * args:
+ *    queue - pointer to save queue (can be NULL)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+void save_queue_flush(save_queue_t *queue);
+
+#endif
@@ -35,6 +35,7 @@
 
 #include "gview.h"
 #include "frame_decoder.h"
+#include "colorspaces.h"
 #include "../config.h"
 
 #include "uvc_h264.h"
@@ -50,6 +51,9 @@ typedef struct _h264_decoder_context_t
 	const AVCodec *codec;
 	AVCodecContext *context;
 	AVFrame *picture;
+#if LIBAVCODEC_VER_AT_LEAST(58,129)
+	AVPacket *packet; //reused for every frame
+#endif
 
 	int width;
 	int height;
@@ -1047,6 +1051,15 @@ int h264_init_decoder(int width, int height)
 	avcodec_get_frame_defaults(h264_ctx->picture);
 #endif
 
+#if LIBAVCODEC_VER_AT_LEAST(58,129)
+	h264_ctx->packet = av_packet_alloc();
+	if(h264_ctx->packet == NULL)
+	{
+		fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (h264_init_decoder): %s\n", strerror(errno));
+		exit(-1);
+	}
+#endif
+
 #if LIBAVUTIL_VER_AT_LEAST(54,6)
 	h264_ctx->pic_size = av_image_get_buffer_size(h264_ctx->context->pix_fmt, width, height, 1);
 #else
@@ -1082,19 +1095,14 @@ int h264_decode(uint8_t *out_buf, uint8_t *in_buf, int size)
 	int got_frame = 0;
 
 #if LIBAVCODEC_VER_AT_LEAST(58,129)
-	AVPacket *avpkt = av_packet_alloc();
-	if (!avpkt) 
-	{
-        fprintf(stderr, "V4L2_CORE uvc_H264: could not allocate av_packet\n");
-        return -1;
-    }
+	/*the packet only points to in_buf (no data is owned)*/
+	h264_ctx->packet->size = size;
+	h264_ctx->packet->data = in_buf;
 
-	avpkt->size = size;
-	avpkt->data = in_buf;
+	int ret = libav_decode(h264_ctx->context, h264_ctx->picture, &got_frame, h264_ctx->packet);
 
-	int ret = libav_decode(h264_ctx->context, h264_ctx->picture, &got_frame, avpkt);
-
-	av_packet_free(&avpkt);
+	h264_ctx->packet->size = 0;
+	h264_ctx->packet->data = NULL;
 #else
 	AVPacket avpkt;
 	av_init_packet(&avpkt);
@@ -1112,14 +1120,13 @@ int h264_decode(uint8_t *out_buf, uint8_t *in_buf, int size)
 
 	if(got_frame)
 	{
-#if LIBAVUTIL_VER_AT_LEAST(54,6)
-		av_image_copy_to_buffer(out_buf, h264_ctx->pic_size,
-                             (const unsigned char * const*) h264_ctx->picture->data, h264_ctx->picture->linesize,
-                             h264_ctx->context->pix_fmt, h264_ctx->width, h264_ctx->height, 1);
-#else
-		avpicture_layout((AVPicture *) h264_ctx->picture, h264_ctx->context->pix_fmt,
-			h264_ctx->width, h264_ctx->height, out_buf, h264_ctx->pic_size);
-#endif
+		/*convert straight from the decoded planes (high 4:2:2 profiles are also handled)*/
+		int chroma_h_shift = (h264_ctx->context->pix_fmt == AV_PIX_FMT_YUV422P ||
+			h264_ctx->context->pix_fmt == AV_PIX_FMT_YUVJ422P) ? 0 : 1;
+
+		planar_to_yu12(out_buf, h264_ctx->picture->data, h264_ctx->picture->linesize,
+			h264_ctx->width, h264_ctx->height, 1, chroma_h_shift);
+
 		return ret;
 	}
 	else
@@ -1156,6 +1163,10 @@ void h264_close_decoder()
 	#endif
 #endif
 
+#if LIBAVCODEC_VER_AT_LEAST(58,129)
+	av_packet_free(&h264_ctx->packet);
+#endif
+
 	free(h264_ctx);
 
 	h264_ctx = NULL;
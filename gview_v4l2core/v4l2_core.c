@@ -35,7 +35,7 @@
 #include <sys/ioctl.h>
 #include <libv4l2.h>
 #include <sys/mman.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
 #include <errno.h>
 #include <assert.h>
 /* support for internationalization - i18n */
@@ -54,6 +54,7 @@
 #include "v4l2_formats.h"
 #include "v4l2_controls.h"
 #include "v4l2_devices.h"
+#include "colorspaces.h"
 #include "../config.h"
 
 #ifndef GETTEXT_PACKAGE_V4L2CORE
@@ -78,6 +79,7 @@ static uint8_t flag_fps_change = 0; /*set to 1 to request a fps change*/
 static uint8_t disable_libv4l2 = 0; /*set to 1 to disable libv4l2 calls*/
 
 static int frame_queue_size = 1; /*just one frame in queue (enough for a single thread)*/
+static int frame_hold_count = 0; /*extra frames for references kept by consumers*/
 
 /*
  * ioctl with a number of retries in the case of I/O failure
@@ -127,6 +129,7 @@ void __attribute__ ((constructor)) v4l2core_init()
 	
 	/*set defaults*/
 	frame_queue_size = 1;
+	frame_hold_count = 0;
 	disable_libv4l2 = 0;
 	
 }
@@ -227,6 +230,56 @@ static int check_v4l2_dev(v4l2_dev_t *vd)
 	return E_OK;
 }
 
+/*
+ * get the v4l2 memory type used by the capture method
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: v4l2 memory type (V4L2_MEMORY_XXX)
+ */
+static int get_buff_memory(v4l2_dev_t *vd)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	/*dmabuf mode exports mmap buffers*/
+	return (vd->cap_meth == IO_USERPTR) ? V4L2_MEMORY_USERPTR : V4L2_MEMORY_MMAP;
+}
+
+/*
+ * queue a v4l2 buffer
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   index - buffer index
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: VIDIOC_QBUF ioctl result
+ */
+static int enqueue_buff(v4l2_dev_t *vd, int index)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	struct v4l2_buffer buf;
+	memset(&buf, 0, sizeof(struct v4l2_buffer));
+
+	buf.index = index;
+	buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf.memory = get_buff_memory(vd);
+	if(vd->cap_meth == IO_USERPTR)
+	{
+		buf.m.userptr = (unsigned long) vd->mem[index];
+		buf.length = vd->buff_length[index];
+	}
+
+	return xioctl(vd->fd, VIDIOC_QBUF, &buf);
+}
+
 /*
  * unmaps v4l2 buffers
  * args:
@@ -252,8 +305,26 @@ static int unmap_buff(v4l2_dev_t *vd)
 		case IO_READ:
 			break;
 
+		case IO_USERPTR:
+			/*free the userptr buffer pool*/
+			for (i = 0; i < vd->buff_count; i++)
+			{
+				if(vd->mem[i] != MAP_FAILED)
+					free(vd->mem[i]);
+				vd->mem[i] = MAP_FAILED;
+			}
+			break;
+
+		case IO_DMABUF:
+			for (i = 0; i < vd->buff_count; i++)
+			{
+				if(vd->buff_fd[i] >= 0)
+					close(vd->buff_fd[i]);
+				vd->buff_fd[i] = -1;
+			}
+			/*fall through*/
 		case IO_MMAP:
-			for (i = 0; i < NB_BUFFER; i++)
+			for (i = 0; i < vd->buff_count; i++)
 			{
 				// unmap old buffer
 				if((vd->mem[i] != MAP_FAILED) && vd->buff_length[i])
@@ -261,11 +332,52 @@ static int unmap_buff(v4l2_dev_t *vd)
 					{
 						fprintf(stderr, "V4L2_CORE: couldn't unmap buff: %s\n", strerror(errno));
 					}
+				vd->mem[i] = MAP_FAILED;
 			}
 	}
 	return ret;
 }
 
+/*
+ * export the mmap buffers as dmabuf (IO_DMABUF)
+ *   the fds can be shared with other devices (gpu, encoders)
+ *   while the cpu keeps using the mmaped buffers
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code  (0- E_OK)
+ */
+static int export_buff(v4l2_dev_t *vd)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	int i = 0;
+	for (i = 0; i < vd->buff_count; i++)
+	{
+		struct v4l2_exportbuffer expbuf;
+		memset(&expbuf, 0, sizeof(struct v4l2_exportbuffer));
+		expbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		expbuf.index = i;
+		expbuf.flags = O_RDONLY | O_CLOEXEC;
+
+		if(xioctl(vd->fd, VIDIOC_EXPBUF, &expbuf) < 0)
+		{
+			fprintf(stderr, "V4L2_CORE: (VIDIOC_EXPBUF) Unable to export buffer[%i]: %s\n", i, strerror(errno));
+			return E_EXPBUF_ERR;
+		}
+		vd->buff_fd[i] = expbuf.fd;
+
+		if(verbosity > 1)
+			printf("V4L2_CORE: exported buffer[%i] as dmabuf fd %i\n", i, expbuf.fd);
+	}
+
+	return E_OK;
+}
+
 /*
  * maps v4l2 buffers
  * args:
@@ -286,7 +398,7 @@ static int map_buff(v4l2_dev_t *vd)
 
 	int i = 0;
 	// map new buffer
-	for (i = 0; i < NB_BUFFER; i++)
+	for (i = 0; i < vd->buff_count; i++)
 	{
 		vd->mem[i] = v4l2_mmap( NULL, // start anywhere
 			vd->buff_length[i],
@@ -335,8 +447,34 @@ static int query_buff(v4l2_dev_t *vd)
 		case IO_READ:
 			break;
 
+		case IO_USERPTR:
+		{
+			/*no driver memory: alloc a page aligned buffer pool*/
+			size_t page_size = sysconf(_SC_PAGESIZE);
+			size_t length = vd->format.fmt.pix.sizeimage;
+			if(length == 0)
+				length = (vd->format.fmt.pix.width) * (vd->format.fmt.pix.height) * 3; //worst case (rgb)
+			length = (length + page_size - 1) & ~(page_size - 1);
+
+			for (i = 0; i < vd->buff_count; i++)
+			{
+				void *mem = NULL;
+				if(posix_memalign(&mem, page_size, length) != 0)
+				{
+					fprintf(stderr, "V4L2_CORE: FATAL memory allocation failure (query_buff): %s\n", strerror(errno));
+					exit(-1);
+				}
+				vd->mem[i] = mem;
+				vd->buff_length[i] = length;
+				vd->buff_offset[i] = 0;
+			}
+			vd->buf.length = length;
+			break;
+		}
+
 		case IO_MMAP:
-			for (i = 0; i < NB_BUFFER; i++)
+		case IO_DMABUF:
+			for (i = 0; i < vd->buff_count; i++)
 			{
 				memset(&vd->buf, 0, sizeof(struct v4l2_buffer));
 				vd->buf.index = i;
@@ -367,10 +505,15 @@ static int query_buff(v4l2_dev_t *vd)
 			// map the new buffers
 			if(map_buff(vd) != 0)
 				ret = E_MMAP_ERR;
+			else if(vd->cap_meth == IO_DMABUF)
+				ret = export_buff(vd);
 			break;
 	}
 	for(i = 0; i < vd->frame_queue_size; ++i)
+	{
 		vd->frame_queue[i].raw_frame_max_size = vd->buf.length;
+		vd->frame_queue[i].dmabuf_fd = -1;
+	}
 
 	return ret;
 }
@@ -403,17 +546,9 @@ static int queue_buff(v4l2_dev_t *vd)
 
 		case IO_MMAP:
 		default:
-			for (i = 0; i < NB_BUFFER; ++i)
+			for (i = 0; i < vd->buff_count; ++i)
 			{
-				memset(&vd->buf, 0, sizeof(struct v4l2_buffer));
-				vd->buf.index = i;
-				vd->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-				//vd->buf.flags = V4L2_BUF_FLAG_TIMECODE;
-				//vd->buf.timecode = vd->timecode;
-				//vd->buf.timestamp.tv_sec = 0;
-				//vd->buf.timestamp.tv_usec = 0;
-				vd->buf.memory = V4L2_MEMORY_MMAP;
-				ret = xioctl(vd->fd, VIDIOC_QBUF, &vd->buf);
+				ret = enqueue_buff(vd, i);
 				if (ret < 0)
 				{
 					fprintf(stderr, "V4L2_CORE: (VIDIOC_QBUF) Unable to queue buffer: %s\n", strerror(errno));
@@ -510,6 +645,8 @@ static int set_v4l2_framerate (v4l2_dev_t *vd)
 			break;
 
 		case IO_MMAP:
+		case IO_USERPTR:
+		case IO_DMABUF:
 			if(stream_status == STRM_OK)
 			{
 				/*unmap the buffers*/
@@ -547,8 +684,106 @@ static int set_v4l2_framerate (v4l2_dev_t *vd)
 	return ret;
 }
 
+/*
+ * set the device events watched in the epoll set
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   op - epoll_ctl operation (EPOLL_CTL_ADD or EPOLL_CTL_MOD)
+ *   ctrl_events - watch control events (POLLPRI) flag
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: epoll_ctl result
+ */
+static int watch_device_events(v4l2_dev_t *vd, int op, int ctrl_events)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = EPOLLIN;
+	if(ctrl_events)
+		ev.events |= EPOLLPRI;
+	ev.data.fd = vd->fd;
+
+	return epoll_ctl(vd->epoll_fd, op, vd->fd, &ev);
+}
+
+/*
+ * create the epoll set for frame, control and device (udev) events
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code  (0- E_OK)
+ */
+static int init_events(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	vd->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if(vd->epoll_fd < 0)
+	{
+		fprintf(stderr, "V4L2_CORE: couldn't create epoll set: %s\n", strerror(errno));
+		return E_DEVICE_ERR;
+	}
+
+	if(watch_device_events(vd, EPOLL_CTL_ADD, 1) < 0)
+	{
+		fprintf(stderr, "V4L2_CORE: couldn't watch device %s: %s\n", vd->videodevice, strerror(errno));
+		return E_DEVICE_ERR;
+	}
+
+	/*hotplug is optional (no udev monitor)*/
+	add_device_list_watch(vd->epoll_fd);
+
+	return E_OK;
+}
+
+/*
+ * dispatch pending control or device events
+ *   the event watch is suspended until the events are checked
+ *   (v4l2core_check_control_events, v4l2core_check_device_list_events)
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   event - core event: EV_CONTROLS or EV_DEVICES
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+static void dispatch_event(v4l2_dev_t *vd, int event)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	/*device watch is one shot: already suspended*/
+	if(event == EV_CONTROLS)
+		watch_device_events(vd, EPOLL_CTL_MOD, 0);
+
+	if(verbosity > 2)
+		printf("V4L2_CORE: %s events pending\n", (event == EV_CONTROLS) ? "control" : "device");
+
+	/*lock the mutex*/
+	__LOCK_MUTEX( __PMUTEX );
+	v4l2core_event_callback_t callback = vd->event_callback;
+	void *data = vd->event_callback_data;
+	/*unlock the mutex*/
+	__UNLOCK_MUTEX( __PMUTEX );
+
+	if(callback)
+		callback(vd, event, data);
+}
+
 /*
  * checks if frame data is available
+ *   pending control and device events are dispatched while waiting
  * args:
  *   vd - pointer to v4l2 device handler
  *
@@ -563,8 +798,7 @@ static int check_frame_available(v4l2_dev_t *vd)
 	assert(vd != NULL);
 
 	int ret = E_OK;
-	fd_set rdset;
-	struct timeval timeout;
+	struct epoll_event events[2];
 
 	/*lock the mutex*/
 	__LOCK_MUTEX( __PMUTEX );
@@ -591,28 +825,50 @@ static int check_frame_available(v4l2_dev_t *vd)
 		flag_fps_change = 0;
 	}
 
-	FD_ZERO(&rdset);
-	FD_SET(vd->fd, &rdset);
-	timeout.tv_sec = 1; /* 1 sec timeout*/
-	timeout.tv_usec = 0;
-	/* select - wait for data or timeout*/
-	ret = select(vd->fd + 1, &rdset, NULL, NULL, &timeout);
-	if (ret < 0)
-	{
-		fprintf(stderr, "V4L2_CORE: Could not grab image (select error): %s\n", strerror(errno));
-		return E_SELECT_ERR;
-	}
+	uint64_t deadline = ns_time_monotonic() + 1000000000; /* 1 sec timeout*/
 
-	if (ret == 0)
+	while(1)
 	{
-		fprintf(stderr, "V4L2_CORE: Could not grab image (select timeout): %s\n", strerror(errno));
-		return E_SELECT_TIMEOUT_ERR;
-	}
+		uint64_t now = ns_time_monotonic();
+		int timeout = (now < deadline) ? (int) ((deadline - now + 999999) / 1000000) : 0;
 
-	if ((ret > 0) && (FD_ISSET(vd->fd, &rdset)))
-		return E_OK;
+		/* wait for data, events or timeout*/
+		ret = epoll_wait(vd->epoll_fd, events, 2, timeout);
+		if (ret < 0)
+		{
+			if(errno == EINTR)
+				continue;
+
+			fprintf(stderr, "V4L2_CORE: Could not grab image (epoll error): %s\n", strerror(errno));
+			return E_SELECT_ERR;
+		}
+
+		if (ret == 0)
+		{
+			fprintf(stderr, "V4L2_CORE: Could not grab image (epoll timeout): no frame for 1 sec\n");
+			return E_SELECT_TIMEOUT_ERR;
+		}
+
+		int frame_ready = 0;
+		int i = 0;
+		for(i = 0; i < ret; i++)
+		{
+			if(events[i].data.fd != vd->fd)
+			{
+				dispatch_event(vd, EV_DEVICES);
+				continue;
+			}
 
-	return E_UNKNOWN_ERR;
+			if(events[i].events & EPOLLPRI)
+				dispatch_event(vd, EV_CONTROLS);
+			/*errors are reported by the dequeue*/
+			if(events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+				frame_ready = 1;
+		}
+
+		if(frame_ready)
+			return E_OK;
+	}
 }
 
 /*
@@ -632,6 +888,8 @@ void v4l2core_set_verbosity(int level)
 
 /*
  * set frame queue size (set before v4l2core_init_dev)
+ *   a size above 1 enables pipelined decoding in v4l2core_get_decoded_frame:
+ *   frames are decoded by (size - 1) threads while the next ones are captured
  * args:
  *   size - size in frames of frame queue
  *
@@ -642,7 +900,23 @@ void v4l2core_set_verbosity(int level)
  */
 void v4l2core_set_frame_queue_size(int size)
 {
-	frame_queue_size = size;
+	frame_queue_size = (size > 1) ? size : 1;
+}
+
+/*
+ * set the number of extra frames in queue for consumers holding
+ * frame references (set before v4l2core_init_dev)
+ * args:
+ *   count - number of extra frames
+ *
+ * asserts:
+ *   none
+ *
+ * returns void
+ */
+void v4l2core_set_frame_hold_count(int count)
+{
+	frame_hold_count = (count > 0) ? count : 0;
 }
 
 /*
@@ -679,7 +953,7 @@ void v4l2core_enable_libv4l2()
  * set v4l2 capture method to use
  * args:
  *   vd - pointer to v4l2 device handler
- *   method - capture method (IO_READ or IO_MMAP)
+ *   method - capture method (IO_READ, IO_MMAP, IO_USERPTR or IO_DMABUF)
  *
  * asserts:
  *   vd is not null
@@ -691,7 +965,63 @@ void v4l2core_set_capture_method(v4l2_dev_t *vd, int method)
 	/*asserts*/
 	assert(vd != NULL);
 
-	vd->cap_meth = method;
+	switch(method)
+	{
+		case IO_READ:
+		case IO_MMAP:
+		case IO_USERPTR:
+		case IO_DMABUF:
+			vd->cap_meth = method;
+			break;
+
+		default:
+			fprintf(stderr, "V4L2_CORE: unknown capture method (%i): using mmap\n", method);
+			vd->cap_meth = IO_MMAP;
+			break;
+	}
+}
+
+/*
+ * set the number of driver buffers to request (set before the format)
+ *   more buffers absorb longer processing hiccups before the driver drops frames
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   count - number of buffers [2 - NB_BUFFER_MAX]
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+*/
+void v4l2core_set_buffer_count(v4l2_dev_t *vd, int count)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	if(count < 2)
+		count = 2;
+	if(count > NB_BUFFER_MAX)
+		count = NB_BUFFER_MAX;
+
+	vd->nb_buffers = count;
+}
+
+/*
+ * get the number of driver buffers in use
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: number of buffers granted by the driver (requested count if none yet)
+*/
+int v4l2core_get_buffer_count(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	return (vd->buff_count > 0) ? vd->buff_count : vd->nb_buffers;
 }
 
 /*
@@ -1048,8 +1378,11 @@ int v4l2core_stop_stream(v4l2_dev_t *vd)
 	vd->streaming = STRM_STOP;
 	
 	if(verbosity > 2)
+	{
 		printf("V4L2_CORE: (VIDIOC_STREAMOFF) stream_status = STRM_STOP\n");
-		
+		printf("V4L2_CORE: decoder heap allocations: %" PRIu64 "\n", v4l2core_get_decoder_allocs());
+	}
+
 	return ret;
 }
 
@@ -1095,6 +1428,7 @@ static int process_input_buffer(v4l2_dev_t *vd)
 	}
 	
 	vd->frame_queue[qind].status = FRAME_DECODING;
+	vd->frame_queue[qind].refcount = 1;
 	
 	/*
      * driver timestamp is unreliable
@@ -1115,6 +1449,12 @@ static int process_input_buffer(v4l2_dev_t *vd)
 	
 	/*point vd->raw_frame to current frame buffer*/
 	vd->frame_queue[qind].raw_frame = vd->mem[vd->buf.index];
+	vd->frame_queue[qind].dmabuf_fd = (vd->cap_meth == IO_DMABUF) ?
+		vd->buff_fd[vd->buf.index] : -1;
+
+	/*color encoding for yuv to rgb conversions (bmp/png snapshots)*/
+	vd->frame_queue[qind].yuv_matrix = vd->yuv_matrix;
+	vd->frame_queue[qind].yuv_range = vd->yuv_range;
 	
 	/*determine real fps every 3 sec aprox.*/
 	fps_frame_count++;
@@ -1237,12 +1577,17 @@ v4l2_frame_buff_t *v4l2core_get_frame(v4l2_dev_t *vd)
 				memset(&vd->buf, 0, sizeof(struct v4l2_buffer));
 
 				vd->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-				vd->buf.memory = V4L2_MEMORY_MMAP;
+				vd->buf.memory = get_buff_memory(vd);
 
 				ret = xioctl(vd->fd, VIDIOC_DQBUF, &vd->buf);
 
 				if(!ret)
+				{
 					qind = process_input_buffer(vd);
+					/*no free frame (all held): drop it and give the buffer back*/
+					if(qind < 0 && enqueue_buff(vd, vd->buf.index) < 0)
+						fprintf(stderr, "V4L2_CORE: (VIDIOC_QBUF) Unable to queue buffer %i: %s\n", vd->buf.index, strerror(errno));
+				}
 				else
 					fprintf(stderr, "V4L2_CORE: (VIDIOC_DQBUF) Unable to dequeue buffer: %s\n", strerror(errno));
 			}
@@ -1265,7 +1610,8 @@ v4l2_frame_buff_t *v4l2core_get_frame(v4l2_dev_t *vd)
 }
 
 /*
- * releases the video frame (so that it can be reused by the driver)
+ * releases a video frame reference
+ *   the frame is reused by the driver when the last reference is released
  * args:
  *   vd - pointer to v4l2 device handler
  *   frame - pointer to decoded frame buffer
@@ -1278,10 +1624,17 @@ v4l2_frame_buff_t *v4l2core_get_frame(v4l2_dev_t *vd)
 int v4l2core_release_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 {
 	int ret = 0;
-	
-	//match the v4l2_buffer with the correspondig frame
-	vd->buf.index = frame->index;
-	
+
+	/*lock the mutex*/
+	__LOCK_MUTEX( __PMUTEX );
+	int refcount = --frame->refcount;
+	/*unlock the mutex*/
+	__UNLOCK_MUTEX( __PMUTEX );
+
+	/*still referenced*/
+	if(refcount > 0)
+		return E_OK;
+
 	switch(vd->cap_meth)
 	{
 		case IO_READ:
@@ -1289,8 +1642,12 @@ int v4l2core_release_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 		
 		case IO_MMAP:
 		default:
-			/* queue the buffer */
-			ret = xioctl(vd->fd, VIDIOC_QBUF, &vd->buf);
+			/*pipelined or referenced frames have no driver buffer (already requeued)*/
+			if(frame->index < 0)
+				break;
+
+			/* queue the buffer matching the frame */
+			ret = enqueue_buff(vd, frame->index);
 
 			if(ret)
 				fprintf(stderr, "V4L2_CORE: (VIDIOC_QBUF) Unable to queue buffer %i: %s\n", frame->index, strerror(errno));
@@ -1301,6 +1658,7 @@ int v4l2core_release_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 	__LOCK_MUTEX( __PMUTEX );
 	frame->raw_frame = NULL;
 	frame->raw_frame_size = 0;
+	frame->dmabuf_fd = -1;
 	frame->status = FRAME_READY;
 	/*unlock the mutex*/
 	__UNLOCK_MUTEX( __PMUTEX );
@@ -1311,8 +1669,133 @@ int v4l2core_release_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
 	return E_OK;
 }
 
+/*
+ * take a new video frame reference (released with v4l2core_release_frame)
+ *   the decoded data (yuv or h264) stays valid until the last reference
+ *   is released, from any thread; a frame still holding a driver buffer
+ *   gives it back right away (raw_frame is set to NULL), pipelined frames
+ *   keep their raw data copy
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   frame - pointer to frame buffer (with at least one reference)
+ *
+ * asserts:
+ *   vd is not null
+ *   frame is not null
+ *
+ * returns: none
+ */
+void v4l2core_frame_ref(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(frame != NULL);
+
+	/*don't keep the driver buffer out of the queue while referenced*/
+	if(frame->index >= 0)
+	{
+		if(vd->cap_meth != IO_READ && enqueue_buff(vd, frame->index))
+			fprintf(stderr, "V4L2_CORE: (VIDIOC_QBUF) Unable to queue buffer %i: %s\n", frame->index, strerror(errno));
+
+		frame->index = -1;
+		frame->raw_frame = NULL;
+		frame->raw_frame_size = 0;
+		frame->dmabuf_fd = -1;
+	}
+
+	/*lock the mutex*/
+	__LOCK_MUTEX( __PMUTEX );
+	assert(frame->refcount > 0);
+	frame->refcount++;
+	/*unlock the mutex*/
+	__UNLOCK_MUTEX( __PMUTEX );
+}
+
+/*
+ * get the number of free frames in queue
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: number of free frames
+ */
+int v4l2core_get_free_frames(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+
+	int free_frames = 0;
+	int i = 0;
+
+	/*lock the mutex*/
+	__LOCK_MUTEX( __PMUTEX );
+	for(i = 0; i < vd->frame_queue_size; ++i)
+		if(vd->frame_queue[i].status == FRAME_READY)
+			free_frames++;
+	/*unlock the mutex*/
+	__UNLOCK_MUTEX( __PMUTEX );
+
+	return free_frames;
+}
+
+/*
+ * gets the next decoded frame from the decode stage
+ *   every free frame in the queue is filled with a new captured frame
+ *   and submitted for decoding, the raw data is copied by the stage so
+ *   the driver buffer is requeued right away (the camera never waits
+ *   for the decoder or the render)
+ * args:
+ *    vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *    vd is not null
+ *    vd->decode_stage is not null
+ *
+ * returns: pointer to decoded frame buffer (NULL on error)
+ */
+static v4l2_frame_buff_t *get_pipelined_frame(v4l2_dev_t *vd)
+{
+	/*asserts*/
+	assert(vd != NULL);
+	assert(vd->decode_stage != NULL);
+
+	/*held frames (see v4l2core_set_frame_hold_count) stay out of the pipeline*/
+	while(decode_stage_get_pending(vd->decode_stage) < vd->frame_pipeline_size)
+	{
+		/*lock the mutex*/
+		__LOCK_MUTEX( __PMUTEX );
+		int qind = get_next_ready_frame(vd);
+		/*unlock the mutex*/
+		__UNLOCK_MUTEX( __PMUTEX );
+
+		if(qind < 0)
+			break;
+
+		v4l2_frame_buff_t *frame = v4l2core_get_frame(vd);
+		if(frame == NULL)
+			break;
+
+		frame->index = -1; /*driver buffer is requeued below*/
+		frame->dmabuf_fd = -1;
+		decode_stage_submit(vd->decode_stage, frame);
+
+		if(vd->cap_meth != IO_READ)
+		{
+			/*vd->buf still holds the dequeued buffer*/
+			if(enqueue_buff(vd, vd->buf.index) < 0)
+				fprintf(stderr, "V4L2_CORE: (VIDIOC_QBUF) Unable to queue buffer %i: %s\n", vd->buf.index, strerror(errno));
+		}
+	}
+
+	return decode_stage_get_frame(vd->decode_stage);
+}
+
 /*
  * gets the next video frame and decodes it
+ *   if the frame queue size is bigger than 1 decoding is pipelined
+ *   (see v4l2core_set_frame_queue_size)
  * args:
  *    vd - pointer to v4l2 device handler
  *
@@ -1320,6 +1803,20 @@ int v4l2core_release_frame(v4l2_dev_t *vd, v4l2_frame_buff_t *frame)
  */
 v4l2_frame_buff_t *v4l2core_get_decoded_frame(v4l2_dev_t *vd)
 {
+	if(vd->frame_pipeline_size > 1)
+	{
+		if(vd->decode_stage == NULL)
+		{
+			/*h264 frames reference the previous ones: decode them in order*/
+			int nworkers = (vd->requested_fmt == V4L2_PIX_FMT_H264) ?
+				1 : vd->frame_pipeline_size - 1;
+			vd->decode_stage = decode_stage_create(vd, nworkers);
+		}
+
+		if(vd->decode_stage != NULL)
+			return get_pipelined_frame(vd);
+	}
+
 	v4l2_frame_buff_t *frame = v4l2core_get_frame(vd);
 	if(frame != NULL)
 	{
@@ -1451,17 +1948,25 @@ static int try_video_stream_format(v4l2_dev_t *vd,
 		default:
 			/* request buffers */
 			memset(&vd->rb, 0, sizeof(struct v4l2_requestbuffers));
-			vd->rb.count = NB_BUFFER;
+			vd->rb.count = vd->nb_buffers;
 			vd->rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-			vd->rb.memory = V4L2_MEMORY_MMAP;
+			vd->rb.memory = get_buff_memory(vd);
 
 			ret = xioctl(vd->fd, VIDIOC_REQBUFS, &vd->rb);
 
-			if (ret < 0)
+			if (ret < 0 || vd->rb.count < 1)
 			{
 				fprintf(stderr, "V4L2_CORE: (VIDIOC_REQBUFS) Unable to allocate buffers: %s\n", strerror(errno));
+				if(vd->cap_meth == IO_USERPTR)
+					fprintf(stderr, "         try with mmap method instead\n");
 				return E_REQBUFS_ERR;
 			}
+
+			/*the driver may change the number of buffers*/
+			vd->buff_count = (vd->rb.count > NB_BUFFER_MAX) ? NB_BUFFER_MAX : vd->rb.count;
+			if(verbosity > 0 && vd->buff_count != vd->nb_buffers)
+				printf("V4L2_CORE: driver allocated %i buffers (requested %i)\n",
+					vd->buff_count, vd->nb_buffers);
 			/* map the buffers */
 			if (query_buff(vd))
 			{
@@ -1475,7 +1980,7 @@ static int try_video_stream_format(v4l2_dev_t *vd,
 				memset(&vd->rb, 0, sizeof(struct v4l2_requestbuffers));
 				vd->rb.count = 0;
 				vd->rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-				vd->rb.memory = V4L2_MEMORY_MMAP;
+				vd->rb.memory = get_buff_memory(vd);
 				if(xioctl(vd->fd, VIDIOC_REQBUFS, &vd->rb)<0)
 					fprintf(stderr, "V4L2_CORE: (VIDIOC_REQBUFS) Unable to delete buffers: %s\n", strerror(errno));
 
@@ -1493,7 +1998,7 @@ static int try_video_stream_format(v4l2_dev_t *vd,
 				memset(&vd->rb, 0, sizeof(struct v4l2_requestbuffers));
 				vd->rb.count = 0;
 				vd->rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-				vd->rb.memory = V4L2_MEMORY_MMAP;
+				vd->rb.memory = get_buff_memory(vd);
 				if(xioctl(vd->fd, VIDIOC_REQBUFS, &vd->rb)<0)
 					fprintf(stderr, "V4L2_CORE: (VIDIOC_REQBUFS) Unable to delete buffers: %s\n", strerror(errno));
 				return E_QBUF_ERR;
@@ -1548,6 +2053,149 @@ int v4l2core_get_frame_height(v4l2_dev_t *vd)
 	return vd->format.fmt.pix.height;
 }
 
+/*
+ * set the yuv color encoding (used for yuv to rgb conversions)
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   matrix - color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ *   range - quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2core_set_yuv_color_encoding(v4l2_dev_t *vd, int matrix, int range)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	vd->yuv_matrix = (matrix == YUV_MATRIX_BT709) ? YUV_MATRIX_BT709 : YUV_MATRIX_BT601;
+	vd->yuv_range = (range == YUV_RANGE_LIMITED) ? YUV_RANGE_LIMITED : YUV_RANGE_FULL;
+
+	if(verbosity > 0)
+		printf("V4L2_CORE: yuv color encoding set to %s (%s range)\n",
+			vd->yuv_matrix == YUV_MATRIX_BT709 ? "BT.709" : "BT.601",
+			vd->yuv_range == YUV_RANGE_LIMITED ? "limited" : "full");
+}
+
+/*
+ * get the yuv color matrix
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ */
+int v4l2core_get_yuv_matrix(v4l2_dev_t *vd)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	return vd->yuv_matrix;
+}
+
+/*
+ * get the yuv quantization range
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
+ */
+int v4l2core_get_yuv_range(v4l2_dev_t *vd)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	return vd->yuv_range;
+}
+
+/*
+ * set the number of threads used for decoding raw frames
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   nthreads - number of threads (0 - auto: one per online cpu)
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: error code (E_OK)
+ */
+int v4l2core_set_decoder_threads(v4l2_dev_t *vd, int nthreads)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	if(nthreads <= 0)
+	{
+		long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = (ncpu > 0) ? (int) ncpu : 1;
+	}
+
+	if(nthreads > DECODER_MAX_THREADS)
+		nthreads = DECODER_MAX_THREADS;
+
+	if(nthreads == decoder_pool_get_threads(vd->decoder_pool))
+		return E_OK;
+
+	if(vd->decoder_pool)
+		decoder_pool_destroy(vd->decoder_pool);
+
+	/*a single thread decodes in the caller (no pool)*/
+	vd->decoder_pool = decoder_pool_create(nthreads);
+
+	if(verbosity > 0)
+		printf("V4L2_CORE: using %i decoder thread(s)\n",
+			decoder_pool_get_threads(vd->decoder_pool));
+
+	return E_OK;
+}
+
+/*
+ * get the number of threads used for decoding raw frames
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: number of decoder threads
+ */
+int v4l2core_get_decoder_threads(v4l2_dev_t *vd)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	return decoder_pool_get_threads(vd->decoder_pool);
+}
+
+/*
+ * convert a yu12 frame to rgba (rgb32, alpha set to 255)
+ * args:
+ *   out - pointer to output rgba data buffer (width * height * 4)
+ *   in - pointer to input yu12 data buffer
+ *   width - frame width (in pixels)
+ *   height - frame height (in pixels)
+ *   matrix - color matrix (YUV_MATRIX_BT601 or YUV_MATRIX_BT709)
+ *   range - quantization range (YUV_RANGE_FULL or YUV_RANGE_LIMITED)
+ *
+ * asserts:
+ *   out is not null
+ *   in is not null
+ *
+ * returns: none
+ */
+void v4l2core_yu12_to_rgba(uint8_t *out, uint8_t *in, int width, int height,
+	int matrix, int range)
+{
+	yu12_to_rgba(out, in, width, height, matrix, range);
+}
+
 /*
  * get requested frame format
  * args:
@@ -1733,9 +2381,26 @@ static void clean_v4l2_dev(v4l2_dev_t *vd)
 	if(vd->list_stream_formats)
 		free_frame_formats(vd);
 
+	save_queue_destroy(vd->save_queue);
+	vd->save_queue = NULL;
+	save_image_jpeg_clean_cache();
+	save_image_png_clean();
+
 	if(vd->frame_queue)
 		free(vd->frame_queue);
 
+	if(vd->decoder_pool)
+		decoder_pool_destroy(vd->decoder_pool);
+	vd->decoder_pool = NULL;
+
+	/*close the event set*/
+	if(vd->epoll_fd > 0)
+	{
+		remove_device_list_watch(vd->epoll_fd);
+		close(vd->epoll_fd);
+	}
+	vd->epoll_fd = 0;
+
 	/*close descriptor*/
 	if(vd->fd > 0)
 		v4l2_close(vd->fd);
@@ -1790,7 +2455,8 @@ v4l2_dev_t* v4l2core_init_dev(const char *device)
 		printf("V4L2_CORE: video device: %s \n", vd->videodevice);
 	}
 
-	vd->frame_queue_size = frame_queue_size;
+	vd->frame_pipeline_size = frame_queue_size;
+	vd->frame_queue_size = frame_queue_size + frame_hold_count;
 	/*alloc frame buffer queue*/
 	vd->frame_queue = calloc(vd->frame_queue_size, sizeof(v4l2_frame_buff_t));
 	
@@ -1817,6 +2483,13 @@ v4l2_dev_t* v4l2core_init_dev(const char *device)
 		return (NULL);
 	}
 
+	/*frame, control and device events*/
+	if(init_events(vd) != E_OK)
+	{
+		clean_v4l2_dev(vd);
+		return (NULL);
+	}
+
 	vd->this_device = v4l2core_get_device_index(vd->videodevice);
 	if(vd->this_device < 0)
 		vd->this_device = 0;
@@ -1843,10 +2516,13 @@ v4l2_dev_t* v4l2core_init_dev(const char *device)
 		return (NULL);
 	}
 
+	vd->nb_buffers = NB_BUFFER;
+
 	int i = 0;
-	for (i = 0; i < NB_BUFFER; i++)
+	for (i = 0; i < NB_BUFFER_MAX; i++)
 	{
 		vd->mem[i] = MAP_FAILED; /*not mmaped yet*/
+		vd->buff_fd[i] = -1; /*not exported*/
 	}
 
 	return (vd);
@@ -1942,9 +2618,42 @@ int v4l2core_check_control_events(v4l2_dev_t *vd)
 		}
 	}
 
+	/*watch for the next events*/
+	if(vd->epoll_fd > 0)
+		watch_device_events(vd, EPOLL_CTL_MOD, 1);
+
 	return ret;
 }
 
+/*
+ * set the core event callback
+ *   the frame wait also watches control and device events and calls
+ *   the callback as soon as they are pending; the callback runs in the
+ *   capture thread, so it should only schedule the matching
+ *   v4l2core_check_xxx_events call (watching stops until it's made)
+ * args:
+ *   vd - pointer to v4l2 device handler
+ *   callback - event callback (NULL to disable)
+ *   data - user data passed to the callback
+ *
+ * asserts:
+ *   vd is not null
+ *
+ * returns: none
+ */
+void v4l2core_set_event_callback(v4l2_dev_t *vd, v4l2core_event_callback_t callback, void *data)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	/*lock the mutex*/
+	__LOCK_MUTEX( __PMUTEX );
+	vd->event_callback = callback;
+	vd->event_callback_data = data;
+	/*unlock the mutex*/
+	__UNLOCK_MUTEX( __PMUTEX );
+}
+
 /*
  * get device pan step value
  * args:
@@ -2072,6 +2781,13 @@ void v4l2core_clean_buffers(v4l2_dev_t *vd)
 	if(vd->streaming == STRM_OK)
 		v4l2core_stop_stream(vd);
 
+	/*queued images may reference frames*/
+	save_queue_flush(vd->save_queue);
+
+	/*stop decoding before freeing the frame buffers*/
+	decode_stage_destroy(vd->decode_stage);
+	vd->decode_stage = NULL;
+
 	clean_v4l2_frames(vd);
 
 	// unmap queue buffers
@@ -2092,11 +2808,12 @@ void v4l2core_clean_buffers(v4l2_dev_t *vd)
 			memset(&vd->rb, 0, sizeof(struct v4l2_requestbuffers));
 			vd->rb.count = 0;
 			vd->rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-			vd->rb.memory = V4L2_MEMORY_MMAP;
+			vd->rb.memory = get_buff_memory(vd);
 			if(xioctl(vd->fd, VIDIOC_REQBUFS, &vd->rb)<0)
 			{
 				fprintf(stderr, "V4L2_CORE: (VIDIOC_REQBUFS) Failed to delete buffers: %s (errno %d)\n", strerror(errno), errno);
 			}
+			vd->buff_count = 0;
 			break;
 	}
 }
@@ -2115,6 +2832,9 @@ void v4l2core_close_dev(v4l2_dev_t *vd)
 	if(vd == NULL)
 		return;
 
+	/*queued images release their frame references (locks the mutex)*/
+	save_queue_flush(vd->save_queue);
+
 	/* thread must be joined before destroying the mutex
          * so no need to unlock before destroying it
          */
@@ -2280,6 +3000,99 @@ int v4l2core_save_image(
 	return save_frame_image(frame, filename, format);
 }
 
+/*
+ * queue the frame to be saved to file by the save queue workers
+ *   (image encoding and file writing don't block the caller)
+ *   the frame is referenced if it leaves a free frame for capture,
+ *   or else its data is copied, so it can be released right after this call
+ * args:
+ *    vd - pointer to v4l2 device handler
+ *    frame - pointer to frame buffer
+ *    filename - output file name
+ *    format - image type
+ *           (IMG_FMT_RAW, IMG_FMT_JPG, IMG_FMT_PNG, IMG_FMT_BMP)
+ *    copy - copy the frame data, even if it could be referenced
+ *           (set it if the frame data is changed after this call)
+ *    callback - called (from a worker thread) when the image is saved (can be NULL)
+ *    data - callback user data
+ *
+ * asserts:
+ *    vd is not null
+ *    frame is not null
+ *    filename is not null
+ *
+ * returns: error code (E_QUEUE_FULL_ERR if too many images are pending)
+ */
+int v4l2core_save_image_async(
+	v4l2_dev_t *vd,
+	v4l2_frame_buff_t *frame,
+	const char *filename,
+	int format,
+	int copy,
+	v4l2core_save_image_callback_t callback,
+	void *data)
+{
+	/*assertions*/
+	assert(vd != NULL);
+	assert(frame != NULL);
+	assert(filename != NULL);
+
+	if(vd->save_queue == NULL)
+	{
+		/*leave a cpu for capture and decoding*/
+		long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		int nworkers = (ncpu > 1) ? (int) (ncpu - 1) : 1;
+
+		vd->save_queue = save_queue_create(vd, nworkers);
+		if(vd->save_queue == NULL)
+		{
+			fprintf(stderr, "V4L2_CORE: couldn't create save queue: saving image in place\n");
+			int ret = save_frame_image(frame, filename, format);
+			if(callback)
+				callback(filename, ret, data);
+			return ret;
+		}
+	}
+
+	return save_queue_add(vd->save_queue, frame, filename, format, copy, callback, data);
+}
+
+/*
+ * get the number of queued images (v4l2core_save_image_async) not yet saved
+ * args:
+ *    vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns: number of pending images
+ */
+int v4l2core_get_save_image_pending(v4l2_dev_t *vd)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	return save_queue_get_pending(vd->save_queue);
+}
+
+/*
+ * wait for all the queued images (v4l2core_save_image_async) to be saved
+ * args:
+ *    vd - pointer to v4l2 device handler
+ *
+ * asserts:
+ *    vd is not null
+ *
+ * returns: none
+ */
+void v4l2core_flush_save_image(v4l2_dev_t *vd)
+{
+	/*assertions*/
+	assert(vd != NULL);
+
+	save_queue_flush(vd->save_queue);
+}
+
 /*
  * get h264 unit id
  * args:
@@ -24,6 +24,9 @@
 
 #include "gviewv4l2core.h"
 #include "gview.h"
+#include "decoder_pool.h"
+#include "decode_stage.h"
+#include "save_queue.h"
 
 /*
  * video device data
@@ -35,7 +38,7 @@ struct _v4l2_dev_t
 	
 	__MUTEX_TYPE mutex;                // device mutex
 
-	int cap_meth;                       // capture method: IO_READ or IO_MMAP
+	int cap_meth;                       // capture method: IO_READ, IO_MMAP, IO_USERPTR or IO_DMABUF
 	v4l2_stream_formats_t* list_stream_formats; //list of available stream formats
 	int numb_formats;                   //list size
 	//int current_format_index;           //index of current stream format
@@ -48,6 +51,10 @@ struct _v4l2_dev_t
 	struct v4l2_streamparm streamparm;   // v4l2 stream parameters struct
 	struct v4l2_event_subscription evsub;// v4l2 event subscription struct
 
+	int epoll_fd;                       // epoll set for frame, control and device events
+	v4l2core_event_callback_t event_callback; // core event callback (can be NULL)
+	void *event_callback_data;          // core event callback user data
+
 	int requested_fmt;                  //requested format (may differ from format.fmt.pix.pixelformat)
 
 	int fps_num;                        //fps numerator
@@ -55,14 +62,25 @@ struct _v4l2_dev_t
 	
 	double real_fps;                    //real fps (calculated from number of captured frames)
 
+	int yuv_matrix;                     //yuv color matrix: YUV_MATRIX_BT601 ; YUV_MATRIX_BT709
+	int yuv_range;                      //yuv quantization range: YUV_RANGE_FULL ; YUV_RANGE_LIMITED
+
+	decoder_pool_t *decoder_pool;       //frame decoder thread pool (NULL = single thread)
+
 	uint8_t streaming;                  // flag device stream : STRM_STOP ; STRM_REQ_STOP; STRM_OK
 	uint64_t frame_index;               // captured frame index from 0 to max(uint64_t)
-	void *mem[NB_BUFFER];               // memory buffers for mmap driver frames
-	uint32_t buff_length[NB_BUFFER];    // memory buffers length as set by VIDIOC_QUERYBUF
-	uint32_t buff_offset[NB_BUFFER];    // memory buffers offset as set by VIDIOC_QUERYBUF
+	int nb_buffers;                     // number of driver buffers to request
+	int buff_count;                     // number of driver buffers granted by VIDIOC_REQBUFS
+	void *mem[NB_BUFFER_MAX];           // memory buffers for mmap driver frames (or userptr pool)
+	uint32_t buff_length[NB_BUFFER_MAX];// memory buffers length as set by VIDIOC_QUERYBUF
+	uint32_t buff_offset[NB_BUFFER_MAX];// memory buffers offset as set by VIDIOC_QUERYBUF
+	int buff_fd[NB_BUFFER_MAX];         // dmabuf fds exported with VIDIOC_EXPBUF (IO_DMABUF)
 
 	v4l2_frame_buff_t *frame_queue;     //frame queue
-	int frame_queue_size;               //size of frame queue (in frames)
+	int frame_queue_size;               //size of frame queue (in frames, including held frames)
+	int frame_pipeline_size;            //frames in the decode pipeline (frame_queue_size - held frames)
+	decode_stage_t *decode_stage;       //pipelined decoding (frame_queue_size > 1)
+	save_queue_t *save_queue;           //asynchronous image saving (created on first use)
 
 	uint8_t h264_unit_id;  				// uvc h264 unit id, if <= 0 then uvc h264 is not supported
 	uint8_t h264_no_probe_default;      // flag core to use the preset h264_config_probe_req data (don't reset to default before commit)
@@ -27,6 +27,7 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <sys/epoll.h>
 
 #include "gviewv4l2core.h"
 #include "v4l2_devices.h"
@@ -337,6 +338,77 @@ int v4l2core_get_device_index(const char *videodevice)
 	return -1;
 }
 
+/*
+ * (re)arm the one shot udev monitor watch
+ * args:
+ *   op - epoll_ctl operation (EPOLL_CTL_ADD or EPOLL_CTL_MOD)
+ *
+ * asserts:
+ *   none
+ *
+ * returns: epoll_ctl result
+ */
+static int arm_device_list_watch(int op)
+{
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.fd = my_device_list.udev_fd;
+
+	return epoll_ctl(my_device_list.events_fd, op, my_device_list.udev_fd, &ev);
+}
+
+/*
+ * watch the udev monitor in a epoll set
+ *   the watch is one shot and rearmed by check_device_list_events
+ * args:
+ *   epoll_fd - epoll set descriptor
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code (0 - E_OK)
+ */
+int add_device_list_watch(int epoll_fd)
+{
+	if(my_device_list.udev_fd <= 0)
+		return E_DEVICE_ERR;
+
+	/*only one set can watch the monitor*/
+	if(my_device_list.events_fd > 0)
+		remove_device_list_watch(my_device_list.events_fd);
+
+	my_device_list.events_fd = epoll_fd;
+
+	if(arm_device_list_watch(EPOLL_CTL_ADD) < 0)
+	{
+		fprintf(stderr, "V4L2_CORE: couldn't watch device events: %s\n", strerror(errno));
+		my_device_list.events_fd = 0;
+		return E_UNKNOWN_ERR;
+	}
+
+	return E_OK;
+}
+
+/*
+ * stop watching the udev monitor in a epoll set
+ * args:
+ *   epoll_fd - epoll set descriptor
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void remove_device_list_watch(int epoll_fd)
+{
+	if(epoll_fd <= 0 || my_device_list.events_fd != epoll_fd)
+		return;
+
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, my_device_list.udev_fd, NULL);
+	my_device_list.events_fd = 0;
+}
+
 /*
  * check for new devices
  * args:
@@ -403,30 +475,42 @@ int check_device_list_events(v4l2_dev_t *vd)
 	   }
 			
             udev_device_unref(dev);
-
-            return(1);
+            ret = 1;
         }
         else
+        {
             fprintf(stderr, "V4L2_CORE: No Device from receive_device(). An error occured.\n");
+            ret = 0;
+        }
     }
+    else
+        ret = 0;
+
+    /*watch for the next event*/
+    if(my_device_list.events_fd > 0)
+        arm_device_list_watch(EPOLL_CTL_MOD);
 
-    return(0);
+    return(ret);
 }
 
 /*
  * close v4l2 devices list
+ *   (also called by the library destructor: the list may not exist,
+ *    e.g. in programs that only use the decoders - tests, benchmarks)
  * args:
  *   none
  *
  * asserts:
- *   vd->list_devices is not null
+ *   none
  *
  * returns: void
  */
 void v4l2core_close_v4l2_device_list()
 {
-	free_device_list();
+	if(my_device_list.list_devices != NULL)
+		free_device_list();
 	
 	if (my_device_list.udev)
 		udev_unref(my_device_list.udev);
+	my_device_list.udev = NULL;
 }
@@ -33,6 +33,7 @@ typedef struct _v4l2_device_list_t
 	struct udev *udev;                  // pointer to a udev struct (lib udev)
     struct udev_monitor *udev_mon;      // udev monitor
     int udev_fd;                        // udev monitor file descriptor
+    int events_fd;                      // epoll set watching udev_fd (0 if none)
     v4l2_dev_sys_data_t* list_devices;  // list of available v4l2 devices
     int num_devices;                    // number of available v4l2 devices
 } v4l2_device_list_t;
@@ -102,4 +103,29 @@ int enum_v4l2_devices();
  */
 int check_device_list_events(v4l2_dev_t *vd);
 
+/*
+ * watch the udev monitor in a epoll set
+ *   the watch is one shot and rearmed by check_device_list_events
+ * args:
+ *   epoll_fd - epoll set descriptor
+ *
+ * asserts:
+ *   none
+ *
+ * returns: error code (0 - E_OK)
+ */
+int add_device_list_watch(int epoll_fd);
+
+/*
+ * stop watching the udev monitor in a epoll set
+ * args:
+ *   epoll_fd - epoll set descriptor
+ *
+ * asserts:
+ *   none
+ *
+ * returns: none
+ */
+void remove_device_list_watch(int epoll_fd);
+
 #endif
@@ -72,6 +72,8 @@
 #define __THREAD_CREATE(t,f,d) (pthread_create(t,NULL,f,d))
 #define __THREAD_CREATE_ATTRIB(t,a,f,d) (pthread_create(t,a,f,d))
 #define __THREAD_JOIN(t) (pthread_join(t, NULL))
+#define __THREAD_DETACH(t) (pthread_detach(t))
+#define __THREAD_SELF() (pthread_self())
 
 #define __ATTRIB_TYPE pthread_attr_t
 #define __INIT_ATTRIB(t) (pthread_attr_init(t))
@@ -84,14 +86,20 @@
 #define __CLOSE_MUTEX(m) ( pthread_mutex_destroy(m) )
 #define __LOCK_MUTEX(m) ( pthread_mutex_lock(m) )
 #define __UNLOCK_MUTEX(m) ( pthread_mutex_unlock(m) )
+#define __TRYLOCK_MUTEX(m) ( pthread_mutex_trylock(m) )
 
 #define __COND_TYPE pthread_cond_t
 #define __INIT_COND(c)  ( pthread_cond_init (c, NULL) )
 #define __CLOSE_COND(c) ( pthread_cond_destroy(c) )
 #define __COND_BCAST(c) ( pthread_cond_broadcast(c) )
 #define __COND_SIGNAL(c) ( pthread_cond_signal(c) )
+#define __COND_WAIT(c,m) ( pthread_cond_wait(c,m) )
 #define __COND_TIMED_WAIT(c,m,t) ( pthread_cond_timedwait(c,m,t) )
 
+#define __ONCE_TYPE pthread_once_t
+#define __STATIC_ONCE_INIT PTHREAD_ONCE_INIT
+#define __ONCE(o,f) ( pthread_once(o,f) )
+
 /*next index of ring buffer with size elements*/
 #define NEXT_IND(ind,size) ind++;if(ind>=size) ind=0
 /*previous index of ring buffer with size elements*/
@@ -0,0 +1,427 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*
+ * checks that the vectorized audio sample conversions (sse2, neon)
+ *  are bit exact with the scalar references: float to int16 rounds
+ *  like lroundf(sample * INT16_MAX) (saturated to the int16 range),
+ *  (de)interleaving float samples is an exact copy
+ *
+ * the inputs hold the values lroundf rounds away from zero (exact
+ *  halves), their neighbours, out of range and infinite samples;
+ *  the sizes cover every remainder of the simd loops and the
+ *  channel counts with and without a simd path
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <float.h>
+
+#include "gview.h"
+#include "audio_convert.h"
+
+#define GUARD_SIZE (64)
+#define GUARD_BYTE (0xA5)
+
+#define MAX_CHANNELS (8)
+
+static const float special_samples[] =
+{
+	0.0f, -0.0f, 1.0f, -1.0f, 0.5f, -0.5f,
+	1.0001f, -1.0001f, 2.0f, -2.0f, 1e30f, -1e30f,
+	FLT_MAX, -FLT_MAX, FLT_MIN, -FLT_MIN, 1e-40f, -1e-40f,
+	0.5f / INT16_MAX, -0.5f / INT16_MAX, 1.5f / INT16_MAX, -1.5f / INT16_MAX,
+	INFINITY, -INFINITY
+};
+
+#define N_SPECIAL (int)(sizeof(special_samples)/sizeof(float))
+
+/*sample counts: every remainder of the 8 sample loops and odd sizes*/
+static const int sample_counts[] = {0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 63, 1021, 4099};
+
+#define N_COUNTS (int)(sizeof(sample_counts)/sizeof(int))
+
+/*
+ * scalar reference: float to int16
+ * args:
+ *    in - float sample
+ *
+ * asserts:
+ *    none
+ *
+ * returns: int16 sample
+ */
+static int16_t ref_s16(float in)
+{
+	float x = in * INT16_MAX;
+
+	/*saturate before rounding: lroundf is undefined out of the long range*/
+	if(x >= INT16_MAX)
+		return INT16_MAX;
+	if(x <= INT16_MIN)
+		return INT16_MIN;
+
+	return (int16_t) lroundf(x);
+}
+
+/*
+ * fill a buffer with special and pseudo random samples in [-1.25, 1.25]
+ * args:
+ *    buf - pointer to buffer
+ *    samples - number of samples
+ *    seed - pointer to the generator state
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void fill_samples(float *buf, int samples, uint32_t *seed)
+{
+	int i = 0;
+	for(i = 0; i < samples; i++)
+	{
+		*seed = *seed * 1664525 + 1013904223;
+		if((*seed >> 28) < 4)
+			buf[i] = special_samples[(*seed >> 8) % N_SPECIAL];
+		else
+			buf[i] = ((float) (*seed >> 8) / (float) (1 << 24)) * 2.5f - 1.25f;
+	}
+}
+
+/*
+ * allocate a buffer with guard bytes at the end
+ * args:
+ *    size - buffer size (without guard)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: pointer to buffer (filled with the guard byte)
+ */
+static void *alloc_guarded(size_t size)
+{
+	uint8_t *buf = malloc(size + GUARD_SIZE);
+	if(buf == NULL)
+	{
+		fprintf(stderr, "FAIL: memory allocation failure\n");
+		exit(-1);
+	}
+
+	memset(buf, GUARD_BYTE, size + GUARD_SIZE);
+	return buf;
+}
+
+/*
+ * check that the guard bytes after a buffer are untouched
+ * args:
+ *    buf - pointer to buffer
+ *    size - buffer size (without guard)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: TRUE if the guard is intact
+ */
+static int guard_intact(const void *buf, size_t size)
+{
+	const uint8_t *p = (const uint8_t *) buf;
+	int i = 0;
+	for(i = 0; i < GUARD_SIZE; i++)
+		if(p[size + i] != GUARD_BYTE)
+			return FALSE;
+
+	return TRUE;
+}
+
+/*
+ * compare an int16 conversion with the reference
+ * args:
+ *    name - conversion name
+ *    out - pointer to converted samples
+ *    ref - pointer to reference samples
+ *    in - pointer to input samples (in the order of ref)
+ *    samples - number of samples
+ *    channels - number of channels
+ *
+ * asserts:
+ *    none
+ *
+ * returns: TRUE if equal and the guard is intact
+ */
+static int check_s16(const char *name, const int16_t *out, const int16_t *ref,
+	const float *in, int samples, int channels)
+{
+	int i = 0;
+	for(i = 0; i < samples; i++)
+		if(out[i] != ref[i])
+		{
+			fprintf(stderr, "FAIL: %s %i samples %i channels: sample %i (%.9g) is %i not %i\n",
+				name, samples, channels, i, in[i], out[i], ref[i]);
+			return FALSE;
+		}
+
+	if(!guard_intact(out, samples * sizeof(int16_t)))
+	{
+		fprintf(stderr, "FAIL: %s %i samples %i channels: write past the end\n",
+			name, samples, channels);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * float to int16: every value rounding to an exact half and its neighbours
+ * args:
+ *    none
+ *
+ * asserts:
+ *    none
+ *
+ * returns: TRUE on success
+ */
+static int test_s16_halves()
+{
+	int samples = 3 * (INT16_MAX - INT16_MIN + 2);
+	float *in = malloc(samples * sizeof(float));
+	int16_t *ref = malloc(samples * sizeof(int16_t));
+	int16_t *out = alloc_guarded(samples * sizeof(int16_t));
+	if(!in || !ref)
+	{
+		fprintf(stderr, "FAIL: memory allocation failure\n");
+		exit(-1);
+	}
+
+	int i = 0;
+	int k = 0;
+	for(k = INT16_MIN - 1; k <= INT16_MAX; k++)
+	{
+		float x = ((float) k + 0.5f) / INT16_MAX;
+		in[i++] = nextafterf(x, -INFINITY);
+		in[i++] = x;
+		in[i++] = nextafterf(x, INFINITY);
+	}
+
+	for(i = 0; i < samples; i++)
+		ref[i] = ref_s16(in[i]);
+
+	audio_convert_float_to_s16(out, in, samples);
+	int ok = check_s16("float_to_s16 (halves)", out, ref, in, samples, 1);
+
+	free(in);
+	free(ref);
+	free(out);
+
+	return ok;
+}
+
+/*
+ * float to int16 (interleaved)
+ * args:
+ *    seed - pointer to the generator state
+ *
+ * asserts:
+ *    none
+ *
+ * returns: TRUE on success
+ */
+static int test_s16(uint32_t *seed)
+{
+	int ok = TRUE;
+	int c = 0;
+
+	for(c = 0; c < N_COUNTS && ok; c++)
+	{
+		int samples = sample_counts[c];
+		float *in = malloc((samples + 1) * sizeof(float));
+		int16_t *ref = malloc((samples + 1) * sizeof(int16_t));
+		int16_t *out = alloc_guarded(samples * sizeof(int16_t));
+		if(!in || !ref)
+		{
+			fprintf(stderr, "FAIL: memory allocation failure\n");
+			exit(-1);
+		}
+
+		fill_samples(in, samples, seed);
+
+		int i = 0;
+		for(i = 0; i < samples; i++)
+			ref[i] = ref_s16(in[i]);
+
+		audio_convert_float_to_s16(out, in, samples);
+		ok = check_s16("float_to_s16", out, ref, in, samples, 1);
+
+		free(in);
+		free(ref);
+		free(out);
+	}
+
+	return ok;
+}
+
+/*
+ * float to int16 planes
+ * args:
+ *    seed - pointer to the generator state
+ *
+ * asserts:
+ *    none
+ *
+ * returns: TRUE on success
+ */
+static int test_s16p(uint32_t *seed)
+{
+	int ok = TRUE;
+	int ch = 0;
+	int c = 0;
+
+	for(ch = 1; ch <= MAX_CHANNELS && ok; ch++)
+		for(c = 0; c < N_COUNTS && ok; c++)
+		{
+			int frames = sample_counts[c];
+			int samples = frames * ch;
+			float *in = malloc((samples + 1) * sizeof(float));
+			float *in_p = malloc((samples + 1) * sizeof(float)); //input in plane order
+			int16_t *ref = malloc((samples + 1) * sizeof(int16_t));
+			int16_t *out = alloc_guarded(samples * sizeof(int16_t));
+			if(!in || !in_p || !ref)
+			{
+				fprintf(stderr, "FAIL: memory allocation failure\n");
+				exit(-1);
+			}
+
+			fill_samples(in, samples, seed);
+
+			int i = 0, j = 0;
+			for(i = 0; i < frames; i++)
+				for(j = 0; j < ch; j++)
+				{
+					in_p[j * frames + i] = in[i * ch + j];
+					ref[j * frames + i] = ref_s16(in[i * ch + j]);
+				}
+
+			audio_convert_float_to_s16p(out, in, frames, ch);
+			ok = check_s16("float_to_s16p", out, ref, in_p, samples, ch);
+
+			free(in);
+			free(in_p);
+			free(ref);
+			free(out);
+		}
+
+	return ok;
+}
+
+/*
+ * float (de)interleave: float to float planes and back
+ * args:
+ *    seed - pointer to the generator state
+ *
+ * asserts:
+ *    none
+ *
+ * returns: TRUE on success
+ */
+static int test_fltp(uint32_t *seed)
+{
+	int ok = TRUE;
+	int ch = 0;
+	int c = 0;
+
+	for(ch = 1; ch <= MAX_CHANNELS && ok; ch++)
+		for(c = 0; c < N_COUNTS && ok; c++)
+		{
+			int frames = sample_counts[c];
+			int samples = frames * ch;
+			size_t size = samples * sizeof(float);
+			float *in = malloc(size + sizeof(float));
+			float *ref = malloc(size + sizeof(float));
+			float *planes = alloc_guarded(size);
+			float *out = alloc_guarded(size);
+			if(!in || !ref)
+			{
+				fprintf(stderr, "FAIL: memory allocation failure\n");
+				exit(-1);
+			}
+
+			fill_samples(in, samples, seed);
+
+			int i = 0, j = 0;
+			for(i = 0; i < frames; i++)
+				for(j = 0; j < ch; j++)
+					ref[j * frames + i] = in[i * ch + j];
+
+			audio_convert_float_to_fltp(planes, in, frames, ch);
+			if(memcmp(planes, ref, size) != 0 || !guard_intact(planes, size))
+			{
+				fprintf(stderr, "FAIL: float_to_fltp %i frames %i channels\n", frames, ch);
+				ok = FALSE;
+			}
+
+			audio_convert_fltp_to_float(out, ref, frames, ch);
+			if(memcmp(out, in, size) != 0 || !guard_intact(out, size))
+			{
+				fprintf(stderr, "FAIL: fltp_to_float %i frames %i channels\n", frames, ch);
+				ok = FALSE;
+			}
+
+			free(in);
+			free(ref);
+			free(planes);
+			free(out);
+		}
+
+	return ok;
+}
+
+int main()
+{
+#if !defined(__SSE2__) && !defined(__aarch64__)
+	printf("SKIP: no simd audio conversion in this build\n");
+	return 77; /*automake: test skipped*/
+#else
+	uint32_t seed = 0x12345678;
+	int failed = 0;
+	int ok = TRUE;
+
+	ok = test_s16_halves();
+	printf("%s: float_to_s16 (exact halves)\n", ok ? "PASS" : "FAIL");
+	failed += !ok;
+
+	ok = test_s16(&seed);
+	printf("%s: float_to_s16\n", ok ? "PASS" : "FAIL");
+	failed += !ok;
+
+	ok = test_s16p(&seed);
+	printf("%s: float_to_s16p\n", ok ? "PASS" : "FAIL");
+	failed += !ok;
+
+	ok = test_fltp(&seed);
+	printf("%s: float_to_fltp, fltp_to_float\n", ok ? "PASS" : "FAIL");
+	failed += !ok;
+
+	return failed ? 1 : 0;
+#endif
+}
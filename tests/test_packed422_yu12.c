@@ -0,0 +1,206 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*
+ * checks that every simd packed 422 to yu12 kernel usable on the
+ *  running cpu is bit exact with the scalar reference conversion
+ *
+ * packed 422 lines hold two pixel macropixels and yu12 chroma is
+ *  averaged over line pairs, so frame dimensions are always even;
+ *  the sizes below cover odd chroma widths and heights and every
+ *  remainder of the 16 and 32 pixel simd loops
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "gview.h"
+#include "colorspaces.h"
+#include "cpu_features.h"
+
+#define GUARD_SIZE (64)
+#define GUARD_BYTE (0xA5)
+
+typedef void (*yu12_conv_t)(uint8_t *out, uint8_t *in, int width, int height);
+
+typedef struct _conv_test_t
+{
+	const char *name;
+	yu12_conv_t conv; //dispatching converter
+	yu12_conv_t conv_c; //scalar reference
+} conv_test_t;
+
+typedef struct _simd_path_t
+{
+	const char *name;
+	uint32_t mask; //features allowed for this path
+	uint32_t need; //features needed to run it
+} simd_path_t;
+
+static const conv_test_t conv_tests[] =
+{
+	{"yuyv", yuyv_to_yu12, yuyv_to_yu12_c},
+	{"yvyu", yvyu_to_yu12, yvyu_to_yu12_c},
+	{"uyvy", uyvy_to_yu12, uyvy_to_yu12_c},
+	{"vyuy", vyuy_to_yu12, vyuy_to_yu12_c},
+};
+
+static const simd_path_t simd_paths[] =
+{
+	{"avx2", CPU_FEATURE_AVX2 | CPU_FEATURE_SSE2, CPU_FEATURE_AVX2},
+	{"sse2", CPU_FEATURE_SSE2, CPU_FEATURE_SSE2},
+	{"neon", CPU_FEATURE_NEON, CPU_FEATURE_NEON},
+};
+
+static const int frame_sizes[][2] =
+{
+	{2, 2}, {6, 2}, {2, 6}, {14, 6}, {16, 2}, {18, 10},
+	{30, 22}, {32, 4}, {34, 34}, {46, 14}, {62, 6}, {66, 18},
+	{98, 50}, {642, 482}, {1282, 722}, {1920, 1080},
+};
+
+/*
+ * fill a buffer with pseudo random data (fixed seed)
+ * args:
+ *    buf - pointer to buffer
+ *    size - buffer size
+ *    seed - pointer to the generator state
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void fill_random(uint8_t *buf, size_t size, uint32_t *seed)
+{
+	size_t i = 0;
+	for(i = 0; i < size; i++)
+	{
+		*seed = *seed * 1664525 + 1013904223;
+		buf[i] = (uint8_t) (*seed >> 24);
+	}
+}
+
+/*
+ * check that the guard bytes after a buffer are untouched
+ * args:
+ *    buf - pointer to buffer
+ *    size - buffer size (without guard)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: TRUE if the guard is intact
+ */
+static int guard_intact(const uint8_t *buf, size_t size)
+{
+	int i = 0;
+	for(i = 0; i < GUARD_SIZE; i++)
+		if(buf[size + i] != GUARD_BYTE)
+			return FALSE;
+
+	return TRUE;
+}
+
+int main()
+{
+	uint32_t features = get_cpu_features();
+	uint32_t seed = 0x12345678;
+	int npaths = 0;
+	int failed = 0;
+
+	size_t p = 0, t = 0, s = 0;
+	for(p = 0; p < sizeof(simd_paths)/sizeof(simd_paths[0]); p++)
+	{
+		if(!(features & simd_paths[p].need))
+		{
+			printf("SKIP: %s kernels (not supported by the cpu)\n", simd_paths[p].name);
+			continue;
+		}
+
+		npaths++;
+		set_cpu_features_mask(simd_paths[p].mask);
+
+		for(t = 0; t < sizeof(conv_tests)/sizeof(conv_tests[0]); t++)
+		{
+			int ok = TRUE;
+
+			for(s = 0; s < sizeof(frame_sizes)/sizeof(frame_sizes[0]); s++)
+			{
+				int width = frame_sizes[s][0];
+				int height = frame_sizes[s][1];
+				size_t in_size = (size_t) width * height * 2;
+				size_t out_size = ((size_t) width * height * 3) / 2;
+
+				uint8_t *in = malloc(in_size);
+				uint8_t *ref = malloc(out_size + GUARD_SIZE);
+				uint8_t *out = malloc(out_size + GUARD_SIZE);
+				if(!in || !ref || !out)
+				{
+					fprintf(stderr, "FAIL: memory allocation failure\n");
+					exit(-1);
+				}
+
+				fill_random(in, in_size, &seed);
+				memset(ref, GUARD_BYTE, out_size + GUARD_SIZE);
+				memset(out, GUARD_BYTE, out_size + GUARD_SIZE);
+
+				conv_tests[t].conv_c(ref, in, width, height);
+				conv_tests[t].conv(out, in, width, height);
+
+				if(memcmp(ref, out, out_size) != 0)
+				{
+					size_t i = 0;
+					while(ref[i] == out[i])
+						i++;
+					fprintf(stderr, "FAIL: %s %s %ix%i: first mismatch at byte %zu (%i != %i)\n",
+						simd_paths[p].name, conv_tests[t].name, width, height,
+						i, out[i], ref[i]);
+					ok = FALSE;
+				}
+				else if(!guard_intact(out, out_size))
+				{
+					fprintf(stderr, "FAIL: %s %s %ix%i: write past the end of the frame\n",
+						simd_paths[p].name, conv_tests[t].name, width, height);
+					ok = FALSE;
+				}
+
+				free(in);
+				free(ref);
+				free(out);
+			}
+
+			printf("%s: %s %s_to_yu12\n", ok ? "PASS" : "FAIL",
+				simd_paths[p].name, conv_tests[t].name);
+			if(!ok)
+				failed++;
+		}
+	}
+
+	set_cpu_features_mask(~((uint32_t) 0));
+
+	if(!npaths)
+		return 77; /*automake: test skipped*/
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,397 @@
+/*******************************************************************************#
+#           guvcview              http://guvcview.sourceforge.net               #
+#                                                                               #
+#           Paulo Assis <pj.assis@gmail.com>                                    #
+#                                                                               #
+# This program is free software; you can redistribute it and/or modify          #
+# it under the terms of the GNU General Public License as published by          #
+# the Free Software Foundation; either version 2 of the License, or             #
+# (at your option) any later version.                                           #
+#                                                                               #
+# This program is distributed in the hope that it will be useful,               #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of                #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                 #
+# GNU General Public License for more details.                                  #
+#                                                                               #
+# You should have received a copy of the GNU General Public License             #
+# along with this program; if not, write to the Free Software                   #
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA     #
+#                                                                               #
+********************************************************************************/
+
+/*
+ * checks the fixed point yu12 to rgb conversions (yu12_to_rgb24,
+ *  yu12_to_dib24, yu12_to_rgba) on every path usable on the running cpu
+ *
+ * every simd kernel must be bit exact with the scalar conversion; every
+ *  path must stay within YU12_RGB_TOLERANCE of the correctly rounded
+ *  floating point formula for all four encodings (every y, u, v value)
+ *  and within YU12_RGB_OLD_TOLERANCE of the previous double precision
+ *  BT.601 conversion, which truncated instead of rounding
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include "gview.h"
+#include "gviewv4l2core.h"
+#include "colorspaces.h"
+#include "cpu_features.h"
+
+#define GUARD_SIZE (64)
+#define GUARD_BYTE (0xA5)
+
+/*max deviation from the correctly rounded floating point formula*/
+#define YU12_RGB_TOLERANCE (1)
+/*max deviation from the previous (truncating) double precision formula*/
+#define YU12_RGB_OLD_TOLERANCE (2)
+
+/*
+ * exhaustive frames: the 256x256 chroma plane holds every (u, v) pair
+ *  and each 2x2 luma block 4 consecutive y values, so 64 frames
+ *  cover every (y, u, v) combination
+ */
+#define ALL_WIDTH  (512)
+#define ALL_HEIGHT (512)
+#define ALL_FRAMES (64)
+
+typedef void (*yu12_rgb_conv_t)(uint8_t *out, uint8_t *in, int width, int height,
+	int matrix, int range);
+
+typedef struct _conv_test_t
+{
+	const char *name;
+	yu12_rgb_conv_t conv;
+	int bpp; //output bytes per pixel
+} conv_test_t;
+
+typedef struct _simd_path_t
+{
+	const char *name;
+	uint32_t mask; //features allowed for this path
+	uint32_t need; //features needed to run it
+} simd_path_t;
+
+static const conv_test_t conv_tests[] =
+{
+	{"yu12_to_rgb24", yu12_to_rgb24, 3},
+	{"yu12_to_dib24", yu12_to_dib24, 3},
+	{"yu12_to_rgba",  yu12_to_rgba,  4},
+};
+
+static const simd_path_t simd_paths[] =
+{
+	{"scalar", CPU_FEATURE_NONE, CPU_FEATURE_NONE},
+	{"ssse3", CPU_FEATURE_SSSE3 | CPU_FEATURE_SSE2, CPU_FEATURE_SSSE3},
+	{"sse2", CPU_FEATURE_SSE2, CPU_FEATURE_SSE2},
+	{"neon", CPU_FEATURE_NEON, CPU_FEATURE_NEON},
+};
+
+static const int frame_sizes[][2] =
+{
+	{2, 2}, {6, 2}, {2, 6}, {14, 6}, {16, 2}, {18, 10},
+	{30, 22}, {32, 4}, {34, 34}, {46, 14}, {62, 6}, {66, 18},
+	{98, 50}, {642, 482}, {1282, 722},
+};
+
+/*Kr, Kb for each matrix (YUV_MATRIX_XXX)*/
+static const double matrix_k[2][2] =
+{
+	{0.299, 0.114},   /*BT.601*/
+	{0.2126, 0.0722}  /*BT.709*/
+};
+
+static const char *encoding_name[2][2] =
+{
+	{"bt601 full", "bt601 limited"},
+	{"bt709 full", "bt709 limited"}
+};
+
+/*
+ * fill a buffer with pseudo random data (fixed seed)
+ * args:
+ *    buf - pointer to buffer
+ *    size - buffer size
+ *    seed - pointer to the generator state
+ *
+ * asserts:
+ *    none
+ *
+ * returns: none
+ */
+static void fill_random(uint8_t *buf, size_t size, uint32_t *seed)
+{
+	size_t i = 0;
+	for(i = 0; i < size; i++)
+	{
+		*seed = *seed * 1664525 + 1013904223;
+		buf[i] = (uint8_t) (*seed >> 24);
+	}
+}
+
+/*
+ * check that the guard bytes after a buffer are untouched
+ * args:
+ *    buf - pointer to buffer
+ *    size - buffer size (without guard)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: TRUE if the guard is intact
+ */
+static int guard_intact(const uint8_t *buf, size_t size)
+{
+	int i = 0;
+	for(i = 0; i < GUARD_SIZE; i++)
+		if(buf[size + i] != GUARD_BYTE)
+			return FALSE;
+
+	return TRUE;
+}
+
+/*
+ * round and clip to a 8 bit value
+ * args:
+ *    value - value to round
+ *
+ * asserts:
+ *    none
+ *
+ * returns: rounded value (0 to 255)
+ */
+static int round_clip(double value)
+{
+	value = floor(value + 0.5);
+	return (value > 255) ? 255 : (value < 0) ? 0 : (int) value;
+}
+
+/*
+ * bit exactness: each conversion compared with the scalar path
+ * args:
+ *    path - pointer to simd path (already allowed)
+ *    seed - pointer to the generator state
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of failed conversions
+ */
+static int test_bit_exact(const simd_path_t *path, uint32_t *seed)
+{
+	int failed = 0;
+	size_t t = 0, s = 0;
+
+	for(t = 0; t < sizeof(conv_tests)/sizeof(conv_tests[0]); t++)
+	{
+		int ok = TRUE;
+
+		for(s = 0; s < sizeof(frame_sizes)/sizeof(frame_sizes[0]) && ok; s++)
+		{
+			int width = frame_sizes[s][0];
+			int height = frame_sizes[s][1];
+			size_t in_size = ((size_t) width * height * 3) / 2;
+			size_t out_size = (size_t) width * height * conv_tests[t].bpp;
+
+			uint8_t *in = malloc(in_size);
+			uint8_t *ref = malloc(out_size + GUARD_SIZE);
+			uint8_t *out = malloc(out_size + GUARD_SIZE);
+			if(!in || !ref || !out)
+			{
+				fprintf(stderr, "FAIL: memory allocation failure\n");
+				exit(-1);
+			}
+
+			fill_random(in, in_size, seed);
+			memset(out, GUARD_BYTE, out_size + GUARD_SIZE);
+
+			int m = 0, r = 0;
+			for(m = 0; m < 2 && ok; m++)
+				for(r = 0; r < 2 && ok; r++)
+				{
+					set_cpu_features_mask(CPU_FEATURE_NONE);
+					conv_tests[t].conv(ref, in, width, height, m, r);
+					set_cpu_features_mask(path->mask);
+					conv_tests[t].conv(out, in, width, height, m, r);
+
+					if(memcmp(ref, out, out_size) != 0)
+					{
+						size_t i = 0;
+						while(ref[i] == out[i])
+							i++;
+						fprintf(stderr, "FAIL: %s %s %s %ix%i: first mismatch at byte %zu (%i != %i)\n",
+							path->name, conv_tests[t].name, encoding_name[m][r],
+							width, height, i, out[i], ref[i]);
+						ok = FALSE;
+					}
+					else if(!guard_intact(out, out_size))
+					{
+						fprintf(stderr, "FAIL: %s %s %ix%i: write past the end of the frame\n",
+							path->name, conv_tests[t].name, width, height);
+						ok = FALSE;
+					}
+				}
+
+			free(in);
+			free(ref);
+			free(out);
+		}
+
+		printf("%s: %s %s (bit exact with scalar)\n", ok ? "PASS" : "FAIL",
+			path->name, conv_tests[t].name);
+		if(!ok)
+			failed++;
+	}
+
+	return failed;
+}
+
+/*
+ * tolerance: every (y, u, v) value against the floating point formulas
+ * args:
+ *    path - pointer to simd path (already allowed)
+ *
+ * asserts:
+ *    none
+ *
+ * returns: number of failed encodings
+ */
+static int test_tolerance(const simd_path_t *path)
+{
+	int failed = 0;
+	size_t in_size = (ALL_WIDTH * ALL_HEIGHT * 3) / 2;
+	uint8_t *in = malloc(in_size);
+	uint8_t *out = malloc(ALL_WIDTH * ALL_HEIGHT * 3);
+	if(!in || !out)
+	{
+		fprintf(stderr, "FAIL: memory allocation failure\n");
+		exit(-1);
+	}
+
+	uint8_t *pu = in + (ALL_WIDTH * ALL_HEIGHT);
+	uint8_t *pv = pu + ((ALL_WIDTH * ALL_HEIGHT) / 4);
+
+	int h = 0, w = 0;
+	for(h = 0; h < ALL_HEIGHT / 2; h++)
+		for(w = 0; w < ALL_WIDTH / 2; w++)
+		{
+			pu[h * (ALL_WIDTH / 2) + w] = w;
+			pv[h * (ALL_WIDTH / 2) + w] = h;
+		}
+
+	int m = 0, r = 0;
+	for(m = 0; m < 2; m++)
+		for(r = 0; r < 2; r++)
+		{
+			double kr = matrix_k[m][0];
+			double kb = matrix_k[m][1];
+			double kg = 1 - kr - kb;
+			double y_scale = r ? 255.0 / 219 : 1;
+			double c_scale = r ? 255.0 / 224 : 1;
+			double y_off = r ? 16 : 0;
+
+			int max_dev = 0;
+			int max_old_dev = 0;
+
+			int k = 0;
+			for(k = 0; k < ALL_FRAMES; k++)
+			{
+				for(h = 0; h < ALL_HEIGHT; h++)
+					for(w = 0; w < ALL_WIDTH; w++)
+						in[h * ALL_WIDTH + w] = 4 * k + (h & 1) * 2 + (w & 1);
+
+				yu12_to_rgb24(out, in, ALL_WIDTH, ALL_HEIGHT, m, r);
+
+				for(h = 0; h < ALL_HEIGHT; h++)
+					for(w = 0; w < ALL_WIDTH; w++)
+					{
+						int y = in[h * ALL_WIDTH + w];
+						int u = pu[(h / 2) * (ALL_WIDTH / 2) + (w / 2)] - 128;
+						int v = pv[(h / 2) * (ALL_WIDTH / 2) + (w / 2)] - 128;
+						uint8_t *rgb = out + ((h * ALL_WIDTH + w) * 3);
+
+						double yy = (y - y_off) * y_scale;
+						double ref[3] =
+						{
+							yy + 2 * (1 - kr) * v * c_scale,
+							yy - (2 * (1 - kb) * kb / kg) * u * c_scale -
+								(2 * (1 - kr) * kr / kg) * v * c_scale,
+							yy + 2 * (1 - kb) * u * c_scale
+						};
+						/*previous BT.601 full range conversion (truncates)*/
+						double old[3] =
+						{
+							y + 1.402 * v,
+							y - 0.34414 * u - 0.71414 * v,
+							y + 1.772 * u
+						};
+
+						int c = 0;
+						for(c = 0; c < 3; c++)
+						{
+							int dev = abs(rgb[c] - round_clip(ref[c]));
+							if(dev > max_dev)
+								max_dev = dev;
+
+							if(m == YUV_MATRIX_BT601 && r == YUV_RANGE_FULL)
+							{
+								dev = abs(rgb[c] - CLIP(old[c]));
+								if(dev > max_old_dev)
+									max_old_dev = dev;
+							}
+						}
+					}
+			}
+
+			int ok = (max_dev <= YU12_RGB_TOLERANCE);
+			printf("%s: %s %s max deviation %i (tolerance %i)\n", ok ? "PASS" : "FAIL",
+				path->name, encoding_name[m][r], max_dev, YU12_RGB_TOLERANCE);
+			if(!ok)
+				failed++;
+
+			if(m == YUV_MATRIX_BT601 && r == YUV_RANGE_FULL)
+			{
+				ok = (max_old_dev <= YU12_RGB_OLD_TOLERANCE);
+				printf("%s: %s %s max deviation from the previous conversion %i (tolerance %i)\n",
+					ok ? "PASS" : "FAIL", path->name, encoding_name[m][r],
+					max_old_dev, YU12_RGB_OLD_TOLERANCE);
+				if(!ok)
+					failed++;
+			}
+		}
+
+	free(in);
+	free(out);
+
+	return failed;
+}
+
+int main()
+{
+	uint32_t features = get_cpu_features();
+	uint32_t seed = 0x12345678;
+	int failed = 0;
+
+	size_t p = 0;
+	for(p = 0; p < sizeof(simd_paths)/sizeof(simd_paths[0]); p++)
+	{
+		if((features & simd_paths[p].need) != simd_paths[p].need)
+		{
+			printf("SKIP: %s kernels (not supported by the cpu)\n", simd_paths[p].name);
+			continue;
+		}
+
+		if(simd_paths[p].mask != CPU_FEATURE_NONE)
+			failed += test_bit_exact(&simd_paths[p], &seed);
+
+		set_cpu_features_mask(simd_paths[p].mask);
+		failed += test_tolerance(&simd_paths[p]);
+	}
+
+	set_cpu_features_mask(~((uint32_t) 0));
+
+	return failed ? 1 : 0;
+}